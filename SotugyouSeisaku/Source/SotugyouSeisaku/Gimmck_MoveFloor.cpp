@@ -4,19 +4,26 @@
 #include "Components/StaticMeshComponent.h"
 #include "GameFramework/Character.h"
 #include "DrawDebugHelpers.h"
+#include "GimmickEvents.h"
+#include "GimmickSubsystem.h"
+#include "Gimmick_PushBlock.h"
+#include "GimmickMath.h"
+#include "GimmickTypes.h"
 
 /// @brief コンストラクタ　動く床の各種設定
 AGimmck_MoveFloor::AGimmck_MoveFloor()
 {
+	LLM_SCOPE_BYTAG(Gimmick);
+
 	PrimaryActorTick.bCanEverTick = true;
 
-	//ルートコンポーネント作成
-	mRoot = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
-	RootComponent = mRoot;
+	//サーバーから複製するが、動きは時刻表どおり各マシンで進めるので移動は複製しない（状態が変わるまで休止）
+	bReplicates = true;
+	NetDormancy = DORM_Initial;
 
-	//床のメッシュ
+	//床のメッシュ（ルートにする）
 	mMesh = CreateDefaultSubobject<UStaticMeshComponent>(TEXT("FloorMesh"));
-	mMesh->SetupAttachment(RootComponent);
+	RootComponent = mMesh;
 
 	//Movableに設定
 	mMesh->SetMobility(EComponentMobility::Movable);
@@ -28,18 +35,19 @@ AGimmck_MoveFloor::AGimmck_MoveFloor()
 	mMesh->SetGenerateOverlapEvents(true);
 	mMesh->SetSimulatePhysics(false);
 
-	//デフォルト設定
-	mMovementPattern = EFloorMovementPattern::Horizontal_Y;
-	mMoveDistance = 500.0f;
-	mCustomMoveOffset = FVector(0.0f, 500.0f, 0.0f);
-	mMoveSpeed = 200.0f;
-	mWaitTime = 1.0f;
+	//動くたびにナビメッシュを作り直さないよう、ナビゲーションには影響させない
+	//（AIは AGimmickFloorNavLink の時刻表付きリンクで乗り降りする）
+	mMesh->SetCanEverAffectNavigation(false);
+
+	//デフォルト設定（移動の調整は共有設定 mConfig）
 	bAutoStart = true;
 	bMoveActorsOnFloor = true;
 }
 
 void AGimmck_MoveFloor::BeginPlay()
 {
+	LLM_SCOPE_BYTAG(Gimmick);
+
 	Super::BeginPlay();
 
 	//開始位置を保存
@@ -55,63 +63,185 @@ void AGimmck_MoveFloor::BeginPlay()
 		mMesh->OnComponentEndOverlap.AddDynamic(this, &AGimmck_MoveFloor::OnFloorEndOverlap);
 	}
 
-	// 自動開始しない場合は待機状態
-	if (!bAutoStart)
+	// 自動開始しない場合は待機状態（円運動は待機しないので、今まで通りすぐに回り始める）
+	if (!bAutoStart && !IsCircular())
 	{
-		bIsWaiting = true;
+		StartWait(0.0f);
+	}
+
+	//同じメッシュのギミックとまとめて描画する
+	if (bUseInstancedRendering && UGimmickInstanceSubsystem::IsEnabled())
+	{
+		if (UGimmickInstanceSubsystem* Instances = GetWorld()->GetSubsystem<UGimmickInstanceSubsystem>())
+		{
+			mMeshInstance = Instances->AddInstance(mMesh);
+		}
+	}
+
+	//ギミック登録簿に登録（保存されていた状態があればここで復元される）
+	if (UGimmickSubsystem* Gimmicks = GetWorld()->GetSubsystem<UGimmickSubsystem>())
+	{
+		Gimmicks->RegisterGimmick(this);
 	}
 }
 
+void AGimmck_MoveFloor::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UGimmickTimerSubsystem* Timers = GetWorld()->GetSubsystem<UGimmickTimerSubsystem>())
+	{
+		Timers->ClearTimer(mWaitTimer);
+	}
+
+	//共有インスタンスを解放
+	if (UGimmickInstanceSubsystem* Instances = GetWorld()->GetSubsystem<UGimmickInstanceSubsystem>())
+	{
+		Instances->RemoveInstance(mMeshInstance);
+	}
+
+	//ギミック登録簿から削除（ストリーミングで外れる場合は状態を保存）
+	if (UGimmickSubsystem* Gimmicks = GetWorld()->GetSubsystem<UGimmickSubsystem>())
+	{
+		Gimmicks->UnregisterGimmick(this, EndPlayReason);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
 /// @brief 移動パターンのよって終了位置を計算する関数
 void AGimmck_MoveFloor::CalculateEndPosition()
 {
-	switch (mMovementPattern)
+	mEndPosition = mStartPosition + GetRouteOffset();
+
+	//円運動の場合、中心位置は開始位置
+	if (IsCircular())
 	{
-	case EFloorMovementPattern::Horizontal_X://X軸方向への水平移動
-		mEndPosition = mStartPosition + FVector(mMoveDistance, 0.0f, 0.0f);
-		break;
+		mCircleCenter = mStartPosition;
+		mCircleAngle = 0.0f;
+	}
+}
 
-	case EFloorMovementPattern::Horizontal_Y://Y軸方向への水平移動
-		mEndPosition = mStartPosition + FVector(0.0f, mMoveDistance, 0.0f);
-		break;
+/// @brief 開始位置から終了位置までの移動量を求める関数
+/// @return 移動量（円運動ではゼロ）
+FVector AGimmck_MoveFloor::GetRouteOffset() const
+{
+	const FMoveFloorSettings& Settings = GetSettings();
+	return GimmickMath::GetRouteOffset(GimmickConfig::ToMathPattern(Settings.Pattern), Settings.Distance, Settings.CustomOffset);
+}
 
-	case EFloorMovementPattern::Vertical_Z://Z軸方向への垂直移動
-		mEndPosition = mStartPosition + FVector(0.0f, 0.0f, mMoveDistance);
-		break;
+/// @brief 円運動の中心と角度から位置を求める関数
+/// @param Center 円の中心
+/// @param Angle 角度（ラジアン）
+/// @return 床の位置
+FVector AGimmck_MoveFloor::GetCirclePosition(const FVector& Center, float Angle) const
+{
+	const FMoveFloorSettings& Settings = GetSettings();
+	return Center + GimmickMath::GetCircleOffset(GimmickConfig::ToMathPattern(Settings.Pattern), Settings.Distance, Angle);
+}
+
+/// @brief 円運動かどうか
+bool AGimmck_MoveFloor::IsCircular() const
+{
+	return GimmickMath::IsCircular(GimmickConfig::ToMathPattern(GetSettings().Pattern));
+}
+
+namespace MoveFloorTimetable
+{
+	//円運動の床に乗り降りできる、乗り場の前後の弧の長さ（cm）
+	constexpr float CircleDockArc = 100.0f;
+}
 
-	case EFloorMovementPattern::Diagonal_XY://XY平面上の斜め移動
+/// @brief 乗り降りする場所を求める関数（BeginPlay前はエディタ上の配置から求める）
+/// @param End 0 = 開始位置側、1 = 終了位置側
+/// @return 床がその側に止まったときの位置
+FVector AGimmck_MoveFloor::GetDockLocation(int32 End) const
+{
+	const FVector Start = HasActorBegunPlay() ? mStartPosition : GetActorLocation();
+
+	if (IsCircular())
 	{
-		float HalfDist = mMoveDistance / FMath::Sqrt(2.0f);
-		mEndPosition = mStartPosition + FVector(HalfDist, HalfDist, 0.0f);
+		return GetCirclePosition(Start, End == 0 ? 0.0f : PI);
 	}
-	break;
+	return End == 0 ? Start : Start + GetRouteOffset();
+}
 
-	case EFloorMovementPattern::Diagonal_XZ://XZ平面上の斜め移動
+/// @brief 片道の移動時間を求める関数
+/// @return 片道の秒数（円運動では半周の秒数）
+float AGimmck_MoveFloor::GetTravelTime() const
+{
+	const FMoveFloorSettings& Settings = GetSettings();
+	if (Settings.Speed <= 0.0f)
 	{
-		float HalfDist = mMoveDistance / FMath::Sqrt(2.0f);
-		mEndPosition = mStartPosition + FVector(HalfDist, 0.0f, HalfDist);
+		return BIG_NUMBER;
 	}
-	break;
+	return IsCircular() ? PI * Settings.Distance / Settings.Speed : GetRouteOffset().Size() / Settings.Speed;
+}
 
-	case EFloorMovementPattern::Diagonal_YZ://YZ平面上の斜め移動
+/// @brief 指定した側に止まっている残り時間を求める関数
+///        円運動は止まらないので、乗り場の前後の弧を通り過ぎるまでの時間を返す
+/// @param End 0 = 開始位置側、1 = 終了位置側
+/// @return 残り秒数（止まっていなければ 0）
+float AGimmck_MoveFloor::GetDockedTimeRemaining(int32 End) const
+{
+	const FMoveFloorSettings& Settings = GetSettings();
+	if (IsCircular())
 	{
-		float HalfDist = mMoveDistance / FMath::Sqrt(2.0f);
-		mEndPosition = mStartPosition + FVector(0.0f, HalfDist, HalfDist);
+		if (Settings.Distance <= 0.0f || Settings.Speed <= 0.0f)
+		{
+			return 0.0f;
+		}
+
+		//乗り場の角度との差（-π〜π）
+		const float DockAngle = End == 0 ? 0.0f : PI;
+		const float HalfWindow = MoveFloorTimetable::CircleDockArc / Settings.Distance;
+		const float Offset = FMath::UnwindRadians(mCircleAngle - DockAngle);
+		return FMath::Abs(Offset) <= HalfWindow ? (HalfWindow - Offset) * Settings.Distance / Settings.Speed : 0.0f;
+	}
+
+	//到着したら待機が終わるまで向きは変わらない
+	const bool bAtEnd = mDirection == 1;
+	return bIsWaiting && bAtEnd == (End == 1) ? GetWaitRemaining() : 0.0f;
+}
+
+/// @brief 指定した側に次に止まるまでの時間を求める関数
+/// @param End 0 = 開始位置側、1 = 終了位置側
+/// @return 秒数（止まっていれば 0）
+float AGimmck_MoveFloor::GetTimeUntilDocked(int32 End) const
+{
+	const FMoveFloorSettings& Settings = GetSettings();
+	if (GetDockedTimeRemaining(End) > 0.0f)
+	{
+		return 0.0f;
+	}
+	if (Settings.Speed <= 0.0f)
+	{
+		return BIG_NUMBER;
 	}
-	break;
-	//円運動
-	case EFloorMovementPattern::Circle_XY:
-	case EFloorMovementPattern::Circle_XZ:
-	case EFloorMovementPattern::Circle_YZ:
-		//円運動の場合、中心位置は開始位置
-		mCircleCenter = mStartPosition;
-		mCircleAngle = 0.0f;
-		break;
 
-	case EFloorMovementPattern::Custom:
-		mEndPosition = mStartPosition + mCustomMoveOffset;
-		break;
+	if (IsCircular())
+	{
+		//乗り場の手前の端に来るまでの角度
+		const float DockAngle = End == 0 ? 0.0f : PI;
+		const float HalfWindow = Settings.Distance > 0.0f ? MoveFloorTimetable::CircleDockArc / Settings.Distance : 0.0f;
+		const float Remaining = FMath::Fmod(DockAngle - HalfWindow - mCircleAngle + 4.0f * PI, 2.0f * PI);
+		return Remaining * Settings.Distance / Settings.Speed;
+	}
+
+	const FVector Target = (End == 0) ? mStartPosition : mEndPosition;
+	const FVector Other = (End == 0) ? mEndPosition : mStartPosition;
+	const bool bHeadingToTarget = (mDirection == 1) == (End == 1);
+
+	if (bIsWaiting)
+	{
+		//反対側で待機中 → 待機の残り + 片道
+		return GetWaitRemaining() + GetTravelTime();
 	}
+	if (bHeadingToTarget)
+	{
+		return FVector::Dist(GetActorLocation(), Target) / Settings.Speed;
+	}
+
+	//反対側へ向かっている → 反対側まで + 待機 + 片道
+	return FVector::Dist(GetActorLocation(), Other) / Settings.Speed + Settings.WaitTime + GetTravelTime();
 }
 
 void AGimmck_MoveFloor::Tick(float DeltaTime)
@@ -119,11 +249,7 @@ void AGimmck_MoveFloor::Tick(float DeltaTime)
 	Super::Tick(DeltaTime);
 
 	//円運動かどうかで処理を分岐
-	bool bIsCircular = (mMovementPattern == EFloorMovementPattern::Circle_XY ||
-		mMovementPattern == EFloorMovementPattern::Circle_XZ ||
-		mMovementPattern == EFloorMovementPattern::Circle_YZ);
-
-	if (bIsCircular)
+	if (IsCircular())
 	{
 		UpdateCircularMovement(DeltaTime);
 	}
@@ -131,124 +257,302 @@ void AGimmck_MoveFloor::Tick(float DeltaTime)
 	{
 		UpdateLinearMovement(DeltaTime);
 	}
+
+	//登録簿の位置を更新（同じセル内なら位置の書き換えだけ）
+	if (UGimmickSubsystem* Gimmicks = GetWorld()->GetSubsystem<UGimmickSubsystem>())
+	{
+		Gimmicks->UpdateGimmickLocation(this);
+	}
 }
 
-/// @brief 往復移動の処理関数
-/// @param DeltaTime フレーム間の経過時間
-void AGimmck_MoveFloor::UpdateLinearMovement(float DeltaTime)
+/// @brief 実行時状態を保存・復元する関数
+/// @param Ar 読み書きするアーカイブ
+void AGimmck_MoveFloor::SerializeGimmickState(FArchive& Ar)
 {
-	//待機中の処理
-	if (bIsWaiting)
+	FVector3f Location(GetActorLocation());
+	int8 Direction = static_cast<int8>(mDirection);
+	uint8 bWaiting = bIsWaiting ? 1 : 0;
+	float WaitElapsed = bIsWaiting ? FMath::Max(GetSettings().WaitTime - GetWaitRemaining(), 0.0f) : 0.0f;
+
+	Ar << Location << Direction << bWaiting << WaitElapsed << mCircleAngle;
+
+	if (Ar.IsLoading())
 	{
-		mWaitTimer += DeltaTime;
+		mDirection = Direction;
+		SetActorLocation(FVector(Location));
 
-		if (mWaitTimer >= mWaitTime)
+		//待機中なら残り時間でタイマーを掛け直す
+		if (bWaiting != 0)
+		{
+			StartWait(WaitElapsed);
+		}
+		else
 		{
-			bIsWaiting = false;
-			mWaitTimer = 0.0f;
-			mDirection *= -1;
+			ClearWait();
 		}
+	}
+}
+
+/// @brief メモリ使用量に乗っているアクターの配列の分を加える
+/// @param CumulativeResourceSize 加算先
+void AGimmck_MoveFloor::GetResourceSizeEx(FResourceSizeEx& CumulativeResourceSize)
+{
+	Super::GetResourceSizeEx(CumulativeResourceSize);
 
+	CumulativeResourceSize.AddDedicatedSystemMemoryBytes(mActorsOnFloor.GetAllocatedSize());
+}
+
+/// @brief 止まっていた時間分だけ状態を進める関数
+///        1フレームずつ動かさず、移動・待機の区間単位でまとめて進める
+/// @param Seconds 進める時間（秒）
+void AGimmck_MoveFloor::AdvanceGimmickState(float Seconds)
+{
+	const FMoveFloorSettings& Settings = GetSettings();
+	if (Seconds <= 0.0f || Settings.Speed <= 0.0f)
+	{
 		return;
 	}
 
-	//現在位置と目標位置の取得
-	FVector CurrentPosition = GetActorLocation();
-	FVector TargetPosition = (mDirection == 1) ? mEndPosition : mStartPosition;
-
-	//滑らかに移動
-	FVector NewPosition = FMath::VInterpConstantTo(
-		CurrentPosition,
-		TargetPosition,
-		DeltaTime,
-		mMoveSpeed
-	);
+	//円運動は角度を進めるだけ（半径 0 なら回らない）
+	if (IsCircular())
+	{
+		if (Settings.Distance <= 0.0f)
+		{
+			return;
+		}
+		mCircleAngle = FMath::Fmod(mCircleAngle + Settings.Speed / Settings.Distance * Seconds, 2.0f * PI);
+		UpdateCircularMovement(0.0f);
+		return;
+	}
 
-	//移動量を計算
-	FVector DeltaMove = NewPosition - CurrentPosition;
+	//1周期 = 往復の移動時間 + 両端での待機時間
+	const float TravelTime = FVector::Dist(mStartPosition, mEndPosition) / Settings.Speed;
+	const float Period = 2.0f * (TravelTime + Settings.WaitTime);
+	if (Period <= KINDA_SMALL_NUMBER)
+	{
+		return;
+	}
 
-	//位置を更新
-	SetActorLocation(NewPosition);
+	//どの状態からでも1周期以内に周期に乗るので、それを超える分は周期の余りにする
+	if (Seconds > Period)
+	{
+		Seconds = Period + FMath::Fmod(Seconds - Period, Period);
+	}
 
-	//床の上のアクターも一緒に移動
-	if (bMoveActorsOnFloor && !DeltaMove.IsNearlyZero())
+	//待機の経過時間はタイマーの残りから求め、進め終わったらタイマーを掛け直す
+	FVector Position = GetActorLocation();
+	float WaitTimer = bIsWaiting ? FMath::Max(Settings.WaitTime - GetWaitRemaining(), 0.0f) : 0.0f;
+	while (Seconds > 0.0f)
 	{
-		for (AActor* Actor : mActorsOnFloor)
+		if (bIsWaiting)
 		{
-			if (Actor)
+			//待機の残り時間だけ進める
+			const float Step = FMath::Clamp(Settings.WaitTime - WaitTimer, 0.0f, Seconds);
+			WaitTimer += Step;
+			Seconds -= Step;
+
+			if (WaitTimer >= Settings.WaitTime)
 			{
-				Actor->AddActorWorldOffset(DeltaMove, false);
+				bIsWaiting = false;
+				WaitTimer = 0.0f;
+				mDirection *= -1;
+			}
+		}
+		else
+		{
+			//目標位置に着くまでの時間だけ進める
+			const FVector TargetPosition = (mDirection == 1) ? mEndPosition : mStartPosition;
+			const float ArriveTime = FVector::Dist(Position, TargetPosition) / Settings.Speed;
+
+			if (Seconds < ArriveTime)
+			{
+				Position = FMath::VInterpConstantTo(Position, TargetPosition, Seconds, Settings.Speed);
+				Seconds = 0.0f;
+			}
+			else
+			{
+				Position = TargetPosition;
+				Seconds -= ArriveTime;
+				bIsWaiting = true;
+				WaitTimer = 0.0f;
 			}
 		}
 	}
 
-	//目標位置に到達したかチェック
-	float DistanceToTarget = FVector::Dist(NewPosition, TargetPosition);
+	SetActorLocation(Position);
 
-	//目的地の到着したかチェック
-	if (DistanceToTarget < 1.0f)
+	if (bIsWaiting)
 	{
-		SetActorLocation(TargetPosition);
-		bIsWaiting = true;
-		mWaitTimer = 0.0f;
+		StartWait(WaitTimer);
+	}
+	else
+	{
+		ClearWait();
 	}
 }
 
-/// @brief 円運動の処理関数
+/// @brief 待機を終えて出発する関数（タイマーから呼ばれるほか、手順などから早めに出発させるのにも使う）
+void AGimmck_MoveFloor::Depart()
+{
+	if (!bIsWaiting)
+	{
+		return;
+	}
+
+	ClearWait();
+	mDirection *= -1;
+
+	//止まっている間に眠った、上に乗っているブロックを起こす（床と一緒に動けるように）
+	AGimmick_PushBlock::WakeBlocksOn(this);
+
+	GimmickEvents::Emit(EGimmickEventType::MoveFloorDeparted, this);
+}
+
+/// @brief 待機を始める関数
+///        待機の終わりはタイミングホイールに登録し、待機中はTickしない
+///        タイマーのサブシステムがないワールド（Game / PIE 以外）では、Tickを止めずに残り時間を数える
+/// @param Elapsed すでに待った秒数
+void AGimmck_MoveFloor::StartWait(float Elapsed)
+{
+	bIsWaiting = true;
+	mWaitRemaining = FMath::Max(GetSettings().WaitTime - Elapsed, 0.0f);
+
+	UGimmickTimerSubsystem* Timers = GetWorld()->GetSubsystem<UGimmickTimerSubsystem>();
+	if (!Timers)
+	{
+		return;
+	}
+
+	Timers->ClearTimer(mWaitTimer);
+	mWaitTimer = Timers->SetTimer(this, mWaitRemaining, [this]()
+	{
+		mWaitTimer.Invalidate();
+		Depart();
+	});
+	SetActorTickEnabled(false);
+}
+
+/// @brief 待機をやめる関数
+void AGimmck_MoveFloor::ClearWait()
+{
+	bIsWaiting = false;
+
+	if (UGimmickTimerSubsystem* Timers = GetWorld()->GetSubsystem<UGimmickTimerSubsystem>())
+	{
+		Timers->ClearTimer(mWaitTimer);
+	}
+	SetActorTickEnabled(true);
+}
+
+/// @brief 待機の残り時間を求める関数
+/// @return 秒数（待機中でなければ 0）
+float AGimmck_MoveFloor::GetWaitRemaining() const
+{
+	if (!bIsWaiting)
+	{
+		return 0.0f;
+	}
+
+	const UGimmickTimerSubsystem* Timers = GetWorld()->GetSubsystem<UGimmickTimerSubsystem>();
+	return FMath::Max(Timers ? Timers->GetTimerRemaining(mWaitTimer) : mWaitRemaining, 0.0f);
+}
+
+/// @brief 往復移動の処理関数
 /// @param DeltaTime フレーム間の経過時間
-void AGimmck_MoveFloor::UpdateCircularMovement(float DeltaTime)
+void AGimmck_MoveFloor::UpdateLinearMovement(float DeltaTime)
 {
+	//待機中は動かない（待機の終わりはタイマーから Depart が呼ばれる）
+	if (bIsWaiting)
+	{
+		//タイマーがなければここで待ち時間を数える
+		if (!mWaitTimer.IsValid())
+		{
+			mWaitRemaining -= DeltaTime;
+			if (mWaitRemaining <= 0.0f)
+			{
+				Depart();
+			}
+		}
+		return;
+	}
+
+	const FMoveFloorSettings& Settings = GetSettings();
+
+	//現在位置と目標位置の取得
 	FVector CurrentPosition = GetActorLocation();
+	FVector TargetPosition = (mDirection == 1) ? mEndPosition : mStartPosition;
 
-	//角速度を計算（速度 / 半径）
-	float AngularSpeed = mMoveSpeed / mMoveDistance;
-	mCircleAngle += AngularSpeed * DeltaTime;
+	//滑らかに移動し、目標位置に到達したかチェック
+	bool bArrived = false;
+	FVector NewPosition = GimmickMath::StepTowards(CurrentPosition, TargetPosition, DeltaTime, Settings.Speed, bArrived);
 
-	//角度を0〜2πの範囲に保つ
-	if (mCircleAngle >= 2.0f * PI)
+	//到着するなら目標位置に合わせてから動かす（到着したフレームも位置の更新は1回）
+	if (bArrived)
 	{
-		mCircleAngle -= 2.0f * PI;
+		NewPosition = TargetPosition;
 	}
 
-	//パターンに応じて新しい位置を計算
-	FVector NewPosition = mCircleCenter;
+	//位置を更新（床の上のアクターも一緒に移動）
+	MoveWithRiders(NewPosition);
 
-	switch (mMovementPattern)
+	//目的地の到着したかチェック
+	if (bArrived)
 	{
-	case EFloorMovementPattern::Circle_XY:
-		NewPosition.X += FMath::Cos(mCircleAngle) * mMoveDistance;
-		NewPosition.Y += FMath::Sin(mCircleAngle) * mMoveDistance;
-		break;
+		StartWait(0.0f);
 
-	case EFloorMovementPattern::Circle_XZ:
-		NewPosition.X += FMath::Cos(mCircleAngle) * mMoveDistance;
-		NewPosition.Z += FMath::Sin(mCircleAngle) * mMoveDistance;
-		break;
-
-	case EFloorMovementPattern::Circle_YZ:
-		NewPosition.Y += FMath::Cos(mCircleAngle) * mMoveDistance;
-		NewPosition.Z += FMath::Sin(mCircleAngle) * mMoveDistance;
-		break;
+		GimmickEvents::Emit(EGimmickEventType::MoveFloorArrived, this);
 	}
+}
+
+/// @brief 円運動の処理関数
+/// @param DeltaTime フレーム間の経過時間
+void AGimmck_MoveFloor::UpdateCircularMovement(float DeltaTime)
+{
+	const FMoveFloorSettings& Settings = GetSettings();
+
+	//角度を進める（0〜2πの範囲に保つ）
+	mCircleAngle = GimmickMath::AdvanceCircleAngle(mCircleAngle, Settings.Speed, Settings.Distance, DeltaTime);
+
+	//パターンに応じて新しい位置を計算
+	FVector NewPosition = GetCirclePosition(mCircleCenter, mCircleAngle);
 
-	//移動量を計算
-	FVector DeltaMove = NewPosition - CurrentPosition;
+	//位置を更新（床の上のアクターも一緒に移動）
+	MoveWithRiders(NewPosition);
+}
+
+/// @brief 床と上に乗っているアクターを同じ量だけ動かす関数
+///        オーバーラップの更新は FScopedMovementUpdate で遅らせ、全員を動かし終えてから床・乗っているアクターごとに1回ずつ行う
+///        （床のオーバーラップを乗っているアクターの動く前の位置で調べて、降りたことにならないように）
+/// @param NewPosition 床の新しい位置
+void AGimmck_MoveFloor::MoveWithRiders(const FVector& NewPosition)
+{
+	const FVector DeltaMove = NewPosition - GetActorLocation();
+	const bool bMoveRiders = bMoveActorsOnFloor && !DeltaMove.IsNearlyZero();
+
+	FScopedMovementUpdate FloorUpdate(mMesh, EScopedUpdate::DeferredUpdates);
+
+	//乗っているアクターごとの遅延（オーバーラップのイベントも遅れるので、動かし終えるまで乗っているアクターは変わらない）
+	TArray<TOptional<FScopedMovementUpdate>, TInlineAllocator<4>> RiderUpdates;
+	if (bMoveRiders)
+	{
+		RiderUpdates.SetNum(mActorsOnFloor.Num());
+	}
 
-	//位置を更新
 	SetActorLocation(NewPosition);
 
-	//床の上のアクターも一緒に移動
-	if (bMoveActorsOnFloor && !DeltaMove.IsNearlyZero())
+	if (bMoveRiders)
 	{
-		for (AActor* Actor : mActorsOnFloor)
+		for (int32 i = 0; i < mActorsOnFloor.Num(); i++)
 		{
-			if (Actor)
+			if (AActor* Actor = mActorsOnFloor[i])
 			{
+				RiderUpdates[i].Emplace(Actor->GetRootComponent(), EScopedUpdate::DeferredUpdates);
 				Actor->AddActorWorldOffset(DeltaMove, false);
 			}
 		}
 	}
 }
+
 /// @brief 床にアクターが乗った時に呼ばれるオーバーラップイベント
 /// @param OverlappedComponent イベントが発生したコンポーネント
 /// @param OtherActor 重なったアクター
@@ -289,4 +593,46 @@ void AGimmck_MoveFloor::OnFloorEndOverlap(UPrimitiveComponent* OverlappedCompone
 	{
 		mActorsOnFloor.Remove(OtherActor);
 	}
-}
\ No newline at end of file
+}
+
+#if WITH_EDITORONLY_DATA
+/// @brief 読み込み時に、以前のルートの位置をメッシュに、床ごとに保存していた以前の設定を個別の上書きに移す
+///        共有設定のアセットにまとめるのは、上書きの値を見てエディタで行う
+void AGimmck_MoveFloor::PostLoad()
+{
+	Super::PostLoad();
+
+	//以前の版で別に持っていたルートに保存されている位置を、ルートにしたメッシュに移す
+	GimmickMigration::MigrateRemovedRoot(this, mMesh);
+
+	//アーキタイプ（ブループリントのクラスの既定値など）と違う値だけがこのアクタに保存されているので、アーキタイプの値と比べる
+	//（クラスの既定値と比べると、アーキタイプで変えた値をクラスの既定値に戻したアクタを移せない）
+	//移した後も値は戻さない（アーキタイプから値を引き継いだアクタは同じ値になり、二重に移さない）
+	const AGimmck_MoveFloor* Archetype = Cast<AGimmck_MoveFloor>(GetArchetype());
+	if (!Archetype)
+	{
+		Archetype = GetDefault<AGimmck_MoveFloor>();
+	}
+	auto Overrides = [this]() { return UGimmickConfigOverrides::FindOrAdd(this, mOverrides); };
+	if (mMovementPattern_DEPRECATED != Archetype->mMovementPattern_DEPRECATED)
+	{
+		Overrides()->Set(mMovementPattern_DEPRECATED);
+	}
+	if (mMoveDistance_DEPRECATED != Archetype->mMoveDistance_DEPRECATED)
+	{
+		Overrides()->Set(EGimmickConfigParam::MoveDistance, mMoveDistance_DEPRECATED);
+	}
+	if (mCustomMoveOffset_DEPRECATED != Archetype->mCustomMoveOffset_DEPRECATED)
+	{
+		Overrides()->Set(EGimmickConfigParam::CustomMoveOffset, mCustomMoveOffset_DEPRECATED);
+	}
+	if (mMoveSpeed_DEPRECATED != Archetype->mMoveSpeed_DEPRECATED)
+	{
+		Overrides()->Set(EGimmickConfigParam::MoveSpeed, mMoveSpeed_DEPRECATED);
+	}
+	if (mWaitTime_DEPRECATED != Archetype->mWaitTime_DEPRECATED)
+	{
+		Overrides()->Set(EGimmickConfigParam::WaitTime, mWaitTime_DEPRECATED);
+	}
+}
+#endif
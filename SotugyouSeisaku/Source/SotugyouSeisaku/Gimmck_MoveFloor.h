@@ -4,32 +4,17 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "GimmickStateInterface.h"
+#include "GimmickInstanceSubsystem.h"
+#include "GimmickTimerSubsystem.h"
+#include "GimmickConfig.h"
 #include "Gimmck_MoveFloor.generated.h"
 
-//移動パターンの列挙型
-UENUM(BlueprintType)
-enum class EFloorMovementPattern : uint8
-{
-	Horizontal_X UMETA(DisplayName = "横移動 (X軸)"),
-	Horizontal_Y UMETA(DisplayName = "横移動 (Y軸)"),
-	Vertical_Z UMETA(DisplayName = "縦移動 (Z軸・上下)"),
-	Diagonal_XY UMETA(DisplayName = "斜め移動 (XY平面)"),
-	Diagonal_XZ UMETA(DisplayName = "斜め移動 (XZ平面)"),
-	Diagonal_YZ UMETA(DisplayName = "斜め移動 (YZ平面)"),
-	Circle_XY UMETA(DisplayName = "円運動 (XY平面)"),
-	Circle_XZ UMETA(DisplayName = "円運動 (XZ平面)"),
-	Circle_YZ UMETA(DisplayName = "円運動 (YZ平面)"),
-	Custom UMETA(DisplayName = "カスタム (手動設定)")
-};
-
 UCLASS()
-class SOTUGYOUSEISAKU_API AGimmck_MoveFloor : public AActor
+class SOTUGYOUSEISAKU_API AGimmck_MoveFloor : public AActor, public IGimmickStateInterface
 {
 	GENERATED_BODY()
 
-	UPROPERTY(VisibleAnywhere)
-	TObjectPtr<USceneComponent> mRoot;
-
 	UPROPERTY(VisibleAnywhere)
 	TObjectPtr<UStaticMeshComponent> mMesh;
 	
@@ -40,30 +25,30 @@ public:
 protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 public:	
 	// Called every frame
 	virtual void Tick(float DeltaTime) override;
 
-	//移動パターンの選択
-	UPROPERTY(EditAnywhere, Category = "Movement Settings")
-	EFloorMovementPattern mMovementPattern = EFloorMovementPattern::Horizontal_Y;
-
-	//移動距離（パターンによって使い方が異なる）
-	UPROPERTY(EditAnywhere, Category = "Movement Settings", meta = (EditCondition = "mMovementPattern != EFloorMovementPattern::Custom"))
-	float mMoveDistance = 500.0f;
+	//IGimmickStateInterface
+	virtual EGimmickType GetGimmickType() const override { return EGimmickType::MoveFloor; }
+	virtual void SerializeGimmickState(FArchive& Ar) override;
+	virtual void AdvanceGimmickState(float Seconds) override;
 
-	//カスタム移動量（Customパターンの場合のみ使用）
-	UPROPERTY(EditAnywhere, Category = "Movement Settings", meta = (EditCondition = "mMovementPattern == EFloorMovementPattern::Custom"))
-	FVector mCustomMoveOffset = FVector(0.0f, 500.0f, 0.0f);
+	//乗っているアクターの配列の分をメモリ使用量に加える
+	virtual void GetResourceSizeEx(FResourceSizeEx& CumulativeResourceSize) override;
 
-	//移動速度（cm/秒）
+	//共有設定（同じ調整の床で1つのアセットを参照する、未設定ならクラスの既定値）
 	UPROPERTY(EditAnywhere, Category = "Movement Settings")
-	float mMoveSpeed = 200.0f;
+	TObjectPtr<UGimmickMoveFloorConfig> mConfig;
+
+	//この床だけの上書き（上書きする床だけが持つ）
+	UPROPERTY(EditAnywhere, Instanced, Category = "Movement Settings")
+	TObjectPtr<UGimmickConfigOverrides> mOverrides;
 
-	//到着時の待機時間（秒）※円運動では無視
-	UPROPERTY(EditAnywhere, Category = "Movement Settings", meta = (EditCondition = "mMovementPattern != EFloorMovementPattern::Circle_XY && mMovementPattern != EFloorMovementPattern::Circle_XZ && mMovementPattern != EFloorMovementPattern::Circle_YZ"))
-	float mWaitTime = 1.0f;
+	//実際に使う設定（共有設定に上書きを適用したもの）
+	const FMoveFloorSettings& GetSettings() const { return GimmickConfig::Resolve(mConfig.Get(), mOverrides.Get()); }
 
 	//自動で開始するか
 	UPROPERTY(EditAnywhere, Category = "Movement Settings")
@@ -73,6 +58,13 @@ public:
 	UPROPERTY(EditAnywhere, Category = "Movement Settings")
 	bool bMoveActorsOnFloor = true;
 
+	//同じメッシュのギミックと共有インスタンスでまとめて描画するか
+	UPROPERTY(EditAnywhere, Category = "Rendering")
+	bool bUseInstancedRendering = true;
+
+	//共有インスタンスのハンドル
+	FGimmickInstanceHandle mMeshInstance;
+
 	//開始位置（自動で保存）
 	FVector mStartPosition;
 
@@ -91,8 +83,11 @@ public:
 	//現在待機中か
 	bool bIsWaiting = false;
 
-	//待機タイマー
-	float mWaitTimer = 0.0f;
+	//待機の終わりを知らせるタイマー（ギミックのタイミングホイールに登録する、待機中はTickしない）
+	FGimmickTimerHandle mWaitTimer;
+
+	//タイマーのサブシステムがないワールド（エディタのプレビューなど）で、Tickで数える待機の残り秒数
+	float mWaitRemaining = 0.0f;
 
 	//床の上に乗っているアクター
 	UPROPERTY()
@@ -110,10 +105,63 @@ public:
 	//移動パターンに応じて終了位置を計算
 	void CalculateEndPosition();
 
+	//開始位置から終了位置までの移動量（円運動ではゼロ）
+	FVector GetRouteOffset() const;
+
+	//円運動の中心と角度から位置を求める
+	FVector GetCirclePosition(const FVector& Center, float Angle) const;
+
+	//円運動か
+	bool IsCircular() const;
+
+	//時刻表（AIのナビゲーションリンク用）
+	//乗り降りする場所（0 = 開始位置側、1 = 終了位置側。円運動では角度 0 と π の位置）
+	FVector GetDockLocation(int32 End) const;
+
+	//指定した側に止まっている残り時間（止まっていなければ 0）
+	float GetDockedTimeRemaining(int32 End) const;
+
+	//指定した側に次に止まるまでの時間（止まっていれば 0）
+	float GetTimeUntilDocked(int32 End) const;
+
+	//片道の移動時間
+	float GetTravelTime() const;
+
+	//待機を終えて出発する（待機中でなければ何もしない）
+	void Depart();
+
+	//待機を始める（Elapsed = すでに待った秒数）
+	void StartWait(float Elapsed);
+
+	//待機をやめる（出発の通知はしない）
+	void ClearWait();
+
+	//待機の残り時間（待機中でなければ 0）
+	float GetWaitRemaining() const;
+
 	//往復移動の処理
 	void UpdateLinearMovement(float DeltaTime);
 
 	//円運動の処理
 	void UpdateCircularMovement(float DeltaTime);
 
+	//床と上に乗っているアクターを同じ量だけ動かす（オーバーラップの更新は全員を動かした後に1回ずつ）
+	void MoveWithRiders(const FVector& NewPosition);
+
+#if WITH_EDITORONLY_DATA
+	//読み込み時に以前のルートの位置をメッシュへ移し、共有設定を参照する前に床ごとに保存していた設定を上書きへ移す
+	virtual void PostLoad() override;
+
+	UPROPERTY()
+	EFloorMovementPattern mMovementPattern_DEPRECATED = EFloorMovementPattern::Horizontal_Y;
+	UPROPERTY()
+	float mMoveDistance_DEPRECATED = 500.0f;
+	UPROPERTY()
+	FVector mCustomMoveOffset_DEPRECATED = FVector(0.0f, 500.0f, 0.0f);
+	UPROPERTY()
+	float mMoveSpeed_DEPRECATED = 200.0f;
+	UPROPERTY()
+	float mWaitTime_DEPRECATED = 1.0f;
+#endif
+
 };
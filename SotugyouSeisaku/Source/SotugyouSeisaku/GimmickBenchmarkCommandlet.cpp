@@ -0,0 +1,341 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GimmickBenchmarkCommandlet.h"
+#include "GimmickBenchmarkSuites.h"
+#include "Engine/World.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Dom/JsonObject.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "HAL/IConsoleManager.h"
+
+DEFINE_LOG_CATEGORY(LogGimmickBenchmark);
+
+namespace GimmickBenchmark
+{
+	/// @brief 1シナリオ分の計測結果
+	struct FResult
+	{
+		FString Name;
+		int32 Count = 0;
+		double MeanMs = 0.0;
+		double P95Ms = 0.0;
+		double P99Ms = 0.0;
+	};
+
+	/// @brief 昇順に並んだサンプルからパーセンタイル値を取り出す
+	double Percentile(const TArray<double>& SortedSamples, double Ratio)
+	{
+		if (SortedSamples.Num() == 0)
+		{
+			return 0.0;
+		}
+		const int32 Index = FMath::Clamp(FMath::CeilToInt(Ratio * SortedSamples.Num()) - 1, 0, SortedSamples.Num() - 1);
+		return SortedSamples[Index];
+	}
+
+	/// @brief 計測用の空ワールドを作ってシナリオを実行する
+	FResult RunScenario(const FScenario& Scenario, int32 Count, int32 Frames)
+	{
+		UWorld* World = CreateBenchmarkWorld(Scenario.Name);
+
+		FScenarioContext Context = SetupScenarios(World, MakeArrayView(&Scenario, 1), Count);
+
+		//生成直後の初期化コストを除くため数フレーム空回しする
+		TickWorld(World, 10);
+
+		TArray<double> Samples;
+		Samples.Reserve(Frames);
+		for (int32 Frame = 0; Frame < Frames; Frame++)
+		{
+			const double StartTime = FPlatformTime::Seconds();
+			Scenario.Step(World, Frame, Context);
+			TickWorld(World, 1);
+			Samples.Add((FPlatformTime::Seconds() - StartTime) * 1000.0);
+		}
+
+		DestroyBenchmarkWorld(World);
+
+		FResult Result;
+		Result.Name = Scenario.Name;
+		Result.Count = Count;
+
+		double Total = 0.0;
+		for (double Sample : Samples)
+		{
+			Total += Sample;
+		}
+		Result.MeanMs = Samples.Num() > 0 ? Total / Samples.Num() : 0.0;
+
+		Samples.Sort();
+		Result.P95Ms = Percentile(Samples, 0.95);
+		Result.P99Ms = Percentile(Samples, 0.99);
+		return Result;
+	}
+
+	/// @brief 計測結果をJSON化する
+	TSharedRef<FJsonObject> ResultsToJson(const TArray<FResult>& Results, int32 Frames)
+	{
+		TSharedRef<FJsonObject> Root = MakeShared<FJsonObject>();
+		Root->SetStringField(TEXT("machine"), FPlatformProcess::ComputerName());
+		Root->SetStringField(TEXT("cpu"), FPlatformMisc::GetCPUBrand());
+		Root->SetNumberField(TEXT("frames"), Frames);
+
+		TSharedRef<FJsonObject> Scenarios = MakeShared<FJsonObject>();
+		for (const FResult& Result : Results)
+		{
+			TSharedRef<FJsonObject> Entry = MakeShared<FJsonObject>();
+			Entry->SetNumberField(TEXT("count"), Result.Count);
+			Entry->SetNumberField(TEXT("mean_ms"), Result.MeanMs);
+			Entry->SetNumberField(TEXT("p95_ms"), Result.P95Ms);
+			Entry->SetNumberField(TEXT("p99_ms"), Result.P99Ms);
+			Scenarios->SetObjectField(Result.Name, Entry);
+		}
+		Root->SetObjectField(TEXT("scenarios"), Scenarios);
+		return Root;
+	}
+
+	/// @brief JSONをファイルに書き出す
+	bool SaveJson(const TSharedRef<FJsonObject>& Json, const FString& Path)
+	{
+		FString Text;
+		TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Text);
+		FJsonSerializer::Serialize(Json, Writer);
+		return FFileHelper::SaveStringToFile(Text, *Path);
+	}
+
+	/// @brief ベースラインと比較し、しきい値を超えて遅くなったシナリオの数を返す
+	///        時間は同じマシンで計測したものどうしでしか比べられないので、ベースラインがない場合と
+	///        別のマシンで記録したベースラインの場合は警告だけ出して比べない（-UpdateBaseline でこのマシンの値を記録する）。
+	///        同じマシンのベースラインが読めない・シナリオや数が合わない場合は比較できないので失敗として数える
+	int32 CompareWithBaseline(const TArray<FResult>& Results, const FString& BaselinePath, double Threshold)
+	{
+		FString Text;
+		if (!FFileHelper::LoadFileToString(Text, *BaselinePath))
+		{
+			UE_LOG(LogGimmickBenchmark, Warning, TEXT("Baseline not found: %s, timings are not compared (run with -UpdateBaseline on this machine to record one)"), *BaselinePath);
+			return 0;
+		}
+
+		TSharedPtr<FJsonObject> Baseline;
+		TSharedRef<TJsonReader<>> Reader = TJsonReaderFactory<>::Create(Text);
+		if (!FJsonSerializer::Deserialize(Reader, Baseline) || !Baseline.IsValid())
+		{
+			UE_LOG(LogGimmickBenchmark, Error, TEXT("Failed to parse baseline: %s"), *BaselinePath);
+			return 1;
+		}
+
+		FString BaselineMachine;
+		Baseline->TryGetStringField(TEXT("machine"), BaselineMachine);
+		if (BaselineMachine != FPlatformProcess::ComputerName())
+		{
+			UE_LOG(LogGimmickBenchmark, Warning, TEXT("Baseline %s was recorded on '%s', not on this machine ('%s'), timings are not compared"),
+				*BaselinePath, *BaselineMachine, FPlatformProcess::ComputerName());
+			return 0;
+		}
+
+		const TSharedPtr<FJsonObject>* Scenarios = nullptr;
+		if (!Baseline->TryGetObjectField(TEXT("scenarios"), Scenarios))
+		{
+			UE_LOG(LogGimmickBenchmark, Error, TEXT("Baseline has no scenarios: %s"), *BaselinePath);
+			return 1;
+		}
+
+		int32 RegressionCount = 0;
+		for (const FResult& Result : Results)
+		{
+			const TSharedPtr<FJsonObject>* Entry = nullptr;
+			if (!(*Scenarios)->TryGetObjectField(Result.Name, Entry))
+			{
+				UE_LOG(LogGimmickBenchmark, Error, TEXT("%s: no baseline entry (run with -UpdateBaseline to add it)"), *Result.Name);
+				RegressionCount++;
+				continue;
+			}
+
+			//ギミックの数が違うと時間を比べられない
+			const int32 BaseCount = static_cast<int32>((*Entry)->GetNumberField(TEXT("count")));
+			if (BaseCount != Result.Count)
+			{
+				UE_LOG(LogGimmickBenchmark, Error, TEXT("%s: baseline was measured with -Count=%d, this run used %d"), *Result.Name, BaseCount, Result.Count);
+				RegressionCount++;
+				continue;
+			}
+
+			//平均とp95の両方を比較する（p99は揺れが大きいので参考値）
+			const double BaseMean = (*Entry)->GetNumberField(TEXT("mean_ms"));
+			const double BaseP95 = (*Entry)->GetNumberField(TEXT("p95_ms"));
+			const bool bMeanRegressed = Result.MeanMs > BaseMean * (1.0 + Threshold);
+			const bool bP95Regressed = Result.P95Ms > BaseP95 * (1.0 + Threshold);
+
+			if (bMeanRegressed || bP95Regressed)
+			{
+				UE_LOG(LogGimmickBenchmark, Error, TEXT("%s regressed: mean %.3f ms (baseline %.3f), p95 %.3f ms (baseline %.3f)"),
+					*Result.Name, Result.MeanMs, BaseMean, Result.P95Ms, BaseP95);
+				RegressionCount++;
+			}
+		}
+		return RegressionCount;
+	}
+}
+
+UGimmickBenchmarkCommandlet::UGimmickBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsEditor = true;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+/// @brief コマンドレットのエントリポイント
+/// @param Params コマンドライン引数
+/// @return 0 = 成功、1 = 性能劣化を検出（ベースラインがない・合わない場合も 1）
+int32 UGimmickBenchmarkCommandlet::Main(const FString& Params)
+{
+	using namespace GimmickBenchmark;
+
+	int32 Count = 500;
+	int32 Frames = 600;
+	double Threshold = 0.15;
+	FString OutputPath = FPaths::ProjectSavedDir() / TEXT("Benchmark/GimmickBenchmark.json");
+	FString BaselinePath = FPaths::ProjectConfigDir() / TEXT("GimmickBenchmarkBaseline.json");
+
+	FParse::Value(*Params, TEXT("Count="), Count);
+	FParse::Value(*Params, TEXT("Frames="), Frames);
+	FParse::Value(*Params, TEXT("Threshold="), Threshold);
+	FParse::Value(*Params, TEXT("Output="), OutputPath);
+	FParse::Value(*Params, TEXT("Baseline="), BaselinePath);
+	const bool bUpdateBaseline = FParse::Param(*Params, TEXT("UpdateBaseline"));
+
+	//見た目の処理も含めて計測する（-nullrhi で動かしても取り除かない、-ServerProfile=1 で実際のサーバーと同じ判定にする）
+	int32 ServerProfile = 0;
+	FParse::Value(*Params, TEXT("ServerProfile="), ServerProfile);
+	IConsoleManager::Get().FindConsoleVariable(TEXT("Gimmick.ServerProfile"))->Set(ServerProfile, ECVF_SetByCode);
+
+	//Tick以外の計測
+	FString Suite = TEXT("Tick");
+	FParse::Value(*Params, TEXT("Suite="), Suite);
+	if (Suite == TEXT("Save"))
+	{
+		RunSaveSuite(Count);
+		return 0;
+	}
+	if (Suite == TEXT("Registry"))
+	{
+		RunRegistrySuite();
+		return 0;
+	}
+	if (Suite == TEXT("Components"))
+	{
+		RunComponentsSuite(Count, Frames);
+		return 0;
+	}
+	if (Suite == TEXT("Transform"))
+	{
+		RunTransformSuite(Count, Frames);
+		return 0;
+	}
+	if (Suite == TEXT("Sequence"))
+	{
+		RunSequenceSuite(Frames);
+		return 0;
+	}
+	if (Suite == TEXT("EventBus"))
+	{
+		RunEventBusSuite(Count);
+		return 0;
+	}
+	if (Suite == TEXT("Timers"))
+	{
+		RunTimersSuite(Frames);
+		return 0;
+	}
+	if (Suite == TEXT("FastForward"))
+	{
+		RunFastForwardSuite(Count, Frames);
+		return 0;
+	}
+	if (Suite == TEXT("ServerProfile"))
+	{
+		RunServerProfileSuite(Count, Frames);
+		return 0;
+	}
+	if (Suite == TEXT("Allocations"))
+	{
+		return RunAllocationsSuite(Count, Frames);
+	}
+	if (Suite == TEXT("Load"))
+	{
+		FString Maps;
+		FParse::Value(*Params, TEXT("Map="), Maps);
+		return RunLoadSuite(Maps, Frames);
+	}
+	if (Suite == TEXT("NavFloor"))
+	{
+		RunNavFloorSuite(Frames);
+		return 0;
+	}
+	if (Suite == TEXT("BlockSleep"))
+	{
+		RunBlockSleepSuite(Count, Frames);
+		return 0;
+	}
+	if (Suite == TEXT("Replication"))
+	{
+		FString Map;
+		FString Clients = TEXT("8+32");
+		float Seconds = 30.0f;
+		FParse::Value(*Params, TEXT("Map="), Map);
+		FParse::Value(*Params, TEXT("Clients="), Clients);
+		FParse::Value(*Params, TEXT("Seconds="), Seconds);
+		return RunReplicationSuite(Map, Clients, Seconds);
+	}
+	if (Suite == TEXT("Math"))
+	{
+		return RunMathSuite(Count, Frames);
+	}
+	if (Suite == TEXT("Config"))
+	{
+		RunConfigSuite(Count);
+		return 0;
+	}
+	if (Suite == TEXT("Collapse"))
+	{
+		return RunCollapseSuite(Count, Frames);
+	}
+
+	//計測するシナリオ一覧（動く床は全パターン）
+	TArray<FScenario> Scenarios;
+	const UEnum* PatternEnum = StaticEnum<EFloorMovementPattern>();
+	for (int32 i = 0; i < PatternEnum->NumEnums() - 1; i++)
+	{
+		Scenarios.Add(MakeMoveFloorScenario(static_cast<EFloorMovementPattern>(PatternEnum->GetValueByIndex(i))));
+	}
+	Scenarios.Add(MakeFallFloorScenario());
+	Scenarios.Add(MakeButtonScenario());
+	Scenarios.Add(MakePushBlockScenario());
+
+	TArray<FResult> Results;
+	for (const FScenario& Scenario : Scenarios)
+	{
+		const FResult Result = RunScenario(Scenario, Count, Frames);
+		UE_LOG(LogGimmickBenchmark, Display, TEXT("%-24s count=%d mean=%.3f ms p95=%.3f ms p99=%.3f ms"),
+			*Result.Name, Result.Count, Result.MeanMs, Result.P95Ms, Result.P99Ms);
+		Results.Add(Result);
+	}
+
+	const TSharedRef<FJsonObject> Json = ResultsToJson(Results, Frames);
+	if (SaveJson(Json, OutputPath))
+	{
+		UE_LOG(LogGimmickBenchmark, Display, TEXT("Results written to %s"), *OutputPath);
+	}
+
+	if (bUpdateBaseline)
+	{
+		SaveJson(Json, BaselinePath);
+		UE_LOG(LogGimmickBenchmark, Display, TEXT("Baseline updated: %s"), *BaselinePath);
+		return 0;
+	}
+
+	return CompareWithBaseline(Results, BaselinePath, Threshold) > 0 ? 1 : 0;
+}
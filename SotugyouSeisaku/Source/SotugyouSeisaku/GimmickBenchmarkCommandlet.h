@@ -0,0 +1,56 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "GimmickBenchmarkCommandlet.generated.h"
+
+/// @brief ギミックの負荷を計測するコマンドレット
+///        描画なしの空ワールドにギミックを大量に生成し、一定フレーム数だけTickしてゲームスレッド時間を計測する
+///
+///        実行例:
+///        UnrealEditor-Cmd SotugyouSeisaku.uproject -run=GimmickBenchmark -nullrhi -unattended
+///            -Count=500 -Frames=600 -Threshold=0.15 [-Output=<json>] [-Baseline=<json>] [-UpdateBaseline]
+///
+///        結果は Config/GimmickBenchmarkBaseline.json と比べ、平均か p95 がしきい値を超えて遅くなったら 1 を返す。
+///        ベースラインは計測したマシンの名前を持ち、同じマシンで記録したものとだけ比べる（ない場合・別のマシンの場合は警告だけ出して 0 を返す）。
+///        同じマシンのベースラインにシナリオがない・-Count が違う場合は 1 を返す。
+///        ベースラインは CI のマシンで -UpdateBaseline を付けて実行して記録する（比べずに書き直す）。
+///
+///        ここでは処理時間・回数・大きさだけを計測する。結果が正しいか（保存の復元、タイミングホイールの順序、イベントバス、
+///        時間飛ばし、共有設定、動く床のオーバーラップの更新、動く床を渡るAI）は自動テスト SotugyouSeisaku.Gimmick.* で確かめる。
+///        ワールドとギミックの生成は GimmickBenchmarkFixture.h を自動テストと共有する。
+///        各 -Suite の計測はサブシステムごとに GimmickBenchmark*Suites.cpp に分けてあり、GimmickBenchmarkSuites.h で宣言する。
+///
+///        -Suite=Save で進行状況の保存・読み込み時間とデータサイズを計測する（-Count=5000 など）
+///        -Suite=Registry でギミック登録簿の検索を 10k / 100k 件で計測する
+///        -Suite=Components で共有インスタンス描画の有無によるコンポーネント数・メモリ・移動の更新時間を比べる
+///        -Suite=Transform で動く床（乗っているキャラクター付き）・押せるブロックの移動による1フレームあたりのトランスフォーム更新とオーバーラップの更新の回数を数える
+///        -Suite=Sequence でTickしない手順（時間待ち・イベント待ち）を同時にいくつ動かせるかを計測する
+///        -Suite=EventBus でイベントバスに積む・取り出す1件あたりの時間を計測する（-Count=100000 など）
+///        -Suite=Timers でギミックのタイミングホイールと FTimerManager を、同時に動いているタイマー 1k / 10k / 100k で比べる
+///        -Suite=FastForward で時間飛ばし（AdvanceGimmicks）の処理時間を、同じ時間を1フレームずつTickした場合と比べる
+///        -Suite=ServerProfile で見た目の処理を取り除く専用サーバー向けの設定の有無によるギミック1個あたりのメモリとTick時間を比べる
+///        （ほかの計測は見た目の処理も含める。-ServerProfile=<0/1> で変えられる）
+///        -Suite=Allocations で暖気後のギミックの毎フレームの処理がヒープ確保をしないかを確かめ、クラスごとのメモリ使用量を出す（確保があれば 1 を返す）
+///        -Suite=Load -Map=/Game/Maps/<Name>[+<Name>...] でマップの読み込み・開始時間とゲームプレイ中の同期読み込みの数を計測する
+///        （ギミックの生成・再生成で同期読み込みが起きたら 1 を返す）
+///        -Suite=NavFloor で時刻表付きリンクを使う場合に、床がナビメッシュに影響する場合と比べて避けられた再構築時間を計測する
+///        -Suite=BlockSleep で押せるブロック（-Count=500）を並べた部屋で1個を押し続け、止まったブロックを眠らせる場合と常にシミュレーションする場合の物理の1ステップの時間を比べる
+///        -Suite=Replication [-Map=<マップ>] [-Clients=8+32] [-Seconds=30] で同じマシンに専用サーバーとクライアントを起動し、
+///        ギミック向けのレプリケーショングラフでのサーバーのレプリケーションの処理時間と送信量を計測する（報告がなければ 1 を返す）
+///        -Suite=Math でワールドを作らずにギミックの計算（GimmickMath）の1個ずつとまとめて計算する場合の処理時間を比べる
+///        （-Count=4096 -Frames=1000 など）
+///        -Suite=Config -Count=2000 で、設定をギミックごとに持つ場合と共有設定を参照する場合のメモリとマップに書き出す大きさを比べる
+///        -Suite=Collapse -Count=64 で、落ちる床が同時に崩れるときの1個あたりの処理時間を、焼き込んだ結果を再生する場合と破片を毎回シミュレーションする場合で比べる
+UCLASS()
+class SOTUGYOUSEISAKU_API UGimmickBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UGimmickBenchmarkCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,360 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GimmickBenchmarkFixture.h"
+#include "Engine/Engine.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/StaticMeshActor.h"
+#include "GameFramework/WorldSettings.h"
+#include "Components/StaticMeshComponent.h"
+#include "Components/BrushComponent.h"
+#include "PhysicsEngine/BodySetup.h"
+#include "EngineUtils.h"
+#include "Gimmck_MoveFloor.h"
+#include "Gimmick_Button.h"
+#include "Gimmick_ButtonManager.h"
+#include "Gimmick_FallFloor.h"
+#include "Gimmick_PushBlock.h"
+#include "GimmickFloorNavLink.h"
+#include "SotugyouSeisakuCharacter.h"
+#include "NavigationSystem.h"
+#include "NavMesh/NavMeshBoundsVolume.h"
+#include "NavMesh/RecastNavMesh.h"
+#include "Misc/ConfigCacheIni.h"
+
+namespace GimmickBenchmark
+{
+	//ナビメッシュの設定のセクション
+	static const TCHAR* NavMeshSection = TEXT("/Script/NavigationSystem.RecastNavMesh");
+
+	FScopedDynamicNavMesh::FScopedDynamicNavMesh()
+	{
+		GConfig->GetString(NavMeshSection, TEXT("RuntimeGeneration"), mPrevRuntimeGeneration, GEngineIni);
+		GConfig->SetString(NavMeshSection, TEXT("RuntimeGeneration"), TEXT("Dynamic"), GEngineIni);
+		GetMutableDefault<ARecastNavMesh>()->ReloadConfig();
+	}
+
+	FScopedDynamicNavMesh::~FScopedDynamicNavMesh()
+	{
+		GConfig->SetString(NavMeshSection, TEXT("RuntimeGeneration"), *mPrevRuntimeGeneration, GEngineIni);
+		GetMutableDefault<ARecastNavMesh>()->ReloadConfig();
+	}
+
+	/// @brief インデックスからグリッド上の配置位置を求める
+	FVector GridLocation(int32 Index)
+	{
+		const int32 Row = Index / 100;
+		const int32 Column = Index % 100;
+		return FVector(Column * GridSpacing, Row * GridSpacing, 0.0f);
+	}
+
+	/// @brief メッシュ未設定のコンポーネントにキューブを割り当て、コリジョンとオーバーラップの負荷を実際に近づける
+	void AssignBenchmarkMesh(AActor* Actor)
+	{
+		static UStaticMesh* CubeMesh = LoadObject<UStaticMesh>(nullptr, TEXT("/Engine/BasicShapes/Cube.Cube"));
+		if (!Actor || !CubeMesh)
+		{
+			return;
+		}
+
+		TArray<UStaticMeshComponent*> Meshes;
+		Actor->GetComponents(Meshes);
+		for (UStaticMeshComponent* Mesh : Meshes)
+		{
+			if (!Mesh->GetStaticMesh())
+			{
+				Mesh->SetStaticMesh(CubeMesh);
+			}
+		}
+	}
+
+	/// @brief 計測用の空ワールドを作り、ゲームモードなしでBeginPlayまで進める
+	/// @param Name ワールド名
+	/// @param bWithNavigation ナビゲーションシステムを追加するか
+	UWorld* CreateBenchmarkWorld(const FString& Name, bool bWithNavigation)
+	{
+		UWorld* World = UWorld::CreateWorld(EWorldType::Game, false, FName(*FString::Printf(TEXT("GimmickBenchmark_%s"), *Name)));
+		FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+		WorldContext.SetCurrentWorld(World);
+
+		if (bWithNavigation)
+		{
+			FNavigationSystem::AddNavigationSystemToWorld(*World, FNavigationSystemRunMode::GameMode);
+		}
+
+		World->InitializeActorsForPlay(FURL());
+		World->BeginPlay();
+		World->GetWorldSettings()->NotifyBeginPlay();
+		return World;
+	}
+
+	/// @brief 計測用のワールドを破棄する
+	void DestroyBenchmarkWorld(UWorld* World)
+	{
+		GEngine->DestroyWorldContext(World);
+		World->DestroyWorld(false);
+		CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+	}
+
+	/// @brief ワールドを固定時間で進める
+	/// @param World 対象のワールド
+	/// @param Frames 進めるフレーム数
+	void TickWorld(UWorld* World, int32 Frames)
+	{
+		for (int32 Frame = 0; Frame < Frames; Frame++)
+		{
+			World->Tick(LEVELTICK_All, FrameDeltaTime);
+			GFrameCounter++;
+		}
+	}
+
+	/// @brief シナリオをそれぞれ同じ数ずつ生成する
+	/// @param World 生成するワールド
+	/// @param Scenarios 生成するシナリオ
+	/// @param CountPerType シナリオごとの数
+	/// @return ボタンやトリガーを踏む役のアクタを含む、シナリオ実行中に共有する状態
+	FScenarioContext SetupScenarios(UWorld* World, TConstArrayView<FScenario> Scenarios, int32 CountPerType)
+	{
+		FScenarioContext Context;
+		Context.Presser = World->SpawnActor<AActor>();
+		for (const FScenario& Scenario : Scenarios)
+		{
+			Scenario.Setup(World, CountPerType, Context);
+		}
+		return Context;
+	}
+
+	/// @brief シナリオの1フレーム分の操作をまとめて行う（ワールドは進めない）
+	void StepScenarios(UWorld* World, TConstArrayView<FScenario> Scenarios, int32 Frame, FScenarioContext& Context)
+	{
+		for (const FScenario& Scenario : Scenarios)
+		{
+			Scenario.Step(World, Frame, Context);
+		}
+	}
+
+	/// @brief 動く床のシナリオ（指定パターンだけを生成）
+	FScenario MakeMoveFloorScenario(EFloorMovementPattern Pattern)
+	{
+		FScenario Scenario;
+		Scenario.Name = FString::Printf(TEXT("MoveFloor_%s"), *StaticEnum<EFloorMovementPattern>()->GetNameStringByValue(static_cast<int64>(Pattern)));
+		Scenario.Setup = [Pattern](UWorld* World, int32 Count, FScenarioContext& Context)
+		{
+			UGimmickMoveFloorConfig* Config = NewObject<UGimmickMoveFloorConfig>(World);
+			Config->mSettings.Pattern = Pattern;
+
+			for (int32 i = 0; i < Count; i++)
+			{
+				AGimmck_MoveFloor* Floor = World->SpawnActorDeferred<AGimmck_MoveFloor>(AGimmck_MoveFloor::StaticClass(), FTransform(GridLocation(i)));
+				Floor->mConfig = Config;
+				Floor->FinishSpawning(FTransform(GridLocation(i)));
+				AssignBenchmarkMesh(Floor);
+			}
+		};
+		Scenario.Step = [](UWorld*, int32, FScenarioContext&) {};
+		return Scenario;
+	}
+
+	/// @brief 落ちる床のシナリオ（一定間隔で全ての床を踏んで落下と再生成を繰り返す）
+	FScenario MakeFallFloorScenario()
+	{
+		FScenario Scenario;
+		Scenario.Name = TEXT("FallFloor");
+		Scenario.Setup = [](UWorld* World, int32 Count, FScenarioContext& Context)
+		{
+			UGimmickFallFloorConfig* Config = NewObject<UGimmickFallFloorConfig>(World);
+			Config->mSettings.DeleteDelay = 0.5f;
+			Config->mSettings.RespawnDelay = 0.5f;
+
+			for (int32 i = 0; i < Count; i++)
+			{
+				AGimmick_FallFloor* Floor = World->SpawnActor<AGimmick_FallFloor>(GridLocation(i), FRotator::ZeroRotator);
+				Floor->mConfig = Config;
+				AssignBenchmarkMesh(Floor);
+			}
+		};
+		Scenario.Step = [](UWorld* World, int32 Frame, FScenarioContext& Context)
+		{
+			if (Frame % FallFloorTriggerInterval != 0)
+			{
+				return;
+			}
+
+			for (TActorIterator<AGimmick_FallFloor> It(World); It; ++It)
+			{
+				It->OnTriggerBeginOverlap(nullptr, Context.Presser, nullptr, 0, false, FHitResult());
+			}
+		};
+		return Scenario;
+	}
+
+	/// @brief ボタンとボタンマネージャーのシナリオ（順番通りにボタンを押して離す）
+	FScenario MakeButtonScenario()
+	{
+		FScenario Scenario;
+		Scenario.Name = TEXT("ButtonSequence");
+		Scenario.Setup = [](UWorld* World, int32 Count, FScenarioContext& Context)
+		{
+			const int32 ManagerCount = FMath::Max(1, Count / ButtonsPerManager);
+			for (int32 i = 0; i < ManagerCount; i++)
+			{
+				const FVector Origin = GridLocation(i);
+
+				//ドア（動かせるメッシュアクタ）
+				AStaticMeshActor* Door = World->SpawnActorDeferred<AStaticMeshActor>(AStaticMeshActor::StaticClass(), FTransform(Origin));
+				Door->GetStaticMeshComponent()->SetMobility(EComponentMobility::Movable);
+				Door->FinishSpawning(FTransform(Origin));
+				AssignBenchmarkMesh(Door);
+
+				TArray<AGimmick_Button*> Sequence;
+				for (int32 j = 0; j < ButtonsPerManager; j++)
+				{
+					AGimmick_Button* Button = World->SpawnActor<AGimmick_Button>(Origin + FVector(200.0f * (j + 1), 0.0f, 0.0f), FRotator::ZeroRotator);
+					AssignBenchmarkMesh(Button);
+					Sequence.Add(Button);
+					Context.Buttons.Add(Button);
+				}
+
+				AGimmick_ButtonManager* Manager = World->SpawnActorDeferred<AGimmick_ButtonManager>(AGimmick_ButtonManager::StaticClass(), FTransform(Origin));
+				Manager->SetupSequence(Sequence, Door);
+				Manager->FinishSpawning(FTransform(Origin));
+			}
+		};
+		Scenario.Step = [](UWorld*, int32 Frame, FScenarioContext& Context)
+		{
+			if (Frame % ButtonPressInterval != 0)
+			{
+				return;
+			}
+
+			//全マネージャーで同じ番号のボタンを押し、前のボタンを離す
+			const int32 Slot = (Frame / ButtonPressInterval) % ButtonsPerManager;
+			const int32 PrevSlot = (Slot + ButtonsPerManager - 1) % ButtonsPerManager;
+			for (int32 i = 0; i + ButtonsPerManager <= Context.Buttons.Num(); i += ButtonsPerManager)
+			{
+				Context.Buttons[i + PrevSlot]->OnTriggerEndOverlap(nullptr, Context.Presser, nullptr, 0);
+				Context.Buttons[i + Slot]->OnTriggerBeginOverlap(nullptr, Context.Presser, nullptr, 0, false, FHitResult());
+			}
+		};
+		return Scenario;
+	}
+
+	/// @brief 押せるブロックのシナリオ（スクリプトで動かしたキャラクターがブロックを押し続ける）
+	FScenario MakePushBlockScenario()
+	{
+		FScenario Scenario;
+		Scenario.Name = TEXT("PushBlock");
+		Scenario.Setup = [](UWorld* World, int32 Count, FScenarioContext& Context)
+		{
+			for (int32 i = 0; i < Count; i++)
+			{
+				const FVector Origin = GridLocation(i);
+
+				AGimmick_PushBlock* Block = World->SpawnActor<AGimmick_PushBlock>(Origin + FVector(150.0f, 0.0f, 50.0f), FRotator::ZeroRotator);
+				AssignBenchmarkMesh(Block);
+
+				ASotugyouSeisakuCharacter* Pusher = World->SpawnActor<ASotugyouSeisakuCharacter>(Origin + FVector(0.0f, 0.0f, 100.0f), FRotator::ZeroRotator);
+				if (!Block || !Pusher)
+				{
+					continue;
+				}
+
+				Pusher->mTargetBlock = Block;
+				Pusher->bIsPushing = true;
+				Block->StartPushing(Pusher);
+
+				Context.Pushers.Add(Pusher);
+				Context.PusherOrigins.Add(Pusher->GetActorLocation());
+			}
+		};
+		Scenario.Step = [](UWorld*, int32 Frame, FScenarioContext& Context)
+		{
+			//前後移動と左右の向き変えを繰り返す
+			const float Time = Frame * FrameDeltaTime;
+			const FVector Offset(FMath::Sin(Time) * 200.0f, 0.0f, 0.0f);
+			const FRotator Rotation(0.0f, FMath::Sin(Time * 0.5f) * 45.0f, 0.0f);
+			for (int32 i = 0; i < Context.Pushers.Num(); i++)
+			{
+				Context.Pushers[i]->SetActorLocationAndRotation(Context.PusherOrigins[i] + Offset, Rotation);
+			}
+		};
+		return Scenario;
+	}
+
+	/// @brief 時間飛ばしと1フレームずつTickした場合を比べるギミックを置く
+	///        動く床（Horizontal_X、既定の設定）と、生成してすぐに踏んだ落ちる床を Count 個ずつ、同じ順に生成する
+	///        落ちる床の落ちるまでの時間は 10 個ごとに 0.5〜1.4 秒で、再生成までは 1 秒
+	/// @param World 生成するワールド
+	/// @param Count 種類ごとの数
+	void SetupFastForwardGimmicks(UWorld* World, int32 Count)
+	{
+		FScenarioContext Context;
+		MakeMoveFloorScenario(EFloorMovementPattern::Horizontal_X).Setup(World, Count, Context);
+
+		AActor* Presser = World->SpawnActor<AActor>();
+		for (int32 i = 0; i < Count; i++)
+		{
+			AGimmick_FallFloor* Floor = World->SpawnActor<AGimmick_FallFloor>(GridLocation(Count + i), FRotator::ZeroRotator);
+			UGimmickConfigOverrides* Overrides = UGimmickConfigOverrides::FindOrAdd(Floor, Floor->mOverrides);
+			Overrides->Set(EGimmickConfigParam::DeleteDelay, 0.5f + (i % 10) * 0.1f);
+			Overrides->Set(EGimmickConfigParam::RespawnDelay, 1.0f);
+			AssignBenchmarkMesh(Floor);
+			Floor->OnTriggerBeginOverlap(nullptr, Presser, nullptr, 0, false, FHitResult());
+		}
+	}
+
+	/// @brief 溝を挟んだ2つの地面と、溝を往復する床を作ってナビメッシュを生成する
+	///        地面A（x = -500〜500）と地面B（x = 1100〜2100）の間に幅600cmの溝があり、
+	///        床（300cm四方）は x = 650 と 950 の間を往復する（どちらの位置でも片側の地面にしか接しない）
+	/// @param World 対象のワールド（ナビゲーションシステム付きで作り、FScopedDynamicNavMesh の間に呼ぶ）
+	/// @param bFloorAffectsNavigation 床をナビメッシュに影響させるか（false なら時刻表付きリンクを置く）
+	FNavFloorLevel SetupNavFloorLevel(UWorld* World, bool bFloorAffectsNavigation)
+	{
+		FNavFloorLevel Level;
+		Level.NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(World);
+		Level.AgentStart = FVector(-300.0f, 0.0f, 100.0f);
+		Level.Goal = FVector(1800.0f, 0.0f, 100.0f);
+
+		//地面（上面が z = 0 のキューブ）
+		for (const float CenterX : { 0.0f, 1600.0f })
+		{
+			SpawnWithMesh<AStaticMeshActor>(World, FTransform(FRotator::ZeroRotator, FVector(CenterX, 0.0f, -50.0f), FVector(10.0f, 10.0f, 1.0f)));
+		}
+
+		//溝を往復する床（上面が z = 0）
+		UGimmickMoveFloorConfig* FloorConfig = NewObject<UGimmickMoveFloorConfig>(World);
+		FloorConfig->mSettings.Pattern = EFloorMovementPattern::Horizontal_X;
+		FloorConfig->mSettings.Distance = 300.0f;
+		FloorConfig->mSettings.Speed = 200.0f;
+		FloorConfig->mSettings.WaitTime = 1.5f;
+		const FTransform FloorTransform(FRotator::ZeroRotator, FVector(650.0f, 0.0f, -10.0f), FVector(3.0f, 3.0f, 0.2f));
+		Level.Floor = SpawnWithMesh<AGimmck_MoveFloor>(World, FloorTransform, [FloorConfig, bFloorAffectsNavigation](AGimmck_MoveFloor& Floor)
+		{
+			Floor.mConfig = FloorConfig;
+			if (bFloorAffectsNavigation)
+			{
+				Floor.FindComponentByClass<UStaticMeshComponent>()->SetCanEverAffectNavigation(true);
+			}
+		});
+
+		if (!bFloorAffectsNavigation)
+		{
+			AGimmickFloorNavLink* Link = World->SpawnActor<AGimmickFloorNavLink>(FVector(800.0f, 0.0f, 0.0f), FRotator::ZeroRotator);
+			Link->SetFloor(Level.Floor);
+		}
+
+		//ナビメッシュの範囲（ブラシの代わりにボックスのコリジョンで大きさを決める）
+		const FTransform BoundsTransform(FVector(800.0f, 0.0f, 0.0f));
+		ANavMeshBoundsVolume* Bounds = World->SpawnActorDeferred<ANavMeshBoundsVolume>(ANavMeshBoundsVolume::StaticClass(), BoundsTransform);
+		UBodySetup* BoundsBody = NewObject<UBodySetup>(Bounds->GetBrushComponent());
+		BoundsBody->AggGeom.BoxElems.Add(FKBoxElem(4000.0f, 2000.0f, 1000.0f));
+		Bounds->GetBrushComponent()->BrushBodySetup = BoundsBody;
+		Bounds->FinishSpawning(BoundsTransform);
+
+		if (Level.NavSys)
+		{
+			Level.NavSys->OnNavigationBoundsUpdated(Bounds);
+			Level.NavSys->Build();
+		}
+		return Level;
+	}
+}
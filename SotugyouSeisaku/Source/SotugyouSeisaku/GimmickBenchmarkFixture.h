@@ -0,0 +1,136 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
+#include "GimmickConfig.h"
+
+class AGimmck_MoveFloor;
+class AGimmick_Button;
+class ASotugyouSeisakuCharacter;
+class UNavigationSystemV1;
+
+/// @brief ベンチマーク（UGimmickBenchmarkCommandlet）と自動テストで共有する、空ワールドとギミックの生成の処理
+///        ワールドはゲームモードなし・描画なしでBeginPlayまで進め、ギミックは GridSpacing ごとに格子状に並べる
+namespace GimmickBenchmark
+{
+	//1フレームの固定時間（60fps想定）
+	constexpr float FrameDeltaTime = 1.0f / 60.0f;
+
+	//ギミック同士の配置間隔（cm）
+	constexpr float GridSpacing = 1000.0f;
+
+	//1つのボタンマネージャーが管理するボタンの数
+	constexpr int32 ButtonsPerManager = 4;
+
+	//ボタンを押し替える間隔（フレーム）
+	constexpr int32 ButtonPressInterval = 10;
+
+	//落ちる床を踏む間隔（フレーム）
+	constexpr int32 FallFloorTriggerInterval = 30;
+
+	/// @brief シナリオ実行中に共有する状態
+	struct FScenarioContext
+	{
+		//ボタンやトリガーを踏む役のアクタ
+		AActor* Presser = nullptr;
+
+		//ボタン（マネージャーごとにButtonsPerManager個ずつ並ぶ）
+		TArray<AGimmick_Button*> Buttons;
+
+		//ブロックを押すキャラクターとその基準位置
+		TArray<ASotugyouSeisakuCharacter*> Pushers;
+		TArray<FVector> PusherOrigins;
+	};
+
+	/// @brief 1シナリオ分の定義
+	struct FScenario
+	{
+		FString Name;
+		TFunction<void(UWorld*, int32, FScenarioContext&)> Setup;
+		TFunction<void(UWorld*, int32, FScenarioContext&)> Step;
+	};
+
+	/// @brief 動く床で溝を渡るテスト用のレベル
+	struct FNavFloorLevel
+	{
+		UNavigationSystemV1* NavSys = nullptr;
+		AGimmck_MoveFloor* Floor = nullptr;
+
+		//AIの出発地点と目的地（溝を挟んだ両側の地面）
+		FVector AgentStart;
+		FVector Goal;
+	};
+
+	/// @brief このスコープの間だけナビメッシュを実行時に作り直せるようにする（プロジェクトの設定ファイルは変えない）
+	class FScopedDynamicNavMesh
+	{
+	public:
+		FScopedDynamicNavMesh();
+		~FScopedDynamicNavMesh();
+
+	private:
+		FString mPrevRuntimeGeneration;
+	};
+
+	//インデックスからグリッド上の配置位置を求める
+	FVector GridLocation(int32 Index);
+
+	//メッシュ未設定のコンポーネントにキューブを割り当て、コリジョンとオーバーラップの負荷を実際に近づける
+	void AssignBenchmarkMesh(AActor* Actor);
+
+	/// @brief メッシュを割り当ててからアクタを生成する（BeginPlay より前に設定を渡す）
+	/// @param World 生成するワールド
+	/// @param Transform 配置
+	/// @param Configure FinishSpawning の前に呼ぶ処理
+	template <typename ActorType, typename FuncType>
+	ActorType* SpawnWithMesh(UWorld* World, const FTransform& Transform, FuncType&& Configure)
+	{
+		ActorType* Actor = World->SpawnActorDeferred<ActorType>(ActorType::StaticClass(), Transform);
+		AssignBenchmarkMesh(Actor);
+		Configure(*Actor);
+		Actor->FinishSpawning(Transform);
+		return Actor;
+	}
+
+	template <typename ActorType>
+	ActorType* SpawnWithMesh(UWorld* World, const FTransform& Transform)
+	{
+		return SpawnWithMesh<ActorType>(World, Transform, [](ActorType&) {});
+	}
+
+	//計測用の空ワールドを作り、ゲームモードなしでBeginPlayまで進める
+	UWorld* CreateBenchmarkWorld(const FString& Name, bool bWithNavigation = false);
+
+	//計測用のワールドを破棄する
+	void DestroyBenchmarkWorld(UWorld* World);
+
+	//ワールドを固定時間で Frames フレーム進める
+	void TickWorld(UWorld* World, int32 Frames);
+
+	//シナリオをそれぞれ CountPerType 個ずつ生成する（踏む役のアクタも作る）
+	FScenarioContext SetupScenarios(UWorld* World, TConstArrayView<FScenario> Scenarios, int32 CountPerType);
+
+	//シナリオの1フレーム分の操作をまとめて行う（ワールドは進めない）
+	void StepScenarios(UWorld* World, TConstArrayView<FScenario> Scenarios, int32 Frame, FScenarioContext& Context);
+
+	//動く床のシナリオ（指定パターンだけを生成）
+	FScenario MakeMoveFloorScenario(EFloorMovementPattern Pattern);
+
+	//落ちる床のシナリオ（一定間隔で全ての床を踏んで落下と再生成を繰り返す）
+	FScenario MakeFallFloorScenario();
+
+	//ボタンとボタンマネージャーのシナリオ（順番通りにボタンを押して離す）
+	FScenario MakeButtonScenario();
+
+	//押せるブロックのシナリオ（スクリプトで動かしたキャラクターがブロックを押し続ける）
+	FScenario MakePushBlockScenario();
+
+	//往復する動く床と、最初に1回踏んだ落ちる床（落ちるまでの時間は 0.5〜1.4 秒、再生成は 1 秒）を Count 個ずつ置く（時間飛ばしの比較用）
+	void SetupFastForwardGimmicks(UWorld* World, int32 Count);
+
+	//溝を挟んだ2つの地面と、溝を往復する床を作ってナビメッシュを生成する
+	FNavFloorLevel SetupNavFloorLevel(UWorld* World, bool bFloorAffectsNavigation);
+}
@@ -0,0 +1,219 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GimmickBenchmarkSuites.h"
+#include "Gimmick_FallFloor.h"
+#include "GimmickPlacementSpawner.h"
+#include "GimmickPreloadSubsystem.h"
+#include "Engine/Engine.h"
+#include "EngineUtils.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/ConfigCacheIni.h"
+#include "HAL/FileManager.h"
+#include "Dom/JsonObject.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+
+namespace GimmickBenchmark
+{
+	/// @brief マップを読み込んでゲームとして開始するまでの時間と、ゲームプレイ中の同期読み込みの数を計測する
+	///        マップごとに前のマップをガベージコレクションで解放してから読み込む（エンジンのコンテンツは読み込み済みのまま）。
+	///        ゲームプレイ中は、部屋（AGimmickPlacementSpawner）を一定間隔で順に先読み・生成し（プレイヤーが近づいたのと同じ）、
+	///        落ちる床を定期的に踏んで再生成まで進める
+	/// @param Maps 計測するマップ（+ 区切り）
+	/// @param Frames ゲームプレイを進めるフレーム数
+	/// @return 0 = ギミックの処理で同期読み込みが起きなかった、1 = 起きた、またはマップを読み込めない
+	int32 RunLoadSuite(const FString& Maps, int32 Frames)
+	{
+		TArray<FString> MapNames;
+		Maps.ParseIntoArray(MapNames, TEXT("+"));
+		if (MapNames.Num() == 0)
+		{
+			UE_LOG(LogGimmickBenchmark, Error, TEXT("No map given, use -Map=/Game/Maps/<Name>[+<Name>...]"));
+			return 1;
+		}
+
+		GimmickLoading::StartTracking();
+
+		int32 FailedMaps = 0;
+		for (const FString& MapName : MapNames)
+		{
+			CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+
+			const double LoadStart = FPlatformTime::Seconds();
+			UPackage* Package = LoadPackage(nullptr, *MapName, LOAD_None);
+			UWorld* World = Package ? UWorld::FindWorldInPackage(Package) : nullptr;
+			const double LoadMs = (FPlatformTime::Seconds() - LoadStart) * 1000.0;
+			if (!World)
+			{
+				UE_LOG(LogGimmickBenchmark, Error, TEXT("Failed to load map %s"), *MapName);
+				FailedMaps++;
+				continue;
+			}
+
+			//描画・ナビ・AIなしのゲームのワールドとして開始する（全アクタの BeginPlay まで）
+			const double BeginPlayStart = FPlatformTime::Seconds();
+			World->WorldType = EWorldType::Game;
+			World->AddToRoot();
+			FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+			WorldContext.SetCurrentWorld(World);
+			if (!World->bIsWorldInitialized)
+			{
+				World->InitWorld(UWorld::InitializationValues()
+					.AllowAudioPlayback(false)
+					.RequiresHitProxies(false)
+					.CreatePhysicsScene(true)
+					.CreateNavigation(false)
+					.CreateAISystem(false));
+			}
+			World->UpdateWorldComponents(true, false);
+			World->InitializeActorsForPlay(FURL());
+			World->BeginPlay();
+			World->GetWorldSettings()->NotifyBeginPlay();
+			const double BeginPlayMs = (FPlatformTime::Seconds() - BeginPlayStart) * 1000.0;
+
+			//ここからゲームプレイ中
+			GimmickLoading::ResetSyncLoadCounts();
+
+			TArray<AGimmickPlacementSpawner*> Spawners;
+			for (TActorIterator<AGimmickPlacementSpawner> It(World); It; ++It)
+			{
+				Spawners.Add(*It);
+			}
+			const int32 RoomInterval = FMath::Max(1, Frames / (Spawners.Num() + 1));
+			int32 NextRoom = 0;
+
+			AActor* Presser = World->SpawnActor<AActor>();
+			for (int32 Frame = 0; Frame < Frames; Frame++)
+			{
+				if (Frame % RoomInterval == 0 && Spawners.IsValidIndex(NextRoom))
+				{
+					Spawners[NextRoom++]->Preload();
+				}
+				if (Frame % FallFloorTriggerInterval == 0)
+				{
+					for (TActorIterator<AGimmick_FallFloor> It(World); It; ++It)
+					{
+						It->OnTriggerBeginOverlap(nullptr, Presser, nullptr, 0, false, FHitResult());
+					}
+				}
+
+				//非同期読み込みはエンジンのTickの代わりにここで進める
+				ProcessAsyncLoading(true, false, 0.005);
+				TickWorld(World, 1);
+			}
+
+			int32 SpawnedRooms = 0;
+			for (const AGimmickPlacementSpawner* Spawner : Spawners)
+			{
+				SpawnedRooms += Spawner->HasSpawned() ? 1 : 0;
+			}
+
+			const int32 SyncLoads = GimmickLoading::GetSyncLoadCount();
+			const int32 GimmickSyncLoads = GimmickLoading::GetGimmickSyncLoadCount();
+			UE_LOG(LogGimmickBenchmark, Display, TEXT("%s: load %.1f ms, begin play %.1f ms, rooms spawned %d/%d, sync loads during gameplay %d (gimmick paths %d)"),
+				*MapName, LoadMs, BeginPlayMs, SpawnedRooms, Spawners.Num(), SyncLoads, GimmickSyncLoads);
+			if (GimmickSyncLoads > 0)
+			{
+				UE_LOG(LogGimmickBenchmark, Error, TEXT("%s: %d synchronous loads on gimmick paths during gameplay"), *MapName, GimmickSyncLoads);
+				FailedMaps++;
+			}
+
+			GEngine->DestroyWorldContext(World);
+			World->DestroyWorld(false);
+			World->RemoveFromRoot();
+		}
+
+		CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+		return FailedMaps > 0 ? 1 : 0;
+	}
+
+	/// @brief 同じマシンで専用サーバーとクライアントを別プロセスで起動し、サーバーのレプリケーションの処理時間と送信量を計測する
+	///        サーバーは UGimmickReplicationGraph の -GimmickNetReport で、指定した数のクライアントが入ってから一定時間計測し、結果を書き出して終了する
+	/// @param Map 計測するマップ（空ならゲームの既定のマップ）
+	/// @param ClientCounts クライアントの数（+ 区切り）
+	/// @param Seconds 計測する秒数
+	/// @return 0 = すべて計測できた、1 = 計測できなかったものがある
+	int32 RunReplicationSuite(const FString& Map, const FString& ClientCounts, float Seconds)
+	{
+		constexpr int32 Port = 17777;
+
+		//サーバーがマップを開くまで待つ秒数
+		constexpr float ServerStartupSeconds = 15.0f;
+
+		const FString Executable = FPlatformProcess::ExecutablePath();
+		const FString Project = FPaths::ConvertRelativePathToFull(FPaths::GetProjectFilePath());
+		FString ServerMap = Map;
+		if (ServerMap.IsEmpty())
+		{
+			GConfig->GetString(TEXT("/Script/EngineSettings.GameMapsSettings"), TEXT("GameDefaultMap"), ServerMap, GEngineIni);
+		}
+
+		TArray<FString> Counts;
+		ClientCounts.ParseIntoArray(Counts, TEXT("+"));
+		int32 Failures = 0;
+		for (const FString& CountString : Counts)
+		{
+			const int32 Clients = FCString::Atoi(*CountString);
+			if (Clients <= 0)
+			{
+				continue;
+			}
+
+			const FString ReportPath = FPaths::ConvertRelativePathToFull(FPaths::ProjectSavedDir() / FString::Printf(TEXT("Benchmark/Replication_%d.json"), Clients));
+			IFileManager::Get().Delete(*ReportPath);
+
+			const FString ServerArgs = FString::Printf(TEXT("\"%s\" %s -server -nullrhi -nosound -unattended -port=%d -GimmickNetReport=\"%s\" -GimmickNetReportClients=%d -GimmickNetReportSeconds=%.0f"),
+				*Project, *ServerMap, Port, *ReportPath, Clients, Seconds);
+			FProcHandle Server = FPlatformProcess::CreateProc(*Executable, *ServerArgs, true, true, true, nullptr, 0, nullptr, nullptr);
+			if (!Server.IsValid())
+			{
+				UE_LOG(LogGimmickBenchmark, Error, TEXT("Replication: failed to start the server"));
+				return 1;
+			}
+			FPlatformProcess::Sleep(ServerStartupSeconds);
+
+			const FString ClientArgs = FString::Printf(TEXT("\"%s\" 127.0.0.1:%d -game -nullrhi -nosound -unattended"), *Project, Port);
+			TArray<FProcHandle> ClientProcs;
+			for (int32 i = 0; i < Clients; i++)
+			{
+				ClientProcs.Add(FPlatformProcess::CreateProc(*Executable, *ClientArgs, true, true, true, nullptr, 0, nullptr, nullptr));
+			}
+
+			//サーバーが計測を終えて終了するのを待つ（クライアントの起動・接続の分の余裕を持たせる）
+			const double Deadline = FPlatformTime::Seconds() + Seconds + 60.0 + Clients * 5.0;
+			while (FPlatformProcess::IsProcRunning(Server) && FPlatformTime::Seconds() < Deadline)
+			{
+				FPlatformProcess::Sleep(1.0f);
+			}
+
+			for (FProcHandle& Proc : ClientProcs)
+			{
+				if (Proc.IsValid())
+				{
+					FPlatformProcess::TerminateProc(Proc, true);
+					FPlatformProcess::CloseProc(Proc);
+				}
+			}
+			if (FPlatformProcess::IsProcRunning(Server))
+			{
+				FPlatformProcess::TerminateProc(Server, true);
+			}
+			FPlatformProcess::CloseProc(Server);
+
+			FString Json;
+			TSharedPtr<FJsonObject> Report;
+			if (!FFileHelper::LoadFileToString(Json, *ReportPath) || !FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(Json), Report) || !Report.IsValid())
+			{
+				UE_LOG(LogGimmickBenchmark, Error, TEXT("Replication: no report from the server with %d clients (check the server log in Saved/Logs)"), Clients);
+				Failures++;
+				continue;
+			}
+
+			UE_LOG(LogGimmickBenchmark, Display, TEXT("Replication: %d clients, replicate %.3f ms/frame over %d frames, sent %.1f KB/s (%.2f KB/s per client)"),
+				Clients, Report->GetNumberField(TEXT("replicate_ms")), static_cast<int32>(Report->GetNumberField(TEXT("frames"))),
+				Report->GetNumberField(TEXT("out_bytes_per_second")) / 1024.0, Report->GetNumberField(TEXT("out_bytes_per_client_per_second")) / 1024.0);
+		}
+		return Failures > 0 ? 1 : 0;
+	}
+}
@@ -0,0 +1,171 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GimmickBenchmarkSuites.h"
+#include "GimmickMath.h"
+
+namespace GimmickBenchmark
+{
+	/// @brief ギミックの計算（GimmickMath）を1個ずつの版とまとめて計算する版で処理時間を比べる
+	///        ワールドを作らないので数ミリ秒で終わる（結果が一致するかは自動テスト SotugyouSeisaku.Gimmick.Math で確かめる）
+	/// @param Count 1回にまとめて計算する数
+	/// @param Iterations 計測の繰り返し回数
+	/// @return 0
+	int32 RunMathSuite(int32 Count, int32 Iterations)
+	{
+		using namespace GimmickMath;
+
+		Count = FMath::Max(Count, 1);
+		Iterations = FMath::Max(Iterations, 1);
+		FRandomStream Random(Count);
+
+		constexpr int32 PatternCount = static_cast<int32>(EFloorPattern::Custom) + 1;
+
+		//動く床
+		FFloorBatch Floors;
+		TArray<FFloorParams> FloorParams;
+		Floors.Reserve(Count);
+		FloorParams.Reserve(Count);
+		for (int32 i = 0; i < Count; i++)
+		{
+			FFloorParams& Floor = FloorParams.AddDefaulted_GetRef();
+			Floor.Pattern = static_cast<EFloorPattern>(Random.RandHelper(PatternCount));
+			Floor.Distance = Random.FRandRange(100.0f, 1000.0f);
+			Floor.CustomOffset = FVector3f(Random.VRand()) * Random.FRandRange(100.0f, 1000.0f);
+			Floor.Speed = Random.FRandRange(50.0f, 500.0f);
+			Floor.WaitTime = Random.FRandRange(0.0f, 2.0f);
+			Floors.Add(Floor);
+		}
+
+		TArray<float> Times;
+		TArray<float> OutX;
+		TArray<float> OutY;
+		TArray<float> OutZ;
+		Times.SetNumUninitialized(Count);
+		OutX.SetNumUninitialized(Count);
+		OutY.SetNumUninitialized(Count);
+		OutZ.SetNumUninitialized(Count);
+
+		//押せる向き: 元の判定（正規化して Acos で角度を比べる）
+		auto ReferenceCanPush = [](const FVector& ToPlayer, const FVector& PushDir, float PushAngle)
+		{
+			FVector Dir = ToPlayer;
+			Dir.Z = 0.0f;
+			if (Dir.IsNearlyZero())
+			{
+				return false;
+			}
+			Dir.Normalize();
+			FVector Face = PushDir;
+			Face.Z = 0.0f;
+			Face.Normalize();
+			return FMath::RadiansToDegrees(FMath::Acos(FMath::Clamp(-FVector::DotProduct(Dir, Face), -1.0, 1.0))) <= PushAngle;
+		};
+
+		FPushConeBatch Cones;
+		Cones.Reserve(Count);
+		TArray<FVector> ConeDirs;
+		TArray<float> ConeAngles;
+		TArray<float> PlayerX;
+		TArray<float> PlayerY;
+		PlayerX.SetNumUninitialized(Count);
+		PlayerY.SetNumUninitialized(Count);
+		for (int32 i = 0; i < Count; i++)
+		{
+			const FVector Block(Random.FRandRange(-5000.0f, 5000.0f), Random.FRandRange(-5000.0f, 5000.0f), 0.0f);
+			const FVector PushDir = Random.VRand();
+			const float Angle = Random.FRandRange(0.0f, 180.0f);
+			const FVector Player = Block + Random.VRand() * Random.FRandRange(50.0f, 300.0f);
+
+			Cones.Add(Block, GetPushDir2D(PushDir), PushConeCos(Angle));
+			ConeDirs.Add(PushDir);
+			ConeAngles.Add(Angle);
+			PlayerX[i] = Player.X;
+			PlayerY[i] = Player.Y;
+		}
+
+		TArray<uint8> CanPush;
+		CanPush.SetNumUninitialized(Count);
+
+		//落ちる床の揺れ
+		TArray<float> Frequencies;
+		TArray<float> Amplitudes;
+		Frequencies.SetNumUninitialized(Count);
+		Amplitudes.SetNumUninitialized(Count);
+		for (int32 i = 0; i < Count; i++)
+		{
+			Frequencies[i] = Random.FRandRange(5.0f, 40.0f);
+			Amplitudes[i] = Random.FRandRange(1.0f, 10.0f);
+		}
+
+		//処理時間（1個あたりの ns）
+		double Checksum = 0.0;
+		auto Measure = [Count, Iterations](const TFunctionRef<void()> Body)
+		{
+			const double Start = FPlatformTime::Seconds();
+			for (int32 Iteration = 0; Iteration < Iterations; Iteration++)
+			{
+				Body();
+			}
+			return (FPlatformTime::Seconds() - Start) * 1.0e9 / (static_cast<double>(Count) * Iterations);
+		};
+
+		for (float& Time : Times)
+		{
+			Time = Random.FRandRange(0.0f, 100.0f);
+		}
+		const double FloorSingleNs = Measure([&]()
+		{
+			for (int32 i = 0; i < Count; i++)
+			{
+				Checksum += SampleFloorOffset(FloorParams[i], Times[i]).X;
+			}
+		});
+		const double FloorBatchNs = Measure([&]()
+		{
+			EvaluateFloorOffsets(Floors, Times.GetData(), OutX.GetData(), OutY.GetData(), OutZ.GetData());
+			Checksum += OutX[0];
+		});
+
+		const double ConeAcosNs = Measure([&]()
+		{
+			for (int32 i = 0; i < Count; i++)
+			{
+				const FVector Block(Cones.BlockX[i], Cones.BlockY[i], 0.0f);
+				Checksum += ReferenceCanPush(FVector(PlayerX[i], PlayerY[i], 0.0f) - Block, ConeDirs[i], ConeAngles[i]) ? 1.0 : 0.0;
+			}
+		});
+		const double ConeSingleNs = Measure([&]()
+		{
+			for (int32 i = 0; i < Count; i++)
+			{
+				const FVector ToPlayer(PlayerX[i] - Cones.BlockX[i], PlayerY[i] - Cones.BlockY[i], 0.0f);
+				Checksum += IsInPushCone(ToPlayer, FVector(Cones.DirX[i], Cones.DirY[i], 0.0f), Cones.ConeCos[i]) ? 1.0 : 0.0;
+			}
+		});
+		const double ConeBatchNs = Measure([&]()
+		{
+			TestPushCones(Cones, PlayerX.GetData(), PlayerY.GetData(), CanPush.GetData());
+			Checksum += CanPush[0];
+		});
+
+		const double ShakeSingleNs = Measure([&]()
+		{
+			for (int32 i = 0; i < Count; i++)
+			{
+				Checksum += GetShakeOffset(Times[i], Frequencies[i], Amplitudes[i]).X;
+			}
+		});
+		const double ShakeBatchNs = Measure([&]()
+		{
+			EvaluateShakeOffsets(Times.GetData(), Frequencies.GetData(), Amplitudes.GetData(), Count, OutX.GetData(), OutY.GetData());
+			Checksum += OutX[0];
+		});
+
+		UE_LOG(LogGimmickBenchmark, Display, TEXT("Math: %d items x %d iterations (checksum %.1f)"), Count, Iterations, Checksum);
+		UE_LOG(LogGimmickBenchmark, Display, TEXT("Floors: single %.2f ns, batched %.2f ns (x%.1f)"), FloorSingleNs, FloorBatchNs, FloorSingleNs / FMath::Max(FloorBatchNs, 0.001));
+		UE_LOG(LogGimmickBenchmark, Display, TEXT("Push cones: acos %.2f ns, single %.2f ns, batched %.2f ns (x%.1f)"), ConeAcosNs, ConeSingleNs, ConeBatchNs, ConeSingleNs / FMath::Max(ConeBatchNs, 0.001));
+		UE_LOG(LogGimmickBenchmark, Display, TEXT("Shakes: single %.2f ns, batched %.2f ns (x%.1f)"), ShakeSingleNs, ShakeBatchNs, ShakeSingleNs / FMath::Max(ShakeBatchNs, 0.001));
+
+		return 0;
+	}
+}
@@ -0,0 +1,358 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GimmickBenchmarkSuites.h"
+#include "Gimmck_MoveFloor.h"
+#include "Gimmick_Button.h"
+#include "Gimmick_FallFloor.h"
+#include "Gimmick_PushBlock.h"
+#include "GimmickSubsystem.h"
+#include "GimmickTimerSubsystem.h"
+#include "GimmickSchedulerSubsystem.h"
+#include "GimmickFeedbackSubsystem.h"
+#include "GimmickFlightRecorderSubsystem.h"
+#include "GimmickInstanceSubsystem.h"
+#include "EngineUtils.h"
+#include "Tickable.h"
+#include "UObject/Package.h"
+#include "Serialization/ObjectWriter.h"
+
+namespace GimmickBenchmark
+{
+	/// @brief ゲームスレッドのヒープ確保の回数を数える GMalloc の中継
+	///        確保・解放は元のアロケーターにそのまま渡す（入れ替える前に確保したメモリも解放できる）
+	class FAllocationCounter final : public FMalloc
+	{
+	public:
+		explicit FAllocationCounter(FMalloc* InInner)
+			: mInner(InInner)
+		{
+		}
+
+		virtual void* Malloc(SIZE_T Size, uint32 Alignment) override
+		{
+			Note();
+			return mInner->Malloc(Size, Alignment);
+		}
+
+		virtual void* Realloc(void* Original, SIZE_T Size, uint32 Alignment) override
+		{
+			if (Size > 0)
+			{
+				Note();
+			}
+			return mInner->Realloc(Original, Size, Alignment);
+		}
+
+		virtual void Free(void* Original) override { mInner->Free(Original); }
+		virtual bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override { return mInner->GetAllocationSize(Original, SizeOut); }
+		virtual SIZE_T QuantizeSize(SIZE_T Size, uint32 Alignment) override { return mInner->QuantizeSize(Size, Alignment); }
+		virtual void Trim(bool bTrimThreadCaches) override { mInner->Trim(bTrimThreadCaches); }
+		virtual void SetupTLSCachesOnCurrentThread() override { mInner->SetupTLSCachesOnCurrentThread(); }
+		virtual void ClearAndDisableTLSCachesOnCurrentThread() override { mInner->ClearAndDisableTLSCachesOnCurrentThread(); }
+		virtual bool IsInternallyThreadSafe() const override { return mInner->IsInternallyThreadSafe(); }
+		virtual bool ValidateHeap() override { return mInner->ValidateHeap(); }
+		virtual const TCHAR* GetDescriptiveName() override { return TEXT("GimmickAllocationCounter"); }
+
+		//数えるか（ゲームスレッドの確保だけ数える）
+		bool bCounting = false;
+
+		//数えた回数
+		int64 Count = 0;
+
+	private:
+		void Note()
+		{
+			if (bCounting && IsInGameThread())
+			{
+				Count++;
+			}
+		}
+
+		FMalloc* mInner;
+	};
+
+	/// @brief 暖気後のゲームプレイの毎フレームの処理（ギミックのTickと、ギミックのサブシステムのTick）がヒープ確保をしないかを確かめる
+	///        動く床と押せるブロック（押すキャラクター付き）を置いてワールドを暖気した後、毎フレームの処理を1つずつ直接呼び、
+	///        その間のゲームスレッドの確保を数える（ワールドのTick自体のエンジンの確保は含めない）。
+	///        落ちる床・ボタンはイベントのときだけ動くので含めない。最後にクラスごとのメモリ使用量も出す
+	/// @param Count ギミックの総数
+	/// @param Frames 確かめるフレーム数
+	/// @return 0 = 確保なし、1 = 確保あり
+	int32 RunAllocationsSuite(int32 Count, int32 Frames)
+	{
+		constexpr int32 WarmupFrames = 120;
+
+		UWorld* World = CreateBenchmarkWorld(TEXT("Allocations"));
+		const FScenario Scenarios[] = { MakeMoveFloorScenario(EFloorMovementPattern::Horizontal_X), MakePushBlockScenario() };
+		FScenarioContext Context = SetupScenarios(World, Scenarios, FMath::Max(1, Count / 2));
+
+		for (int32 Frame = 0; Frame < WarmupFrames; Frame++)
+		{
+			StepScenarios(World, Scenarios, Frame, Context);
+			TickWorld(World, 1);
+		}
+
+		//毎フレームの処理（名前と呼び出し）
+		TArray<TPair<FString, TFunction<void()>>> Paths;
+		Paths.Emplace(TEXT("AGimmck_MoveFloor::Tick"), [World]()
+		{
+			for (TActorIterator<AGimmck_MoveFloor> It(World); It; ++It)
+			{
+				if (It->IsActorTickEnabled())
+				{
+					It->Tick(FrameDeltaTime);
+				}
+			}
+		});
+		Paths.Emplace(TEXT("AGimmick_PushBlock::FollowPlayer"), [World]()
+		{
+			//押されているブロックを1フレームごとに前後へ動かす（位置は元に戻る）
+			const float Step = (GFrameCounter % 2 == 0) ? 2.0f : -2.0f;
+			for (TActorIterator<AGimmick_PushBlock> It(World); It; ++It)
+			{
+				if (It->bIsBeginePushed)
+				{
+					It->FollowPlayer(It->GetActorForwardVector() * Step, It->GetActorLocation(), 0.0f);
+				}
+			}
+		});
+		auto AddSubsystem = [&Paths](const TCHAR* Name, FTickableGameObject* Subsystem)
+		{
+			if (Subsystem)
+			{
+				Paths.Emplace(Name, [Subsystem]() { Subsystem->Tick(FrameDeltaTime); });
+			}
+		};
+		AddSubsystem(TEXT("UGimmickTimerSubsystem::Tick"), World->GetSubsystem<UGimmickTimerSubsystem>());
+		AddSubsystem(TEXT("UGimmickSchedulerSubsystem::Tick"), World->GetSubsystem<UGimmickSchedulerSubsystem>());
+		AddSubsystem(TEXT("UGimmickInstanceSubsystem::Tick"), World->GetSubsystem<UGimmickInstanceSubsystem>());
+		AddSubsystem(TEXT("UGimmickFeedbackSubsystem::Tick"), World->GetSubsystem<UGimmickFeedbackSubsystem>());
+		AddSubsystem(TEXT("UGimmickFlightRecorderSubsystem::Tick"), World->GetSubsystem<UGimmickFlightRecorderSubsystem>());
+
+		TArray<int64> Allocations;
+		Allocations.SetNumZeroed(Paths.Num());
+
+		FAllocationCounter Counter(GMalloc);
+		FMalloc* PrevMalloc = GMalloc;
+		GMalloc = &Counter;
+		for (int32 Frame = 0; Frame < Frames; Frame++)
+		{
+			StepScenarios(World, Scenarios, WarmupFrames + Frame, Context);
+
+			for (int32 i = 0; i < Paths.Num(); i++)
+			{
+				Counter.Count = 0;
+				Counter.bCounting = true;
+				Paths[i].Value();
+				Counter.bCounting = false;
+				Allocations[i] += Counter.Count;
+			}
+			GFrameCounter++;
+		}
+		GMalloc = PrevMalloc;
+
+		int64 Total = 0;
+		for (int32 i = 0; i < Paths.Num(); i++)
+		{
+			UE_LOG(LogGimmickBenchmark, Display, TEXT("%-40s %lld allocations in %d frames (%.2f/frame)"),
+				*Paths[i].Key, Allocations[i], Frames, static_cast<double>(Allocations[i]) / FMath::Max(Frames, 1));
+			Total += Allocations[i];
+		}
+
+		for (const FGimmickClassMemory& Memory : UGimmickSubsystem::GatherMemoryReport(World))
+		{
+			UE_LOG(LogGimmickBenchmark, Display, TEXT("%-32s count %d, %.0f bytes/instance (physics %.0f)"),
+				*GetNameSafe(Memory.Class), Memory.Count, static_cast<double>(Memory.GetTotalBytes()) / Memory.Count, static_cast<double>(Memory.PhysicsBytes) / Memory.Count);
+		}
+
+		DestroyBenchmarkWorld(World);
+
+		if (Total > 0)
+		{
+			UE_LOG(LogGimmickBenchmark, Error, TEXT("Gameplay hot paths made %lld heap allocations after warm-up"), Total);
+			return 1;
+		}
+		return 0;
+	}
+
+	/// @brief 共有設定の計測で数える大きさ
+	struct FConfigSizes
+	{
+		int32 Gimmicks = 0;
+		int32 Overridden = 0;
+
+		//ギミックごとに設定を持つ場合（以前）/ 共有設定を参照する場合のメモリ（設定の部分だけ）
+		int64 InlineMemory = 0;
+		int64 SharedMemory = 0;
+
+		//ギミックごとに設定を持つ場合 / 共有設定を参照する場合にマップに書き出す大きさ
+		int64 InlineSerialized = 0;
+		int64 SharedSerialized = 0;
+	};
+
+	/// @brief オブジェクトを既定値（アーキタイプ）との差分で書き出した大きさ（マップに保存するときと同じタグ付きの形式）
+	int64 SerializedSize(UObject* Object)
+	{
+		TArray<uint8> Bytes;
+		FObjectWriter Writer(Object, Bytes);
+		return Bytes.Num();
+	}
+
+	/// @brief 設定を既定値との差分で書き出した大きさ（以前はアクタのプロパティとしてギミックごとに書き出していた部分）
+	///        設定だけを持つ共有設定を書き出し、既定値のままの共有設定との差を取る
+	template <typename ConfigType, typename SettingsType>
+	int64 SerializedSettingsSize(const SettingsType& Settings)
+	{
+		ConfigType* Config = NewObject<ConfigType>(GetTransientPackage());
+		const int64 EmptySize = SerializedSize(Config);
+		Config->mSettings = Settings;
+		return SerializedSize(Config) - EmptySize;
+	}
+
+	/// @brief 共有設定を参照するギミックを1個生成し、大きさを数える
+	/// @param World 生成するワールド
+	/// @param Index 配置の番号
+	/// @param Config 共有設定
+	/// @param Override 上書き（nullptr なら上書きしない）
+	/// @param BaseSerialized 設定なしのアクタを書き出した大きさ
+	/// @param Sizes 加算先
+	template <typename ActorType, typename ConfigType>
+	void SpawnConfiguredGimmick(UWorld* World, int32 Index, ConfigType* Config, const FGimmickConfigOverride* Override, int64 BaseSerialized, FConfigSizes& Sizes)
+	{
+		const FTransform Transform(GridLocation(Index));
+		ActorType* Actor = World->SpawnActorDeferred<ActorType>(ActorType::StaticClass(), Transform);
+		Actor->mConfig = Config;
+
+		//以前のようにギミックごとに持っていた場合の設定（共有設定に上書きを適用したもの）
+		auto InlineSettings = Config->mSettings;
+		if (Override)
+		{
+			UGimmickConfigOverrides::FindOrAdd(Actor, Actor->mOverrides)->mEntries.Add(*Override);
+			InlineSettings.ApplyOverride(*Override);
+		}
+		Actor->FinishSpawning(Transform);
+
+		Sizes.Gimmicks++;
+		Sizes.InlineMemory += sizeof(InlineSettings);
+		Sizes.SharedMemory += sizeof(Actor->mConfig) + sizeof(Actor->mOverrides);
+		Sizes.InlineSerialized += BaseSerialized + SerializedSettingsSize<ConfigType>(InlineSettings);
+		Sizes.SharedSerialized += SerializedSize(Actor);
+		if (const UGimmickConfigOverrides* Overrides = Actor->mOverrides)
+		{
+			Sizes.Overridden++;
+			Sizes.SharedMemory += Overrides->GetClass()->GetStructureSize() + Overrides->mEntries.GetAllocatedSize();
+			Sizes.SharedSerialized += SerializedSize(Actor->mOverrides.Get());
+		}
+	}
+
+	/// @brief 共有設定（フライウェイト）の効果を計測する
+	///        動く床・ボタン・落ちる床を 2:1:1 で Count 個置き、調整は種類ごとに Variants 通り（プレハブに相当）で、OverrideEvery 個に1個は上書きを持つ。
+	///        以前のようにギミックごとに設定を持つ場合（設定の構造体の大きさ・既定値との差分で書き出した大きさ）と、
+	///        共有設定を参照する場合（参照の大きさ・アクタを書き出した大きさ + 共有設定1つずつ + 上書き）を比べる。
+	///        共有設定と上書きから設定が求まるか・共有設定を直すと参照しているギミックに届くかは自動テスト SotugyouSeisaku.Gimmick.Config で確かめる
+	/// @param Count ギミックの総数
+	void RunConfigSuite(int32 Count)
+	{
+		constexpr int32 Variants = 8;
+		constexpr int32 OverrideEvery = 20;
+
+		UWorld* World = CreateBenchmarkWorld(TEXT("Config"));
+
+		//種類ごとの調整（共有設定）
+		TArray<UGimmickMoveFloorConfig*> FloorConfigs;
+		TArray<UGimmickButtonConfig*> ButtonConfigs;
+		TArray<UGimmickFallFloorConfig*> FallFloorConfigs;
+		const EFloorMovementPattern Patterns[] = { EFloorMovementPattern::Horizontal_X, EFloorMovementPattern::Vertical_Z, EFloorMovementPattern::Circle_XY };
+		for (int32 v = 0; v < Variants; v++)
+		{
+			UGimmickMoveFloorConfig* Floor = FloorConfigs.Add_GetRef(NewObject<UGimmickMoveFloorConfig>(World));
+			Floor->mSettings.Pattern = Patterns[v % UE_ARRAY_COUNT(Patterns)];
+			Floor->mSettings.Distance = 300.0f + 100.0f * v;
+			Floor->mSettings.Speed = 150.0f + 25.0f * v;
+			Floor->mSettings.WaitTime = 0.5f + 0.25f * v;
+
+			UGimmickButtonConfig* Button = ButtonConfigs.Add_GetRef(NewObject<UGimmickButtonConfig>(World));
+			Button->mSettings.MoveDir = FVector(0.0f, 200.0f + 50.0f * v, 0.0f);
+			Button->mSettings.MoveSpeed = 200.0f + 25.0f * v;
+			Button->mSettings.bReturnToOriginal = v % 2 == 0;
+
+			UGimmickFallFloorConfig* FallFloor = FallFloorConfigs.Add_GetRef(NewObject<UGimmickFallFloorConfig>(World));
+			FallFloor->mSettings.DeleteDelay = 1.0f + 0.25f * v;
+			FallFloor->mSettings.RespawnDelay = 2.0f + 0.5f * v;
+			FallFloor->mSettings.ShakeAmplitude = 3.0f + v;
+			FallFloor->mSettings.ShakeFrequency = 15.0f + v;
+		}
+
+		//設定なしのアクタを書き出した大きさ（以前のギミックは、これに設定の差分が加わっていた）
+		auto BaseSize = [World](UClass* Class)
+		{
+			AActor* Actor = World->SpawnActor<AActor>(Class, FTransform::Identity);
+			const int64 Size = SerializedSize(Actor);
+			Actor->Destroy();
+			return Size;
+		};
+		const int64 FloorBase = BaseSize(AGimmck_MoveFloor::StaticClass());
+		const int64 ButtonBase = BaseSize(AGimmick_Button::StaticClass());
+		const int64 FallFloorBase = BaseSize(AGimmick_FallFloor::StaticClass());
+
+		FConfigSizes Sizes;
+		for (int32 i = 0; i < Count; i++)
+		{
+			const int32 Variant = (i / 4) % Variants;
+			const bool bOverride = i % OverrideEvery == OverrideEvery - 1;
+
+			FGimmickConfigOverride Override;
+			Override.Value = 0.1f * (i % 7) + 0.25f;
+
+			switch (i % 4)
+			{
+			case 0:
+			case 1:
+				Override.Param = EGimmickConfigParam::WaitTime;
+				SpawnConfiguredGimmick<AGimmck_MoveFloor>(World, i, FloorConfigs[Variant], bOverride ? &Override : nullptr, FloorBase, Sizes);
+				break;
+			case 2:
+				Override.Param = EGimmickConfigParam::DoorMoveSpeed;
+				Override.Value *= 1000.0f;
+				SpawnConfiguredGimmick<AGimmick_Button>(World, i, ButtonConfigs[Variant], bOverride ? &Override : nullptr, ButtonBase, Sizes);
+				break;
+			default:
+				Override.Param = EGimmickConfigParam::DeleteDelay;
+				SpawnConfiguredGimmick<AGimmick_FallFloor>(World, i, FallFloorConfigs[Variant], bOverride ? &Override : nullptr, FallFloorBase, Sizes);
+				break;
+			}
+		}
+
+		//共有設定1つずつの分
+		int64 ConfigMemory = 0;
+		int64 ConfigSerialized = 0;
+		for (int32 v = 0; v < Variants; v++)
+		{
+			for (UObject* Config : { static_cast<UObject*>(FloorConfigs[v]), static_cast<UObject*>(ButtonConfigs[v]), static_cast<UObject*>(FallFloorConfigs[v]) })
+			{
+				ConfigMemory += Config->GetClass()->GetStructureSize();
+				ConfigSerialized += SerializedSize(Config);
+			}
+		}
+
+		//上書きを適用した結果（同じ値は1つにまとめる）の分は、一番大きい設定の大きさで多めに数える
+		const int64 InternedMemory = GimmickConfig::NumInterned() * static_cast<int64>(sizeof(FMoveFloorSettings));
+		const int64 SharedMemory = Sizes.SharedMemory + ConfigMemory + InternedMemory;
+		const int64 SharedSerialized = Sizes.SharedSerialized + ConfigSerialized;
+
+		const int32 Gimmicks = FMath::Max(Sizes.Gimmicks, 1);
+		UE_LOG(LogGimmickBenchmark, Display, TEXT("Config: %d gimmicks (%d with overrides), %d shared configs, %d interned override results"),
+			Sizes.Gimmicks, Sizes.Overridden, Variants * 3, GimmickConfig::NumInterned());
+		UE_LOG(LogGimmickBenchmark, Display, TEXT("Tuning memory: per instance %.1f KB (%.1f bytes/gimmick), shared %.1f KB (%.1f bytes/gimmick incl. configs and overrides), saved %.1f KB"),
+			Sizes.InlineMemory / 1024.0, static_cast<double>(Sizes.InlineMemory) / Gimmicks,
+			SharedMemory / 1024.0, static_cast<double>(SharedMemory) / Gimmicks, (Sizes.InlineMemory - SharedMemory) / 1024.0);
+		UE_LOG(LogGimmickBenchmark, Display, TEXT("Serialized gimmicks: per instance %.1f KB (%.1f bytes/gimmick), shared %.1f KB (%.1f bytes/gimmick incl. configs and overrides), saved %.1f KB (%.1f%%)"),
+			Sizes.InlineSerialized / 1024.0, static_cast<double>(Sizes.InlineSerialized) / Gimmicks,
+			SharedSerialized / 1024.0, static_cast<double>(SharedSerialized) / Gimmicks,
+			(Sizes.InlineSerialized - SharedSerialized) / 1024.0, 100.0 * (Sizes.InlineSerialized - SharedSerialized) / FMath::Max<int64>(Sizes.InlineSerialized, 1));
+		UE_LOG(LogGimmickBenchmark, Display, TEXT("Actor class sizes for reference: MoveFloor %d, Button %d, FallFloor %d bytes"),
+			AGimmck_MoveFloor::StaticClass()->GetStructureSize(), AGimmick_Button::StaticClass()->GetStructureSize(), AGimmick_FallFloor::StaticClass()->GetStructureSize());
+
+		DestroyBenchmarkWorld(World);
+	}
+}
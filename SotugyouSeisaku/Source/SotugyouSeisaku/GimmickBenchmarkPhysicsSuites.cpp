@@ -0,0 +1,341 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GimmickBenchmarkSuites.h"
+#include "Gimmick_FallFloor.h"
+#include "Gimmick_PushBlock.h"
+#include "SotugyouSeisakuCharacter.h"
+#include "GimmickCollapseCache.h"
+#include "GimmickCollapseSubsystem.h"
+#include "Engine/StaticMeshActor.h"
+#include "Components/StaticMeshComponent.h"
+#include "NavigationSystem.h"
+#include "NavigationData.h"
+
+namespace GimmickBenchmark
+{
+	/// @brief 床が動くことによるナビメッシュの再構築時間を、時刻表付きリンクを使う場合と比べる
+	///        AIが動く床に乗って溝を渡れるかは自動テスト SotugyouSeisaku.Gimmick.NavFloor で確かめる
+	/// @param Frames 再構築時間を計測するフレーム数
+	void RunNavFloorSuite(int32 Frames)
+	{
+		const FScopedDynamicNavMesh DynamicNavMesh;
+
+		//床を動かしながらフレーム時間を計る（ナビメッシュの非同期ビルドもフレーム内で完了させる）
+		auto MeasureFrames = [Frames](UWorld* World, const FNavFloorLevel& Level)
+		{
+			ANavigationData* NavData = Level.NavSys ? Level.NavSys->GetDefaultNavDataInstance() : nullptr;
+			const double Start = FPlatformTime::Seconds();
+			for (int32 Frame = 0; Frame < Frames; Frame++)
+			{
+				TickWorld(World, 1);
+				if (NavData)
+				{
+					NavData->EnsureBuildCompletion();
+				}
+			}
+			return (FPlatformTime::Seconds() - Start) * 1000.0 / FMath::Max(Frames, 1);
+		};
+
+		//床がナビメッシュに影響する場合（動くたびに周りのタイルを作り直す）
+		UWorld* DynamicWorld = CreateBenchmarkWorld(TEXT("NavFloorDynamic"), true);
+		const double DynamicFrameMs = MeasureFrames(DynamicWorld, SetupNavFloorLevel(DynamicWorld, true));
+		DestroyBenchmarkWorld(DynamicWorld);
+
+		//床は影響させず、時刻表付きリンクを使う場合
+		UWorld* LinkWorld = CreateBenchmarkWorld(TEXT("NavFloorLink"), true);
+		const double LinkFrameMs = MeasureFrames(LinkWorld, SetupNavFloorLevel(LinkWorld, false));
+		DestroyBenchmarkWorld(LinkWorld);
+
+		UE_LOG(LogGimmickBenchmark, Display, TEXT("NavFloor: frame %.3f ms with navmesh rebuilds, %.3f ms with timetabled link (%.3f ms/frame of rebuild avoided)"),
+			DynamicFrameMs, LinkFrameMs, DynamicFrameMs - LinkFrameMs);
+	}
+
+	/// @brief 物理の1ステップ（TG_StartPhysics の開始から TG_EndPhysics の完了まで）の時間を計るTick関数の組
+	class FPhysicsStepTimer
+	{
+	public:
+		explicit FPhysicsStepTimer(UWorld* InWorld)
+			: mWorld(InWorld)
+		{
+			mBegin.Owner = this;
+			mBegin.bBegin = true;
+			mBegin.TickGroup = TG_PrePhysics;
+			mBegin.RegisterTickFunction(mWorld->PersistentLevel);
+			mWorld->StartPhysicsTickFunction.AddPrerequisite(mWorld, mBegin);
+
+			mEnd.Owner = this;
+			mEnd.TickGroup = TG_EndPhysics;
+			mEnd.AddPrerequisite(mWorld, mWorld->EndPhysicsTickFunction);
+			mEnd.RegisterTickFunction(mWorld->PersistentLevel);
+		}
+
+		~FPhysicsStepTimer()
+		{
+			mWorld->StartPhysicsTickFunction.RemovePrerequisite(mWorld, mBegin);
+			mBegin.UnRegisterTickFunction();
+			mEnd.UnRegisterTickFunction();
+		}
+
+		//計測するか
+		bool bRecording = false;
+
+		//1ステップごとの時間（ミリ秒）
+		TArray<double> Samples;
+
+	private:
+		struct FMarkTickFunction : public FTickFunction
+		{
+			FPhysicsStepTimer* Owner = nullptr;
+			bool bBegin = false;
+
+			virtual void ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent) override
+			{
+				const double Now = FPlatformTime::Seconds();
+				if (bBegin)
+				{
+					Owner->mStartTime = Now;
+				}
+				else if (Owner->bRecording)
+				{
+					Owner->Samples.Add((Now - Owner->mStartTime) * 1000.0);
+				}
+			}
+
+			virtual FString DiagnosticMessage() override
+			{
+				return TEXT("GimmickBenchmark PhysicsStepTimer");
+			}
+		};
+
+		UWorld* mWorld;
+		FMarkTickFunction mBegin;
+		FMarkTickFunction mEnd;
+		double mStartTime = 0.0;
+	};
+
+	/// @brief 止まっている押せるブロックを眠らせる場合と、常にシミュレーションする場合の物理の1ステップの時間を比べる
+	///        床の上にブロックを並べた部屋で、1個だけをスクリプトで動かしたキャラクターが押し続ける
+	/// @param Count ブロックの数
+	/// @param Frames 計測するフレーム数
+	void RunBlockSleepSuite(int32 Count, int32 Frames)
+	{
+		//生成したブロックが落ち着いて眠るまで回すフレーム数
+		constexpr int32 SettleFrames = 300;
+
+		//ブロックの配置間隔（cm、1辺 100cm のキューブの間を空ける）
+		constexpr float BlockSpacing = 150.0f;
+
+		const int32 Side = FMath::Max(1, FMath::CeilToInt(FMath::Sqrt(static_cast<float>(Count))));
+		const float RoomSize = Side * BlockSpacing + 1000.0f;
+
+		for (const bool bSleep : { false, true })
+		{
+			UWorld* World = CreateBenchmarkWorld(bSleep ? TEXT("BlockSleepOn") : TEXT("BlockSleepOff"));
+			World->bShouldSimulatePhysics = true;
+
+			//部屋の床（上面が Z = 0）
+			const FTransform FloorTransform(FRotator::ZeroRotator, FVector(Side * BlockSpacing * 0.5f, Side * BlockSpacing * 0.5f, -50.0f), FVector(RoomSize / 100.0f, RoomSize / 100.0f, 1.0f));
+			SpawnWithMesh<AStaticMeshActor>(World, FloorTransform, [](AStaticMeshActor& Floor) { Floor.GetStaticMeshComponent()->SetMobility(EComponentMobility::Movable); });
+
+			TArray<AGimmick_PushBlock*> Blocks;
+			for (int32 i = 0; i < Count; i++)
+			{
+				const FVector Location((i % Side) * BlockSpacing, (i / Side) * BlockSpacing, 51.0f);
+				if (AGimmick_PushBlock* Block = World->SpawnActor<AGimmick_PushBlock>(Location, FRotator::ZeroRotator))
+				{
+					AssignBenchmarkMesh(Block);
+					Blocks.Add(Block);
+
+					//眠らせない場合: 止まったときの通知を外して、眠らせる前の動作（物理エンジンに任せてシミュレーションを続ける）にする
+					if (!bSleep)
+					{
+						if (UPrimitiveComponent* Body = Cast<UPrimitiveComponent>(Block->GetRootComponent()))
+						{
+							Body->OnComponentSleep.RemoveAll(Block);
+						}
+					}
+				}
+			}
+
+			//角のブロックを部屋の内側へ押す
+			ASotugyouSeisakuCharacter* Pusher = nullptr;
+			FVector PusherOrigin = FVector::ZeroVector;
+			if (Blocks.Num() > 0)
+			{
+				Pusher = World->SpawnActor<ASotugyouSeisakuCharacter>(Blocks[0]->GetActorLocation() - FVector(150.0f, 0.0f, -50.0f), FRotator::ZeroRotator);
+				if (Pusher)
+				{
+					Pusher->mTargetBlock = Blocks[0];
+					Pusher->bIsPushing = true;
+					Blocks[0]->StartPushing(Pusher);
+					PusherOrigin = Pusher->GetActorLocation();
+				}
+			}
+
+			FPhysicsStepTimer Timer(World);
+			auto Step = [World, Pusher, PusherOrigin](int32 Frame)
+			{
+				if (Pusher)
+				{
+					const float Time = Frame * FrameDeltaTime;
+					Pusher->SetActorLocation(PusherOrigin + FVector((1.0f - FMath::Cos(Time)) * 100.0f, 0.0f, 0.0f));
+				}
+				TickWorld(World, 1);
+			};
+
+			for (int32 Frame = 0; Frame < SettleFrames; Frame++)
+			{
+				Step(Frame);
+			}
+
+			Timer.bRecording = true;
+			const double Start = FPlatformTime::Seconds();
+			for (int32 Frame = 0; Frame < Frames; Frame++)
+			{
+				Step(SettleFrames + Frame);
+			}
+			const double FrameMs = (FPlatformTime::Seconds() - Start) * 1000.0 / FMath::Max(Frames, 1);
+			Timer.bRecording = false;
+
+			int32 Sleeping = 0;
+			for (const AGimmick_PushBlock* Block : Blocks)
+			{
+				Sleeping += Block->IsSleeping() ? 1 : 0;
+			}
+
+			double Total = 0.0;
+			for (const double Sample : Timer.Samples)
+			{
+				Total += Sample;
+			}
+			Timer.Samples.Sort();
+			UE_LOG(LogGimmickBenchmark, Display, TEXT("%s: %d blocks (%d asleep), physics step mean %.3f ms, p95 %.3f ms, frame %.3f ms"),
+				bSleep ? TEXT("Sleep") : TEXT("Always simulate"), Blocks.Num(), Sleeping,
+				Timer.Samples.Num() > 0 ? Total / Timer.Samples.Num() : 0.0, Percentile(Timer.Samples, 0.95), FrameMs);
+
+			DestroyBenchmarkWorld(World);
+		}
+
+	}
+
+	/// @brief 落ちる床が同時に崩れるときの1個あたりの処理時間を、焼き込んだ結果を再生する場合と破片を毎回シミュレーションする場合で比べる
+	///        キューブの床を 3 × 3 の破片に分けて焼き込み、崩れる床を置かない場合のフレーム時間を引いた分を崩れの数で割る
+	///        崩れは焼き込みの長さごとに全ての床で始め直す（毎回シミュレーションする場合は前の破片を消してから生成する）
+	/// @param Count 同時に崩れる床の数
+	/// @param Frames 計測するフレーム数
+	/// @return 0 = 計測できた、1 = 焼き込めなかった
+	int32 RunCollapseSuite(int32 Count, int32 Frames)
+	{
+		UStaticMesh* CubeMesh = LoadObject<UStaticMesh>(nullptr, TEXT("/Engine/BasicShapes/Cube.Cube"));
+
+		//焼き込みは計測用のワールドを破棄した後も使うので、GCから守る
+		UGimmickCollapseCache* Cache = NewObject<UGimmickCollapseCache>(GetTransientPackage());
+		Cache->AddToRoot();
+		Cache->mFloorMesh = CubeMesh;
+		Cache->mPieceMesh = CubeMesh;
+
+		UWorld* BakeWorld = CreateBenchmarkWorld(TEXT("CollapseBake"));
+		const double BakeStart = FPlatformTime::Seconds();
+		const bool bBaked = Cache->BakeInWorld(BakeWorld);
+		const double BakeMs = (FPlatformTime::Seconds() - BakeStart) * 1000.0;
+		DestroyBenchmarkWorld(BakeWorld);
+
+		if (!bBaked)
+		{
+			UE_LOG(LogGimmickBenchmark, Error, TEXT("Collapse: failed to bake the collapse cache"));
+			Cache->RemoveFromRoot();
+			return 1;
+		}
+
+		//float のトランスフォーム（位置・回転）で持つ場合との比較
+		const int64 FloatBytes = static_cast<int64>(Cache->mFrameCount) * Cache->NumPieces() * (sizeof(FVector3f) + sizeof(FQuat4f));
+		UE_LOG(LogGimmickBenchmark, Display, TEXT("Collapse cache: %d pieces x %d frames (%.2f s) baked offline in %.1f ms, %lld bytes (float transforms: %lld bytes)"),
+			Cache->NumPieces(), Cache->mFrameCount, Cache->GetPlayLength(), BakeMs, Cache->GetBakedBytes(), FloatBytes);
+
+		const int32 CollapseFrames = FMath::CeilToInt(Cache->GetPlayLength() / FrameDeltaTime) + 1;
+
+		enum class EMode { None, Live, Playback };
+		double NoneMeanMs = 0.0;
+		for (const EMode Mode : { EMode::None, EMode::Live, EMode::Playback })
+		{
+			const TCHAR* ModeName = Mode == EMode::None ? TEXT("No collapses") : Mode == EMode::Live ? TEXT("Live simulation") : TEXT("Baked playback");
+			UWorld* World = CreateBenchmarkWorld(Mode == EMode::None ? TEXT("CollapseNone") : Mode == EMode::Live ? TEXT("CollapseLive") : TEXT("CollapsePlayback"));
+			World->bShouldSimulatePhysics = true;
+			UGimmickCollapseSubsystem* Collapses = World->GetSubsystem<UGimmickCollapseSubsystem>();
+
+			TArray<UStaticMeshComponent*> LivePieces;
+			auto StartCollapses = [&]()
+			{
+				//前の崩れの破片を片付ける
+				for (UStaticMeshComponent* Piece : LivePieces)
+				{
+					if (IsValid(Piece))
+					{
+						Piece->GetOwner()->Destroy();
+					}
+				}
+				LivePieces.Reset();
+
+				for (int32 i = 0; i < Count; i++)
+				{
+					const FTransform FloorTransform(GridLocation(i));
+					if (Mode == EMode::Live)
+					{
+						Cache->SpawnSimulatedPieces(World, FloorTransform, LivePieces);
+					}
+					else if (Mode == EMode::Playback && Collapses)
+					{
+						Collapses->Play(Cache, FloorTransform, nullptr);
+					}
+				}
+			};
+
+			FPhysicsStepTimer Timer(World);
+			Timer.bRecording = true;
+
+			TArray<double> Samples;
+			Samples.Reserve(Frames);
+			for (int32 Frame = 0; Frame < Frames; Frame++)
+			{
+				const double Start = FPlatformTime::Seconds();
+				if (Frame % CollapseFrames == 0)
+				{
+					StartCollapses();
+				}
+				TickWorld(World, 1);
+				Samples.Add((FPlatformTime::Seconds() - Start) * 1000.0);
+			}
+			Timer.bRecording = false;
+
+			double Total = 0.0;
+			for (const double Sample : Samples)
+			{
+				Total += Sample;
+			}
+			const double MeanMs = Samples.Num() > 0 ? Total / Samples.Num() : 0.0;
+
+			double PhysicsTotal = 0.0;
+			for (const double Sample : Timer.Samples)
+			{
+				PhysicsTotal += Sample;
+			}
+
+			if (Mode == EMode::None)
+			{
+				NoneMeanMs = MeanMs;
+			}
+
+			Samples.Sort();
+			UE_LOG(LogGimmickBenchmark, Display, TEXT("%s: %d collapses at once, frame mean %.3f ms, p95 %.3f ms, physics step mean %.3f ms, per collapse %.4f ms, piece instances %d"),
+				ModeName, Mode == EMode::None ? 0 : Count, MeanMs, Percentile(Samples, 0.95),
+				Timer.Samples.Num() > 0 ? PhysicsTotal / Timer.Samples.Num() : 0.0,
+				Mode == EMode::None ? 0.0 : (MeanMs - NoneMeanMs) / FMath::Max(Count, 1),
+				Collapses ? Collapses->NumInstances() : 0);
+
+			DestroyBenchmarkWorld(World);
+		}
+
+		Cache->RemoveFromRoot();
+		return 0;
+	}
+}
@@ -0,0 +1,172 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GimmickBenchmarkSuites.h"
+#include "GimmickSaveSubsystem.h"
+#include "GimmickSubsystem.h"
+#include "GimmickSpatialHash.h"
+#include "Misc/FileHelper.h"
+
+namespace GimmickBenchmark
+{
+	/// @brief 進行状況の保存・読み込みを計測する（全種類のギミックを同じ数ずつ生成）
+	///        保存した状態が元に戻るかは自動テスト SotugyouSeisaku.Gimmick.Save で確かめる
+	void RunSaveSuite(int32 Count)
+	{
+		UWorld* World = CreateBenchmarkWorld(TEXT("Save"));
+
+		const FScenario Scenarios[] = { MakeMoveFloorScenario(EFloorMovementPattern::Horizontal_X), MakeFallFloorScenario(), MakeButtonScenario(), MakePushBlockScenario() };
+		SetupScenarios(World, Scenarios, FMath::Max(1, Count / 4));
+
+		const double CaptureStart = FPlatformTime::Seconds();
+		TArray<uint8> Blob = UGimmickSaveSubsystem::CaptureWorldState(World);
+		const double CaptureMs = (FPlatformTime::Seconds() - CaptureStart) * 1000.0;
+
+		const FString Path = UGimmickSaveSubsystem::GetSlotPath(TEXT("Benchmark"));
+		const double WriteStart = FPlatformTime::Seconds();
+		FFileHelper::SaveArrayToFile(Blob, *Path);
+		const double WriteMs = (FPlatformTime::Seconds() - WriteStart) * 1000.0;
+
+		const double ApplyStart = FPlatformTime::Seconds();
+		const int32 AppliedCount = UGimmickSaveSubsystem::ApplyWorldState(World, Blob);
+		const double ApplyMs = (FPlatformTime::Seconds() - ApplyStart) * 1000.0;
+
+		UE_LOG(LogGimmickBenchmark, Display, TEXT("Save: %d gimmicks, blob %d bytes (%.1f bytes/gimmick), capture %.3f ms, write %.3f ms, apply %.3f ms"),
+			AppliedCount, Blob.Num(), AppliedCount > 0 ? static_cast<double>(Blob.Num()) / AppliedCount : 0.0, CaptureMs, WriteMs, ApplyMs);
+
+		DestroyBenchmarkWorld(World);
+	}
+
+	/// @brief ギミック登録簿の検索を計測する（10k / 100k 件）
+	///        登録簿の索引である空間ハッシュを直接使い、全件走査（ワールド走査に相当）と比較する
+	void RunRegistrySuite()
+	{
+		constexpr int32 QueryCount = 10000;
+		constexpr float QueryRadius = 1500.0f;
+		constexpr float NearestRadius = 5000.0f;
+		const FVector RoomExtent(2500.0f, 2500.0f, 1000.0f);
+		const uint8 CategoryCount = static_cast<uint8>(EGimmickType::Count);
+
+		for (const int32 Count : { 10000, 100000 })
+		{
+			//平均して1セルに1個程度になる広さにばらまく
+			FRandomStream Random(Count);
+			const float WorldSize = FMath::Sqrt(static_cast<float>(Count)) * GridSpacing;
+			auto RandomLocation = [&Random, WorldSize]()
+			{
+				return FVector(Random.FRandRange(0.0f, WorldSize), Random.FRandRange(0.0f, WorldSize), Random.FRandRange(0.0f, 2000.0f));
+			};
+
+			TArray<FVector> Locations;
+			TArray<uint8> Categories;
+			Locations.SetNumUninitialized(Count);
+			Categories.SetNumUninitialized(Count);
+			for (int32 i = 0; i < Count; i++)
+			{
+				Locations[i] = RandomLocation();
+				Categories[i] = static_cast<uint8>(Random.RandHelper(CategoryCount));
+			}
+
+			TArray<FVector> Queries;
+			Queries.SetNumUninitialized(QueryCount);
+			for (FVector& Query : Queries)
+			{
+				Query = RandomLocation();
+			}
+
+			//結果を使って最適化で消されないようにする
+			int64 Checksum = 0;
+			const uint32 Mask = FGimmickSpatialHash::CategoryMask(static_cast<uint8>(EGimmickType::PushBlock));
+
+			FGimmickSpatialHash Hash;
+			double Start = FPlatformTime::Seconds();
+			for (int32 i = 0; i < Count; i++)
+			{
+				Hash.Insert(i, Locations[i], Categories[i]);
+			}
+			const double InsertNs = (FPlatformTime::Seconds() - Start) * 1e9 / Count;
+
+			Start = FPlatformTime::Seconds();
+			for (const FVector& Query : Queries)
+			{
+				Hash.ForEachInRadius(Query, QueryRadius, Mask, [&Checksum](int32 Id, const FVector&) { Checksum += Id; });
+			}
+			const double RadiusNs = (FPlatformTime::Seconds() - Start) * 1e9 / QueryCount;
+
+			//全件走査は遅いので問い合わせ数を減らす
+			const int32 LinearQueryCount = QueryCount / 10;
+			const float RadiusSquared = QueryRadius * QueryRadius;
+			Start = FPlatformTime::Seconds();
+			for (int32 q = 0; q < LinearQueryCount; q++)
+			{
+				for (int32 i = 0; i < Count; i++)
+				{
+					if (Categories[i] == static_cast<uint8>(EGimmickType::PushBlock) && FVector::DistSquared(Queries[q], Locations[i]) <= RadiusSquared)
+					{
+						Checksum += i;
+					}
+				}
+			}
+			const double LinearNs = (FPlatformTime::Seconds() - Start) * 1e9 / LinearQueryCount;
+
+			Start = FPlatformTime::Seconds();
+			for (const FVector& Query : Queries)
+			{
+				Checksum += Hash.FindNearest(Query, NearestRadius, Mask);
+			}
+			const double NearestNs = (FPlatformTime::Seconds() - Start) * 1e9 / QueryCount;
+
+			Start = FPlatformTime::Seconds();
+			for (const FVector& Query : Queries)
+			{
+				Hash.ForEachInBox(FBox(Query - RoomExtent, Query + RoomExtent), FGimmickSpatialHash::AllCategories, [&Checksum](int32 Id, const FVector&) { Checksum += Id; });
+			}
+			const double BoxNs = (FPlatformTime::Seconds() - Start) * 1e9 / QueryCount;
+
+			//動くギミックの位置更新（1フレーム分の移動量）
+			Start = FPlatformTime::Seconds();
+			for (int32 i = 0; i < Count; i++)
+			{
+				Hash.Update(i, Locations[i] + FVector(200.0f * FrameDeltaTime, 0.0f, 0.0f));
+			}
+			const double UpdateNs = (FPlatformTime::Seconds() - Start) * 1e9 / Count;
+
+			UE_LOG(LogGimmickBenchmark, Display, TEXT("Registry %6d: insert %.1f ns, update %.1f ns, radius %.1f ns (linear scan %.1f ns), nearest %.1f ns, room bounds %.1f ns (checksum %lld)"),
+				Count, InsertNs, UpdateNs, RadiusNs, LinearNs, NearestNs, BoxNs, Checksum);
+		}
+	}
+
+	/// @brief 時間飛ばし（AdvanceGimmicks）の処理時間を、同じ時間を1フレームずつTickした場合と比べる
+	///        往復する動く床と、最初に1回踏んだ落ちる床を Count 個ずつ置く。最後に1時間分の時間飛ばしの処理時間も計測する
+	///        飛ばした結果がTickした場合と一致するかは自動テスト SotugyouSeisaku.Gimmick.FastForward で確かめる
+	/// @param Count 種類ごとのギミックの数
+	/// @param Frames 比べる時間（フレーム数）
+	void RunFastForwardSuite(int32 Count, int32 Frames)
+	{
+		const float Seconds = Frames * FrameDeltaTime;
+
+		//1フレームずつTickする
+		UWorld* SteppedWorld = CreateBenchmarkWorld(TEXT("FastForward_Tick"));
+		SetupFastForwardGimmicks(SteppedWorld, Count);
+		double Start = FPlatformTime::Seconds();
+		TickWorld(SteppedWorld, Frames);
+		const double TickMs = (FPlatformTime::Seconds() - Start) * 1000.0;
+		DestroyBenchmarkWorld(SteppedWorld);
+
+		//時間を飛ばす
+		UWorld* SkipWorld = CreateBenchmarkWorld(TEXT("FastForward_Skip"));
+		SetupFastForwardGimmicks(SkipWorld, Count);
+		UGimmickSubsystem* Gimmicks = SkipWorld->GetSubsystem<UGimmickSubsystem>();
+		Start = FPlatformTime::Seconds();
+		Gimmicks->AdvanceGimmicks(Seconds);
+		const double SkipMs = (FPlatformTime::Seconds() - Start) * 1000.0;
+
+		UE_LOG(LogGimmickBenchmark, Display, TEXT("FastForward %.1f s, %d gimmicks: tick %.2f ms, advance %.3f ms"), Seconds, Count * 2, TickMs, SkipMs);
+
+		//長い時間飛ばしても処理時間は変わらない
+		Start = FPlatformTime::Seconds();
+		Gimmicks->AdvanceGimmicks(3600.0f);
+		UE_LOG(LogGimmickBenchmark, Display, TEXT("FastForward 3600.0 s, %d gimmicks: advance %.3f ms"), Count * 2, (FPlatformTime::Seconds() - Start) * 1000.0);
+
+		DestroyBenchmarkWorld(SkipWorld);
+	}
+}
@@ -0,0 +1,183 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GimmickBenchmarkSuites.h"
+#include "Gimmck_MoveFloor.h"
+#include "Gimmick_Button.h"
+#include "Gimmick_FallFloor.h"
+#include "Gimmick_PushBlock.h"
+#include "GimmickOverlapProbeComponent.h"
+#include "GimmickInstanceSubsystem.h"
+#include "Engine/StaticMesh.h"
+#include "Components/StaticMeshComponent.h"
+#include "GameFramework/Character.h"
+#include "HAL/IConsoleManager.h"
+
+namespace GimmickBenchmark
+{
+	/// @brief 共有インスタンス描画の有無で、コンポーネント構成と移動（トランスフォーム更新）の時間を比べる
+	///        動く床・落ちる床・ボタンを同じ数ずつ生成する
+	void RunComponentsSuite(int32 Count, int32 Frames)
+	{
+		IConsoleVariable* InstancedRendering = IConsoleManager::Get().FindConsoleVariable(TEXT("Gimmick.InstancedRendering"));
+		const bool bPrevInstanced = InstancedRendering->GetBool();
+
+		for (const bool bInstanced : { false, true })
+		{
+			InstancedRendering->Set(bInstanced, ECVF_SetByCode);
+			UWorld* World = CreateBenchmarkWorld(bInstanced ? TEXT("ComponentsInstanced") : TEXT("Components"));
+
+			//メッシュはBeginPlay前に割り当てる（インスタンス描画の登録はBeginPlayで行われる）
+			int32 Index = 0;
+			const int32 CountPerType = FMath::Max(1, Count / 3);
+			for (int32 i = 0; i < CountPerType; i++)
+			{
+				SpawnWithMesh<AGimmck_MoveFloor>(World, FTransform(GridLocation(Index++)));
+				SpawnWithMesh<AGimmick_FallFloor>(World, FTransform(GridLocation(Index++)));
+				SpawnWithMesh<AGimmick_Button>(World, FTransform(GridLocation(Index++)));
+			}
+
+			const FGimmickComponentStats Stats = UGimmickInstanceSubsystem::GatherComponentStats(World);
+
+			TickWorld(World, 10);
+
+			//動く床が毎フレーム動くので、トランスフォーム更新を含むフレーム時間を計る
+			const double Start = FPlatformTime::Seconds();
+			TickWorld(World, Frames);
+			const double FrameMs = (FPlatformTime::Seconds() - Start) * 1000.0 / FMath::Max(Frames, 1);
+
+			UE_LOG(LogGimmickBenchmark, Display, TEXT("%s: actors %d, components %d, scene proxies %d, component memory %.1f KB, frame %.3f ms"),
+				bInstanced ? TEXT("Instanced") : TEXT("Per-actor"), Stats.Actors, Stats.Components, Stats.SceneProxies, Stats.Bytes / 1024.0, FrameMs);
+
+			DestroyBenchmarkWorld(World);
+		}
+
+		InstancedRendering->Set(bPrevInstanced, ECVF_SetByCode);
+	}
+
+	/// @brief ギミックの移動による1フレームあたりのトランスフォーム更新とオーバーラップの更新の回数を数える
+	///        動く床（上に乗ったキャラクター付き）と、プレイヤーが押して回している押せるブロックを同じ数ずつ生成する
+	///        UpdateComponentToWorld の回数は各コンポーネントの TransformUpdated の通知回数、
+	///        UpdateOverlaps の回数は各アクタのルートに付けた UGimmickOverlapProbeComponent が実際に更新された回数で数える
+	///        （床・乗っているキャラクター・ブロックそれぞれ1フレームに1回が最小。回数が正しいかは SotugyouSeisaku.Gimmick.MoveFloor で確かめる）
+	void RunTransformSuite(int32 Count, int32 Frames)
+	{
+		UWorld* World = CreateBenchmarkWorld(TEXT("Transform"));
+
+		const int32 CountPerType = FMath::Max(1, Count / 2);
+		UGimmickMoveFloorConfig* FloorConfig = NewObject<UGimmickMoveFloorConfig>(World);
+		FloorConfig->mSettings.Pattern = EFloorMovementPattern::Horizontal_X;
+		FloorConfig->mSettings.Distance = 50.0f;
+		FloorConfig->mSettings.WaitTime = 0.0f;
+		TArray<AActor*> Movers;
+		TArray<AGimmick_PushBlock*> Blocks;
+		for (int32 i = 0; i < CountPerType; i++)
+		{
+			//短い距離を待たずに往復する床（到着するフレームも多く含める）
+			AGimmck_MoveFloor* Floor = SpawnWithMesh<AGimmck_MoveFloor>(World, FTransform(GridLocation(i)), [FloorConfig](AGimmck_MoveFloor& Spawned) { Spawned.mConfig = FloorConfig; });
+			Movers.Add(Floor);
+
+			//床はキャラクターのカプセルをブロックするのでオーバーラップでは乗らない。乗っている状態を直接作る
+			ACharacter* Rider = World->SpawnActor<ACharacter>(ACharacter::StaticClass(), FTransform(GridLocation(i) + FVector(0.0f, 0.0f, 150.0f)));
+			Floor->mActorsOnFloor.Add(Rider);
+			Movers.Add(Rider);
+
+			AGimmick_PushBlock* Block = SpawnWithMesh<AGimmick_PushBlock>(World, FTransform(GridLocation(CountPerType + i)));
+			Movers.Add(Block);
+			Blocks.Add(Block);
+		}
+
+		int64 ComponentUpdates = 0;
+		TArray<UGimmickOverlapProbeComponent*> Probes;
+		for (AActor* Mover : Movers)
+		{
+			Mover->ForEachComponent<USceneComponent>(false, [&ComponentUpdates](USceneComponent* Component)
+			{
+				Component->TransformUpdated.AddLambda([&ComponentUpdates](USceneComponent*, EUpdateTransformFlags, ETeleportType)
+				{
+					ComponentUpdates++;
+				});
+			});
+			Probes.Add(UGimmickOverlapProbeComponent::AttachTo(Mover));
+		}
+
+		TickWorld(World, 10);
+		ComponentUpdates = 0;
+		for (UGimmickOverlapProbeComponent* Probe : Probes)
+		{
+			Probe->mUpdateCount = 0;
+		}
+
+		//プレイヤーが押しながら曲がっている状態を、キャラクターのTickと同じ呼び出しで再現する
+		const double Start = FPlatformTime::Seconds();
+		for (int32 Frame = 0; Frame < Frames; Frame++)
+		{
+			for (AGimmick_PushBlock* Block : Blocks)
+			{
+				const FVector PlayerCenter = Block->GetActorLocation() - Block->GetActorForwardVector() * 100.0f;
+				Block->FollowPlayer(Block->GetActorForwardVector() * 2.0f, PlayerCenter, 0.5f);
+			}
+			TickWorld(World, 1);
+		}
+		const double FrameMs = (FPlatformTime::Seconds() - Start) * 1000.0 / FMath::Max(Frames, 1);
+		const double FrameCount = FMath::Max(Frames, 1);
+
+		int64 OverlapUpdates = 0;
+		for (const UGimmickOverlapProbeComponent* Probe : Probes)
+		{
+			OverlapUpdates += Probe ? Probe->mUpdateCount : 0;
+		}
+
+		UE_LOG(LogGimmickBenchmark, Display, TEXT("%d floors (+rider), %d blocks: UpdateComponentToWorld %.1f/frame, UpdateOverlaps %.1f/frame (minimum %d), frame %.3f ms"),
+			CountPerType, CountPerType, ComponentUpdates / FrameCount, OverlapUpdates / FrameCount, Movers.Num(), FrameMs);
+
+		DestroyBenchmarkWorld(World);
+	}
+
+	/// @brief 見た目の処理を取り除く（Gimmick.ServerProfile=1、コマンドレットは描画できないので取り除かれる）場合と取り除かない場合で、サーバーのメモリとTick時間を比べる
+	///        動く床・落ちる床（定期的に踏む）・ボタン（順番に押す）を同じ数ずつ置き、
+	///        ギミック1個あたりのコンポーネント数・メモリと、1フレームの平均時間を出す
+	/// @param Count ギミックの総数
+	/// @param Frames 計測するフレーム数
+	void RunServerProfileSuite(int32 Count, int32 Frames)
+	{
+		IConsoleVariable* ServerProfile = IConsoleManager::Get().FindConsoleVariable(TEXT("Gimmick.ServerProfile"));
+		const int32 PrevServerProfile = ServerProfile->GetInt();
+
+		const FScenario Scenarios[] = { MakeMoveFloorScenario(EFloorMovementPattern::Horizontal_X), MakeFallFloorScenario(), MakeButtonScenario() };
+		for (const int32 Profile : { 0, 1 })
+		{
+			ServerProfile->Set(Profile, ECVF_SetByCode);
+			UWorld* World = CreateBenchmarkWorld(Profile == 0 ? TEXT("ServerProfileOff") : TEXT("ServerProfileOn"));
+
+			FScenarioContext Context = SetupScenarios(World, Scenarios, FMath::Max(1, Count / 3));
+
+			auto Step = [World, &Scenarios, &Context](int32 Frame)
+			{
+				StepScenarios(World, Scenarios, Frame, Context);
+				TickWorld(World, 1);
+			};
+
+			for (int32 Frame = 0; Frame < 10; Frame++)
+			{
+				Step(Frame);
+			}
+
+			const double Start = FPlatformTime::Seconds();
+			for (int32 Frame = 0; Frame < Frames; Frame++)
+			{
+				Step(10 + Frame);
+			}
+			const double FrameMs = (FPlatformTime::Seconds() - Start) * 1000.0 / FMath::Max(Frames, 1);
+
+			const FGimmickComponentStats Stats = UGimmickInstanceSubsystem::GatherComponentStats(World);
+			const int32 Actors = FMath::Max(Stats.Actors, 1);
+			UE_LOG(LogGimmickBenchmark, Display, TEXT("%s: actors %d, components %d (%.2f/actor), component memory %.1f KB (%.1f bytes/actor), frame %.3f ms"),
+				Profile == 0 ? TEXT("Full") : TEXT("Server profile"), Stats.Actors, Stats.Components, static_cast<double>(Stats.Components) / Actors,
+				Stats.Bytes / 1024.0, static_cast<double>(Stats.Bytes) / Actors, FrameMs);
+
+			DestroyBenchmarkWorld(World);
+		}
+
+		ServerProfile->Set(PrevServerProfile, ECVF_SetByCode);
+	}
+}
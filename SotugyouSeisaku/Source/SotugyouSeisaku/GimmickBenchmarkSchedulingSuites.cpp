@@ -0,0 +1,268 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GimmickBenchmarkSuites.h"
+#include "GimmickEvents.h"
+#include "GimmickEventBus.h"
+#include "GimmickSequenceSubsystem.h"
+#include "GimmickTimerSubsystem.h"
+#include "TimerManager.h"
+#include "Async/ParallelFor.h"
+
+namespace GimmickBenchmark
+{
+	/// @brief Tickしない手順を同時にいくつ動かせるかを計測する
+	///        各手順は「時間待ち → 処理 → ドアの到着待ち → 処理」を繰り返す（ドアが開いたら少し待って次のギミックを動かす形）
+	///        手順なしのワールドとのフレーム時間の差を手順の負荷とし、1ms あたりの同時実行数に換算する
+	void RunSequenceSuite(int32 Frames)
+	{
+		//イベントを発生させる役の数（それぞれ約1秒に1回ドアの到着を通知する）
+		constexpr int32 EmitterCount = 60;
+
+		auto MeasureFrames = [Frames](UWorld* World, const TArray<AActor*>& Emitters)
+		{
+			const double Start = FPlatformTime::Seconds();
+			for (int32 Frame = 0; Frame < Frames; Frame++)
+			{
+				GimmickEvents::Emit(EGimmickEventType::DoorArrived, Emitters[Frame % Emitters.Num()]);
+				TickWorld(World, 1);
+			}
+			return (FPlatformTime::Seconds() - Start) * 1000.0 / FMath::Max(Frames, 1);
+		};
+
+		//手順なしのフレーム時間（基準）
+		double BaseFrameMs = 0.0;
+
+		for (const int32 Count : { 0, 1000, 10000, 100000 })
+		{
+			UWorld* World = CreateBenchmarkWorld(FString::Printf(TEXT("Sequence%d"), Count));
+			UGimmickSequenceSubsystem* Sequences = World->GetSubsystem<UGimmickSequenceSubsystem>();
+
+			TArray<AActor*> Emitters;
+			for (int32 i = 0; i < EmitterCount; i++)
+			{
+				Emitters.Add(World->SpawnActor<AActor>());
+			}
+
+			//終わったら同じ手順をもう一度始め、同時に動いている数を保つ
+			int64 CompletedSteps = 0;
+			TFunction<void(int32)> StartSequence = [&](int32 Index)
+			{
+				Sequences->Run(FGimmickSequence()
+					.WaitSeconds(0.1f + (Index % 10) * 0.05f)
+					.Do([&CompletedSteps]() { CompletedSteps++; })
+					.WaitEvent(EGimmickEventType::DoorArrived, Emitters[Index % EmitterCount])
+					.Do([&StartSequence, &CompletedSteps, Index]()
+					{
+						CompletedSteps++;
+						StartSequence(Index);
+					}));
+			};
+
+			const double StartTime = FPlatformTime::Seconds();
+			for (int32 i = 0; i < Count; i++)
+			{
+				StartSequence(i);
+			}
+			const double StartUs = Count > 0 ? (FPlatformTime::Seconds() - StartTime) * 1e6 / Count : 0.0;
+
+			const double FrameMs = MeasureFrames(World, Emitters);
+			UE_LOG(LogGimmickBenchmark, Display, TEXT("Sequence %6d: running %d, frame %.3f ms, start %.3f us/sequence, steps completed %lld"),
+				Count, Sequences->NumRunning(), FrameMs, StartUs, CompletedSteps);
+
+			if (Count == 0)
+			{
+				BaseFrameMs = FrameMs;
+			}
+			else
+			{
+				const double CostMs = FMath::Max(FrameMs - BaseFrameMs, KINDA_SMALL_NUMBER);
+				UE_LOG(LogGimmickBenchmark, Display, TEXT("Sequence %6d: %.3f ms/frame over empty world -> %.0f concurrent sequences per ms of game thread"),
+					Count, CostMs, Count / CostMs);
+			}
+
+			//待ち中の手順はサブシステムと一緒に破棄される
+			DestroyBenchmarkWorld(World);
+		}
+	}
+
+	/// @brief イベントバスへの通知の時間を計測する
+	///        ゲームスレッドから1件ずつ積む場合と、複数スレッドから同時に積む場合の1件あたりの時間、
+	///        まとめて取り出す時間、演出側がデリゲートで直接受け取っていた場合（比較用）の時間を測る
+	///        積んだイベントが欠けずに取り出せるかは自動テスト SotugyouSeisaku.Gimmick.EventBus で確かめる
+	/// @param Count 1回の計測で積むイベントの数
+	void RunEventBusSuite(int32 Count)
+	{
+		constexpr int32 ProducerCount = 4;
+		Count = FMath::Max(Count, ProducerCount);
+
+		UWorld* World = CreateBenchmarkWorld(TEXT("EventBus"));
+		const AActor* Gimmick = World->SpawnActor<AActor>(AActor::StaticClass(), FTransform(FVector(100.0f, 200.0f, 300.0f)));
+
+		FGimmickEventBus& Bus = FGimmickEventBus::Get();
+		const int32 Consumer = Bus.AddConsumer(TEXT("Benchmark"), static_cast<uint32>(Count));
+		if (Consumer == INDEX_NONE)
+		{
+			DestroyBenchmarkWorld(World);
+			return;
+		}
+
+		int64 Drained = 0;
+		auto DrainAll = [&Bus, Consumer, &Drained]()
+		{
+			Drained = 0;
+			const double Start = FPlatformTime::Seconds();
+			Bus.Drain(Consumer, [&Drained](const FGimmickBusEvent& Event) { Drained += static_cast<int32>(Event.Type) + 1; });
+			return (FPlatformTime::Seconds() - Start) * 1e9;
+		};
+
+		//ゲームスレッドから1件ずつ
+		double Start = FPlatformTime::Seconds();
+		for (int32 i = 0; i < Count; i++)
+		{
+			Bus.Push(EGimmickEventType::ButtonPressed, Gimmick);
+		}
+		const double SingleNs = (FPlatformTime::Seconds() - Start) * 1e9 / Count;
+		const double SingleDrainNs = DrainAll() / Count;
+
+		//複数スレッドから同時に
+		const int32 CountPerProducer = Count / ProducerCount;
+		Start = FPlatformTime::Seconds();
+		ParallelFor(ProducerCount, [&Bus, Gimmick, CountPerProducer](int32)
+		{
+			for (int32 i = 0; i < CountPerProducer; i++)
+			{
+				Bus.Push(EGimmickEventType::FallFloorTriggered, Gimmick);
+			}
+		});
+		const double ParallelNs = (FPlatformTime::Seconds() - Start) * 1e9 / (CountPerProducer * ProducerCount);
+		const double ParallelDrainNs = DrainAll() / (CountPerProducer * ProducerCount);
+
+		//比較用: 演出側がデリゲートで直接受け取り、その場でアクタの情報を引く場合
+		FOnGimmickEvent Delegate;
+		FVector Sum = FVector::ZeroVector;
+		Delegate.AddLambda([&Sum](EGimmickEventType, const AActor* Actor)
+		{
+			if (Actor && Actor->GetWorld())
+			{
+				Sum += Actor->GetActorLocation();
+			}
+		});
+		Start = FPlatformTime::Seconds();
+		for (int32 i = 0; i < Count; i++)
+		{
+			Delegate.Broadcast(EGimmickEventType::ButtonPressed, Gimmick);
+		}
+		const double DelegateNs = (FPlatformTime::Seconds() - Start) * 1e9 / Count;
+
+		UE_LOG(LogGimmickBenchmark, Display, TEXT("EventBus: %d events, push %.1f ns/event (game thread), %.1f ns/event (%d producers), drain %.1f / %.1f ns/event, delegate %.1f ns/event"),
+			Count, SingleNs, ParallelNs, ProducerCount, SingleDrainNs, ParallelDrainNs, DelegateNs);
+
+		Bus.RemoveConsumer(Consumer);
+		DestroyBenchmarkWorld(World);
+	}
+
+	/// @brief ギミックのタイミングホイールと FTimerManager を、同時に動いているタイマーの数ごとに比べる
+	///        各タイマーは 0.1〜5 秒後に呼ばれ、呼ばれたら同じ範囲の時間で登録し直す（動いている数を保つ）
+	///        登録・1フレームの進行・解除の時間を計測する（期限の順に呼ばれるかは自動テスト SotugyouSeisaku.Gimmick.TimingWheel で確かめる）
+	/// @param Frames 進行を計測するフレーム数
+	void RunTimersSuite(int32 Frames)
+	{
+		for (const int32 Count : { 1000, 10000, 100000 })
+		{
+			FRandomStream Random(Count);
+			TArray<float> Delays;
+			Delays.SetNumUninitialized(Count);
+			for (float& Delay : Delays)
+			{
+				Delay = Random.FRandRange(0.1f, 5.0f);
+			}
+
+			//タイミングホイール
+			double WheelScheduleNs = 0.0;
+			double WheelFrameUs = 0.0;
+			double WheelCancelNs = 0.0;
+			int64 WheelFired = 0;
+			{
+				FGimmickTimingWheel Wheel;
+				TArray<FGimmickTimerHandle> Handles;
+				Handles.SetNum(Count);
+
+				TFunction<void(int32)> Schedule = [&](int32 Index)
+				{
+					Handles[Index] = Wheel.Schedule(Delays[Index], [&Schedule, &WheelFired, Index]()
+					{
+						WheelFired++;
+						Schedule(Index);
+					});
+				};
+
+				double Start = FPlatformTime::Seconds();
+				for (int32 i = 0; i < Count; i++)
+				{
+					Schedule(i);
+				}
+				WheelScheduleNs = (FPlatformTime::Seconds() - Start) * 1e9 / Count;
+
+				Start = FPlatformTime::Seconds();
+				for (int32 Frame = 0; Frame < Frames; Frame++)
+				{
+					Wheel.Advance(FrameDeltaTime);
+				}
+				WheelFrameUs = (FPlatformTime::Seconds() - Start) * 1e6 / FMath::Max(Frames, 1);
+
+				Start = FPlatformTime::Seconds();
+				for (FGimmickTimerHandle& Handle : Handles)
+				{
+					Wheel.Cancel(Handle);
+				}
+				WheelCancelNs = (FPlatformTime::Seconds() - Start) * 1e9 / Count;
+			}
+
+			//FTimerManager（ワールドに属さない単体のもの）
+			double ManagerScheduleNs = 0.0;
+			double ManagerFrameUs = 0.0;
+			double ManagerCancelNs = 0.0;
+			int64 ManagerFired = 0;
+			{
+				FTimerManager Manager;
+				TArray<FTimerHandle> Handles;
+				Handles.SetNum(Count);
+
+				TFunction<void(int32)> Schedule = [&](int32 Index)
+				{
+					Manager.SetTimer(Handles[Index], FTimerDelegate::CreateLambda([&Schedule, &ManagerFired, Index]()
+					{
+						ManagerFired++;
+						Schedule(Index);
+					}), Delays[Index], false);
+				};
+
+				double Start = FPlatformTime::Seconds();
+				for (int32 i = 0; i < Count; i++)
+				{
+					Schedule(i);
+				}
+				ManagerScheduleNs = (FPlatformTime::Seconds() - Start) * 1e9 / Count;
+
+				//FTimerManager は同じフレームに2回進まないので、フレーム番号を進めながら呼ぶ
+				Start = FPlatformTime::Seconds();
+				for (int32 Frame = 0; Frame < Frames; Frame++)
+				{
+					GFrameCounter++;
+					Manager.Tick(FrameDeltaTime);
+				}
+				ManagerFrameUs = (FPlatformTime::Seconds() - Start) * 1e6 / FMath::Max(Frames, 1);
+
+				Start = FPlatformTime::Seconds();
+				for (FTimerHandle& Handle : Handles)
+				{
+					Manager.ClearTimer(Handle);
+				}
+				ManagerCancelNs = (FPlatformTime::Seconds() - Start) * 1e9 / Count;
+			}
+
+			UE_LOG(LogGimmickBenchmark, Display, TEXT("Timers %6d: wheel schedule %.1f ns, frame %.1f us, cancel %.1f ns, fired %lld | FTimerManager schedule %.1f ns, frame %.1f us, cancel %.1f ns, fired %lld"),
+				Count, WheelScheduleNs, WheelFrameUs, WheelCancelNs, WheelFired, ManagerScheduleNs, ManagerFrameUs, ManagerCancelNs, ManagerFired);
+		}
+	}
+}
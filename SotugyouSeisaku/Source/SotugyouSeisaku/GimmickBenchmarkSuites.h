@@ -0,0 +1,47 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GimmickBenchmarkFixture.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(LogGimmickBenchmark, Log, All);
+
+/// @brief UGimmickBenchmarkCommandlet の -Suite ごとの計測
+///        サブシステムごとに GimmickBenchmark*Suites.cpp に分け、コマンドレットは -Suite に応じてここから呼ぶだけにする
+namespace GimmickBenchmark
+{
+	//昇順に並んだサンプルからパーセンタイル値を取り出す
+	double Percentile(const TArray<double>& SortedSamples, double Ratio);
+
+	//ギミック登録簿・保存・時間飛ばし（GimmickBenchmarkRegistrySuites.cpp）
+	void RunSaveSuite(int32 Count);
+	void RunRegistrySuite();
+	void RunFastForwardSuite(int32 Count, int32 Frames);
+
+	//描画・トランスフォーム更新・サーバー向けの設定（GimmickBenchmarkRenderingSuites.cpp）
+	void RunComponentsSuite(int32 Count, int32 Frames);
+	void RunTransformSuite(int32 Count, int32 Frames);
+	void RunServerProfileSuite(int32 Count, int32 Frames);
+
+	//手順・イベントバス・タイマー（GimmickBenchmarkSchedulingSuites.cpp）
+	void RunSequenceSuite(int32 Frames);
+	void RunEventBusSuite(int32 Count);
+	void RunTimersSuite(int32 Frames);
+
+	//ヒープ確保・共有設定のメモリ（GimmickBenchmarkMemorySuites.cpp）
+	int32 RunAllocationsSuite(int32 Count, int32 Frames);
+	void RunConfigSuite(int32 Count);
+
+	//マップの読み込み・レプリケーション（GimmickBenchmarkLoadingSuites.cpp）
+	int32 RunLoadSuite(const FString& Maps, int32 Frames);
+	int32 RunReplicationSuite(const FString& Map, const FString& ClientCounts, float Seconds);
+
+	//ナビメッシュ・物理・崩れる床（GimmickBenchmarkPhysicsSuites.cpp）
+	void RunNavFloorSuite(int32 Frames);
+	void RunBlockSleepSuite(int32 Count, int32 Frames);
+	int32 RunCollapseSuite(int32 Count, int32 Frames);
+
+	//ギミックの計算（GimmickBenchmarkMathSuite.cpp）
+	int32 RunMathSuite(int32 Count, int32 Iterations);
+}
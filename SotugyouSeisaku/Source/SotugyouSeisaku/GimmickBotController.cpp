@@ -0,0 +1,728 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GimmickBotController.h"
+#include "SotugyouSeisakuCharacter.h"
+#include "Gimmick_PushBlock.h"
+#include "Gimmick_Button.h"
+#include "Gimmick_ButtonManager.h"
+#include "Gimmck_MoveFloor.h"
+#include "Gimmick_FallFloor.h"
+#include "GimmickPlacementSpawner.h"
+#include "GimmickPlacementAsset.h"
+#include "GimmickSubsystem.h"
+#include "EnhancedInputSubsystems.h"
+#include "Engine/Engine.h"
+#include "Engine/LocalPlayer.h"
+#include "EngineUtils.h"
+#include "HAL/PlatformMemory.h"
+#include "Misc/CommandLine.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "UObject/UObjectArray.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogGimmickBot, Log, All);
+
+namespace GimmickBot
+{
+	//ヒストグラムの最初の目盛（ms）と目盛の比
+	static constexpr double HistogramMinMs = 0.05;
+	static constexpr double HistogramRatio = 1.05;
+
+	//この距離（cm）より動いたら進んだとみなす
+	static constexpr double ProgressDistance = 20.0;
+
+	//ブロックの後ろに回ったとみなす距離
+	static constexpr float ApproachRadius = 30.0f;
+
+	//押す手でブロックを探す範囲
+	static constexpr float BlockSearchRadius = 300.0f;
+
+	//どの部屋にもいないときの名前
+	static const FName OutsideRoom(TEXT("Outside"));
+}
+
+/// @brief フレーム時間を加える
+/// @param Ms フレーム時間（ms）
+void AGimmickBotController::FFrameTimeHistogram::Add(double Ms)
+{
+	int32 Bucket = 0;
+	if (Ms > GimmickBot::HistogramMinMs)
+	{
+		Bucket = FMath::Min(FMath::FloorToInt32(FMath::Loge(Ms / GimmickBot::HistogramMinMs) / FMath::Loge(GimmickBot::HistogramRatio)), BucketCount - 1);
+	}
+	Buckets[Bucket]++;
+	Count++;
+	SumMs += Ms;
+	MaxMs = FMath::Max(MaxMs, Ms);
+}
+
+/// @brief 百分位数を求める（目盛の上端なので最大 5% 大きめになる）
+/// @param Ratio 0〜1
+/// @return フレーム時間（ms）
+double AGimmickBotController::FFrameTimeHistogram::Percentile(double Ratio) const
+{
+	const int64 Target = FMath::Max<int64>(FMath::CeilToInt64(Ratio * Count), 1);
+	int64 Accumulated = 0;
+	for (int32 i = 0; i < BucketCount; i++)
+	{
+		Accumulated += Buckets[i];
+		if (Accumulated >= Target)
+		{
+			return FMath::Min(GimmickBot::HistogramMinMs * FMath::Pow(GimmickBot::HistogramRatio, i + 1.0), MaxMs);
+		}
+	}
+	return MaxMs;
+}
+
+/// @brief コンストラクタ
+AGimmickBotController::AGimmickBotController()
+{
+	//入力の注入と計測を毎フレーム行う
+	PrimaryActorTick.bCanEverTick = true;
+}
+
+/// @brief コマンドラインでボットが指定されたか
+bool AGimmickBotController::IsRequested()
+{
+	return FParse::Param(FCommandLine::Get(), TEXT("GimmickBot"));
+}
+
+void AGimmickBotController::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (!IsLocalController())
+	{
+		return;
+	}
+
+	//コマンドラインの設定
+	FString RoutePath;
+	if (!mRoute && FParse::Value(FCommandLine::Get(), TEXT("GimmickBotRoute="), RoutePath))
+	{
+		mRoute = LoadObject<UGimmickBotRoute>(nullptr, *RoutePath);
+		if (!mRoute)
+		{
+			UE_LOG(LogGimmickBot, Warning, TEXT("Bot route %s not found, planning from the gimmicks in the map"), *RoutePath);
+		}
+	}
+
+	double Hours = 0.0;
+	FParse::Value(FCommandLine::Get(), TEXT("GimmickBotHours="), Hours);
+	mDuration = Hours * 3600.0;
+
+	FParse::Value(FCommandLine::Get(), TEXT("GimmickBotReport="), mReportPath);
+	if (!mReportPath.IsEmpty() && FPaths::IsRelative(mReportPath))
+	{
+		mReportPath = FPaths::ProjectDir() / mReportPath;
+	}
+
+	//フレームレートの上限を外す（描画なしなら垂直同期もないので、ゲームスレッドが回る限り速く回る）
+	if (GEngine)
+	{
+		GEngine->bSmoothFrameRate = false;
+		GEngine->bUseFixedFrameRate = false;
+		GEngine->SetMaxFPS(0.0f);
+	}
+
+	UE_LOG(LogGimmickBot, Display, TEXT("Gimmick bot started (%s, %s)"),
+		mRoute ? *mRoute->GetName() : TEXT("planned route"),
+		mDuration > 0.0 ? *FString::Printf(TEXT("%.1f h"), Hours) : TEXT("until stopped"));
+}
+
+/// @brief 入力を注入して経路を進め、フレーム時間・リスポーン・メモリを記録する
+///        注入した入力は親の PlayerTick の入力処理で同じフレームに使われる
+/// @param DeltaTime フレーム間の経過時間
+void AGimmickBotController::PlayerTick(float DeltaTime)
+{
+	ASotugyouSeisakuCharacter* Character = Cast<ASotugyouSeisakuCharacter>(GetPawn());
+	if (Character && !bFinished)
+	{
+		const double RealTime = FPlatformTime::Seconds();
+		const double Now = GetWorld()->GetTimeSeconds();
+		const FVector Location = Character->GetActorLocation();
+
+		if (!bStarted)
+		{
+			//操作キャラクターが来たら計測を始める
+			bStarted = true;
+			mStartTime = RealTime;
+			mNextMemorySampleTime = RealTime;
+			mNextReportTime = RealTime + mReportInterval;
+			mLastRespawnCount = Character->GetRespawnCount();
+			mStepStartTime = Now;
+			mProgressLocation = Location;
+			mProgressTime = Now;
+			BuildPlan(Location);
+		}
+		else
+		{
+			//前フレームからの実時間を、前フレームにいた部屋のフレーム時間として記録する
+			FRoomStats& Stats = mRooms.FindOrAdd(mCurrentRoom);
+			Stats.Frames.Add((RealTime - mLastFrameTime) * 1000.0);
+
+			//落ちてリスポーンしたら、落ちた部屋に数える
+			const int32 RespawnCount = Character->GetRespawnCount();
+			if (RespawnCount != mLastRespawnCount)
+			{
+				Stats.Respawns += RespawnCount - mLastRespawnCount;
+				mLastRespawnCount = RespawnCount;
+				mPushPhase = EPushPhase::Approach;
+				mArrivedTime = -1.0;
+			}
+		}
+		mLastFrameTime = RealTime;
+
+		//今の手を進める（制限時間を過ぎたら諦める）
+		if (mSteps.IsValidIndex(mStepIndex))
+		{
+			const FGimmickBotStep& Step = mSteps[mStepIndex];
+			mCurrentRoom = Step.Room.IsNone() ? FindRoom(Location) : Step.Room;
+
+			if (Now - mStepStartTime > Step.TimeLimit)
+			{
+				NextStep(Character, true, Now);
+			}
+			else if (DriveStep(Character, Step, Now))
+			{
+				NextStep(Character, false, Now);
+			}
+		}
+		else
+		{
+			mCurrentRoom = FindRoom(Location);
+		}
+
+		if (RealTime >= mNextMemorySampleTime)
+		{
+			SampleMemory(RealTime);
+			mNextMemorySampleTime = RealTime + mMemorySampleInterval;
+		}
+		if (RealTime >= mNextReportTime)
+		{
+			LogReport();
+			mNextReportTime = RealTime + mReportInterval;
+		}
+		if (mDuration > 0.0 && RealTime - mStartTime >= mDuration)
+		{
+			Finish();
+		}
+	}
+
+	Super::PlayerTick(DeltaTime);
+}
+
+/// @brief 経路を作り直す
+///        経路アセットがなければ、ボタンマネージャーをスタートから近い順に、押す順番どおりに近くのブロックをボタンまで押し
+///        （ブロックがなければ自分で踏み）、開いたドアを通る。その後、動く床に乗り、落ちる床を踏んで回る（近いものから順に）
+/// @param Start 経路の始まりの位置
+void AGimmickBotController::BuildPlan(const FVector& Start)
+{
+	GatherRooms();
+
+	mSteps.Reset();
+	mStepIndex = 0;
+	mArrivedTime = -1.0;
+	mStepFrames = 0;
+	mPushPhase = EPushPhase::Approach;
+	mPushBlock.Reset();
+
+	if (mRoute)
+	{
+		mSteps = mRoute->mSteps;
+		return;
+	}
+
+	UWorld* World = GetWorld();
+
+	TArray<AGimmick_ButtonManager*> Managers;
+	for (TActorIterator<AGimmick_ButtonManager> It(World); It; ++It)
+	{
+		Managers.Add(*It);
+	}
+	Managers.Sort([&Start](const AGimmick_ButtonManager& A, const AGimmick_ButtonManager& B)
+	{
+		return FVector::DistSquared(A.GetActorLocation(), Start) < FVector::DistSquared(B.GetActorLocation(), Start);
+	});
+
+	TArray<AGimmick_PushBlock*> Blocks;
+	for (TActorIterator<AGimmick_PushBlock> It(World); It; ++It)
+	{
+		Blocks.Add(*It);
+	}
+
+	for (const AGimmick_ButtonManager* Manager : Managers)
+	{
+		const FName Room = Manager->GetFName();
+		for (const AGimmick_Button* Button : Manager->GetButtonSequence())
+		{
+			if (!Button)
+			{
+				continue;
+			}
+
+			//ボタンの近くの、まだ運んでいないブロックを押して載せる（なければ自分で踏む）
+			const FVector ButtonLocation = Button->GetActorLocation();
+			int32 Nearest = INDEX_NONE;
+			double NearestDistSq = FMath::Square(mRoomRadius);
+			for (int32 i = 0; i < Blocks.Num(); i++)
+			{
+				const double DistSq = FVector::DistSquared2D(Blocks[i]->GetActorLocation(), ButtonLocation);
+				if (DistSq < NearestDistSq)
+				{
+					Nearest = i;
+					NearestDistSq = DistSq;
+				}
+			}
+
+			FGimmickBotStep& Step = mSteps.AddDefaulted_GetRef();
+			Step.Room = Room;
+			if (Nearest != INDEX_NONE)
+			{
+				Step.Action = EGimmickBotAction::PushBlock;
+				Step.Location = Blocks[Nearest]->GetActorLocation();
+				Step.PushTarget = ButtonLocation;
+				Step.AcceptRadius = 30.0f;
+				Step.TimeLimit = 60.0f;
+				Blocks.RemoveAtSwap(Nearest);
+			}
+			else
+			{
+				Step.Location = ButtonLocation;
+				Step.WaitSeconds = 0.5f;
+			}
+		}
+
+		//開いたドアを通る
+		if (const AActor* Door = Manager->GetTargetDoor())
+		{
+			FGimmickBotStep& Step = mSteps.AddDefaulted_GetRef();
+			Step.Location = Door->GetActorLocation();
+			Step.AcceptRadius = 100.0f;
+			Step.Room = Room;
+		}
+	}
+
+	//床は近いものから順に回る（動く床は動いているので、着くまでアクタを追う）
+	TArray<AActor*> Floors;
+	for (TActorIterator<AGimmck_MoveFloor> It(World); It; ++It)
+	{
+		Floors.Add(*It);
+	}
+	for (TActorIterator<AGimmick_FallFloor> It(World); It; ++It)
+	{
+		Floors.Add(*It);
+	}
+
+	FVector From = mSteps.Num() > 0 ? mSteps.Last().Location : Start;
+	while (Floors.Num() > 0)
+	{
+		int32 Nearest = 0;
+		for (int32 i = 1; i < Floors.Num(); i++)
+		{
+			if (FVector::DistSquared(Floors[i]->GetActorLocation(), From) < FVector::DistSquared(Floors[Nearest]->GetActorLocation(), From))
+			{
+				Nearest = i;
+			}
+		}
+
+		AActor* Floor = Floors[Nearest];
+		Floors.RemoveAtSwap(Nearest);
+
+		FGimmickBotStep& Step = mSteps.AddDefaulted_GetRef();
+		Step.Location = Floor->GetActorLocation();
+		if (Floor->IsA<AGimmck_MoveFloor>())
+		{
+			Step.Action = EGimmickBotAction::Wait;
+			Step.Target = Floor;
+			Step.WaitSeconds = mRideSeconds;
+			Step.TimeLimit += mRideSeconds;
+		}
+		From = Step.Location;
+	}
+
+	UE_LOG(LogGimmickBot, Log, TEXT("Planned %d steps through %d rooms"), mSteps.Num(), Managers.Num());
+}
+
+/// @brief 部屋の範囲を集め直す（配置用アクタの範囲と、ボタンマネージャーのボタンの中心）
+void AGimmickBotController::GatherRooms()
+{
+	mRoomBounds.Reset();
+	mRoomCenters.Reset();
+
+	for (TActorIterator<AGimmickPlacementSpawner> It(GetWorld()); It; ++It)
+	{
+		if (It->mPlacement)
+		{
+			mRoomBounds.Emplace(It->GetFName(), It->mPlacement->mBounds.TransformBy(It->GetActorTransform()));
+		}
+	}
+
+	for (TActorIterator<AGimmick_ButtonManager> It(GetWorld()); It; ++It)
+	{
+		FVector Center = FVector::ZeroVector;
+		int32 Count = 0;
+		for (const AGimmick_Button* Button : It->GetButtonSequence())
+		{
+			if (Button)
+			{
+				Center += Button->GetActorLocation();
+				Count++;
+			}
+		}
+		mRoomCenters.Emplace(It->GetFName(), Count > 0 ? Center / Count : It->GetActorLocation());
+	}
+}
+
+/// @brief 位置がどの部屋か
+///        配置用アクタの範囲の中ならその部屋、でなければ mRoomRadius 以内で一番近いボタンマネージャーの部屋
+/// @param Location 位置
+/// @return 部屋の名前（どこでもなければ Outside）
+FName AGimmickBotController::FindRoom(const FVector& Location) const
+{
+	for (const TPair<FName, FBox>& Room : mRoomBounds)
+	{
+		if (Room.Value.IsInsideXY(Location))
+		{
+			return Room.Key;
+		}
+	}
+
+	FName Nearest = GimmickBot::OutsideRoom;
+	double NearestDistSq = FMath::Square(mRoomRadius);
+	for (const TPair<FName, FVector>& Room : mRoomCenters)
+	{
+		const double DistSq = FVector::DistSquared2D(Room.Value, Location);
+		if (DistSq < NearestDistSq)
+		{
+			Nearest = Room.Key;
+			NearestDistSq = DistSq;
+		}
+	}
+	return Nearest;
+}
+
+/// @brief 今の手を1フレーム進める
+/// @param Character 操作キャラクター
+/// @param Step 今の手
+/// @param Now ワールドの時刻
+/// @return 手が終わったか
+bool AGimmickBotController::DriveStep(ASotugyouSeisakuCharacter* Character, const FGimmickBotStep& Step, double Now)
+{
+	mStepFrames++;
+
+	if (Step.Action == EGimmickBotAction::PushBlock)
+	{
+		AGimmick_PushBlock* Block = mPushBlock.Get();
+		if (!Block)
+		{
+			//押すブロックがなければ飛ばす
+			const UGimmickSubsystem* Gimmicks = GetWorld()->GetSubsystem<UGimmickSubsystem>();
+			Block = Gimmicks ? Gimmicks->FindNearestPushBlock(Step.Location, GimmickBot::BlockSearchRadius) : nullptr;
+			if (!Block)
+			{
+				return true;
+			}
+			mPushBlock = Block;
+		}
+
+		//運び終えたら押すのをやめる（押す入力を注入しなければ次のフレームで離したことになる）
+		FVector ToTarget = Step.PushTarget - Block->GetActorLocation();
+		ToTarget.Z = 0.0;
+		if (ToTarget.SizeSquared() <= FMath::Square(Step.AcceptRadius))
+		{
+			return true;
+		}
+
+		const FVector Direction = ToTarget.GetSafeNormal();
+		const FRotator Facing(0.0, Direction.Rotation().Yaw, 0.0);
+		switch (mPushPhase)
+		{
+		case EPushPhase::Approach:
+			//運ぶ向きの反対側に回る
+			if (WalkTo(Character, Block->GetActorLocation() - Direction * mPushStandOff, GimmickBot::ApproachRadius, Now))
+			{
+				mPushPhase = EPushPhase::Engage;
+			}
+			break;
+
+		case EPushPhase::Engage:
+			//ゆっくりブロックの方へ歩いて正面に捉え、捉えたら押す
+			SetControlRotation(Facing);
+			Inject(Character, EGimmickReplayInput::Move, FInputActionValue(FVector2D(0.0, 0.3)));
+			if (Character->mTargetBlock == Block)
+			{
+				Inject(Character, EGimmickReplayInput::Push, FInputActionValue(true));
+			}
+			if (Character->IsPushingBlock())
+			{
+				mPushPhase = EPushPhase::Carry;
+			}
+			break;
+
+		case EPushPhase::Carry:
+			//押したまま運ぶ向きに歩く（離れてしまったら回り直す）
+			if (!Character->IsPushingBlock())
+			{
+				mPushPhase = EPushPhase::Approach;
+				break;
+			}
+			SetControlRotation(Facing);
+			Inject(Character, EGimmickReplayInput::Push, FInputActionValue(true));
+			Inject(Character, EGimmickReplayInput::Move, FInputActionValue(FVector2D(0.0, 1.0)));
+			break;
+		}
+		return false;
+	}
+
+	if (mArrivedTime < 0.0)
+	{
+		if (Step.Action == EGimmickBotAction::Jump && mStepFrames == 1)
+		{
+			PressJump(Character);
+		}
+
+		const AActor* Target = Step.Target.Get();
+		if (!WalkTo(Character, Target ? Target->GetActorLocation() : Step.Location, Step.AcceptRadius, Now))
+		{
+			return false;
+		}
+		mArrivedTime = Now;
+	}
+
+	//着いたら入力せずに待つ（動く床ならそのまま運ばれる）
+	return Now - mArrivedTime >= Step.WaitSeconds;
+}
+
+/// @brief 次の手に進む（最後まで進んだらスタート地点に戻って経路を組み立て直す）
+/// @param Character 操作キャラクター
+/// @param bTimedOut 制限時間を過ぎて諦めたか
+/// @param Now ワールドの時刻
+void AGimmickBotController::NextStep(ASotugyouSeisakuCharacter* Character, bool bTimedOut, double Now)
+{
+	FRoomStats& Stats = mRooms.FindOrAdd(mCurrentRoom);
+	Stats.Steps++;
+	if (bTimedOut)
+	{
+		Stats.Timeouts++;
+		UE_LOG(LogGimmickBot, Warning, TEXT("Bot step %d (%s) timed out in %s"),
+			mStepIndex, *UEnum::GetValueAsString(mSteps[mStepIndex].Action), *mCurrentRoom.ToString());
+	}
+
+	mStepIndex++;
+	mStepStartTime = Now;
+	mArrivedTime = -1.0;
+	mStepFrames = 0;
+	mPushPhase = EPushPhase::Approach;
+	mPushBlock.Reset();
+	mProgressLocation = Character->GetActorLocation();
+	mProgressTime = Now;
+
+	if (mStepIndex < mSteps.Num())
+	{
+		return;
+	}
+
+	if (mRoute && !mRoute->bLoop)
+	{
+		Finish();
+		return;
+	}
+
+	//配置用アクタが後から生成したギミックも拾うので、毎周組み立て直す（ボットが戻すリスポーンは数えない）
+	mLoops++;
+	Character->RespawnPlayer();
+	mLastRespawnCount = Character->GetRespawnCount();
+	BuildPlan(Character->GetActorLocation());
+}
+
+/// @brief 目的地に向かって歩く入力を注入する
+///        しばらく進めなければ段差や隙間とみなしてジャンプする
+/// @param Character 操作キャラクター
+/// @param Target 目的地
+/// @param AcceptRadius 着いたとみなす水平距離
+/// @param Now ワールドの時刻
+/// @return 着いたか
+bool AGimmickBotController::WalkTo(ASotugyouSeisakuCharacter* Character, const FVector& Target, float AcceptRadius, double Now)
+{
+	const FVector Location = Character->GetActorLocation();
+	FVector ToTarget = Target - Location;
+	ToTarget.Z = 0.0;
+	if (ToTarget.SizeSquared() <= FMath::Square(AcceptRadius))
+	{
+		return true;
+	}
+
+	//移動入力はカメラ（コントローラー）の向きが基準なので、目的地の方を向いて前に倒す
+	SetControlRotation(FRotator(0.0, ToTarget.Rotation().Yaw, 0.0));
+	Inject(Character, EGimmickReplayInput::Move, FInputActionValue(FVector2D(0.0, 1.0)));
+
+	if (FVector::DistSquared2D(Location, mProgressLocation) > FMath::Square(GimmickBot::ProgressDistance))
+	{
+		mProgressLocation = Location;
+		mProgressTime = Now;
+	}
+	else if (Now - mProgressTime > mStuckSeconds)
+	{
+		PressJump(Character);
+		mProgressTime = Now;
+	}
+	return false;
+}
+
+/// @brief ジャンプを1フレームだけ注入する（次のフレームで離したことになる）
+/// @param Character 操作キャラクター
+void AGimmickBotController::PressJump(ASotugyouSeisakuCharacter* Character)
+{
+	if (GFrameCounter > mLastJumpFrame + 1)
+	{
+		Inject(Character, EGimmickReplayInput::Jump, FInputActionValue(true));
+		mLastJumpFrame = GFrameCounter;
+	}
+}
+
+/// @brief 入力をEnhanced Input経由で注入する（キーボードで操作したときと同じ入力処理を通る）
+/// @param Character 操作キャラクター
+/// @param Input 入力の種類
+/// @param Value 入力値
+void AGimmickBotController::Inject(ASotugyouSeisakuCharacter* Character, EGimmickReplayInput Input, const FInputActionValue& Value)
+{
+	UInputAction* Action = Character->GetReplayInputAction(Input);
+	UEnhancedInputLocalPlayerSubsystem* InputSubsystem = ULocalPlayer::GetSubsystem<UEnhancedInputLocalPlayerSubsystem>(GetLocalPlayer());
+	if (Action && InputSubsystem)
+	{
+		InputSubsystem->InjectInputForAction(Action, Value, {}, {});
+	}
+}
+
+/// @brief 使用メモリと UObject 数を記録する
+/// @param Now 実時間
+void AGimmickBotController::SampleMemory(double Now)
+{
+	const FPlatformMemoryStats MemoryStats = FPlatformMemory::GetStats();
+
+	FMemorySample& Sample = mMemorySamples.AddDefaulted_GetRef();
+	Sample.Hours = (Now - mStartTime) / 3600.0;
+	Sample.UsedMB = MemoryStats.UsedPhysical / (1024.0 * 1024.0);
+	Sample.Objects = GUObjectArray.GetObjectArrayNumMinusAvailable();
+}
+
+/// @brief 1時間あたりのメモリ増加量を求める（記録全体の最小二乗法の傾き）
+/// @return MB / 時間（記録が2つ未満なら 0）
+double AGimmickBotController::GetMemoryGrowthPerHour() const
+{
+	const int32 Num = mMemorySamples.Num();
+	if (Num < 2)
+	{
+		return 0.0;
+	}
+
+	double MeanHours = 0.0;
+	double MeanMB = 0.0;
+	for (const FMemorySample& Sample : mMemorySamples)
+	{
+		MeanHours += Sample.Hours;
+		MeanMB += Sample.UsedMB;
+	}
+	MeanHours /= Num;
+	MeanMB /= Num;
+
+	double Covariance = 0.0;
+	double Variance = 0.0;
+	for (const FMemorySample& Sample : mMemorySamples)
+	{
+		Covariance += (Sample.Hours - MeanHours) * (Sample.UsedMB - MeanMB);
+		Variance += FMath::Square(Sample.Hours - MeanHours);
+	}
+	return Variance > 0.0 ? Covariance / Variance : 0.0;
+}
+
+/// @brief ここまでの計測結果をログに出す
+void AGimmickBotController::LogReport() const
+{
+	const double Hours = (FPlatformTime::Seconds() - mStartTime) / 3600.0;
+	UE_LOG(LogGimmickBot, Display, TEXT("Bot report after %.2f h, %d loops"), Hours, mLoops);
+	UE_LOG(LogGimmickBot, Display, TEXT("%-32s %10s %8s %8s %8s %8s %8s %8s %8s"),
+		TEXT("Room"), TEXT("Frames"), TEXT("Mean"), TEXT("P50"), TEXT("P95"), TEXT("P99"), TEXT("Max"), TEXT("Respawn"), TEXT("Stuck"));
+
+	TArray<FName> Names;
+	mRooms.GetKeys(Names);
+	Names.Sort(FNameLexicalLess());
+	for (const FName& Name : Names)
+	{
+		const FRoomStats& Stats = mRooms[Name];
+		const FFrameTimeHistogram& Frames = Stats.Frames;
+		UE_LOG(LogGimmickBot, Display, TEXT("%-32s %10lld %8.2f %8.2f %8.2f %8.2f %8.2f %8d %8d"),
+			*Name.ToString(), Frames.Count, Frames.Count > 0 ? Frames.SumMs / Frames.Count : 0.0,
+			Frames.Percentile(0.5), Frames.Percentile(0.95), Frames.Percentile(0.99), Frames.MaxMs, Stats.Respawns, Stats.Timeouts);
+	}
+
+	if (mMemorySamples.Num() > 0)
+	{
+		const FMemorySample& First = mMemorySamples[0];
+		const FMemorySample& Last = mMemorySamples.Last();
+		UE_LOG(LogGimmickBot, Display, TEXT("Memory %.1f -> %.1f MB (%+.1f MB/h), UObjects %d -> %d"),
+			First.UsedMB, Last.UsedMB, GetMemoryGrowthPerHour(), First.Objects, Last.Objects);
+	}
+}
+
+/// @brief ここまでの計測結果を JSON で書き出す
+/// @param FilePath 書き出し先
+/// @return 書き出せたか
+bool AGimmickBotController::WriteReport(const FString& FilePath) const
+{
+	FString Rooms;
+	for (const TPair<FName, FRoomStats>& Pair : mRooms)
+	{
+		const FFrameTimeHistogram& Frames = Pair.Value.Frames;
+		Rooms += FString::Printf(TEXT("%s{\"room\":\"%s\",\"frames\":%lld,\"mean_ms\":%.3f,\"p50_ms\":%.3f,\"p95_ms\":%.3f,\"p99_ms\":%.3f,\"max_ms\":%.3f,\"respawns\":%d,\"steps\":%d,\"timeouts\":%d}"),
+			Rooms.IsEmpty() ? TEXT("") : TEXT(","), *Pair.Key.ToString(), Frames.Count, Frames.Count > 0 ? Frames.SumMs / Frames.Count : 0.0,
+			Frames.Percentile(0.5), Frames.Percentile(0.95), Frames.Percentile(0.99), Frames.MaxMs,
+			Pair.Value.Respawns, Pair.Value.Steps, Pair.Value.Timeouts);
+	}
+
+	FString Memory;
+	for (const FMemorySample& Sample : mMemorySamples)
+	{
+		Memory += FString::Printf(TEXT("%s{\"hours\":%.4f,\"used_mb\":%.2f,\"uobjects\":%d}"), Memory.IsEmpty() ? TEXT("") : TEXT(","), Sample.Hours, Sample.UsedMB, Sample.Objects);
+	}
+
+	const FString Json = FString::Printf(TEXT("{\"hours\":%.4f,\"loops\":%d,\"memory_growth_mb_per_hour\":%.2f,\"rooms\":[%s],\"memory\":[%s]}"),
+		(FPlatformTime::Seconds() - mStartTime) / 3600.0, mLoops, GetMemoryGrowthPerHour(), *Rooms, *Memory);
+	return FFileHelper::SaveStringToFile(Json, *FilePath);
+}
+
+/// @brief 計測を終えて報告し、終了する
+void AGimmickBotController::Finish()
+{
+	bFinished = true;
+
+	SampleMemory(FPlatformTime::Seconds());
+	LogReport();
+	if (!mReportPath.IsEmpty() && !WriteReport(mReportPath))
+	{
+		UE_LOG(LogGimmickBot, Error, TEXT("Could not write bot report to %s"), *mReportPath);
+	}
+
+	FPlatformMisc::RequestExit(false);
+}
+
+//コンソールコマンド
+static FAutoConsoleCommandWithWorldAndArgs GGimmickBotReportCommand(
+	TEXT("Gimmick.Bot.Report"),
+	TEXT("Print the playthrough bot's per-room frame times, respawns and memory growth. Usage: Gimmick.Bot.Report [FileName]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		const AGimmickBotController* Bot = World ? Cast<AGimmickBotController>(World->GetFirstPlayerController()) : nullptr;
+		if (!Bot)
+		{
+			UE_LOG(LogGimmickBot, Display, TEXT("No playthrough bot in this world (start with -GimmickBot)"));
+			return;
+		}
+
+		Bot->LogReport();
+		if (Args.Num() > 0)
+		{
+			Bot->WriteReport(FPaths::IsRelative(Args[0]) ? FPaths::ProjectSavedDir() / Args[0] : Args[0]);
+		}
+	}));
@@ -0,0 +1,203 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/PlayerController.h"
+#include "InputActionValue.h"
+#include "GimmickTypes.h"
+#include "GimmickBotRoute.h"
+#include "GimmickBotController.generated.h"
+
+class ASotugyouSeisakuCharacter;
+class AGimmick_PushBlock;
+
+/// @brief 入力を注入してマップを自動で遊び続けるボット（長時間の負荷試験・性能計測用）
+///
+///        プレイヤーと同じ Enhanced Input のアクション（移動・ジャンプ・押す）を注入するので、
+///        動く床に乗る・ブロックをボタンまで押す・落ちる床を踏んで落ちて RespawnPlayer で戻る、を実際の操作と同じ経路で通す。
+///        経路アセットがなければ、ボタンマネージャーの押す順番・動く床・落ちる床からボットが経路を組み立てる。
+///        最後まで進んだらリスポーンして最初からやり直す。
+///
+///        部屋ごとにフレーム時間の分布（固定幅のヒストグラムなので長時間でもメモリが増えない）・リスポーン回数・詰まった回数を、
+///        一定間隔で使用メモリと UObject 数を記録し、1時間あたりの増加量を求める。
+///
+///        実行例（描画なし・フレームレート上限なし）:
+///        UnrealEditor SotugyouSeisaku.uproject /Game/ThirdPerson/Maps/ThirdPersonMap -game -nullrhi -unattended
+///            -GimmickBot [-GimmickBotRoute=/Game/Bot/Route.Route] [-GimmickBotHours=4] [-GimmickBotReport=Saved/Benchmark/Bot.json]
+///
+///        コンソールコマンド:
+///        Gimmick.Bot.Report
+UCLASS()
+class SOTUGYOUSEISAKU_API AGimmickBotController : public APlayerController
+{
+	GENERATED_BODY()
+
+public:
+	AGimmickBotController();
+
+	virtual void PlayerTick(float DeltaTime) override;
+
+	//コマンドラインでボットが指定されたか（-GimmickBot）
+	static bool IsRequested();
+
+	//ここまでの計測結果をログに出す
+	void LogReport() const;
+
+	//ここまでの計測結果を JSON で書き出す
+	bool WriteReport(const FString& FilePath) const;
+
+protected:
+	virtual void BeginPlay() override;
+
+public:
+	//経路（未設定なら -GimmickBotRoute=、それもなければマップのギミックから組み立てる）
+	UPROPERTY(EditAnywhere, Category = "Bot")
+	TObjectPtr<UGimmickBotRoute> mRoute;
+
+	//ボタンからこの距離までのブロックを押しに行く / ボタンマネージャーからこの距離までを同じ部屋とみなす
+	UPROPERTY(EditAnywhere, Category = "Bot")
+	float mRoomRadius = 2000.0f;
+
+	//動く床に乗っている秒数
+	UPROPERTY(EditAnywhere, Category = "Bot")
+	float mRideSeconds = 4.0f;
+
+	//ブロックを押し始めるときに立つ、ブロックの中心からの距離
+	UPROPERTY(EditAnywhere, Category = "Bot")
+	float mPushStandOff = 130.0f;
+
+	//この秒数ほとんど進めなければジャンプする
+	UPROPERTY(EditAnywhere, Category = "Bot")
+	float mStuckSeconds = 1.0f;
+
+	//使用メモリを記録する間隔（秒）
+	UPROPERTY(EditAnywhere, Category = "Bot")
+	float mMemorySampleInterval = 60.0f;
+
+	//途中経過をログに出す間隔（秒）
+	UPROPERTY(EditAnywhere, Category = "Bot")
+	float mReportInterval = 300.0f;
+
+private:
+	/// @brief フレーム時間のヒストグラム（0.05ms から 5% 刻みの対数目盛）
+	struct FFrameTimeHistogram
+	{
+		static constexpr int32 BucketCount = 200;
+
+		void Add(double Ms);
+		double Percentile(double Ratio) const;
+
+		uint32 Buckets[BucketCount] = {};
+		int64 Count = 0;
+		double SumMs = 0.0;
+		double MaxMs = 0.0;
+	};
+
+	//部屋ごとの計測
+	struct FRoomStats
+	{
+		FFrameTimeHistogram Frames;
+		int32 Respawns = 0;
+		int32 Timeouts = 0;
+		int32 Steps = 0;
+	};
+
+	//使用メモリの記録
+	struct FMemorySample
+	{
+		double Hours = 0.0;
+		double UsedMB = 0.0;
+		int32 Objects = 0;
+	};
+
+	//手の進み具合（押す手の段階）
+	enum class EPushPhase : uint8
+	{
+		Approach,	//ブロックの後ろに回る
+		Engage,		//ブロックの方を向いて押し始める
+		Carry,		//押したまま運ぶ
+	};
+
+	//経路を作り直す（経路アセットがなければマップのギミックから組み立てる）
+	void BuildPlan(const FVector& Start);
+
+	//部屋の範囲を集め直す
+	void GatherRooms();
+
+	//今の手を1フレーム進める（戻り値 = 手が終わったか）
+	bool DriveStep(ASotugyouSeisakuCharacter* Character, const FGimmickBotStep& Step, double Now);
+
+	//次の手に進む
+	void NextStep(ASotugyouSeisakuCharacter* Character, bool bTimedOut, double Now);
+
+	//目的地に向かって歩く入力を注入する（戻り値 = 着いたか）
+	bool WalkTo(ASotugyouSeisakuCharacter* Character, const FVector& Target, float AcceptRadius, double Now);
+
+	//ジャンプを1フレームだけ注入する
+	void PressJump(ASotugyouSeisakuCharacter* Character);
+
+	//入力を注入する
+	void Inject(ASotugyouSeisakuCharacter* Character, EGimmickReplayInput Input, const FInputActionValue& Value);
+
+	//位置がどの部屋か
+	FName FindRoom(const FVector& Location) const;
+
+	//使用メモリを記録する
+	void SampleMemory(double Now);
+
+	//1時間あたりのメモリ増加量（MB、最小二乗法）
+	double GetMemoryGrowthPerHour() const;
+
+	//計測を終えて報告し、終了する
+	void Finish();
+
+	//部屋ごとの計測
+	TMap<FName, FRoomStats> mRooms;
+
+	//部屋の範囲（配置用アクタ）と中心（ボタンマネージャー）
+	TArray<TPair<FName, FBox>> mRoomBounds;
+	TArray<TPair<FName, FVector>> mRoomCenters;
+
+	TArray<FMemorySample> mMemorySamples;
+
+	//経路と今の手
+	TArray<FGimmickBotStep> mSteps;
+	int32 mStepIndex = 0;
+	double mStepStartTime = 0.0;
+	double mArrivedTime = -1.0;
+	int32 mStepFrames = 0;
+	EPushPhase mPushPhase = EPushPhase::Approach;
+
+	//押しているブロック
+	TWeakObjectPtr<AGimmick_PushBlock> mPushBlock;
+
+	//詰まったかの判定
+	FVector mProgressLocation = FVector::ZeroVector;
+	double mProgressTime = 0.0;
+	//最後にジャンプを注入したフレーム（続けて注入すると押しっぱなしになり跳び直さない）
+	uint64 mLastJumpFrame = 0;
+
+	//今いる部屋
+	FName mCurrentRoom;
+
+	//前フレームまでのリスポーン回数
+	int32 mLastRespawnCount = 0;
+
+	//経路を最初からやり直した回数
+	int32 mLoops = 0;
+
+	//計測の時刻（実時間）
+	double mStartTime = 0.0;
+	double mLastFrameTime = 0.0;
+	double mNextMemorySampleTime = 0.0;
+	double mNextReportTime = 0.0;
+
+	//計測する秒数（0 = 終了しない）と報告の書き出し先
+	double mDuration = 0.0;
+	FString mReportPath;
+
+	//操作キャラクターが来て計測を始めたか / 計測を終えたか
+	bool bStarted = false;
+	bool bFinished = false;
+};
@@ -0,0 +1,71 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "GimmickBotRoute.generated.h"
+
+/// @brief 自動プレイボットの1手の種類
+UENUM(BlueprintType)
+enum class EGimmickBotAction : uint8
+{
+	MoveTo UMETA(DisplayName = "移動"),
+	Jump UMETA(DisplayName = "ジャンプしながら移動"),
+	Wait UMETA(DisplayName = "待つ（動く床に乗るなど）"),
+	PushBlock UMETA(DisplayName = "ブロックを押して運ぶ"),
+};
+
+/// @brief 自動プレイボットの1手
+USTRUCT(BlueprintType)
+struct FGimmickBotStep
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, Category = "Step")
+	EGimmickBotAction Action = EGimmickBotAction::MoveTo;
+
+	//移動先 / 押すブロックの位置（近くのブロックを探す）/ 待つ場所
+	UPROPERTY(EditAnywhere, Category = "Step")
+	FVector Location = FVector::ZeroVector;
+
+	//ここまで近づいたら着いたとみなす距離（水平）
+	UPROPERTY(EditAnywhere, Category = "Step", meta = (ClampMin = "1"))
+	float AcceptRadius = 60.0f;
+
+	//ブロックを運ぶ先（PushBlock のとき）
+	UPROPERTY(EditAnywhere, Category = "Step", meta = (EditCondition = "Action == EGimmickBotAction::PushBlock"))
+	FVector PushTarget = FVector::ZeroVector;
+
+	//着いてから待つ秒数
+	UPROPERTY(EditAnywhere, Category = "Step", meta = (ClampMin = "0"))
+	float WaitSeconds = 0.0f;
+
+	//この秒数で終わらなければ諦めて次の手に進む（詰まった回数として数える）
+	UPROPERTY(EditAnywhere, Category = "Step", meta = (ClampMin = "1"))
+	float TimeLimit = 30.0f;
+
+	//計測をまとめる部屋の名前（None なら配置用アクタの範囲から求める）
+	UPROPERTY(EditAnywhere, Category = "Step")
+	FName Room;
+
+	//向かう先のアクタ（ボットが経路を組み立てたとき、動く床に乗る手で設定する。設定されていれば Location の代わりに使う）
+	UPROPERTY(Transient)
+	TWeakObjectPtr<AActor> Target;
+};
+
+/// @brief 自動プレイボットの経路（手を順番に並べたもの）
+///        -GimmickBotRoute= で指定する。指定しなければボットがマップのギミックから経路を組み立てる
+UCLASS(BlueprintType)
+class SOTUGYOUSEISAKU_API UGimmickBotRoute : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY(EditAnywhere, Category = "Route")
+	TArray<FGimmickBotStep> mSteps;
+
+	//最後の手まで進んだらリスポーンして最初からやり直す
+	UPROPERTY(EditAnywhere, Category = "Route")
+	bool bLoop = true;
+};
@@ -0,0 +1,224 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GimmickCollapseCache.h"
+#include "Components/StaticMeshComponent.h"
+#include "Engine/CollisionProfile.h"
+#include "Engine/Engine.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/StaticMeshActor.h"
+#include "Engine/World.h"
+#include "Math/RandomStream.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogGimmickCollapse, Log, All);
+
+#if WITH_EDITOR
+/// @brief 一時的なワールドで破片をシミュレーションして焼き込み直す
+void UGimmickCollapseCache::Bake()
+{
+	Modify();
+
+	if (!mPieceMesh)
+	{
+		mPieceMesh = LoadObject<UStaticMesh>(nullptr, TEXT("/Engine/BasicShapes/Cube.Cube"));
+	}
+
+	//エディタのワールドとは別の、何もないワールドでシミュレーションする
+	UWorld* World = UWorld::CreateWorld(EWorldType::Game, false, TEXT("GimmickCollapseBake"));
+	FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+	WorldContext.SetCurrentWorld(World);
+	World->InitializeActorsForPlay(FURL());
+	World->BeginPlay();
+
+	BakeInWorld(World);
+
+	GEngine->DestroyWorldContext(World);
+	World->DestroyWorld(false);
+}
+#endif
+
+/// @brief 破片をシミュレーションし、一定間隔で位置と回転を量子化して焼き込む
+/// @param World 物理を動かせるワールド（床は原点に置くので、他に何もない状態にしておく）
+/// @return 焼き込めたか
+bool UGimmickCollapseCache::BakeInWorld(UWorld* World)
+{
+	//キーフレーム1つあたりの物理の刻み数
+	constexpr int32 StepsPerFrame = 2;
+
+	mPieceCount = 0;
+	mFrameCount = 0;
+	mFrameInterval = 0.0f;
+	mPieceScales.Reset();
+	mPositions.Reset();
+	mRotations.Reset();
+
+	if (!World || !mFloorMesh || !mPieceMesh)
+	{
+		UE_LOG(LogGimmickCollapse, Warning, TEXT("%s: floor mesh and piece mesh are required to bake"), *GetName());
+		return false;
+	}
+
+	World->bShouldSimulatePhysics = true;
+
+	TArray<UStaticMeshComponent*> Pieces;
+	SpawnSimulatedPieces(World, FTransform::Identity, Pieces);
+	if (Pieces.Num() == 0)
+	{
+		return false;
+	}
+
+	const int32 Frames = FMath::CeilToInt(mDuration * mSampleRate) + 1;
+	const float Interval = 1.0f / mSampleRate;
+
+	//床を原点に置いたので、ワールド座標がそのまま床からの相対トランスフォームになる
+	TArray<FVector> Locations;
+	TArray<FQuat> Rotations;
+	Locations.Reserve(Frames * Pieces.Num());
+	Rotations.Reserve(Frames * Pieces.Num());
+	double MaxExtent = 0.0;
+
+	for (int32 Frame = 0; Frame < Frames; Frame++)
+	{
+		if (Frame > 0)
+		{
+			for (int32 Step = 0; Step < StepsPerFrame; Step++)
+			{
+				World->Tick(LEVELTICK_All, Interval / StepsPerFrame);
+			}
+		}
+
+		for (UStaticMeshComponent* Piece : Pieces)
+		{
+			const FTransform& Transform = Piece->GetComponentTransform();
+			FQuat Rotation = Transform.GetRotation().GetNormalized();
+
+			//補間で遠回りしないよう、前のフレームと同じ向きの符号にそろえる
+			if (Frame > 0 && (Rotations[Rotations.Num() - Pieces.Num()] | Rotation) < 0.0)
+			{
+				Rotation = Rotation * -1.0;
+			}
+
+			Locations.Add(Transform.GetLocation());
+			Rotations.Add(Rotation);
+			MaxExtent = FMath::Max(MaxExtent, Transform.GetLocation().GetAbsMax());
+		}
+	}
+
+	//位置は一番遠くまで飛んだ破片が int16 に収まる刻みで量子化する
+	mPositionStep = FMath::Max(static_cast<float>(MaxExtent / MAX_int16), 0.01f);
+	mPositions.Reserve(Locations.Num() * 3);
+	for (const FVector& Location : Locations)
+	{
+		for (int32 Axis = 0; Axis < 3; Axis++)
+		{
+			mPositions.Add(static_cast<int16>(FMath::Clamp(FMath::RoundToInt(Location[Axis] / mPositionStep), -MAX_int16, MAX_int16)));
+		}
+	}
+
+	//回転は正規化したクォータニオンの各成分を量子化する（再生時に補間してから正規化する）
+	mRotations.Reserve(Rotations.Num() * 4);
+	for (const FQuat& Rotation : Rotations)
+	{
+		mRotations.Add(static_cast<int16>(FMath::RoundToInt(Rotation.X * MAX_int16)));
+		mRotations.Add(static_cast<int16>(FMath::RoundToInt(Rotation.Y * MAX_int16)));
+		mRotations.Add(static_cast<int16>(FMath::RoundToInt(Rotation.Z * MAX_int16)));
+		mRotations.Add(static_cast<int16>(FMath::RoundToInt(Rotation.W * MAX_int16)));
+	}
+
+	for (UStaticMeshComponent* Piece : Pieces)
+	{
+		mPieceScales.Add(FVector3f(Piece->GetComponentScale()));
+		Piece->GetOwner()->Destroy();
+	}
+
+	mPieceCount = Pieces.Num();
+	mFrameCount = Frames;
+	mFrameInterval = Interval;
+
+	UE_LOG(LogGimmickCollapse, Display, TEXT("%s: baked %d pieces x %d frames (%lld bytes)"), *GetName(), mPieceCount, mFrameCount, GetBakedBytes());
+	return true;
+}
+
+/// @brief 床のメッシュを格子状の破片に分け、剛体として生成して崩し始める
+/// @param World 生成するワールド
+/// @param FloorTransform 崩れる床のトランスフォーム
+/// @param OutPieces 生成した破片のメッシュコンポーネント
+void UGimmickCollapseCache::SpawnSimulatedPieces(UWorld* World, const FTransform& FloorTransform, TArray<UStaticMeshComponent*>& OutPieces) const
+{
+	if (!World || !mFloorMesh || !mPieceMesh)
+	{
+		return;
+	}
+
+	const FBox FloorBox = mFloorMesh->GetBoundingBox();
+	const FVector FloorCenter = FloorBox.GetCenter();
+	const FIntPoint Grid(FMath::Max(mPieceGrid.X, 1), FMath::Max(mPieceGrid.Y, 1));
+	const FVector PieceSize = FloorBox.GetSize() / FVector(Grid.X, Grid.Y, 1.0f);
+
+	//隣の破片と重なって弾け飛ばないよう少しだけ縮める
+	const FVector PieceScale = PieceSize * 0.98f / mPieceMesh->GetBoundingBox().GetSize().ComponentMax(FVector(UE_KINDA_SMALL_NUMBER));
+
+	FRandomStream Random(mSeed);
+	for (int32 y = 0; y < Grid.Y; y++)
+	{
+		for (int32 x = 0; x < Grid.X; x++)
+		{
+			const FVector Center = FloorBox.Min + PieceSize * FVector(x + 0.5f, y + 0.5f, 0.5f);
+			const FTransform PieceTransform = FTransform(FQuat::Identity, Center, PieceScale) * FloorTransform;
+
+			AStaticMeshActor* Piece = World->SpawnActorDeferred<AStaticMeshActor>(AStaticMeshActor::StaticClass(), PieceTransform);
+			if (!Piece)
+			{
+				continue;
+			}
+
+			UStaticMeshComponent* Mesh = Piece->GetStaticMeshComponent();
+			Mesh->SetMobility(EComponentMobility::Movable);
+			Mesh->SetStaticMesh(mPieceMesh);
+			Mesh->SetCollisionProfileName(UCollisionProfile::PhysicsActor_ProfileName);
+			Mesh->SetSimulatePhysics(true);
+			Piece->FinishSpawning(PieceTransform);
+
+			//中心から外側へ少し上向きに飛ばし、ばらばらの向きに回す
+			const FVector Velocity = (Center - FloorCenter).GetSafeNormal2D() * mBreakSpeed * Random.FRandRange(0.5f, 1.0f)
+				+ FVector(0.0f, 0.0f, mBreakSpeed * Random.FRandRange(0.0f, 0.5f));
+			Mesh->SetPhysicsLinearVelocity(FloorTransform.TransformVectorNoScale(Velocity));
+			Mesh->SetPhysicsAngularVelocityInDegrees(FloorTransform.TransformVectorNoScale(Random.GetUnitVector() * mSpinSpeed));
+
+			OutPieces.Add(Mesh);
+		}
+	}
+}
+
+/// @brief 指定した時間の破片のトランスフォームを、前後のキーフレームを補間して求める
+/// @param Time 崩れ始めてからの時間（秒、再生する長さを超えたら最後のキーフレーム）
+/// @param FloorTransform 崩れる床のトランスフォーム
+/// @param OutTransforms 破片ごとのワールド座標でのトランスフォーム（要素数は破片の数）
+void UGimmickCollapseCache::SamplePieces(float Time, const FTransform& FloorTransform, TArrayView<FTransform> OutTransforms) const
+{
+	check(IsBaked() && OutTransforms.Num() == mPieceCount);
+
+	const float FrameTime = FMath::Clamp(Time / mFrameInterval, 0.0f, static_cast<float>(mFrameCount - 1));
+	const int32 Frame = FMath::Min(FMath::FloorToInt(FrameTime), mFrameCount - 2);
+	const float Alpha = FrameTime - Frame;
+
+	for (int32 Piece = 0; Piece < mPieceCount; Piece++)
+	{
+		const FVector Location = FMath::Lerp(DecodePosition(Frame, Piece), DecodePosition(Frame + 1, Piece), Alpha);
+		const FQuat Rotation = FQuat::FastLerp(DecodeRotation(Frame, Piece), DecodeRotation(Frame + 1, Piece), Alpha).GetNormalized();
+		OutTransforms[Piece] = FTransform(Rotation, Location, FVector(mPieceScales[Piece])) * FloorTransform;
+	}
+}
+
+/// @brief 量子化した位置を戻す
+FVector UGimmickCollapseCache::DecodePosition(int32 Frame, int32 Piece) const
+{
+	const int16* Position = &mPositions[(Frame * mPieceCount + Piece) * 3];
+	return FVector(Position[0], Position[1], Position[2]) * mPositionStep;
+}
+
+/// @brief 量子化した回転を戻す（長さは正規化しない、補間した後にまとめて正規化する）
+FQuat UGimmickCollapseCache::DecodeRotation(int32 Frame, int32 Piece) const
+{
+	const int16* Rotation = &mRotations[(Frame * mPieceCount + Piece) * 4];
+	return FQuat(Rotation[0], Rotation[1], Rotation[2], Rotation[3]);
+}
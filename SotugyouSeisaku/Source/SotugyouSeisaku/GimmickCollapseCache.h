@@ -0,0 +1,110 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "GimmickCollapseCache.generated.h"
+
+class UStaticMesh;
+class UStaticMeshComponent;
+
+/// @brief 落ちる床が崩れる様子を焼き込んだデータアセット（床のメッシュごとに1つ）
+///        床のメッシュを格子状の破片に分けて剛体シミュレーションを一度だけ実行し、破片ごとの位置と回転を一定間隔で量子化して持つ
+///        実行時は UGimmickCollapseSubsystem がキーフレームを補間して再生するだけで、物理のソルバーは使わない
+UCLASS(BlueprintType)
+class SOTUGYOUSEISAKU_API UGimmickCollapseCache : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	//焼き込み元の床のメッシュ（この大きさを破片に分ける）
+	UPROPERTY(EditAnywhere, Category = "Source")
+	TObjectPtr<UStaticMesh> mFloorMesh;
+
+	//破片の分け方（X × Y）
+	UPROPERTY(EditAnywhere, Category = "Source", meta = (ClampMin = 1, ClampMax = 8))
+	FIntPoint mPieceGrid = FIntPoint(3, 3);
+
+	//焼き込む長さ（秒）
+	UPROPERTY(EditAnywhere, Category = "Source", meta = (ClampMin = 0.1))
+	float mDuration = 2.0f;
+
+	//1秒あたりのキーフレーム数
+	UPROPERTY(EditAnywhere, Category = "Source", meta = (ClampMin = 5, ClampMax = 60))
+	int32 mSampleRate = 30;
+
+	//破片が外側へ飛び散る速さ（cm/s）
+	UPROPERTY(EditAnywhere, Category = "Source")
+	float mBreakSpeed = 150.0f;
+
+	//破片が回る速さ（度/s）
+	UPROPERTY(EditAnywhere, Category = "Source")
+	float mSpinSpeed = 180.0f;
+
+	//破片ごとの飛び方を決める乱数の種
+	UPROPERTY(EditAnywhere, Category = "Source")
+	int32 mSeed = 0;
+
+	//破片として描画するメッシュ（原点が中心のもの、未設定なら焼き込み時にエンジンのキューブを設定する）
+	UPROPERTY(EditAnywhere, Category = "Playback")
+	TObjectPtr<UStaticMesh> mPieceMesh;
+
+#if WITH_EDITOR
+	//一時的なワールドで破片をシミュレーションして焼き込み直す
+	UFUNCTION(CallInEditor, Category = "Source")
+	void Bake();
+#endif
+
+	//物理を動かせるワールドで破片をシミュレーションして焼き込む（ワールドは他に何もない状態にしておく）
+	bool BakeInWorld(UWorld* World);
+
+	//破片を剛体として生成して崩し始める（焼き込みと、ベンチマークで毎回シミュレーションする場合との比較に使う）
+	void SpawnSimulatedPieces(UWorld* World, const FTransform& FloorTransform, TArray<UStaticMeshComponent*>& OutPieces) const;
+
+	//指定した時間の破片のワールド座標でのトランスフォームを求める（OutTransforms の要素数は破片の数）
+	void SamplePieces(float Time, const FTransform& FloorTransform, TArrayView<FTransform> OutTransforms) const;
+
+	//焼き込み済みか
+	bool IsBaked() const { return mPieceCount > 0 && mFrameCount >= 2; }
+
+	//破片の数
+	int32 NumPieces() const { return mPieceCount; }
+
+	//再生する長さ（秒）
+	float GetPlayLength() const { return IsBaked() ? (mFrameCount - 1) * mFrameInterval : 0.0f; }
+
+	//焼き込んだキーフレームの大きさ（バイト）
+	int64 GetBakedBytes() const { return mPositions.Num() * sizeof(int16) + mRotations.Num() * sizeof(int16) + mPieceScales.Num() * sizeof(FVector3f); }
+
+	UPROPERTY(VisibleAnywhere, Category = "Baked")
+	int32 mPieceCount = 0;
+
+	UPROPERTY(VisibleAnywhere, Category = "Baked")
+	int32 mFrameCount = 0;
+
+	//キーフレームの間隔（秒）
+	UPROPERTY(VisibleAnywhere, Category = "Baked")
+	float mFrameInterval = 0.0f;
+
+	//破片ごとのメッシュの拡大率
+	UPROPERTY(VisibleAnywhere, Category = "Baked")
+	TArray<FVector3f> mPieceScales;
+
+	//位置の量子化の刻み（cm）
+	UPROPERTY(VisibleAnywhere, Category = "Baked")
+	float mPositionStep = 1.0f;
+
+	//位置（床からの相対位置を mPositionStep 単位で量子化、[フレーム][破片][XYZ]）
+	UPROPERTY(VisibleAnywhere, Category = "Baked")
+	TArray<int16> mPositions;
+
+	//回転（床からの相対回転のクォータニオンを 1/32767 単位で量子化、[フレーム][破片][XYZW]）
+	UPROPERTY(VisibleAnywhere, Category = "Baked")
+	TArray<int16> mRotations;
+
+private:
+	//量子化した位置と回転を戻す
+	FVector DecodePosition(int32 Frame, int32 Piece) const;
+	FQuat DecodeRotation(int32 Frame, int32 Piece) const;
+};
@@ -0,0 +1,205 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GimmickCollapseSubsystem.h"
+#include "GimmickCollapseCache.h"
+#include "GimmickTypes.h"
+#include "GimmickPreloadSubsystem.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogGimmickCollapse, Log, All);
+
+static TAutoConsoleVariable<bool> CVarGimmickCollapsePlayback(
+	TEXT("Gimmick.CollapsePlayback"),
+	true,
+	TEXT("Play back baked collapse caches when falling floors fall (0 = floors vanish as before)."));
+
+void UGimmickCollapseSubsystem::Deinitialize()
+{
+	mPlaybacks.Empty();
+	mBatches.Empty();
+	mComponents.Empty();
+	mCaches.Empty();
+	mHost = nullptr;
+
+	Super::Deinitialize();
+}
+
+bool UGimmickCollapseSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UGimmickCollapseSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UGimmickCollapseSubsystem, STATGROUP_Tickables);
+}
+
+/// @brief 崩れる様子を再生するか
+bool UGimmickCollapseSubsystem::IsEnabled()
+{
+	return CVarGimmickCollapsePlayback.GetValueOnGameThread();
+}
+
+/// @brief 崩れる様子の再生を始める
+/// @param Cache 床のメッシュに対応する焼き込み
+/// @param FloorTransform 崩れる床のトランスフォーム
+/// @param Material 破片に使うマテリアル（未設定なら破片のメッシュのもの）
+/// @return 再生を始めたか
+bool UGimmickCollapseSubsystem::Play(UGimmickCollapseCache* Cache, const FTransform& FloorTransform, UMaterialInterface* Material)
+{
+	LLM_SCOPE_BYTAG(Gimmick_Instances);
+	GimmickLoading::FSyncLoadScope LoadScope(this, TEXT("UGimmickCollapseSubsystem::Play"));
+
+	if (!Cache || !Cache->IsBaked() || !Cache->mPieceMesh || !IsEnabled() || !GimmickCosmetics::ShouldRun(GetWorld()))
+	{
+		return false;
+	}
+
+	FPlayback& Playback = mPlaybacks.AddDefaulted_GetRef();
+	Playback.Batch = FindOrAddBatch(Cache, Material);
+	Playback.FloorTransform = FloorTransform;
+
+	//再生し終えた崩れのインスタンスを使い回し、なければ破片の数だけ足す
+	FBatch& Batch = mBatches[Playback.Batch];
+	if (Batch.FreeBlocks.Num() > 0)
+	{
+		Playback.FirstInstance = Batch.FreeBlocks.Pop(EAllowShrinking::No);
+	}
+	else
+	{
+		Playback.FirstInstance = Batch.Component->GetInstanceCount();
+		mScratch.SetNum(Cache->NumPieces(), EAllowShrinking::No);
+		Cache->SamplePieces(0.0f, FloorTransform, mScratch);
+		Batch.Component->AddInstances(mScratch, false, true);
+	}
+
+	Batch.bDirty = true;
+	return true;
+}
+
+/// @brief 再生中の崩れの破片を進め、描画状態の更新はバッチ単位でまとめて行う
+/// @param DeltaTime フレーム間の経過時間
+void UGimmickCollapseSubsystem::Tick(float DeltaTime)
+{
+	//再生し終えたインスタンスは大きさを 0 にして見えなくする
+	static const FTransform Hidden(FQuat::Identity, FVector::ZeroVector, FVector::ZeroVector);
+
+	for (int32 i = mPlaybacks.Num() - 1; i >= 0; i--)
+	{
+		FPlayback& Playback = mPlaybacks[i];
+		FBatch& Batch = mBatches[Playback.Batch];
+		const UGimmickCollapseCache* Cache = Batch.Cache;
+
+		Playback.Time += DeltaTime;
+		mScratch.SetNum(Cache->NumPieces(), EAllowShrinking::No);
+
+		if (Playback.Time >= Cache->GetPlayLength())
+		{
+			for (FTransform& Transform : mScratch)
+			{
+				Transform = Hidden;
+			}
+			Batch.FreeBlocks.Add(Playback.FirstInstance);
+			mPlaybacks.RemoveAtSwap(i, EAllowShrinking::No);
+		}
+		else
+		{
+			Cache->SamplePieces(Playback.Time, Playback.FloorTransform, mScratch);
+		}
+
+		Batch.Component->BatchUpdateInstancesTransforms(Playback.FirstInstance, mScratch, true, false, true);
+		Batch.bDirty = true;
+	}
+
+	for (FBatch& Batch : mBatches)
+	{
+		if (Batch.bDirty)
+		{
+			Batch.Component->MarkRenderStateDirty();
+			Batch.bDirty = false;
+		}
+	}
+}
+
+/// @brief 確保しているインスタンス数
+int32 UGimmickCollapseSubsystem::NumInstances() const
+{
+	int32 Count = 0;
+	for (const FBatch& Batch : mBatches)
+	{
+		Count += Batch.Component->GetInstanceCount();
+	}
+	return Count;
+}
+
+/// @brief 焼き込みとマテリアルの組み合わせに対応するバッチを探す（なければ作る）
+/// @param Cache 焼き込み
+/// @param Material 破片に使うマテリアル
+/// @return バッチの番号
+int32 UGimmickCollapseSubsystem::FindOrAddBatch(UGimmickCollapseCache* Cache, UMaterialInterface* Material)
+{
+	//床のメッシュの種類は数個なので線形探索で十分
+	for (int32 i = 0; i < mBatches.Num(); i++)
+	{
+		if (mBatches[i].Cache == Cache && mBatches[i].Material == Material)
+		{
+			return i;
+		}
+	}
+
+	if (!mHost)
+	{
+		FActorSpawnParameters SpawnParams;
+		SpawnParams.Name = TEXT("GimmickCollapseHost");
+		SpawnParams.NameMode = FActorSpawnParameters::ESpawnActorNameMode::Requested;
+		SpawnParams.ObjectFlags = RF_Transient;
+		mHost = GetWorld()->SpawnActor<AActor>(SpawnParams);
+	}
+
+	//描画専用（破片は何にも当たらない）
+	UInstancedStaticMeshComponent* Component = NewObject<UInstancedStaticMeshComponent>(mHost);
+	Component->SetMobility(EComponentMobility::Movable);
+	Component->SetStaticMesh(Cache->mPieceMesh);
+	if (Material)
+	{
+		for (int32 i = 0; i < Cache->mPieceMesh->GetStaticMaterials().Num(); i++)
+		{
+			Component->SetMaterial(i, Material);
+		}
+	}
+	Component->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	Component->SetGenerateOverlapEvents(false);
+	Component->SetCanEverAffectNavigation(false);
+	Component->RegisterComponent();
+	mHost->AddInstanceComponent(Component);
+	mComponents.Add(Component);
+	mCaches.AddUnique(Cache);
+
+	FBatch& Batch = mBatches.AddDefaulted_GetRef();
+	Batch.Cache = Cache;
+	Batch.Material = Material;
+	Batch.Component = Component;
+
+	UE_LOG(LogGimmickCollapse, Verbose, TEXT("New collapse batch: %s"), *GetNameSafe(Cache));
+	return mBatches.Num() - 1;
+}
+
+//コンソールコマンド
+static FAutoConsoleCommandWithWorldAndArgs GGimmickCollapsesCommand(
+	TEXT("Gimmick.Collapses"),
+	TEXT("Print how many falling floor collapses are playing back and how many piece instances are allocated."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		const UGimmickCollapseSubsystem* Collapses = World ? World->GetSubsystem<UGimmickCollapseSubsystem>() : nullptr;
+		if (!Collapses)
+		{
+			return;
+		}
+
+		UE_LOG(LogGimmickCollapse, Display, TEXT("Collapses playing: %d, batches: %d, piece instances: %d (playback %s)"),
+			Collapses->NumPlaying(), Collapses->NumBatches(), Collapses->NumInstances(),
+			UGimmickCollapseSubsystem::IsEnabled() ? TEXT("on") : TEXT("off"));
+	}));
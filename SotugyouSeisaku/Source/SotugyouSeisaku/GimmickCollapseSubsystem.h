@@ -0,0 +1,97 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "GimmickCollapseSubsystem.generated.h"
+
+class UGimmickCollapseCache;
+class UMaterialInterface;
+class UInstancedStaticMeshComponent;
+
+/// @brief 落ちる床が崩れる様子を、焼き込んだ結果（UGimmickCollapseCache）から再生するサブシステム
+///
+///        破片は焼き込みとマテリアルの組み合わせごとの InstancedStaticMeshComponent で描画し、
+///        毎フレームの処理はキーフレームの補間とインスタンスのトランスフォームの更新だけにする（剛体のシミュレーションはしない）。
+///        再生し終えた崩れのインスタンスは見えなくして次の崩れに使い回し、描画状態の更新はバッチ単位で1回だけ行う。
+///
+///        コンソールコマンド:
+///        Gimmick.Collapses（再生中の崩れ・バッチ・インスタンスの数を表示）
+///        Gimmick.CollapsePlayback 0/1（0 なら床は今まで通りその場で消える）
+UCLASS()
+class SOTUGYOUSEISAKU_API UGimmickCollapseSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	//崩れる様子を再生するか（コンソール変数 Gimmick.CollapsePlayback）
+	static bool IsEnabled();
+
+	//崩れる様子の再生を始める（見た目だけなので、専用サーバーなどや焼き込み前なら何もしない）
+	bool Play(UGimmickCollapseCache* Cache, const FTransform& FloorTransform, UMaterialInterface* Material);
+
+	//再生中の崩れの数
+	int32 NumPlaying() const { return mPlaybacks.Num(); }
+
+	//バッチ数と確保しているインスタンス数（再生し終えて使い回しを待っているものも含む）
+	int32 NumBatches() const { return mBatches.Num(); }
+	int32 NumInstances() const;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	//焼き込みとマテリアルの組み合わせに対応するバッチを探す（なければ作る）
+	int32 FindOrAddBatch(UGimmickCollapseCache* Cache, UMaterialInterface* Material);
+
+	struct FBatch
+	{
+		UGimmickCollapseCache* Cache = nullptr;
+		UMaterialInterface* Material = nullptr;
+
+		//破片のインスタンス（ホストアクタが持ち、mComponents でGCから守る）
+		UInstancedStaticMeshComponent* Component = nullptr;
+
+		//再生し終えた崩れのインスタンスの先頭番号（破片の数ずつ並ぶ）
+		TArray<int32> FreeBlocks;
+
+		//このフレームでインスタンスが変わったか
+		bool bDirty = false;
+	};
+
+	struct FPlayback
+	{
+		int32 Batch = INDEX_NONE;
+
+		//このバッチで使うインスタンスの先頭番号
+		int32 FirstInstance = INDEX_NONE;
+
+		//崩れ始めてからの時間
+		float Time = 0.0f;
+
+		FTransform FloorTransform;
+	};
+
+	TArray<FBatch> mBatches;
+	TArray<FPlayback> mPlaybacks;
+
+	//破片のトランスフォームの作業用（毎フレーム確保しない）
+	TArray<FTransform> mScratch;
+
+	//破片のインスタンスを持つアクタ
+	UPROPERTY()
+	TObjectPtr<AActor> mHost;
+
+	//バッチが持つコンポーネントをGCから守る
+	UPROPERTY()
+	TArray<TObjectPtr<UInstancedStaticMeshComponent>> mComponents;
+
+	//再生中の焼き込みをGCから守る
+	UPROPERTY()
+	TArray<TObjectPtr<UGimmickCollapseCache>> mCaches;
+};
@@ -0,0 +1,357 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GimmickConfig.h"
+#include "EngineUtils.h"
+#include "GimmickCollapseCache.h"
+#include "GimmickMath.h"
+#include "GimmickTypes.h"
+#include "Gimmck_MoveFloor.h"
+#include "Gimmick_Button.h"
+#include "Gimmick_FallFloor.h"
+#include "Engine/World.h"
+#include "UObject/GCObject.h"
+#include "UObject/UObjectGlobals.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogGimmickConfig, Log, All);
+
+namespace GimmickConfigPool
+{
+	void EnsureRegistered();
+
+	//同じ値の設定をまとめる表（値 → 1つだけ持つ設定、設定はアドレスが変わらないよう個別に確保する）
+	template <typename SettingsType>
+	struct TPool
+	{
+		const SettingsType* Intern(const SettingsType& Settings)
+		{
+			check(IsInGameThread());
+			EnsureRegistered();
+
+			if (const TUniquePtr<SettingsType>* Found = Entries.Find(Settings))
+			{
+				return Found->Get();
+			}
+
+			LLM_SCOPE_BYTAG(Gimmick);
+			return Entries.Add(Settings, MakeUnique<SettingsType>(Settings)).Get();
+		}
+
+		//設定が参照しているアセット（落ちる床の崩れる様子など）をGCに伝える
+		void AddReferencedObjects(FReferenceCollector& Collector)
+		{
+			for (TPair<SettingsType, TUniquePtr<SettingsType>>& Entry : Entries)
+			{
+				Collector.AddPropertyReferences(SettingsType::StaticStruct(), Entry.Value.Get());
+			}
+		}
+
+		TMap<SettingsType, TUniquePtr<SettingsType>> Entries;
+	};
+
+	TPool<FMoveFloorSettings> MoveFloors;
+	TPool<FButtonSettings> Buttons;
+	TPool<FFallFloorSettings> FallFloors;
+
+	uint32 EditSerial = 0;
+
+	/// @brief まとめた設定が参照しているアセットを、表にある間はGCから守る
+	class FReferences : public FGCObject
+	{
+	public:
+		virtual void AddReferencedObjects(FReferenceCollector& Collector) override
+		{
+			MoveFloors.AddReferencedObjects(Collector);
+			Buttons.AddReferencedObjects(Collector);
+			FallFloors.AddReferencedObjects(Collector);
+		}
+
+		virtual FString GetReferencerName() const override
+		{
+			return TEXT("GimmickConfigPool");
+		}
+	};
+
+	TUniquePtr<FReferences> References;
+
+	/// @brief 表を空にする（上書きを持つギミックは、編集回数が変わるので次に取得したときに作り直す）
+	void Purge()
+	{
+		MoveFloors.Entries.Empty();
+		Buttons.Entries.Empty();
+		FallFloors.Entries.Empty();
+		EditSerial++;
+	}
+
+	/// @brief 最初に使うときに、GCへの参照の報告と表を空にするタイミングを登録する
+	///        ワールドの後片付け（PIEの終了を含む）と、アセットの再読み込みで入れ替わったときに空にする
+	void EnsureRegistered()
+	{
+		if (References)
+		{
+			return;
+		}
+
+		References = MakeUnique<FReferences>();
+		FWorldDelegates::OnWorldCleanup.AddLambda([](UWorld* World, bool bSessionEnded, bool bCleanupResources)
+		{
+			if (World && World->IsGameWorld())
+			{
+				Purge();
+			}
+		});
+		FCoreUObjectDelegates::OnObjectsReplaced.AddLambda([](const TMap<UObject*, UObject*>& ReplacedObjects)
+		{
+			Purge();
+		});
+	}
+}
+
+uint32 GetTypeHash(const FMoveFloorSettings& Settings)
+{
+	uint32 Hash = GetTypeHash(static_cast<uint8>(Settings.Pattern));
+	Hash = HashCombineFast(Hash, GetTypeHash(Settings.Distance));
+	Hash = HashCombineFast(Hash, GetTypeHash(Settings.CustomOffset));
+	Hash = HashCombineFast(Hash, GetTypeHash(Settings.Speed));
+	return HashCombineFast(Hash, GetTypeHash(Settings.WaitTime));
+}
+
+uint32 GetTypeHash(const FButtonSettings& Settings)
+{
+	uint32 Hash = GetTypeHash(Settings.MoveDir);
+	Hash = HashCombineFast(Hash, GetTypeHash(Settings.MoveSpeed));
+	return HashCombineFast(Hash, GetTypeHash(Settings.bReturnToOriginal));
+}
+
+uint32 GetTypeHash(const FFallFloorSettings& Settings)
+{
+	uint32 Hash = GetTypeHash(Settings.RespawnDelay);
+	Hash = HashCombineFast(Hash, GetTypeHash(Settings.DeleteDelay));
+	Hash = HashCombineFast(Hash, GetTypeHash(Settings.ShakeAmplitude));
+	Hash = HashCombineFast(Hash, GetTypeHash(Settings.ShakeFrequency));
+	return HashCombineFast(Hash, GetTypeHash(Settings.CollapseCache));
+}
+
+/// @brief 動く床の移動パターンを GimmickMath の移動パターンに変える
+///        GimmickMath はエンジンに依存しないので同じ並びの別の列挙を持つ。並びに頼らず1つずつ対応させる
+/// @param Pattern 動く床の移動パターン
+/// @return GimmickMath の移動パターン
+GimmickMath::EFloorPattern GimmickConfig::ToMathPattern(EFloorMovementPattern Pattern)
+{
+	switch (Pattern)
+	{
+	case EFloorMovementPattern::Horizontal_X:	return GimmickMath::EFloorPattern::Horizontal_X;
+	case EFloorMovementPattern::Horizontal_Y:	return GimmickMath::EFloorPattern::Horizontal_Y;
+	case EFloorMovementPattern::Vertical_Z:		return GimmickMath::EFloorPattern::Vertical_Z;
+	case EFloorMovementPattern::Diagonal_XY:	return GimmickMath::EFloorPattern::Diagonal_XY;
+	case EFloorMovementPattern::Diagonal_XZ:	return GimmickMath::EFloorPattern::Diagonal_XZ;
+	case EFloorMovementPattern::Diagonal_YZ:	return GimmickMath::EFloorPattern::Diagonal_YZ;
+	case EFloorMovementPattern::Circle_XY:		return GimmickMath::EFloorPattern::Circle_XY;
+	case EFloorMovementPattern::Circle_XZ:		return GimmickMath::EFloorPattern::Circle_XZ;
+	case EFloorMovementPattern::Circle_YZ:		return GimmickMath::EFloorPattern::Circle_YZ;
+	case EFloorMovementPattern::Custom:			return GimmickMath::EFloorPattern::Custom;
+	}
+
+	checkNoEntry();
+	return GimmickMath::EFloorPattern::Custom;
+}
+
+/// @brief 上書きを適用する（動く床以外の項目は無視する）
+/// @param Override 上書き
+void FMoveFloorSettings::ApplyOverride(const FGimmickConfigOverride& Override)
+{
+	switch (Override.Param)
+	{
+	case EGimmickConfigParam::MovementPattern:	Pattern = Override.Pattern; break;
+	case EGimmickConfigParam::MoveDistance:		Distance = Override.Value; break;
+	case EGimmickConfigParam::CustomMoveOffset:	CustomOffset = Override.Vector; break;
+	case EGimmickConfigParam::MoveSpeed:		Speed = Override.Value; break;
+	case EGimmickConfigParam::WaitTime:			WaitTime = Override.Value; break;
+	default: break;
+	}
+}
+
+/// @brief 上書きを適用する（ボタン以外の項目は無視する）
+/// @param Override 上書き
+void FButtonSettings::ApplyOverride(const FGimmickConfigOverride& Override)
+{
+	switch (Override.Param)
+	{
+	case EGimmickConfigParam::DoorMoveDir:		MoveDir = Override.Vector; break;
+	case EGimmickConfigParam::DoorMoveSpeed:	MoveSpeed = Override.Value; break;
+	case EGimmickConfigParam::ReturnToOriginal:	bReturnToOriginal = Override.Value != 0.0f; break;
+	default: break;
+	}
+}
+
+/// @brief 上書きを適用する（落ちる床以外の項目は無視する）
+/// @param Override 上書き
+void FFallFloorSettings::ApplyOverride(const FGimmickConfigOverride& Override)
+{
+	switch (Override.Param)
+	{
+	case EGimmickConfigParam::RespawnDelay:		RespawnDelay = Override.Value; break;
+	case EGimmickConfigParam::DeleteDelay:		DeleteDelay = Override.Value; break;
+	case EGimmickConfigParam::ShakeAmplitude:	ShakeAmplitude = Override.Value; break;
+	case EGimmickConfigParam::ShakeFrequency:	ShakeFrequency = Override.Value; break;
+	default: break;
+	}
+}
+
+#if WITH_EDITOR
+void UGimmickMoveFloorConfig::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+	GimmickConfig::NotifyEdited();
+}
+
+void UGimmickButtonConfig::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+	GimmickConfig::NotifyEdited();
+}
+
+void UGimmickFallFloorConfig::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+	GimmickConfig::NotifyEdited();
+}
+
+void UGimmickConfigOverrides::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+	GimmickConfig::NotifyEdited();
+}
+#endif
+
+/// @brief 上書きを取得する（なければ作る）
+/// @param Owner 上書きを持つギミック（作った上書きの Outer になる）
+/// @param Overrides ギミックの上書きのプロパティ
+/// @return 上書き
+UGimmickConfigOverrides* UGimmickConfigOverrides::FindOrAdd(UObject* Owner, TObjectPtr<UGimmickConfigOverrides>& Overrides)
+{
+	if (!Overrides)
+	{
+		LLM_SCOPE_BYTAG(Gimmick);
+
+		//アーキタイプ（ブループリントのクラスの既定値など）の中に作る場合はフラグを引き継ぐ
+		Overrides = NewObject<UGimmickConfigOverrides>(Owner, NAME_None, Owner->GetMaskedFlags(RF_PropagateToSubObjects));
+	}
+	return Overrides;
+}
+
+/// @brief 数値の項目を上書きする
+/// @param Param 項目
+/// @param Value 値（真偽は 0 以外で true）
+void UGimmickConfigOverrides::Set(EGimmickConfigParam Param, float Value)
+{
+	FGimmickConfigOverride* Entry = mEntries.FindByPredicate([Param](const FGimmickConfigOverride& Other) { return Other.Param == Param; });
+	if (!Entry)
+	{
+		Entry = &mEntries.AddDefaulted_GetRef();
+		Entry->Param = Param;
+	}
+	Entry->Value = Value;
+	mResolved = nullptr;
+}
+
+/// @brief ベクトルの項目を上書きする
+/// @param Param 項目（カスタム移動量・ドアの移動方向）
+/// @param Vector 値
+void UGimmickConfigOverrides::Set(EGimmickConfigParam Param, const FVector& Vector)
+{
+	FGimmickConfigOverride* Entry = mEntries.FindByPredicate([Param](const FGimmickConfigOverride& Other) { return Other.Param == Param; });
+	if (!Entry)
+	{
+		Entry = &mEntries.AddDefaulted_GetRef();
+		Entry->Param = Param;
+	}
+	Entry->Vector = Vector;
+	mResolved = nullptr;
+}
+
+/// @brief 動く床の移動パターンを上書きする
+/// @param Pattern 移動パターン
+void UGimmickConfigOverrides::Set(EFloorMovementPattern Pattern)
+{
+	FGimmickConfigOverride* Entry = mEntries.FindByPredicate([](const FGimmickConfigOverride& Other) { return Other.Param == EGimmickConfigParam::MovementPattern; });
+	if (!Entry)
+	{
+		Entry = &mEntries.AddDefaulted_GetRef();
+		Entry->Param = EGimmickConfigParam::MovementPattern;
+	}
+	Entry->Pattern = Pattern;
+	mResolved = nullptr;
+}
+
+const FMoveFloorSettings* GimmickConfig::Intern(const FMoveFloorSettings& Settings)
+{
+	return GimmickConfigPool::MoveFloors.Intern(Settings);
+}
+
+const FButtonSettings* GimmickConfig::Intern(const FButtonSettings& Settings)
+{
+	return GimmickConfigPool::Buttons.Intern(Settings);
+}
+
+const FFallFloorSettings* GimmickConfig::Intern(const FFallFloorSettings& Settings)
+{
+	return GimmickConfigPool::FallFloors.Intern(Settings);
+}
+
+int32 GimmickConfig::NumInterned()
+{
+	return GimmickConfigPool::MoveFloors.Entries.Num() + GimmickConfigPool::Buttons.Entries.Num() + GimmickConfigPool::FallFloors.Entries.Num();
+}
+
+uint32 GimmickConfig::GetEditSerial()
+{
+	return GimmickConfigPool::EditSerial;
+}
+
+void GimmickConfig::NotifyEdited()
+{
+	GimmickConfigPool::EditSerial++;
+}
+
+//コンソールコマンド
+static FAutoConsoleCommandWithWorldAndArgs GGimmickConfigCommand(
+	TEXT("Gimmick.Config"),
+	TEXT("Print how many gimmicks share each config asset and how many carry per-instance overrides."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (!World)
+		{
+			return;
+		}
+
+		//共有設定（None = クラスの既定値）ごとの参照数
+		TMap<const UObject*, int32> Users;
+		int32 Gimmicks = 0;
+		int32 Overridden = 0;
+		auto Count = [&](const UObject* Config, const UGimmickConfigOverrides* Overrides)
+		{
+			Gimmicks++;
+			Users.FindOrAdd(Config)++;
+			Overridden += Overrides ? 1 : 0;
+		};
+
+		for (TActorIterator<AGimmck_MoveFloor> It(World); It; ++It)
+		{
+			Count(It->mConfig, It->mOverrides);
+		}
+		for (TActorIterator<AGimmick_Button> It(World); It; ++It)
+		{
+			Count(It->mConfig, It->mOverrides);
+		}
+		for (TActorIterator<AGimmick_FallFloor> It(World); It; ++It)
+		{
+			Count(It->mConfig, It->mOverrides);
+		}
+
+		UE_LOG(LogGimmickConfig, Display, TEXT("Gimmicks: %d, shared configs: %d, with overrides: %d, interned override results: %d"),
+			Gimmicks, Users.Num(), Overridden, GimmickConfig::NumInterned());
+		for (const TPair<const UObject*, int32>& User : Users)
+		{
+			UE_LOG(LogGimmickConfig, Display, TEXT("  %s: %d"), User.Key ? *User.Key->GetPathName() : TEXT("(class default)"), User.Value);
+		}
+	}));
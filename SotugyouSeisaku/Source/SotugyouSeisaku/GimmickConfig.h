@@ -0,0 +1,300 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "GimmickConfig.generated.h"
+
+struct FGimmickConfigOverride;
+class UGimmickCollapseCache;
+
+namespace GimmickMath
+{
+	enum class EFloorPattern : uint8;
+}
+
+//移動パターンの列挙型
+UENUM(BlueprintType)
+enum class EFloorMovementPattern : uint8
+{
+	Horizontal_X UMETA(DisplayName = "横移動 (X軸)"),
+	Horizontal_Y UMETA(DisplayName = "横移動 (Y軸)"),
+	Vertical_Z UMETA(DisplayName = "縦移動 (Z軸・上下)"),
+	Diagonal_XY UMETA(DisplayName = "斜め移動 (XY平面)"),
+	Diagonal_XZ UMETA(DisplayName = "斜め移動 (XZ平面)"),
+	Diagonal_YZ UMETA(DisplayName = "斜め移動 (YZ平面)"),
+	Circle_XY UMETA(DisplayName = "円運動 (XY平面)"),
+	Circle_XZ UMETA(DisplayName = "円運動 (XZ平面)"),
+	Circle_YZ UMETA(DisplayName = "円運動 (YZ平面)"),
+	Custom UMETA(DisplayName = "カスタム (手動設定)")
+};
+
+/// @brief 動く床の設定
+USTRUCT(BlueprintType)
+struct FMoveFloorSettings
+{
+	GENERATED_BODY()
+
+	//移動パターンの選択
+	UPROPERTY(EditAnywhere, Category = "Movement Settings")
+	EFloorMovementPattern Pattern = EFloorMovementPattern::Horizontal_Y;
+
+	//移動距離（パターンによって使い方が異なる）
+	UPROPERTY(EditAnywhere, Category = "Movement Settings", meta = (EditCondition = "Pattern != EFloorMovementPattern::Custom"))
+	float Distance = 500.0f;
+
+	//カスタム移動量（Customパターンの場合のみ使用）
+	UPROPERTY(EditAnywhere, Category = "Movement Settings", meta = (EditCondition = "Pattern == EFloorMovementPattern::Custom"))
+	FVector CustomOffset = FVector(0.0f, 500.0f, 0.0f);
+
+	//移動速度（cm/秒）
+	UPROPERTY(EditAnywhere, Category = "Movement Settings")
+	float Speed = 200.0f;
+
+	//到着時の待機時間（秒）※円運動では無視
+	UPROPERTY(EditAnywhere, Category = "Movement Settings", meta = (EditCondition = "Pattern != EFloorMovementPattern::Circle_XY && Pattern != EFloorMovementPattern::Circle_XZ && Pattern != EFloorMovementPattern::Circle_YZ"))
+	float WaitTime = 1.0f;
+
+	void ApplyOverride(const FGimmickConfigOverride& Override);
+
+	bool operator==(const FMoveFloorSettings& Other) const
+	{
+		return Pattern == Other.Pattern && Distance == Other.Distance && CustomOffset == Other.CustomOffset && Speed == Other.Speed && WaitTime == Other.WaitTime;
+	}
+};
+
+/// @brief ボタンの設定（押したときに動かすドア）
+USTRUCT(BlueprintType)
+struct FButtonSettings
+{
+	GENERATED_BODY()
+
+	//ブロックの移動方向（ローカル座標）
+	UPROPERTY(EditAnywhere, Category = "Button Settings")
+	FVector MoveDir = FVector(400.0f, 0.0f, 0.0f);
+
+	//移動速度（cm/秒）
+	UPROPERTY(EditAnywhere, Category = "Button Settings")
+	float MoveSpeed = 300.0f;
+
+	//ボタンを離したら元に戻すか
+	UPROPERTY(EditAnywhere, Category = "Button Settings")
+	bool bReturnToOriginal = true;
+
+	void ApplyOverride(const FGimmickConfigOverride& Override);
+
+	bool operator==(const FButtonSettings& Other) const
+	{
+		return MoveDir == Other.MoveDir && MoveSpeed == Other.MoveSpeed && bReturnToOriginal == Other.bReturnToOriginal;
+	}
+};
+
+/// @brief 落ちる床の設定
+USTRUCT(BlueprintType)
+struct FFallFloorSettings
+{
+	GENERATED_BODY()
+
+	//元に戻るまでの時間
+	UPROPERTY(EditAnywhere, Category = "Falling Floor")
+	float RespawnDelay = 0.0f;
+
+	//床削除までの時間
+	UPROPERTY(EditAnywhere, Category = "Falling Floor")
+	float DeleteDelay = 2.0f;
+
+	//揺れの強さ
+	UPROPERTY(EditAnywhere, Category = "Falling Floor")
+	float ShakeAmplitude = 5.0f;
+
+	//揺れの速さ
+	UPROPERTY(EditAnywhere, Category = "Falling Floor")
+	float ShakeFrequency = 20.0f;
+
+	//崩れる様子（床のメッシュごとに焼き込んだもの、未設定ならその場で消える）
+	UPROPERTY(EditAnywhere, Category = "Falling Floor")
+	TObjectPtr<UGimmickCollapseCache> CollapseCache;
+
+	void ApplyOverride(const FGimmickConfigOverride& Override);
+
+	bool operator==(const FFallFloorSettings& Other) const
+	{
+		return RespawnDelay == Other.RespawnDelay && DeleteDelay == Other.DeleteDelay && ShakeAmplitude == Other.ShakeAmplitude && ShakeFrequency == Other.ShakeFrequency
+			&& CollapseCache == Other.CollapseCache;
+	}
+};
+
+SOTUGYOUSEISAKU_API uint32 GetTypeHash(const FMoveFloorSettings& Settings);
+SOTUGYOUSEISAKU_API uint32 GetTypeHash(const FButtonSettings& Settings);
+SOTUGYOUSEISAKU_API uint32 GetTypeHash(const FFallFloorSettings& Settings);
+
+//個別に上書きできる設定項目
+UENUM(BlueprintType)
+enum class EGimmickConfigParam : uint8
+{
+	MovementPattern UMETA(DisplayName = "動く床: 移動パターン"),
+	MoveDistance UMETA(DisplayName = "動く床: 移動距離"),
+	CustomMoveOffset UMETA(DisplayName = "動く床: カスタム移動量"),
+	MoveSpeed UMETA(DisplayName = "動く床: 移動速度"),
+	WaitTime UMETA(DisplayName = "動く床: 待機時間"),
+	DoorMoveDir UMETA(DisplayName = "ボタン: ドアの移動方向"),
+	DoorMoveSpeed UMETA(DisplayName = "ボタン: ドアの移動速度"),
+	ReturnToOriginal UMETA(DisplayName = "ボタン: 離したら元に戻す"),
+	RespawnDelay UMETA(DisplayName = "落ちる床: 元に戻るまでの時間"),
+	DeleteDelay UMETA(DisplayName = "落ちる床: 削除までの時間"),
+	ShakeAmplitude UMETA(DisplayName = "落ちる床: 揺れの強さ"),
+	ShakeFrequency UMETA(DisplayName = "落ちる床: 揺れの速さ"),
+};
+
+/// @brief 設定項目1つの上書き（項目に合わせて Value / Vector / Pattern のどれかを使う）
+USTRUCT(BlueprintType)
+struct FGimmickConfigOverride
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, Category = "Override")
+	EGimmickConfigParam Param = EGimmickConfigParam::MoveSpeed;
+
+	//数値（真偽は 0 以外で true）
+	UPROPERTY(EditAnywhere, Category = "Override", meta = (EditCondition = "Param != EGimmickConfigParam::MovementPattern && Param != EGimmickConfigParam::CustomMoveOffset && Param != EGimmickConfigParam::DoorMoveDir", EditConditionHides))
+	float Value = 0.0f;
+
+	//ベクトル（カスタム移動量・ドアの移動方向）
+	UPROPERTY(EditAnywhere, Category = "Override", meta = (EditCondition = "Param == EGimmickConfigParam::CustomMoveOffset || Param == EGimmickConfigParam::DoorMoveDir", EditConditionHides))
+	FVector Vector = FVector::ZeroVector;
+
+	//移動パターン
+	UPROPERTY(EditAnywhere, Category = "Override", meta = (EditCondition = "Param == EGimmickConfigParam::MovementPattern", EditConditionHides))
+	EFloorMovementPattern Pattern = EFloorMovementPattern::Horizontal_Y;
+};
+
+/// @brief 動く床の共有設定
+///        同じ調整の床はこのアセットを参照し、アセットを直せば参照している床がまとめて変わる（実行中は読み取り専用）
+UCLASS(BlueprintType)
+class SOTUGYOUSEISAKU_API UGimmickMoveFloorConfig : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
+
+	UPROPERTY(EditAnywhere, Category = "Settings", meta = (ShowOnlyInnerProperties))
+	FMoveFloorSettings mSettings;
+};
+
+/// @brief ボタンの共有設定
+UCLASS(BlueprintType)
+class SOTUGYOUSEISAKU_API UGimmickButtonConfig : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
+
+	UPROPERTY(EditAnywhere, Category = "Settings", meta = (ShowOnlyInnerProperties))
+	FButtonSettings mSettings;
+};
+
+/// @brief 落ちる床の共有設定
+UCLASS(BlueprintType)
+class SOTUGYOUSEISAKU_API UGimmickFallFloorConfig : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
+
+	UPROPERTY(EditAnywhere, Category = "Settings", meta = (ShowOnlyInnerProperties))
+	FFallFloorSettings mSettings;
+};
+
+/// @brief ギミック1個だけの設定の上書き（上書きするギミックだけが持つ）
+///        共有設定に上書きを適用した結果は同じ値どうしで1つにまとめて持つ（GimmickConfig::Intern）
+UCLASS(EditInlineNew)
+class SOTUGYOUSEISAKU_API UGimmickConfigOverrides : public UObject
+{
+	GENERATED_BODY()
+
+public:
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
+
+	//上書きを取得する（なければ Owner の中に作る）
+	static UGimmickConfigOverrides* FindOrAdd(UObject* Owner, TObjectPtr<UGimmickConfigOverrides>& Overrides);
+
+	//項目を上書きする（同じ項目があれば置き換える）
+	void Set(EGimmickConfigParam Param, float Value);
+	void Set(EGimmickConfigParam Param, const FVector& Vector);
+	void Set(EFloorMovementPattern Pattern);
+
+	/// @brief 共有設定に上書きを適用した設定を取得する（共有設定が変わるまで結果を使い回す）
+	/// @param Shared 共有設定
+	/// @return 上書きを適用した設定
+	template <typename SettingsType>
+	const SettingsType& Apply(const SettingsType& Shared) const;
+
+	UPROPERTY(EditAnywhere, Category = "Override", meta = (TitleProperty = "Param"))
+	TArray<FGimmickConfigOverride> mEntries;
+
+private:
+	//前回の結果と、そのときの共有設定・編集回数
+	mutable const void* mResolved = nullptr;
+	mutable const void* mResolvedFrom = nullptr;
+	mutable uint32 mResolvedSerial = 0;
+};
+
+/// @brief 共有設定の取得と、同じ値の設定を1つにまとめる処理
+namespace GimmickConfig
+{
+	//同じ値の設定を1つにまとめる（戻り値はゲームのワールドが片付けられるか、アセットが再読み込みされるまで有効）
+	SOTUGYOUSEISAKU_API const FMoveFloorSettings* Intern(const FMoveFloorSettings& Settings);
+	SOTUGYOUSEISAKU_API const FButtonSettings* Intern(const FButtonSettings& Settings);
+	SOTUGYOUSEISAKU_API const FFallFloorSettings* Intern(const FFallFloorSettings& Settings);
+
+	//動く床の移動パターンを GimmickMath の移動パターンに変える（アクタからの計算は必ずこれを通す）
+	SOTUGYOUSEISAKU_API GimmickMath::EFloorPattern ToMathPattern(EFloorMovementPattern Pattern);
+
+	//まとめた設定の数（動く床・ボタン・落ちる床の合計）
+	SOTUGYOUSEISAKU_API int32 NumInterned();
+
+	//共有設定・上書きが編集された回数（上書きを適用した結果を作り直すのに使う）
+	SOTUGYOUSEISAKU_API uint32 GetEditSerial();
+	SOTUGYOUSEISAKU_API void NotifyEdited();
+
+	/// @brief ギミックが実際に使う設定を求める
+	/// @param Config 共有設定（未設定ならクラスの既定値）
+	/// @param Overrides 個別の上書き（なければ共有設定をそのまま返す）
+	/// @return 設定
+	template <typename ConfigType>
+	const auto& Resolve(const ConfigType* Config, const UGimmickConfigOverrides* Overrides)
+	{
+		const auto& Shared = (Config ? Config : GetDefault<ConfigType>())->mSettings;
+		return Overrides ? Overrides->Apply(Shared) : Shared;
+	}
+}
+
+template <typename SettingsType>
+const SettingsType& UGimmickConfigOverrides::Apply(const SettingsType& Shared) const
+{
+	const uint32 Serial = GimmickConfig::GetEditSerial();
+	if (mResolvedFrom != &Shared || mResolvedSerial != Serial || !mResolved)
+	{
+		SettingsType Settings = Shared;
+		for (const FGimmickConfigOverride& Entry : mEntries)
+		{
+			Settings.ApplyOverride(Entry);
+		}
+		mResolved = GimmickConfig::Intern(Settings);
+		mResolvedFrom = &Shared;
+		mResolvedSerial = Serial;
+	}
+	return *static_cast<const SettingsType*>(mResolved);
+}
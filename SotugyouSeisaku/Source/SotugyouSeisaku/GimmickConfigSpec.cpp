@@ -0,0 +1,149 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GimmickBenchmarkFixture.h"
+#include "Gimmck_MoveFloor.h"
+#include "Gimmick_Button.h"
+#include "Gimmick_FallFloor.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+/// @brief 共有設定（UGimmick*Config）と個別の上書き（UGimmickConfigOverrides）の自動テスト
+///        ギミックが使う設定が共有設定に上書きを適用したものになるか、共有設定を直すと参照しているギミックがまとめて変わるかを確かめる
+///        （メモリとマップに書き出す大きさの比較は -run=GimmickBenchmark -Suite=Config）
+BEGIN_DEFINE_SPEC(FGimmickConfigSpec, "SotugyouSeisaku.Gimmick.Config", EAutomationTestFlags_ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+	UWorld* World = nullptr;
+	int32 NextIndex = 0;
+
+	/// @brief 共有設定と上書きを持たせてギミックを生成する
+	/// @param Config 共有設定（nullptr ならクラスの既定値）
+	/// @param Override 上書き（nullptr なら上書きしない）
+	template <typename ActorType, typename ConfigType>
+	ActorType* SpawnConfigured(ConfigType* Config, const FGimmickConfigOverride* Override)
+	{
+		return GimmickBenchmark::SpawnWithMesh<ActorType>(World, FTransform(GimmickBenchmark::GridLocation(NextIndex++)), [Config, Override](ActorType& Actor)
+		{
+			Actor.mConfig = Config;
+			if (Override)
+			{
+				UGimmickConfigOverrides::FindOrAdd(&Actor, Actor.mOverrides)->mEntries.Add(*Override);
+			}
+		});
+	}
+
+	/// @brief 共有設定と上書きを持たせて生成したギミックの設定が、共有設定に上書きを適用したものと一致するかを確かめる
+	template <typename ActorType, typename ConfigType>
+	void TestResolves(const TCHAR* What, ConfigType* Config, const FGimmickConfigOverride* Override)
+	{
+		const ActorType* Actor = SpawnConfigured<ActorType>(Config, Override);
+		auto Expected = (Config ? Config : GetDefault<ConfigType>())->mSettings;
+		if (Override)
+		{
+			Expected.ApplyOverride(*Override);
+		}
+		TestTrue(What, Actor->GetSettings() == Expected);
+	}
+
+	static FGimmickConfigOverride MakeOverride(EGimmickConfigParam Param, float Value)
+	{
+		FGimmickConfigOverride Override;
+		Override.Param = Param;
+		Override.Value = Value;
+		return Override;
+	}
+
+END_DEFINE_SPEC(FGimmickConfigSpec)
+
+void FGimmickConfigSpec::Define()
+{
+	BeforeEach([this]()
+	{
+		World = GimmickBenchmark::CreateBenchmarkWorld(TEXT("ConfigSpec"));
+		NextIndex = 0;
+	});
+
+	AfterEach([this]()
+	{
+		GimmickBenchmark::DestroyBenchmarkWorld(World);
+		World = nullptr;
+	});
+
+	Describe("GetSettings", [this]()
+	{
+		It("uses the class defaults when no shared config is set", [this]()
+		{
+			TestResolves<AGimmck_MoveFloor, UGimmickMoveFloorConfig>(TEXT("move floor"), nullptr, nullptr);
+			TestResolves<AGimmick_Button, UGimmickButtonConfig>(TEXT("button"), nullptr, nullptr);
+			TestResolves<AGimmick_FallFloor, UGimmickFallFloorConfig>(TEXT("fall floor"), nullptr, nullptr);
+		});
+
+		It("uses the shared config and applies the gimmick's own override on top", [this]()
+		{
+			UGimmickMoveFloorConfig* FloorConfig = NewObject<UGimmickMoveFloorConfig>(World);
+			FloorConfig->mSettings.Pattern = EFloorMovementPattern::Vertical_Z;
+			FloorConfig->mSettings.Distance = 300.0f;
+			FloorConfig->mSettings.Speed = 150.0f;
+			FloorConfig->mSettings.WaitTime = 0.5f;
+
+			UGimmickButtonConfig* ButtonConfig = NewObject<UGimmickButtonConfig>(World);
+			ButtonConfig->mSettings.MoveDir = FVector(0.0f, 250.0f, 0.0f);
+			ButtonConfig->mSettings.MoveSpeed = 225.0f;
+			ButtonConfig->mSettings.bReturnToOriginal = false;
+
+			UGimmickFallFloorConfig* FallFloorConfig = NewObject<UGimmickFallFloorConfig>(World);
+			FallFloorConfig->mSettings.DeleteDelay = 1.25f;
+			FallFloorConfig->mSettings.RespawnDelay = 2.5f;
+			FallFloorConfig->mSettings.ShakeAmplitude = 4.0f;
+
+			const FGimmickConfigOverride WaitTime = MakeOverride(EGimmickConfigParam::WaitTime, 0.35f);
+			const FGimmickConfigOverride DoorMoveSpeed = MakeOverride(EGimmickConfigParam::DoorMoveSpeed, 650.0f);
+			const FGimmickConfigOverride DeleteDelay = MakeOverride(EGimmickConfigParam::DeleteDelay, 0.45f);
+
+			TestResolves<AGimmck_MoveFloor>(TEXT("shared move floor"), FloorConfig, nullptr);
+			TestResolves<AGimmck_MoveFloor>(TEXT("overridden move floor"), FloorConfig, &WaitTime);
+			TestResolves<AGimmick_Button>(TEXT("shared button"), ButtonConfig, nullptr);
+			TestResolves<AGimmick_Button>(TEXT("overridden button"), ButtonConfig, &DoorMoveSpeed);
+			TestResolves<AGimmick_FallFloor>(TEXT("shared fall floor"), FallFloorConfig, nullptr);
+			TestResolves<AGimmick_FallFloor>(TEXT("overridden fall floor"), FallFloorConfig, &DeleteDelay);
+		});
+
+		It("shares one resolved settings object between gimmicks with the same override", [this]()
+		{
+			UGimmickMoveFloorConfig* Config = NewObject<UGimmickMoveFloorConfig>(World);
+			const FGimmickConfigOverride WaitTime = MakeOverride(EGimmickConfigParam::WaitTime, 0.35f);
+
+			const AGimmck_MoveFloor* SharedA = SpawnConfigured<AGimmck_MoveFloor>(Config, nullptr);
+			const AGimmck_MoveFloor* SharedB = SpawnConfigured<AGimmck_MoveFloor>(Config, nullptr);
+			const AGimmck_MoveFloor* OverriddenA = SpawnConfigured<AGimmck_MoveFloor>(Config, &WaitTime);
+			const AGimmck_MoveFloor* OverriddenB = SpawnConfigured<AGimmck_MoveFloor>(Config, &WaitTime);
+
+			TestTrue(TEXT("floors without overrides read the shared config"), &SharedA->GetSettings() == &Config->mSettings && &SharedB->GetSettings() == &Config->mSettings);
+			TestTrue(TEXT("floors with the same override share the resolved settings"), &OverriddenA->GetSettings() == &OverriddenB->GetSettings());
+		});
+	});
+
+	Describe("Editing a shared config", [this]()
+	{
+		It("reaches every gimmick that references it and keeps their overrides", [this]()
+		{
+			UGimmickMoveFloorConfig* Config = NewObject<UGimmickMoveFloorConfig>(World);
+			const FGimmickConfigOverride WaitTime = MakeOverride(EGimmickConfigParam::WaitTime, 0.35f);
+			const AGimmck_MoveFloor* Shared = SpawnConfigured<AGimmck_MoveFloor>(Config, nullptr);
+			const AGimmck_MoveFloor* Overridden = SpawnConfigured<AGimmck_MoveFloor>(Config, &WaitTime);
+
+			//先に一度求めておき、使い回している結果が作り直されることも確かめる
+			TestEqual(TEXT("overridden speed before editing"), Overridden->GetSettings().Speed, Config->mSettings.Speed);
+
+			//エディタで編集したときと同じく編集を知らせる
+			Config->mSettings.Speed *= 2.0f;
+			GimmickConfig::NotifyEdited();
+
+			TestEqual(TEXT("shared speed"), Shared->GetSettings().Speed, Config->mSettings.Speed);
+			TestEqual(TEXT("overridden speed"), Overridden->GetSettings().Speed, Config->mSettings.Speed);
+			TestEqual(TEXT("overridden wait time"), Overridden->GetSettings().WaitTime, WaitTime.Value);
+		});
+	});
+}
+
+#endif
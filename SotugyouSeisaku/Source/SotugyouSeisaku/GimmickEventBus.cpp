@@ -0,0 +1,143 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GimmickEventBus.h"
+#include "GameFramework/Actor.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/ScopeLock.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogGimmickEventBus, Log, All);
+
+static FAutoConsoleCommand GGimmickEventBusStatsCommand(
+	TEXT("Gimmick.EventBus.Stats"),
+	TEXT("Print gimmick event bus consumers and dropped event counts."),
+	FConsoleCommandDelegate::CreateLambda([]()
+	{
+		FGimmickEventBus::Get().LogStats();
+	}));
+
+/// @brief バスを取得する
+FGimmickEventBus& FGimmickEventBus::Get()
+{
+	static FGimmickEventBus Bus;
+	return Bus;
+}
+
+/// @brief 消費者を登録する
+/// @param Name 表示名
+/// @param Capacity キューの容量
+/// @return 消費者の番号（空きがなければ INDEX_NONE）
+int32 FGimmickEventBus::AddConsumer(const FString& Name, uint32 Capacity)
+{
+	LLM_SCOPE_BYTAG(Gimmick_Events);
+
+	FScopeLock Lock(&mRegisterLock);
+
+	//登録を解除された消費者のキューを先に使い回す（キューは積む側が触っている可能性があるので解放しない）
+	const int32 NumSlots = mNumSlots.load(std::memory_order_relaxed);
+	for (int32 i = 0; i < NumSlots; i++)
+	{
+		FConsumer& Entry = mConsumers[i];
+		if (!Entry.bActive.load(std::memory_order_relaxed) && Entry.Queue->GetCapacity() >= Capacity)
+		{
+			//前の消費者の残りを捨ててから有効にする
+			FGimmickBusEvent Discard;
+			while (Entry.Queue->Pop(Discard))
+			{
+			}
+			Entry.Name = Name;
+			Entry.Dropped.store(0, std::memory_order_relaxed);
+			Entry.bActive.store(true, std::memory_order_release);
+			return i;
+		}
+	}
+
+	if (NumSlots >= MaxConsumers)
+	{
+		UE_LOG(LogGimmickEventBus, Warning, TEXT("Too many event bus consumers, %s is not registered"), *Name);
+		return INDEX_NONE;
+	}
+
+	FConsumer& Entry = mConsumers[NumSlots];
+	Entry.Queue = MakeUnique<TGimmickMpmcQueue<FGimmickBusEvent>>(Capacity);
+	Entry.Name = Name;
+	Entry.bActive.store(true, std::memory_order_relaxed);
+
+	//キューを作り終えてから積む側に見せる
+	mNumSlots.store(NumSlots + 1, std::memory_order_release);
+	return NumSlots;
+}
+
+/// @brief 消費者の登録を解除する
+/// @param Consumer 消費者の番号
+void FGimmickEventBus::RemoveConsumer(int32 Consumer)
+{
+	if (Consumer == INDEX_NONE)
+	{
+		return;
+	}
+
+	FScopeLock Lock(&mRegisterLock);
+	mConsumers[Consumer].bActive.store(false, std::memory_order_release);
+}
+
+/// @brief ギミックのイベントを全ての消費者に積む
+/// @param Type イベントの種類
+/// @param Gimmick イベントを発生させたギミック
+void FGimmickEventBus::Push(EGimmickEventType Type, const AActor* Gimmick)
+{
+	LLM_SCOPE_BYTAG(Gimmick_Events);
+
+	//誰も受け取らないならイベントも作らない
+	if (mNumSlots.load(std::memory_order_acquire) == 0)
+	{
+		return;
+	}
+
+	FGimmickBusEvent Event;
+	Event.Type = Type;
+	Event.Cycles = FPlatformTime::Cycles64();
+	if (Gimmick)
+	{
+		Event.Gimmick = FObjectKey(Gimmick);
+		Event.World = FObjectKey(Gimmick->GetWorld());
+		Event.Location = FVector3f(Gimmick->GetActorLocation());
+	}
+	Push(Event);
+}
+
+/// @brief イベントを全ての消費者に積む
+/// @param Event 積むイベント
+void FGimmickEventBus::Push(const FGimmickBusEvent& Event)
+{
+	LLM_SCOPE_BYTAG(Gimmick_Events);
+
+	const int32 NumSlots = mNumSlots.load(std::memory_order_acquire);
+	for (int32 i = 0; i < NumSlots; i++)
+	{
+		FConsumer& Entry = mConsumers[i];
+		if (!Entry.bActive.load(std::memory_order_acquire))
+		{
+			continue;
+		}
+
+		//満杯なら待たずに捨てる（消費者の取り出しが追いついていない）
+		if (!Entry.Queue->Push(Event))
+		{
+			Entry.Dropped.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+}
+
+/// @brief 統計をログに出す
+void FGimmickEventBus::LogStats() const
+{
+	const int32 NumSlots = mNumSlots.load(std::memory_order_acquire);
+	UE_LOG(LogGimmickEventBus, Display, TEXT("Gimmick event bus: %d consumer slots (max %d)"), NumSlots, MaxConsumers);
+	for (int32 i = 0; i < NumSlots; i++)
+	{
+		const FConsumer& Entry = mConsumers[i];
+		UE_LOG(LogGimmickEventBus, Display, TEXT("  [%d] %-24s %s capacity=%u dropped=%llu"),
+			i, *Entry.Name, Entry.bActive.load(std::memory_order_relaxed) ? TEXT("active  ") : TEXT("inactive"),
+			Entry.Queue->GetCapacity(), Entry.Dropped.load(std::memory_order_relaxed));
+	}
+}
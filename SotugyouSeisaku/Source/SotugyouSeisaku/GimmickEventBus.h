@@ -0,0 +1,199 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/ObjectKey.h"
+#include "GimmickTypes.h"
+#include <atomic>
+
+/// @brief バスに流すギミックのイベント（コピーだけで受け渡せる小さな値）
+struct FGimmickBusEvent
+{
+	EGimmickEventType Type = EGimmickEventType::Count;
+
+	//イベントを発生させたギミックとそのワールド（取り出した側でゲームスレッドから ResolveObjectPtr する）
+	FObjectKey Gimmick;
+	FObjectKey World;
+
+	//発生時のギミックの位置
+	FVector3f Location = FVector3f::ZeroVector;
+
+	//発生時刻（FPlatformTime::Cycles64）
+	uint64 Cycles = 0;
+};
+
+/// @brief 容量固定のロックフリーなキュー（複数スレッドから積み、複数スレッドから取り出せる）
+///        各要素に通し番号を持たせるリングバッファで、積む・取り出すはどちらもCAS 1回で済む。満杯なら積まずに false を返す
+template<typename T>
+class TGimmickMpmcQueue
+{
+public:
+	/// @param InCapacity 容量（2のべき乗に切り上げる）
+	explicit TGimmickMpmcQueue(uint32 InCapacity)
+		: mCapacity(FMath::RoundUpToPowerOfTwo(FMath::Max(InCapacity, 2u)))
+		, mMask(mCapacity - 1)
+		, mCells(MakeUnique<FCell[]>(mCapacity))
+	{
+		for (uint32 i = 0; i < mCapacity; i++)
+		{
+			mCells[i].Sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	TGimmickMpmcQueue(const TGimmickMpmcQueue&) = delete;
+	TGimmickMpmcQueue& operator=(const TGimmickMpmcQueue&) = delete;
+
+	/// @brief 要素を積む
+	/// @return 満杯で積めなかったら false
+	bool Push(const T& Item)
+	{
+		FCell* Cell = nullptr;
+		uint64 Pos = mEnqueuePos.load(std::memory_order_relaxed);
+		while (true)
+		{
+			Cell = &mCells[Pos & mMask];
+			const int64 Diff = static_cast<int64>(Cell->Sequence.load(std::memory_order_acquire)) - static_cast<int64>(Pos);
+			if (Diff == 0)
+			{
+				if (mEnqueuePos.compare_exchange_weak(Pos, Pos + 1, std::memory_order_relaxed))
+				{
+					break;
+				}
+			}
+			else if (Diff < 0)
+			{
+				return false;
+			}
+			else
+			{
+				Pos = mEnqueuePos.load(std::memory_order_relaxed);
+			}
+		}
+
+		Cell->Data = Item;
+		Cell->Sequence.store(Pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	/// @brief 要素を取り出す
+	/// @return 空なら false
+	bool Pop(T& OutItem)
+	{
+		FCell* Cell = nullptr;
+		uint64 Pos = mDequeuePos.load(std::memory_order_relaxed);
+		while (true)
+		{
+			Cell = &mCells[Pos & mMask];
+			const int64 Diff = static_cast<int64>(Cell->Sequence.load(std::memory_order_acquire)) - static_cast<int64>(Pos + 1);
+			if (Diff == 0)
+			{
+				if (mDequeuePos.compare_exchange_weak(Pos, Pos + 1, std::memory_order_relaxed))
+				{
+					break;
+				}
+			}
+			else if (Diff < 0)
+			{
+				return false;
+			}
+			else
+			{
+				Pos = mDequeuePos.load(std::memory_order_relaxed);
+			}
+		}
+
+		OutItem = Cell->Data;
+		Cell->Sequence.store(Pos + mCapacity, std::memory_order_release);
+		return true;
+	}
+
+	uint32 GetCapacity() const { return mCapacity; }
+
+private:
+	struct FCell
+	{
+		std::atomic<uint64> Sequence{ 0 };
+		T Data;
+	};
+
+	const uint32 mCapacity;
+	const uint32 mMask;
+	TUniquePtr<FCell[]> mCells;
+
+	//積む側と取り出す側が同じキャッシュラインを奪い合わないように離す
+	alignas(PLATFORM_CACHE_LINE_SIZE) std::atomic<uint64> mEnqueuePos{ 0 };
+	alignas(PLATFORM_CACHE_LINE_SIZE) std::atomic<uint64> mDequeuePos{ 0 };
+};
+
+/// @brief ギミックのイベントを音・エフェクト・UIなどの消費者に配るバス
+///
+///        ギミックは GimmickEvents::Emit から小さな値のイベントを消費者ごとのロックフリーキューに積むだけで、
+///        デリゲートの呼び出しもUObjectの検索も1件ごとのメモリ確保もしない。
+///        消費者は自分の都合のよい場所（ゲームスレッドのTick、オーディオスレッド、タスクグラフなど）でまとめて取り出す。
+///        キューが満杯のときは新しいイベントを捨てて数える（ゲーム側は待たない）。
+///
+///        コンソールコマンド: Gimmick.EventBus.Stats
+class SOTUGYOUSEISAKU_API FGimmickEventBus
+{
+public:
+	//登録できる消費者の数
+	static constexpr int32 MaxConsumers = 8;
+
+	static FGimmickEventBus& Get();
+
+	/// @brief 消費者を登録する（ゲームスレッドから呼ぶ）
+	/// @param Name 表示名
+	/// @param Capacity キューの容量（1フレームに積まれる数より十分大きくする）
+	/// @return 消費者の番号（空きがなければ INDEX_NONE）
+	int32 AddConsumer(const FString& Name, uint32 Capacity = 4096);
+
+	//消費者の登録を解除する（キューは次に登録する消費者が使い回す）
+	void RemoveConsumer(int32 Consumer);
+
+	//イベントを全ての消費者に積む（どのスレッドからでもよい）
+	void Push(EGimmickEventType Type, const AActor* Gimmick);
+	void Push(const FGimmickBusEvent& Event);
+
+	/// @brief 消費者のキューからまとめて取り出す（消費者ごとに決めたスレッドから呼ぶ）
+	/// @param Consumer 消費者の番号
+	/// @param Visit 取り出したイベントごとに呼ぶ処理
+	/// @param MaxCount 今回取り出す最大数
+	/// @return 取り出した数
+	template<typename FuncType>
+	int32 Drain(int32 Consumer, FuncType&& Visit, int32 MaxCount = MAX_int32)
+	{
+		FConsumer& Entry = mConsumers[Consumer];
+		FGimmickBusEvent Event;
+		int32 Count = 0;
+		while (Count < MaxCount && Entry.Queue->Pop(Event))
+		{
+			Visit(Event);
+			Count++;
+		}
+		return Count;
+	}
+
+	//満杯で捨てたイベントの数
+	uint64 GetDropped(int32 Consumer) const { return mConsumers[Consumer].Dropped.load(std::memory_order_relaxed); }
+
+	//統計をログに出す
+	void LogStats() const;
+
+private:
+	struct FConsumer
+	{
+		TUniquePtr<TGimmickMpmcQueue<FGimmickBusEvent>> Queue;
+		std::atomic<bool> bActive{ false };
+		std::atomic<uint64> Dropped{ 0 };
+		FString Name;
+	};
+
+	FConsumer mConsumers[MaxConsumers];
+
+	//キューを作った消費者の数（積む側はここまでを見る）
+	std::atomic<int32> mNumSlots{ 0 };
+
+	//登録・解除どうしの排他（積む・取り出すには使わない）
+	FCriticalSection mRegisterLock;
+};
@@ -0,0 +1,223 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GimmickEventBus.h"
+#include "Async/ParallelFor.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+/// @brief ロックフリーなキュー（TGimmickMpmcQueue）とイベントバス（FGimmickEventBus）の自動テスト
+///        複数スレッドから積んだ値が欠けも重複もなく取り出せるか、満杯のときに積まずに数えるかを確かめる
+///        （1件あたりの処理時間は -run=GimmickBenchmark -Suite=EventBus）
+BEGIN_DEFINE_SPEC(FGimmickEventBusSpec, "SotugyouSeisaku.Gimmick.EventBus", EAutomationTestFlags_ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+	//積むスレッドの数と、1スレッドが積む数
+	static constexpr int32 ProducerCount = 4;
+	static constexpr int32 PushesPerProducer = 20000;
+	static constexpr int32 TotalPushes = ProducerCount * PushesPerProducer;
+
+	//テスト用の消費者のキューの容量（全部積んでも満杯にならない）
+	static constexpr uint32 BusCapacity = 1u << 17;
+
+	/// @brief 値が0からTotalPushes-1までちょうど1回ずつ現れたかを確かめる
+	void TestEachOnce(const TCHAR* What, const TArray<uint64>& Values)
+	{
+		TBitArray<> Seen(false, TotalPushes);
+		int32 Duplicates = 0;
+		int32 OutOfRange = 0;
+		for (const uint64 Value : Values)
+		{
+			if (Value >= static_cast<uint64>(TotalPushes))
+			{
+				OutOfRange++;
+			}
+			else if (Seen[static_cast<int32>(Value)])
+			{
+				Duplicates++;
+			}
+			else
+			{
+				Seen[static_cast<int32>(Value)] = true;
+			}
+		}
+
+		TestEqual(FString::Printf(TEXT("%s: values"), What), Values.Num(), TotalPushes);
+		TestEqual(FString::Printf(TEXT("%s: duplicated values"), What), Duplicates, 0);
+		TestEqual(FString::Printf(TEXT("%s: unknown values"), What), OutOfRange, 0);
+	}
+
+	/// @brief 通し番号を発生時刻の代わりに入れたイベント
+	static FGimmickBusEvent MakeEvent(uint64 Value)
+	{
+		FGimmickBusEvent Event;
+		Event.Type = EGimmickEventType::MoveFloorArrived;
+		Event.Cycles = Value;
+		return Event;
+	}
+
+END_DEFINE_SPEC(FGimmickEventBusSpec)
+
+void FGimmickEventBusSpec::Define()
+{
+	Describe("TGimmickMpmcQueue", [this]()
+	{
+		It("rounds the capacity up to a power of two", [this]()
+		{
+			TestEqual(TEXT("capacity of 100"), static_cast<int32>(TGimmickMpmcQueue<int32>(100).GetCapacity()), 128);
+			TestEqual(TEXT("capacity of 64"), static_cast<int32>(TGimmickMpmcQueue<int32>(64).GetCapacity()), 64);
+		});
+
+		It("pops in push order and refuses to push when full", [this]()
+		{
+			TGimmickMpmcQueue<int32> Queue(16);
+			for (int32 i = 0; i < 16; i++)
+			{
+				TestTrue(FString::Printf(TEXT("push %d"), i), Queue.Push(i));
+			}
+			TestFalse(TEXT("push when full"), Queue.Push(16));
+
+			int32 Value = INDEX_NONE;
+			for (int32 i = 0; i < 16; i++)
+			{
+				TestTrue(FString::Printf(TEXT("pop %d"), i), Queue.Pop(Value));
+				TestEqual(TEXT("popped value"), Value, i);
+			}
+			TestFalse(TEXT("pop when empty"), Queue.Pop(Value));
+
+			//一周した後も使える
+			TestTrue(TEXT("push after wrapping"), Queue.Push(42));
+			TestTrue(TEXT("pop after wrapping"), Queue.Pop(Value));
+			TestEqual(TEXT("value after wrapping"), Value, 42);
+		});
+
+		It("hands every value pushed from several threads to exactly one popping thread", [this]()
+		{
+			TGimmickMpmcQueue<uint64> Queue(TotalPushes);
+
+			//積むスレッドがそれぞれ積みながら取り出しもする（取り出す側も複数スレッドになる）
+			TArray<TArray<uint64>> PoppedPerTask;
+			PoppedPerTask.SetNum(ProducerCount);
+			std::atomic<int32> FailedPushes{ 0 };
+			ParallelFor(ProducerCount, [&Queue, &PoppedPerTask, &FailedPushes](int32 Producer)
+			{
+				TArray<uint64>& Popped = PoppedPerTask[Producer];
+				uint64 Value = 0;
+				for (int32 i = 0; i < PushesPerProducer; i++)
+				{
+					if (!Queue.Push(static_cast<uint64>(Producer) * PushesPerProducer + i))
+					{
+						FailedPushes++;
+					}
+					if ((i & 1) && Queue.Pop(Value))
+					{
+						Popped.Add(Value);
+					}
+				}
+			});
+
+			TArray<uint64> Values;
+			for (const TArray<uint64>& Popped : PoppedPerTask)
+			{
+				Values.Append(Popped);
+			}
+			uint64 Value = 0;
+			while (Queue.Pop(Value))
+			{
+				Values.Add(Value);
+			}
+
+			TestEqual(TEXT("failed pushes"), FailedPushes.load(), 0);
+			TestEachOnce(TEXT("popped"), Values);
+		});
+	});
+
+	Describe("FGimmickEventBus", [this]()
+	{
+		It("delivers every event pushed from several threads", [this]()
+		{
+			FGimmickEventBus& Bus = FGimmickEventBus::Get();
+			const int32 Consumer = Bus.AddConsumer(TEXT("EventBusSpec"), BusCapacity);
+			if (!TestNotEqual(TEXT("consumer"), Consumer, static_cast<int32>(INDEX_NONE)))
+			{
+				return;
+			}
+
+			ParallelFor(ProducerCount, [&Bus](int32 Producer)
+			{
+				for (int32 i = 0; i < PushesPerProducer; i++)
+				{
+					Bus.Push(MakeEvent(static_cast<uint64>(Producer) * PushesPerProducer + i));
+				}
+			});
+
+			TArray<uint64> Values;
+			const int32 Drained = Bus.Drain(Consumer, [&Values](const FGimmickBusEvent& Event) { Values.Add(Event.Cycles); });
+			TestEqual(TEXT("drained"), Drained, TotalPushes);
+			TestEqual(TEXT("dropped"), Bus.GetDropped(Consumer), 0ull);
+			TestEachOnce(TEXT("drained"), Values);
+
+			Bus.RemoveConsumer(Consumer);
+		});
+
+		It("drains at most the requested count and keeps the rest in order", [this]()
+		{
+			FGimmickEventBus& Bus = FGimmickEventBus::Get();
+			const int32 Consumer = Bus.AddConsumer(TEXT("EventBusSpec"), BusCapacity);
+			if (!TestNotEqual(TEXT("consumer"), Consumer, static_cast<int32>(INDEX_NONE)))
+			{
+				return;
+			}
+
+			for (int32 i = 0; i < 10; i++)
+			{
+				Bus.Push(MakeEvent(i));
+			}
+
+			TArray<uint64> Values;
+			const auto Collect = [&Values](const FGimmickBusEvent& Event) { Values.Add(Event.Cycles); };
+			TestEqual(TEXT("first drain"), Bus.Drain(Consumer, Collect, 4), 4);
+			TestEqual(TEXT("second drain"), Bus.Drain(Consumer, Collect), 6);
+			TestEqual(TEXT("drain when empty"), Bus.Drain(Consumer, Collect), 0);
+			TestEqual(TEXT("drained order"), Values, TArray<uint64>({ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 }));
+
+			Bus.RemoveConsumer(Consumer);
+		});
+
+		It("drops and counts events pushed while a consumer's queue is full", [this]()
+		{
+			FGimmickEventBus& Bus = FGimmickEventBus::Get();
+			const int32 Consumer = Bus.AddConsumer(TEXT("EventBusSpec"), BusCapacity);
+			if (!TestNotEqual(TEXT("consumer"), Consumer, static_cast<int32>(INDEX_NONE)))
+			{
+				return;
+			}
+
+			constexpr int32 Overflow = 100;
+			for (int32 i = 0; i < static_cast<int32>(BusCapacity) + Overflow; i++)
+			{
+				Bus.Push(MakeEvent(i));
+			}
+
+			//満杯になってから積んだものが捨てられ、先に積んだものは残る
+			uint64 Last = 0;
+			const int32 Drained = Bus.Drain(Consumer, [&Last](const FGimmickBusEvent& Event) { Last = Event.Cycles; });
+			TestEqual(TEXT("drained"), Drained, static_cast<int32>(BusCapacity));
+			TestEqual(TEXT("last drained"), Last, static_cast<uint64>(BusCapacity - 1));
+			TestEqual(TEXT("dropped"), Bus.GetDropped(Consumer), static_cast<uint64>(Overflow));
+
+			Bus.RemoveConsumer(Consumer);
+
+			//登録し直した消費者は前の残りも捨てた数も引き継がない
+			const int32 Reused = Bus.AddConsumer(TEXT("EventBusSpec"), BusCapacity);
+			if (TestNotEqual(TEXT("reused consumer"), Reused, static_cast<int32>(INDEX_NONE)))
+			{
+				TestEqual(TEXT("dropped after re-adding"), Bus.GetDropped(Reused), 0ull);
+				Bus.Push(MakeEvent(0));
+				TestEqual(TEXT("drained after re-adding"), Bus.Drain(Reused, [](const FGimmickBusEvent&) {}), 1);
+				Bus.RemoveConsumer(Reused);
+			}
+		});
+	});
+}
+
+#endif
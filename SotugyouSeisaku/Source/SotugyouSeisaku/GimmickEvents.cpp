@@ -0,0 +1,34 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GimmickEvents.h"
+#include "GimmickEventBus.h"
+#include "GameFramework/Actor.h"
+
+/// @brief 状態遷移の通知先を取得する
+FOnGimmickEvent& GimmickEvents::OnGimmickEvent()
+{
+	static FOnGimmickEvent Delegate;
+	return Delegate;
+}
+
+/// @brief ギミックの状態遷移を通知する
+/// @param Type イベントの種類
+/// @param Gimmick イベントを発生させたギミック
+void GimmickEvents::Emit(EGimmickEventType Type, const AActor* Gimmick)
+{
+	//サーバーでは、休止しているギミックを一度だけ起こして変わった状態を送る
+	if (Gimmick && Gimmick->GetIsReplicated() && Gimmick->NetDormancy > DORM_Awake && Gimmick->HasAuthority() && !Gimmick->IsNetMode(NM_Standalone))
+	{
+		const_cast<AActor*>(Gimmick)->FlushNetDormancy();
+	}
+
+	//演出（音・エフェクト・UI）向けにはバスに積むだけにして、取り出しは各消費者に任せる
+	FGimmickEventBus::Get().Push(Type, Gimmick);
+
+	//記録や手順の進行など、その場で受け取る必要があるものだけデリゲートで呼ぶ
+	FOnGimmickEvent& Delegate = OnGimmickEvent();
+	if (Delegate.IsBound())
+	{
+		Delegate.Broadcast(Type, Gimmick);
+	}
+}
@@ -0,0 +1,18 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GimmickTypes.h"
+
+//ギミックの状態遷移を受け取るデリゲート
+DECLARE_MULTICAST_DELEGATE_TwoParams(FOnGimmickEvent, EGimmickEventType, const AActor*);
+
+namespace GimmickEvents
+{
+	/// @brief 状態遷移の通知先（記録やデバッグ用）
+	SOTUGYOUSEISAKU_API FOnGimmickEvent& OnGimmickEvent();
+
+	/// @brief ギミックの状態遷移を通知する（FGimmickEventBus にも積む）
+	SOTUGYOUSEISAKU_API void Emit(EGimmickEventType Type, const AActor* Gimmick);
+}
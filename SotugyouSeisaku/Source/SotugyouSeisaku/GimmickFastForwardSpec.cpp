@@ -0,0 +1,124 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GimmickBenchmarkFixture.h"
+#include "GimmickSubsystem.h"
+#include "Gimmck_MoveFloor.h"
+#include "Gimmick_FallFloor.h"
+#include "EngineUtils.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+/// @brief 時間飛ばし（UGimmickSubsystem::AdvanceGimmicks）の自動テスト
+///        同じギミックを置いた2つのワールドを、1フレームずつTickする場合と時間を飛ばす場合で同じ時間だけ進め、結果が一致するかを確かめる
+///        （処理時間の比較は -run=GimmickBenchmark -Suite=FastForward）
+BEGIN_DEFINE_SPEC(FGimmickFastForwardSpec, "SotugyouSeisaku.Gimmick.FastForward", EAutomationTestFlags_ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+	//種類ごとのギミックの数（落ちる床の削除までの時間は10個で一巡する）
+	static constexpr int32 Count = 20;
+
+	UWorld* TickedWorld = nullptr;
+	UWorld* SkippedWorld = nullptr;
+
+	/// @brief 動く床の位置（生成した順）
+	static TArray<FVector> MoveFloorLocations(UWorld* World)
+	{
+		TArray<FVector> Locations;
+		for (TActorIterator<AGimmck_MoveFloor> It(World); It; ++It)
+		{
+			Locations.Add(It->GetActorLocation());
+		}
+		return Locations;
+	}
+
+	/// @brief 立っている落ちる床の数
+	static int32 NumStandingFallFloors(UWorld* World)
+	{
+		int32 Num = 0;
+		for (TActorIterator<AGimmick_FallFloor> It(World); It; ++It)
+		{
+			Num++;
+		}
+		return Num;
+	}
+
+	/// @brief 両方のワールドを Frames フレーム分進め、動く床の位置と落ちる床の数を比べる
+	/// @param Frames 進めるフレーム数
+	/// @param ElapsedSeconds 進めた後の開始からの秒数
+	/// @param ExpectedStanding 進めた後に立っているはずの落ちる床の数
+	void AdvanceAndCompare(int32 Frames, float ElapsedSeconds, int32 ExpectedStanding)
+	{
+		GimmickBenchmark::TickWorld(TickedWorld, Frames);
+		SkippedWorld->GetSubsystem<UGimmickSubsystem>()->AdvanceGimmicks(Frames * GimmickBenchmark::FrameDeltaTime);
+
+		TestEqual(FString::Printf(TEXT("standing fall floors after %.2f s (tick)"), ElapsedSeconds), NumStandingFallFloors(TickedWorld), ExpectedStanding);
+		TestEqual(FString::Printf(TEXT("standing fall floors after %.2f s (advance)"), ElapsedSeconds), NumStandingFallFloors(SkippedWorld), ExpectedStanding);
+
+		//1フレームずつTickすると、端に着いた後の待ち時間が次のフレームから数えられるので、往復するたびに最大1フレーム分ずれる
+		const FMoveFloorSettings& Settings = GetDefault<UGimmickMoveFloorConfig>()->mSettings;
+		const int32 Legs = FMath::CeilToInt(ElapsedSeconds / (Settings.Distance / Settings.Speed + Settings.WaitTime));
+		const float Tolerance = Settings.Speed * GimmickBenchmark::FrameDeltaTime * (Legs + 1) + 1.0f;
+
+		//同じ順に生成しているので、並びどおりに比べる
+		const TArray<FVector> Ticked = MoveFloorLocations(TickedWorld);
+		const TArray<FVector> Skipped = MoveFloorLocations(SkippedWorld);
+		if (!TestEqual(TEXT("moving floors"), Skipped.Num(), Ticked.Num()))
+		{
+			return;
+		}
+		float MaxError = 0.0f;
+		for (int32 i = 0; i < Ticked.Num(); i++)
+		{
+			MaxError = FMath::Max(MaxError, static_cast<float>(FVector::Dist(Ticked[i], Skipped[i])));
+		}
+		TestTrue(FString::Printf(TEXT("moving floor error after %.2f s is %.2f cm (tolerance %.2f cm)"), ElapsedSeconds, MaxError, Tolerance), MaxError <= Tolerance);
+	}
+
+END_DEFINE_SPEC(FGimmickFastForwardSpec)
+
+void FGimmickFastForwardSpec::Define()
+{
+	using namespace GimmickBenchmark;
+
+	BeforeEach([this]()
+	{
+		TickedWorld = CreateBenchmarkWorld(TEXT("FastForwardSpec_Tick"));
+		SetupFastForwardGimmicks(TickedWorld, Count);
+		SkippedWorld = CreateBenchmarkWorld(TEXT("FastForwardSpec_Skip"));
+		SetupFastForwardGimmicks(SkippedWorld, Count);
+	});
+
+	AfterEach([this]()
+	{
+		DestroyBenchmarkWorld(TickedWorld);
+		DestroyBenchmarkWorld(SkippedWorld);
+		TickedWorld = nullptr;
+		SkippedWorld = nullptr;
+	});
+
+	Describe("AdvanceGimmicks", [this]()
+	{
+		It("ends in the same state as ticking frame by frame", [this]()
+		{
+			//1.25 秒: 削除までの時間が 0.5〜1.2 秒の床（10個中8個）が落ち、まだ再生成されていない（再生成は落ちてから1秒）
+			AdvanceAndCompare(75, 1.25f, Count - Count / 10 * 8);
+
+			//10 秒: 落ちた床はすべて再生成されている（再生成した床は踏まれていないので落ちない）
+			AdvanceAndCompare(525, 10.0f, Count);
+		});
+
+		It("takes a jump of an hour in one call without losing any gimmick", [this]()
+		{
+			UGimmickSubsystem* Gimmicks = SkippedWorld->GetSubsystem<UGimmickSubsystem>();
+			const int32 Registered = Gimmicks->Num();
+
+			Gimmicks->AdvanceGimmicks(3600.0f);
+
+			TestEqual(TEXT("registered gimmicks"), Gimmicks->Num(), Registered);
+			TestEqual(TEXT("standing fall floors"), NumStandingFallFloors(SkippedWorld), Count);
+			TestEqual(TEXT("fall floors waiting to respawn"), Gimmicks->GetAbsentGimmicks().Num(), 0);
+		});
+	});
+}
+
+#endif
@@ -0,0 +1,70 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GimmickFeedbackSubsystem.h"
+#include "GimmickEventBus.h"
+#include "GimmickPreloadSubsystem.h"
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
+
+DECLARE_CYCLE_STAT(TEXT("Feedback Drain"), STAT_GimmickFeedbackDrain, STATGROUP_Gimmick);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Feedback Events"), STAT_GimmickFeedbackEvents, STATGROUP_Gimmick);
+
+void UGimmickFeedbackSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	mConsumer = FGimmickEventBus::Get().AddConsumer(FString::Printf(TEXT("Feedback(%s)"), *GetNameSafe(GetWorld())));
+}
+
+void UGimmickFeedbackSubsystem::Deinitialize()
+{
+	FGimmickEventBus::Get().RemoveConsumer(mConsumer);
+	mConsumer = INDEX_NONE;
+
+	Super::Deinitialize();
+}
+
+/// @brief 演出は見た目だけなので、専用サーバーなどでは作らない（イベントバスの消費者も増やさない）
+/// @param Outer ワールド
+bool UGimmickFeedbackSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	return Super::ShouldCreateSubsystem(Outer) && GimmickCosmetics::ShouldRun(Outer);
+}
+
+bool UGimmickFeedbackSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UGimmickFeedbackSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UGimmickFeedbackSubsystem, STATGROUP_Tickables);
+}
+
+/// @brief 溜まったイベントをまとめて取り出して演出側に配る
+/// @param DeltaTime フレーム間の経過時間
+void UGimmickFeedbackSubsystem::Tick(float DeltaTime)
+{
+	LLM_SCOPE_BYTAG(Gimmick_Events);
+	SCOPE_CYCLE_COUNTER(STAT_GimmickFeedbackDrain);
+	GimmickLoading::FSyncLoadScope LoadScope(this, TEXT("UGimmickFeedbackSubsystem::Tick"));
+
+	if (mConsumer == INDEX_NONE)
+	{
+		return;
+	}
+
+	//バスは全ワールド共通なので、自分のワールドのイベントだけを配る（誰も登録していなくても取り出して捨てる）
+	const FObjectKey WorldKey(GetWorld());
+	const bool bBound = OnGimmickFeedback.IsBound();
+	const int32 Count = FGimmickEventBus::Get().Drain(mConsumer, [this, &WorldKey, bBound](const FGimmickBusEvent& Event)
+	{
+		if (bBound && Event.World == WorldKey)
+		{
+			AActor* Gimmick = Cast<AActor>(Event.Gimmick.ResolveObjectPtr());
+			OnGimmickFeedback.Broadcast(Event.Type, Gimmick, FVector(Event.Location));
+		}
+	});
+
+	SET_DWORD_STAT(STAT_GimmickFeedbackEvents, Count);
+}
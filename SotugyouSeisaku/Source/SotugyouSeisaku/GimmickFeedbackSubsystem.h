@@ -0,0 +1,40 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "GimmickTypes.h"
+#include "GimmickFeedbackSubsystem.generated.h"
+
+//ギミックの演出（音・エフェクト・UI）のきっかけを受け取るデリゲート
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_ThreeParams(FOnGimmickFeedback, EGimmickEventType, Type, AActor*, Gimmick, FVector, Location);
+
+/// @brief イベントバスから自分のワールドのイベントを毎フレームまとめて取り出し、演出側に配るサブシステム
+///
+///        ギミックは GimmickEvents::Emit でバスに積むだけなので、演出を増やしてもギミックの処理は重くならない。
+///        取り出すのはワールドのTickの後の1か所だけで、Blueprint（音・エフェクト・UI）は OnGimmickFeedback に登録して受け取る。
+///        イベントの後にギミックが削除されていても、位置は発生時のものが渡される（Gimmick は nullptr になる）。
+UCLASS()
+class SOTUGYOUSEISAKU_API UGimmickFeedbackSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	//ギミックのイベント（1フレーム分をまとめて、発生順に呼ばれる）
+	UPROPERTY(BlueprintAssignable, Category = "Gimmick")
+	FOnGimmickFeedback OnGimmickFeedback;
+
+protected:
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	//イベントバスの消費者の番号
+	int32 mConsumer = INDEX_NONE;
+};
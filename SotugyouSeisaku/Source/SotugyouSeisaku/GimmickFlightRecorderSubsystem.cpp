@@ -0,0 +1,389 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GimmickFlightRecorderSubsystem.h"
+#include "GimmickEventBus.h"
+#include "GimmickSubsystem.h"
+#include "GimmickSchedulerSubsystem.h"
+#include "GimmickSequenceSubsystem.h"
+#include "GimmickStateInterface.h"
+#include "Engine/World.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+#include "Async/Async.h"
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogGimmickFlightRecorder, Log, All);
+
+DECLARE_CYCLE_STAT(TEXT("Flight Recorder Tick"), STAT_GimmickFlightRecorderTick, STATGROUP_Gimmick);
+
+static TAutoConsoleVariable<bool> CVarGimmickFlightRecorderEnable(
+	TEXT("Gimmick.FlightRecorder.Enable"),
+	true,
+	TEXT("Keep recording gimmick activity and dump it around frame hitches."));
+
+static TAutoConsoleVariable<float> CVarGimmickFlightRecorderHitchMs(
+	TEXT("Gimmick.FlightRecorder.HitchMs"),
+	50.0f,
+	TEXT("Frames longer than this (ms) are treated as hitches and dumped."));
+
+static TAutoConsoleVariable<float> CVarGimmickFlightRecorderPreSeconds(
+	TEXT("Gimmick.FlightRecorder.PreSeconds"),
+	2.0f,
+	TEXT("Seconds of history before a hitch to include in the dump."));
+
+static TAutoConsoleVariable<float> CVarGimmickFlightRecorderPostSeconds(
+	TEXT("Gimmick.FlightRecorder.PostSeconds"),
+	1.0f,
+	TEXT("Seconds after a hitch to wait for before writing the dump."));
+
+namespace GimmickFlightRecorder
+{
+	//リングバッファの大きさ（120fps で約8秒分、1フレーム平均8件のイベント）
+	constexpr int32 MaxFrames = 1024;
+	constexpr int32 MaxEvents = 8192;
+
+	//読み込み直後はロードによる遅延が続くので、このフレーム数まではヒッチとみなさない
+	constexpr uint64 WarmupFrames = 60;
+
+	//ファイルの識別子と形式のバージョン
+	constexpr uint32 Magic = 0x31524647;	// "GFR1"
+	constexpr int32 Version = 1;
+}
+
+static FAutoConsoleCommandWithWorldAndArgs GGimmickFlightRecorderDumpCommand(
+	TEXT("Gimmick.FlightRecorder.Dump"),
+	TEXT("Write the recent gimmick activity window to Saved/FlightRecorder."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (UGimmickFlightRecorderSubsystem* Recorder = World ? World->GetSubsystem<UGimmickFlightRecorderSubsystem>() : nullptr)
+		{
+			Recorder->DumpNow(TEXT("Console"));
+		}
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs GGimmickFlightRecorderPrintCommand(
+	TEXT("Gimmick.FlightRecorder.Print"),
+	TEXT("Print a flight recorder dump. Usage: Gimmick.FlightRecorder.Print <FileName>"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (Args.Num() > 0)
+		{
+			UGimmickFlightRecorderSubsystem::PrintDump(FPaths::IsRelative(Args[0]) ? UGimmickFlightRecorderSubsystem::GetDumpDir() / Args[0] : Args[0]);
+		}
+	}));
+
+void UGimmickFlightRecorderSubsystem::FFrameSample::Serialize(FArchive& Ar)
+{
+	Ar << FrameNumber << WorldTime << FrameMs << GameThreadMs << PlayerLocation;
+	Ar << NumGimmicks << NumDormant << SchedulerQueueDepth << SchedulerBudgetUs << NumSequences;
+	Ar << FirstEvent << NumEvents;
+}
+
+void UGimmickFlightRecorderSubsystem::FEventSample::Serialize(FArchive& Ar)
+{
+	Ar << GimmickId << Location << AgeUs << Type;
+}
+
+void UGimmickFlightRecorderSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	LLM_SCOPE_BYTAG(Gimmick_Recorder);
+
+	Super::Initialize(Collection);
+
+	//記録に使うメモリは最初に全部確保する
+	mFrames.SetNum(GimmickFlightRecorder::MaxFrames);
+	mEvents.SetNum(GimmickFlightRecorder::MaxEvents);
+	mConsumer = FGimmickEventBus::Get().AddConsumer(FString::Printf(TEXT("FlightRecorder(%s)"), *GetNameSafe(GetWorld())));
+}
+
+void UGimmickFlightRecorderSubsystem::Deinitialize()
+{
+	FGimmickEventBus::Get().RemoveConsumer(mConsumer);
+	mConsumer = INDEX_NONE;
+
+	Super::Deinitialize();
+}
+
+bool UGimmickFlightRecorderSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+#if UE_BUILD_SHIPPING
+	return false;
+#else
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+#endif
+}
+
+TStatId UGimmickFlightRecorderSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UGimmickFlightRecorderSubsystem, STATGROUP_Tickables);
+}
+
+/// @brief このフレームの様子を記録し、ヒッチを見つけたら後ろの範囲が溜まってから書き出す
+/// @param DeltaTime フレーム間の経過時間
+void UGimmickFlightRecorderSubsystem::Tick(float DeltaTime)
+{
+	LLM_SCOPE_BYTAG(Gimmick_Recorder);
+	SCOPE_CYCLE_COUNTER(STAT_GimmickFlightRecorderTick);
+
+	const uint64 NowCycles = FPlatformTime::Cycles64();
+	const float FrameMs = mLastTickCycles != 0 ? static_cast<float>(FPlatformTime::ToMilliseconds64(NowCycles - mLastTickCycles)) : DeltaTime * 1000.0f;
+	mLastTickCycles = NowCycles;
+
+	if (!CVarGimmickFlightRecorderEnable.GetValueOnGameThread() || mConsumer == INDEX_NONE)
+	{
+		return;
+	}
+
+	UWorld* World = GetWorld();
+	const uint64 FrameIndex = mFrameCount++;
+	FFrameSample& Sample = mFrames[FrameIndex % mFrames.Num()];
+	Sample = FFrameSample();
+	Sample.FrameNumber = GFrameCounter;
+	Sample.WorldTime = World->GetRealTimeSeconds();
+	Sample.FrameMs = FrameMs;
+	Sample.GameThreadMs = FPlatformTime::ToMilliseconds(GGameThreadTime);
+
+	if (const APlayerController* Controller = World->GetFirstPlayerController())
+	{
+		if (const APawn* Pawn = Controller->GetPawn())
+		{
+			Sample.PlayerLocation = FVector3f(Pawn->GetActorLocation());
+		}
+	}
+
+	const UGimmickSubsystem* Registry = World->GetSubsystem<UGimmickSubsystem>();
+	if (Registry)
+	{
+		Sample.NumGimmicks = static_cast<uint16>(FMath::Min(Registry->Num(), static_cast<int32>(MAX_uint16)));
+		Sample.NumDormant = static_cast<uint16>(FMath::Min(Registry->NumDormant(), static_cast<int32>(MAX_uint16)));
+	}
+	if (const UGimmickSchedulerSubsystem* Scheduler = World->GetSubsystem<UGimmickSchedulerSubsystem>())
+	{
+		Sample.SchedulerQueueDepth = static_cast<uint16>(FMath::Min(Scheduler->GetQueueDepth(), static_cast<int32>(MAX_uint16)));
+		Sample.SchedulerBudgetUs = static_cast<uint16>(FMath::Min(Scheduler->GetLastBudgetUsedUs(), static_cast<double>(MAX_uint16)));
+	}
+	if (const UGimmickSequenceSubsystem* Sequences = World->GetSubsystem<UGimmickSequenceSubsystem>())
+	{
+		Sample.NumSequences = Sequences->NumRunning();
+	}
+
+	//前のTickからの状態遷移を取り出す（他のワールドの分は捨てる）
+	const FObjectKey WorldKey(World);
+	Sample.FirstEvent = mEventCount;
+	FGimmickEventBus::Get().Drain(mConsumer, [this, &Sample, &WorldKey, Registry, NowCycles](const FGimmickBusEvent& Event)
+	{
+		if (Event.World != WorldKey)
+		{
+			return;
+		}
+
+		FEventSample& Recorded = mEvents[mEventCount++ % mEvents.Num()];
+		Recorded.Type = Event.Type;
+		Recorded.Location = Event.Location;
+		Recorded.AgeUs = NowCycles > Event.Cycles ? static_cast<uint32>(FPlatformTime::ToSeconds64(NowCycles - Event.Cycles) * 1e6) : 0;
+
+		//削除済みのギミック（落ちた床など）は固定IDを引けないので 0 のまま
+		const AActor* Gimmick = Cast<AActor>(Event.Gimmick.ResolveObjectPtr());
+		Recorded.GimmickId = Registry && Gimmick ? Registry->GetGimmickId(Gimmick) : 0;
+		Sample.NumEvents++;
+	});
+
+	//ヒッチを見つけたら、後ろの範囲が溜まるまで待つ（待っている間のヒッチは同じファイルに入る）
+	if (mPendingHitch == INDEX_NONE && FrameIndex >= GimmickFlightRecorder::WarmupFrames && FrameMs > CVarGimmickFlightRecorderHitchMs.GetValueOnGameThread())
+	{
+		mPendingHitch = static_cast<int64>(FrameIndex);
+		mPendingDumpTime = Sample.WorldTime + CVarGimmickFlightRecorderPostSeconds.GetValueOnGameThread();
+		UE_LOG(LogGimmickFlightRecorder, Log, TEXT("Hitch detected: %.1f ms (frame %llu)"), FrameMs, Sample.FrameNumber);
+	}
+
+	if (mPendingHitch != INDEX_NONE && Sample.WorldTime >= mPendingDumpTime)
+	{
+		const uint64 HitchFrame = static_cast<uint64>(mPendingHitch);
+		mPendingHitch = INDEX_NONE;
+		WriteWindow(HitchFrame, FString::Printf(TEXT("Hitch %.1f ms"), mFrames[HitchFrame % mFrames.Num()].FrameMs));
+
+		//書き出しに使った時間を次のフレームのヒッチと数えない
+		mLastTickCycles = FPlatformTime::Cycles64();
+	}
+}
+
+/// @brief 直近の範囲をファイルに書き出す
+/// @param Reason 書き出した理由
+/// @return 書き出すファイルのパス
+FString UGimmickFlightRecorderSubsystem::DumpNow(const FString& Reason)
+{
+	if (mFrameCount == 0)
+	{
+		return FString();
+	}
+	return WriteWindow(mFrameCount - 1, Reason);
+}
+
+/// @brief 書き出し先のフォルダを取得する
+FString UGimmickFlightRecorderSubsystem::GetDumpDir()
+{
+	return FPaths::ProjectSavedDir() / TEXT("FlightRecorder");
+}
+
+/// @brief 範囲を書き出す
+/// @param HitchFrame 中心になるフレームの通し番号（前は PreSeconds、後ろは記録済みの分まで）
+/// @param Reason 書き出した理由
+/// @return 書き出すファイルのパス
+FString UGimmickFlightRecorderSubsystem::WriteWindow(uint64 HitchFrame, const FString& Reason)
+{
+	const uint64 OldestFrame = mFrameCount > static_cast<uint64>(mFrames.Num()) ? mFrameCount - mFrames.Num() : 0;
+	const uint64 OldestEvent = mEventCount > static_cast<uint64>(mEvents.Num()) ? mEventCount - mEvents.Num() : 0;
+	if (HitchFrame < OldestFrame || HitchFrame >= mFrameCount)
+	{
+		return FString();
+	}
+
+	//前の範囲の始まりを探す
+	const FFrameSample& Hitch = mFrames[HitchFrame % mFrames.Num()];
+	const double StartTime = Hitch.WorldTime - CVarGimmickFlightRecorderPreSeconds.GetValueOnGameThread();
+	uint64 FirstFrame = HitchFrame;
+	while (FirstFrame > OldestFrame && mFrames[(FirstFrame - 1) % mFrames.Num()].WorldTime >= StartTime)
+	{
+		FirstFrame--;
+	}
+
+	TArray<uint8> Bytes;
+	FMemoryWriter Writer(Bytes);
+
+	uint32 Magic = GimmickFlightRecorder::Magic;
+	int32 Version = GimmickFlightRecorder::Version;
+	FString ReasonText = Reason;
+	FString MapName = GetWorld()->GetMapName();
+	uint64 HitchFrameNumber = Hitch.FrameNumber;
+	float HitchMs = CVarGimmickFlightRecorderHitchMs.GetValueOnGameThread();
+	Writer << Magic << Version << ReasonText << MapName << HitchFrameNumber << HitchMs;
+
+	//フレームと、そのフレームの状態遷移（リングから上書きされた分は数えない）
+	int32 NumFrames = static_cast<int32>(mFrameCount - FirstFrame);
+	Writer << NumFrames;
+	for (uint64 i = FirstFrame; i < mFrameCount; i++)
+	{
+		FFrameSample Frame = mFrames[i % mFrames.Num()];
+		const uint64 FirstEvent = FMath::Max(Frame.FirstEvent, OldestEvent);
+		const uint64 EndEvent = FMath::Max(Frame.FirstEvent + Frame.NumEvents, FirstEvent);
+		Frame.FirstEvent = FirstEvent;
+		Frame.NumEvents = static_cast<uint32>(EndEvent - FirstEvent);
+		Frame.Serialize(Writer);
+
+		for (uint64 Event = FirstEvent; Event < EndEvent; Event++)
+		{
+			mEvents[Event % mEvents.Num()].Serialize(Writer);
+		}
+	}
+
+	//登録中のギミック一覧
+	TArray<AActor*> Gimmicks;
+	if (const UGimmickSubsystem* Registry = GetWorld()->GetSubsystem<UGimmickSubsystem>())
+	{
+		Registry->ForEachGimmick([&Gimmicks](AActor* Gimmick) { Gimmicks.Add(Gimmick); });
+
+		int32 NumGimmicks = Gimmicks.Num();
+		Writer << NumGimmicks;
+		for (AActor* Gimmick : Gimmicks)
+		{
+			uint64 Id = Registry->GetGimmickId(Gimmick);
+			const IGimmickStateInterface* State = Cast<IGimmickStateInterface>(Gimmick);
+			EGimmickType Type = State ? State->GetGimmickType() : EGimmickType::Other;
+			FVector3f Location(Gimmick->GetActorLocation());
+			FString Name = Gimmick->GetName();
+			Writer << Id << Type << Location << Name;
+		}
+	}
+	else
+	{
+		int32 NumGimmicks = 0;
+		Writer << NumGimmicks;
+	}
+
+	const FString Path = GetDumpDir() / FString::Printf(TEXT("Gimmick_%s_%s.gfr"), *MapName, *FDateTime::Now().ToString());
+	UE_LOG(LogGimmickFlightRecorder, Display, TEXT("Writing %d frames (%s) to %s"), NumFrames, *Reason, *Path);
+
+	//ファイルへの書き込みでさらにゲームスレッドを止めない
+	Async(EAsyncExecution::ThreadPool, [Bytes = MoveTemp(Bytes), Path]()
+	{
+		if (!FFileHelper::SaveArrayToFile(Bytes, *Path))
+		{
+			UE_LOG(LogGimmickFlightRecorder, Warning, TEXT("Failed to write %s"), *Path);
+		}
+	});
+	return Path;
+}
+
+/// @brief 書き出したファイルの内容をログに出す
+/// @param FilePath ファイルのパス
+/// @return 読み込めたか
+bool UGimmickFlightRecorderSubsystem::PrintDump(const FString& FilePath)
+{
+	TArray<uint8> Bytes;
+	if (!FFileHelper::LoadFileToArray(Bytes, *FilePath))
+	{
+		UE_LOG(LogGimmickFlightRecorder, Warning, TEXT("Failed to read %s"), *FilePath);
+		return false;
+	}
+
+	FMemoryReader Reader(Bytes);
+	uint32 Magic = 0;
+	int32 Version = 0;
+	Reader << Magic << Version;
+	if (Magic != GimmickFlightRecorder::Magic || Version != GimmickFlightRecorder::Version)
+	{
+		UE_LOG(LogGimmickFlightRecorder, Warning, TEXT("%s is not a flight recorder dump"), *FilePath);
+		return false;
+	}
+
+	FString Reason;
+	FString MapName;
+	uint64 HitchFrameNumber = 0;
+	float HitchMs = 0.0f;
+	int32 NumFrames = 0;
+	Reader << Reason << MapName << HitchFrameNumber << HitchMs << NumFrames;
+	UE_LOG(LogGimmickFlightRecorder, Display, TEXT("%s: %s on %s, frame %llu, threshold %.1f ms, %d frames"),
+		*FPaths::GetCleanFilename(FilePath), *Reason, *MapName, HitchFrameNumber, HitchMs, NumFrames);
+
+	const UEnum* EventEnum = StaticEnum<EGimmickEventType>();
+	for (int32 i = 0; i < NumFrames && !Reader.IsError(); i++)
+	{
+		FFrameSample Frame;
+		Frame.Serialize(Reader);
+		UE_LOG(LogGimmickFlightRecorder, Display, TEXT("%s frame %llu t=%.3f %.2f ms (game %.2f ms) gimmicks=%u dormant=%u queue=%u budget=%u us sequences=%u events=%u player=(%.0f, %.0f, %.0f)"),
+			Frame.FrameNumber == HitchFrameNumber ? TEXT("*") : TEXT(" "), Frame.FrameNumber, Frame.WorldTime, Frame.FrameMs, Frame.GameThreadMs,
+			Frame.NumGimmicks, Frame.NumDormant, Frame.SchedulerQueueDepth, Frame.SchedulerBudgetUs, Frame.NumSequences, Frame.NumEvents,
+			Frame.PlayerLocation.X, Frame.PlayerLocation.Y, Frame.PlayerLocation.Z);
+
+		for (uint32 Event = 0; Event < Frame.NumEvents; Event++)
+		{
+			FEventSample Sample;
+			Sample.Serialize(Reader);
+			UE_LOG(LogGimmickFlightRecorder, Display, TEXT("      -%6u us %-20s id=%016llx at (%.0f, %.0f, %.0f)"),
+				Sample.AgeUs, *EventEnum->GetNameStringByValue(static_cast<int64>(Sample.Type)), Sample.GimmickId,
+				Sample.Location.X, Sample.Location.Y, Sample.Location.Z);
+		}
+	}
+
+	int32 NumGimmicks = 0;
+	Reader << NumGimmicks;
+	UE_LOG(LogGimmickFlightRecorder, Display, TEXT("Active gimmicks: %d"), NumGimmicks);
+	const UEnum* TypeEnum = StaticEnum<EGimmickType>();
+	for (int32 i = 0; i < NumGimmicks && !Reader.IsError(); i++)
+	{
+		uint64 Id = 0;
+		EGimmickType Type = EGimmickType::Other;
+		FVector3f Location;
+		FString Name;
+		Reader << Id << Type << Location << Name;
+		UE_LOG(LogGimmickFlightRecorder, Display, TEXT("  %016llx %-14s %-32s (%.0f, %.0f, %.0f)"),
+			Id, *TypeEnum->GetNameStringByValue(static_cast<int64>(Type)), *Name, Location.X, Location.Y, Location.Z);
+	}
+
+	return !Reader.IsError();
+}
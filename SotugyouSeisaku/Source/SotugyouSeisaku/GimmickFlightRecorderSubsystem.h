@@ -0,0 +1,103 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "GimmickTypes.h"
+#include "GimmickFlightRecorderSubsystem.generated.h"
+
+/// @brief フレームの急な遅延（ヒッチ）の前後のギミックの様子を記録するサブシステム
+///
+///        毎フレームの数値（フレーム時間・登録数・スケジューラの待ち数・手順の数・プレイヤーの位置など）と、
+///        イベントバスから取り出した状態遷移を、起動時に確保した固定サイズのリングバッファに常に上書きしていく。
+///        フレーム時間がしきい値を超えたら、その前後（既定では前2秒・後1秒）を後ろの分が溜まってから
+///        ファイルに書き出す（プレイヤーの位置と登録中のギミック一覧も付ける）。
+///        毎フレームの処理は数十バイトの書き込みだけなので、テスト用ビルドでも有効のままにしておける（Shipping では作らない）。
+///
+///        コンソール変数:
+///        Gimmick.FlightRecorder.Enable 0/1
+///        Gimmick.FlightRecorder.HitchMs（これを超えたフレームをヒッチとみなす）
+///        Gimmick.FlightRecorder.PreSeconds / PostSeconds（書き出す範囲）
+///
+///        コンソールコマンド:
+///        Gimmick.FlightRecorder.Dump（直近の範囲をすぐに書き出す）
+///        Gimmick.FlightRecorder.Print <ファイル名>（書き出したファイルの内容をログに出す）
+UCLASS()
+class SOTUGYOUSEISAKU_API UGimmickFlightRecorderSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	/// @brief 直近の範囲をファイルに書き出す
+	/// @param Reason 書き出した理由（ファイルに記録する）
+	/// @return 書き出すファイルのパス（書き込みはバックグラウンドで行う）
+	FString DumpNow(const FString& Reason);
+
+	//書き出したファイルの内容をログに出す
+	static bool PrintDump(const FString& FilePath);
+
+	//書き出し先のフォルダ
+	static FString GetDumpDir();
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	//1フレーム分の記録
+	struct FFrameSample
+	{
+		uint64 FrameNumber = 0;
+		double WorldTime = 0.0;
+		float FrameMs = 0.0f;
+		float GameThreadMs = 0.0f;
+		FVector3f PlayerLocation = FVector3f::ZeroVector;
+		uint16 NumGimmicks = 0;
+		uint16 NumDormant = 0;
+		uint16 SchedulerQueueDepth = 0;
+		uint16 SchedulerBudgetUs = 0;
+		uint32 NumSequences = 0;
+
+		//このフレームの状態遷移（mEvents の通し番号）
+		uint64 FirstEvent = 0;
+		uint32 NumEvents = 0;
+
+		void Serialize(FArchive& Ar);
+	};
+
+	//状態遷移1件分の記録
+	struct FEventSample
+	{
+		uint64 GimmickId = 0;
+		FVector3f Location = FVector3f::ZeroVector;
+		//取り出したフレームの開始からさかのぼった時間
+		uint32 AgeUs = 0;
+		EGimmickEventType Type = EGimmickEventType::Count;
+
+		void Serialize(FArchive& Ar);
+	};
+
+	//範囲を書き出す（HitchFrame の前後を含める）
+	FString WriteWindow(uint64 HitchFrame, const FString& Reason);
+
+	//固定サイズのリングバッファ（通し番号で指す）
+	TArray<FFrameSample> mFrames;
+	TArray<FEventSample> mEvents;
+	uint64 mFrameCount = 0;
+	uint64 mEventCount = 0;
+
+	//イベントバスの消費者の番号
+	int32 mConsumer = INDEX_NONE;
+
+	//前回のTickの時刻（実時間のフレーム時間を測る）
+	uint64 mLastTickCycles = 0;
+
+	//後ろの範囲が溜まるのを待っているヒッチのフレームの通し番号（INDEX_NONE = なし）と、書き出す時刻
+	int64 mPendingHitch = INDEX_NONE;
+	double mPendingDumpTime = 0.0;
+};
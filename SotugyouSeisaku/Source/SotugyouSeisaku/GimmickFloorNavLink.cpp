@@ -0,0 +1,219 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GimmickFloorNavLink.h"
+#include "Gimmck_MoveFloor.h"
+#include "NavLinkCustomComponent.h"
+#include "Navigation/PathFollowingComponent.h"
+#include "GameFramework/Controller.h"
+#include "GameFramework/Pawn.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogGimmickFloorNavLink, Log, All);
+
+/// @brief コンストラクタ　ナビゲーションリンクの各種設定
+AGimmickFloorNavLink::AGimmickFloorNavLink()
+{
+	//リンクを使っているAIがいる間だけTickする
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = false;
+
+	mRoot = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
+	mRoot->SetMobility(EComponentMobility::Static);
+	RootComponent = mRoot;
+
+	mLink = CreateDefaultSubobject<UNavLinkCustomComponent>(TEXT("NavLink"));
+	mLink->SetMoveReachedLink(this, &AGimmickFloorNavLink::OnLinkReached);
+}
+
+void AGimmickFloorNavLink::OnConstruction(const FTransform& Transform)
+{
+	Super::OnConstruction(Transform);
+
+	//エディタで床を動かしたり設定を変えたりしたらリンクも合わせる
+	UpdateLinkData();
+}
+
+void AGimmickFloorNavLink::BeginPlay()
+{
+	Super::BeginPlay();
+
+	UpdateLinkData();
+}
+
+void AGimmickFloorNavLink::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	//使用中のAIは移動を中断させる（待ち続けないように）
+	while (mRiders.Num() > 0)
+	{
+		FinishRider(mRiders.Num() - 1, false);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+/// @brief 床を設定する関数
+/// @param Floor 乗り降りする床
+void AGimmickFloorNavLink::SetFloor(AGimmck_MoveFloor* Floor)
+{
+	mFloor = Floor;
+	UpdateLinkData();
+}
+
+/// @brief 床の時刻表からリンクの両端を計算し直す関数
+///        両端は乗り場から床の進路の外側に mBoardingDistance だけ離れた位置（床が来るのを待つ場所）
+void AGimmickFloorNavLink::UpdateLinkData()
+{
+	if (!mFloor)
+	{
+		mLink->SetEnabled(false);
+		return;
+	}
+
+	const FVector Dock0 = mFloor->GetDockLocation(0);
+	const FVector Dock1 = mFloor->GetDockLocation(1);
+
+	//進路の水平方向に沿って外側へ離す（縦移動などで水平方向がなければ、このアクタの後ろ側で待つ）
+	FVector Outward = (Dock0 - Dock1).GetSafeNormal2D();
+	FVector Start;
+	FVector End;
+	if (Outward.IsNearlyZero())
+	{
+		const FVector Back = -GetActorForwardVector().GetSafeNormal2D();
+		Start = Dock0 + Back * mBoardingDistance;
+		End = Dock1 + Back * mBoardingDistance;
+	}
+	else
+	{
+		Start = Dock0 + Outward * mBoardingDistance;
+		End = Dock1 - Outward * mBoardingDistance;
+	}
+
+	const FTransform& LinkTransform = GetActorTransform();
+	mLink->SetLinkData(LinkTransform.InverseTransformPosition(Start), LinkTransform.InverseTransformPosition(End), ENavLinkDirection::BothWays);
+	mLink->SetEnabled(true);
+}
+
+/// @brief AIがリンクの端に着いたときに呼ばれる関数
+/// @param Link 使われたリンク
+/// @param PathComp AIの経路追従コンポーネント
+/// @param DestPoint リンクの反対側の端（ワールド座標）
+void AGimmickFloorNavLink::OnLinkReached(UNavLinkCustomComponent* Link, UObject* PathComp, const FVector& DestPoint)
+{
+	//経路追従コンポーネントはAIコントローラーが持っている
+	UPathFollowingComponent* PathFollowing = Cast<UPathFollowingComponent>(PathComp);
+	const AController* Controller = PathFollowing ? Cast<AController>(PathFollowing->GetOwner()) : nullptr;
+	APawn* Pawn = Controller ? Controller->GetPawn() : nullptr;
+
+	if (!mFloor || !Pawn)
+	{
+		if (PathFollowing)
+		{
+			PathFollowing->FinishUsingCustomLink(Link);
+		}
+		return;
+	}
+
+	//終了位置側で降りるなら開始位置側から乗る
+	const FVector LinkEnd = GetActorTransform().TransformPosition(mLink->GetEndPoint());
+	const bool bToEnd = FVector::DistSquared(DestPoint, LinkEnd) < FVector::DistSquared(DestPoint, GetActorTransform().TransformPosition(mLink->GetStartPoint()));
+
+	FRider& Rider = mRiders.AddDefaulted_GetRef();
+	Rider.PathFollowing = PathFollowing;
+	Rider.Pawn = Pawn;
+	Rider.From = bToEnd ? 0 : 1;
+	Rider.Destination = DestPoint;
+	Rider.State = ERiderState::Waiting;
+
+	SetActorTickEnabled(true);
+}
+
+/// @brief リンクを使い終わったAIを経路追従に戻す関数
+/// @param Index mRiders のインデックス
+/// @param bSuccess 反対側に着いたか（失敗なら移動を中断させる）
+void AGimmickFloorNavLink::FinishRider(int32 Index, bool bSuccess)
+{
+	if (UPathFollowingComponent* PathFollowing = mRiders[Index].PathFollowing.Get())
+	{
+		if (bSuccess)
+		{
+			PathFollowing->FinishUsingCustomLink(mLink);
+		}
+		else
+		{
+			PathFollowing->AbortMove(*this, FPathFollowingResultFlags::MovementStop);
+		}
+	}
+
+	mRiders.RemoveAtSwap(Index, EAllowShrinking::No);
+	if (mRiders.Num() == 0)
+	{
+		SetActorTickEnabled(false);
+	}
+}
+
+/// @brief リンクを使用中のAIを床の時刻表に合わせて動かす
+/// @param DeltaTime フレーム間の経過時間
+void AGimmickFloorNavLink::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	for (int32 i = mRiders.Num() - 1; i >= 0; i--)
+	{
+		FRider& Rider = mRiders[i];
+		APawn* Pawn = Rider.Pawn.Get();
+		if (!Pawn || !Rider.PathFollowing.IsValid() || !mFloor)
+		{
+			FinishRider(i, false);
+			continue;
+		}
+
+		const int32 To = 1 - Rider.From;
+		const FVector PawnLocation = Pawn->GetActorLocation();
+		const FVector FloorLocation = mFloor->GetActorLocation();
+		const bool bOnFloor = FVector::DistSquared2D(PawnLocation, FloorLocation) <= FMath::Square(mRideRadius);
+
+		switch (Rider.State)
+		{
+		case ERiderState::Waiting:
+			//乗り込める時間が残っている間に床が止まっていたら乗る
+			if (mFloor->GetDockedTimeRemaining(Rider.From) >= mMinBoardingTime)
+			{
+				Rider.State = ERiderState::Boarding;
+			}
+			break;
+
+		case ERiderState::Boarding:
+			if (bOnFloor)
+			{
+				Rider.State = ERiderState::Riding;
+			}
+			else if (mFloor->GetDockedTimeRemaining(Rider.From) <= 0.0f)
+			{
+				//乗り遅れたら次の便を待つ
+				Rider.State = ERiderState::Waiting;
+			}
+			else
+			{
+				Pawn->AddMovementInput((FloorLocation - PawnLocation).GetSafeNormal2D());
+			}
+			break;
+
+		case ERiderState::Riding:
+			//床は乗っているAIを運ぶので、反対側に止まるまで待つ
+			if (mFloor->GetDockedTimeRemaining(To) > 0.0f)
+			{
+				Rider.State = ERiderState::Alighting;
+			}
+			break;
+
+		case ERiderState::Alighting:
+			if (FVector::DistSquared2D(PawnLocation, Rider.Destination) <= FMath::Square(mAcceptanceRadius))
+			{
+				UE_LOG(LogGimmickFloorNavLink, Verbose, TEXT("%s crossed %s"), *GetNameSafe(Pawn), *GetNameSafe(mFloor));
+				FinishRider(i, true);
+				continue;
+			}
+			Pawn->AddMovementInput((Rider.Destination - PawnLocation).GetSafeNormal2D());
+			break;
+		}
+	}
+}
@@ -0,0 +1,104 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "GimmickFloorNavLink.generated.h"
+
+class AGimmck_MoveFloor;
+class UNavLinkCustomComponent;
+class UPathFollowingComponent;
+
+/// @brief 動く床の乗り場同士をつなぐ、時刻表付きのナビゲーションリンク
+///
+///        動く床はナビメッシュに影響させない（動くたびにタイルを作り直さない）代わりに、
+///        床の両端（円運動なら角度 0 と π）の乗り場の手前同士をスマートリンクでつなぐ。
+///        経路探索はリンクを普通の経路として扱い、AIがリンクに着いたらこのアクタが
+///        「床が来るまで待つ → 乗る → 乗ったまま運ばれる → 降りる」を床の時刻表に合わせて行い、終わったら経路追従に戻す。
+///
+///        レベルに配置して mFloor に床を指定する（リンクの位置はエディタ上の床の配置から計算される）。
+UCLASS()
+class SOTUGYOUSEISAKU_API AGimmickFloorNavLink : public AActor
+{
+	GENERATED_BODY()
+
+	//静止したルート（リンクの位置の基準）
+	UPROPERTY(VisibleAnywhere)
+	TObjectPtr<USceneComponent> mRoot;
+
+	//ナビゲーションリンク
+	UPROPERTY(VisibleAnywhere)
+	TObjectPtr<UNavLinkCustomComponent> mLink;
+
+public:
+	AGimmickFloorNavLink();
+
+	virtual void OnConstruction(const FTransform& Transform) override;
+	virtual void Tick(float DeltaTime) override;
+
+	//床を設定する（BeginPlay前にコードから配置する場合に使用）
+	void SetFloor(AGimmck_MoveFloor* Floor);
+
+	//床の時刻表からリンクの両端を計算し直す
+	void UpdateLinkData();
+
+	//リンクを使用中のAIの数
+	int32 NumRiders() const { return mRiders.Num(); }
+
+	//乗り降りする床
+	UPROPERTY(EditAnywhere, Category = "Floor Link")
+	TObjectPtr<AGimmck_MoveFloor> mFloor;
+
+	//乗り場からリンクの端（床が来るのを待つ場所）までの水平距離
+	UPROPERTY(EditAnywhere, Category = "Floor Link")
+	float mBoardingDistance = 250.0f;
+
+	//乗り始めるのに必要な、床が止まっている残り時間（秒）
+	UPROPERTY(EditAnywhere, Category = "Floor Link")
+	float mMinBoardingTime = 0.5f;
+
+	//床の中心からこの水平距離以内に入ったら乗ったとみなす
+	UPROPERTY(EditAnywhere, Category = "Floor Link")
+	float mRideRadius = 80.0f;
+
+	//降りた後、リンクの端にこの距離まで近づいたら経路追従に戻す
+	UPROPERTY(EditAnywhere, Category = "Floor Link")
+	float mAcceptanceRadius = 50.0f;
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	//AIがリンクの端に着いたときに呼ばれる
+	void OnLinkReached(UNavLinkCustomComponent* Link, UObject* PathComp, const FVector& DestPoint);
+
+	//リンクを使い終わったAIを経路追従に戻す
+	void FinishRider(int32 Index, bool bSuccess);
+
+	//乗り降りの段階
+	enum class ERiderState : uint8
+	{
+		Waiting,	//床が来るのを待つ
+		Boarding,	//床に乗り込む
+		Riding,		//床に乗って運ばれる
+		Alighting,	//床から降りてリンクの端に向かう
+	};
+
+	struct FRider
+	{
+		TWeakObjectPtr<UPathFollowingComponent> PathFollowing;
+		TWeakObjectPtr<APawn> Pawn;
+
+		//乗る側（0 = 開始位置側、1 = 終了位置側）
+		int32 From = 0;
+
+		//リンクの降りる側の端
+		FVector Destination = FVector::ZeroVector;
+
+		ERiderState State = ERiderState::Waiting;
+	};
+
+	TArray<FRider> mRiders;
+};
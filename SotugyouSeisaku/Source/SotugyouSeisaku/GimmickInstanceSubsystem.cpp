@@ -0,0 +1,272 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GimmickInstanceSubsystem.h"
+#include "GimmickSubsystem.h"
+#include "GimmickTypes.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Components/StaticMeshComponent.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogGimmickInstance, Log, All);
+
+static TAutoConsoleVariable<bool> CVarGimmickInstancedRendering(
+	TEXT("Gimmick.InstancedRendering"),
+	true,
+	TEXT("Render repeated gimmick meshes through shared instanced static mesh components (applies to gimmicks that begin play afterwards)."));
+
+void UGimmickInstanceSubsystem::Deinitialize()
+{
+	mBatches.Empty();
+	mComponents.Empty();
+	mHost = nullptr;
+
+	Super::Deinitialize();
+}
+
+bool UGimmickInstanceSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UGimmickInstanceSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UGimmickInstanceSubsystem, STATGROUP_Tickables);
+}
+
+/// @brief インスタンス描画が有効か
+bool UGimmickInstanceSubsystem::IsEnabled()
+{
+	return CVarGimmickInstancedRendering.GetValueOnGameThread();
+}
+
+/// @brief このフレームで位置が変わったバッチの描画状態をまとめて更新する
+/// @param DeltaTime フレーム間の経過時間
+void UGimmickInstanceSubsystem::Tick(float DeltaTime)
+{
+	for (FBatch& Batch : mBatches)
+	{
+		if (Batch.bDirty)
+		{
+			Batch.Component->MarkRenderStateDirty();
+			Batch.bDirty = false;
+		}
+	}
+}
+
+/// @brief メッシュコンポーネントの描画を共有インスタンスに移す
+/// @param Source ギミックのメッシュコンポーネント（非表示になり、コリジョンだけを担当する）
+/// @return 共有インスタンスのハンドル（メッシュ未設定なら無効）
+FGimmickInstanceHandle UGimmickInstanceSubsystem::AddInstance(UStaticMeshComponent* Source)
+{
+	LLM_SCOPE_BYTAG(Gimmick_Instances);
+
+	FGimmickInstanceHandle Handle;
+	//専用サーバーなどでは描画しないので、元のメッシュのままにする
+	if (!Source || !Source->GetStaticMesh() || !GimmickCosmetics::ShouldRun(Source))
+	{
+		return Handle;
+	}
+
+	Handle.Batch = FindOrAddBatch(Source->GetStaticMesh(), Source->GetMaterials());
+	FBatch& Batch = mBatches[Handle.Batch];
+
+	//空いているスロットを使い回す
+	if (Batch.FreeSlots.Num() > 0)
+	{
+		Handle.Slot = Batch.FreeSlots.Pop(EAllowShrinking::No);
+	}
+	else
+	{
+		Handle.Slot = Batch.SlotToInstance.Add(INDEX_NONE);
+		Batch.Sources.AddDefaulted();
+		Batch.TransformHandles.AddDefaulted();
+	}
+
+	const int32 Instance = Batch.Component->AddInstance(Source->GetComponentTransform(), true);
+	Batch.SlotToInstance[Handle.Slot] = Instance;
+	if (Instance >= Batch.InstanceToSlot.Num())
+	{
+		Batch.InstanceToSlot.SetNum(Instance + 1);
+	}
+	Batch.InstanceToSlot[Instance] = Handle.Slot;
+
+	//元のコンポーネントが動いたらインスタンスも動かす
+	Batch.Sources[Handle.Slot] = Source;
+	Batch.TransformHandles[Handle.Slot] = Source->TransformUpdated.AddUObject(this, &UGimmickInstanceSubsystem::OnSourceTransformUpdated, Handle);
+
+	//元のコンポーネントはシーンに追加しない（コリジョンとオーバーラップは残る）
+	Source->SetVisibility(false);
+
+	Batch.bDirty = true;
+	return Handle;
+}
+
+/// @brief 共有インスタンスを解放する（EndPlay から呼ぶ想定なので元のコンポーネントは非表示のまま）
+/// @param Handle 解放するハンドル（無効になる）
+void UGimmickInstanceSubsystem::RemoveInstance(FGimmickInstanceHandle& Handle)
+{
+	if (!Handle.IsValid() || !mBatches.IsValidIndex(Handle.Batch))
+	{
+		Handle = FGimmickInstanceHandle();
+		return;
+	}
+
+	FBatch& Batch = mBatches[Handle.Batch];
+	const int32 Instance = Batch.SlotToInstance[Handle.Slot];
+	const int32 LastInstance = Batch.Component->GetInstanceCount() - 1;
+
+	//最後のインスタンスを空いた位置に移してから末尾を削除する（他のインスタンス番号がずれないようにする）
+	if (Instance != LastInstance)
+	{
+		FTransform LastTransform;
+		Batch.Component->GetInstanceTransform(LastInstance, LastTransform, true);
+		Batch.Component->UpdateInstanceTransform(Instance, LastTransform, true, false, true);
+
+		const int32 LastSlot = Batch.InstanceToSlot[LastInstance];
+		Batch.SlotToInstance[LastSlot] = Instance;
+		Batch.InstanceToSlot[Instance] = LastSlot;
+	}
+	Batch.Component->RemoveInstance(LastInstance);
+	Batch.InstanceToSlot.Pop(EAllowShrinking::No);
+
+	if (UStaticMeshComponent* Source = Batch.Sources[Handle.Slot].Get())
+	{
+		Source->TransformUpdated.Remove(Batch.TransformHandles[Handle.Slot]);
+	}
+
+	Batch.SlotToInstance[Handle.Slot] = INDEX_NONE;
+	Batch.Sources[Handle.Slot] = nullptr;
+	Batch.TransformHandles[Handle.Slot].Reset();
+	Batch.FreeSlots.Add(Handle.Slot);
+	Batch.bDirty = true;
+
+	Handle = FGimmickInstanceHandle();
+}
+
+/// @brief 使用中のインスタンス数
+int32 UGimmickInstanceSubsystem::NumInstances() const
+{
+	int32 Count = 0;
+	for (const FBatch& Batch : mBatches)
+	{
+		Count += Batch.Component->GetInstanceCount();
+	}
+	return Count;
+}
+
+/// @brief 元のコンポーネントが動いたときにインスタンスの位置を合わせる
+/// @param Source 動いたコンポーネント
+/// @param UpdateTransformFlags 更新の種類
+/// @param Teleport テレポートかどうか
+/// @param Handle 対応するインスタンスのハンドル
+void UGimmickInstanceSubsystem::OnSourceTransformUpdated(USceneComponent* Source, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport, FGimmickInstanceHandle Handle)
+{
+	FBatch& Batch = mBatches[Handle.Batch];
+
+	//描画状態の更新はフレームの最後にまとめて行う
+	Batch.Component->UpdateInstanceTransform(Batch.SlotToInstance[Handle.Slot], Source->GetComponentTransform(), true, false, true);
+	Batch.bDirty = true;
+}
+
+/// @brief メッシュとマテリアルの組み合わせに対応するバッチを探す（なければ作る）
+/// @param Mesh メッシュ
+/// @param Materials マテリアル（スロット順）
+/// @return バッチの番号
+int32 UGimmickInstanceSubsystem::FindOrAddBatch(UStaticMesh* Mesh, const TArray<UMaterialInterface*>& Materials)
+{
+	//バッチの種類は数個なので線形探索で十分
+	for (int32 i = 0; i < mBatches.Num(); i++)
+	{
+		if (mBatches[i].Mesh == Mesh && mBatches[i].Materials == Materials)
+		{
+			return i;
+		}
+	}
+
+	if (!mHost)
+	{
+		FActorSpawnParameters SpawnParams;
+		SpawnParams.Name = TEXT("GimmickInstanceHost");
+		SpawnParams.NameMode = FActorSpawnParameters::ESpawnActorNameMode::Requested;
+		SpawnParams.ObjectFlags = RF_Transient;
+		mHost = GetWorld()->SpawnActor<AActor>(SpawnParams);
+	}
+
+	//描画専用（コリジョンは元のコンポーネントが持つ）
+	UInstancedStaticMeshComponent* Component = NewObject<UInstancedStaticMeshComponent>(mHost);
+	Component->SetMobility(EComponentMobility::Movable);
+	Component->SetStaticMesh(Mesh);
+	for (int32 i = 0; i < Materials.Num(); i++)
+	{
+		Component->SetMaterial(i, Materials[i]);
+	}
+	Component->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	Component->SetGenerateOverlapEvents(false);
+	Component->SetCanEverAffectNavigation(false);
+	Component->RegisterComponent();
+	mHost->AddInstanceComponent(Component);
+	mComponents.Add(Component);
+
+	FBatch& Batch = mBatches.AddDefaulted_GetRef();
+	Batch.Mesh = Mesh;
+	Batch.Materials = Materials;
+	Batch.Component = Component;
+
+	UE_LOG(LogGimmickInstance, Verbose, TEXT("New gimmick instance batch: %s"), *GetNameSafe(Mesh));
+	return mBatches.Num() - 1;
+}
+
+/// @brief 登録済みのギミックと共有インスタンスのコンポーネント構成を集計する
+/// @param World 対象のワールド
+/// @return 集計結果
+FGimmickComponentStats UGimmickInstanceSubsystem::GatherComponentStats(UWorld* World)
+{
+	FGimmickComponentStats Stats;
+
+	auto AddActor = [&Stats](const AActor* Actor)
+	{
+		Stats.Actors++;
+		for (UActorComponent* Component : Actor->GetComponents())
+		{
+			Stats.Components++;
+			Stats.Bytes += Component->GetClass()->GetStructureSize() + Component->GetResourceSizeBytes(EResourceSizeMode::Exclusive);
+
+			const UPrimitiveComponent* Primitive = Cast<UPrimitiveComponent>(Component);
+			if (Primitive && Primitive->IsRegistered() && Primitive->ShouldComponentAddToScene())
+			{
+				Stats.SceneProxies++;
+			}
+		}
+	};
+
+	if (const UGimmickSubsystem* Gimmicks = World ? World->GetSubsystem<UGimmickSubsystem>() : nullptr)
+	{
+		Gimmicks->ForEachGimmick(AddActor);
+	}
+
+	const UGimmickInstanceSubsystem* Instances = World ? World->GetSubsystem<UGimmickInstanceSubsystem>() : nullptr;
+	if (Instances && Instances->mHost)
+	{
+		AddActor(Instances->mHost);
+	}
+
+	return Stats;
+}
+
+//コンソールコマンド
+static FAutoConsoleCommandWithWorldAndArgs GGimmickComponentsCommand(
+	TEXT("Gimmick.Components"),
+	TEXT("Print component count, scene proxies, memory and shared instances of gimmicks."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		const FGimmickComponentStats Stats = UGimmickInstanceSubsystem::GatherComponentStats(World);
+		UE_LOG(LogGimmickInstance, Display, TEXT("Gimmick actors: %d, components: %d, scene proxies: %d, component memory: %.1f KB"),
+			Stats.Actors, Stats.Components, Stats.SceneProxies, Stats.Bytes / 1024.0);
+
+		if (const UGimmickInstanceSubsystem* Instances = World ? World->GetSubsystem<UGimmickInstanceSubsystem>() : nullptr)
+		{
+			UE_LOG(LogGimmickInstance, Display, TEXT("Shared instance batches: %d, instances: %d"), Instances->NumBatches(), Instances->NumInstances());
+		}
+	}));
@@ -0,0 +1,116 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "GimmickInstanceSubsystem.generated.h"
+
+class UStaticMesh;
+class UMaterialInterface;
+class UStaticMeshComponent;
+class UInstancedStaticMeshComponent;
+
+/// @brief 共有インスタンスへの軽量なハンドル（ギミック側はこれだけを持つ）
+struct FGimmickInstanceHandle
+{
+	//バッチ（メッシュとマテリアルの組み合わせ）の番号
+	int32 Batch = INDEX_NONE;
+
+	//バッチ内の固定スロット（インスタンス番号が詰め直されても変わらない）
+	int32 Slot = INDEX_NONE;
+
+	bool IsValid() const { return Batch != INDEX_NONE; }
+};
+
+/// @brief ギミックのコンポーネント構成の集計結果
+struct FGimmickComponentStats
+{
+	int32 Actors = 0;
+	int32 Components = 0;
+
+	//シーンに追加されるプリミティブ（シーンプロキシ）の数
+	int32 SceneProxies = 0;
+
+	//コンポーネントのオブジェクトサイズとリソースサイズの合計
+	int64 Bytes = 0;
+};
+
+/// @brief 同じメッシュを使うギミックをメッシュごとの InstancedStaticMeshComponent でまとめて描画するサブシステム
+///
+///        ギミックのメッシュコンポーネントは非表示にして（シーンプロキシを作らない）コリジョンだけを担当させ、
+///        描画はワールドに1つのホストアクタが持つ共有インスタンスで行う。
+///        元のコンポーネントが動くとインスタンスの位置も更新し、描画状態の更新はフレームの最後にバッチ単位で1回だけ行う。
+///
+///        コンソールコマンド:
+///        Gimmick.Components（コンポーネント数・メモリ・インスタンス数を表示）
+///        Gimmick.InstancedRendering 0/1（次に BeginPlay するギミックから有効・無効）
+UCLASS()
+class SOTUGYOUSEISAKU_API UGimmickInstanceSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	//インスタンス描画が有効か（コンソール変数 Gimmick.InstancedRendering）
+	static bool IsEnabled();
+
+	//メッシュコンポーネントの描画を共有インスタンスに移す（メッシュ未設定なら無効なハンドルを返す）
+	FGimmickInstanceHandle AddInstance(UStaticMeshComponent* Source);
+
+	//共有インスタンスを解放する（ハンドルは無効になる、元のコンポーネントは非表示のまま）
+	void RemoveInstance(FGimmickInstanceHandle& Handle);
+
+	//バッチ数と使用中のインスタンス数
+	int32 NumBatches() const { return mBatches.Num(); }
+	int32 NumInstances() const;
+
+	//登録済みのギミックと共有インスタンスのコンポーネント構成を集計する
+	static FGimmickComponentStats GatherComponentStats(UWorld* World);
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	//元のコンポーネントが動いたときに呼ばれる
+	void OnSourceTransformUpdated(USceneComponent* Source, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport, FGimmickInstanceHandle Handle);
+
+	//メッシュとマテリアルの組み合わせに対応するバッチを探す（なければ作る）
+	int32 FindOrAddBatch(UStaticMesh* Mesh, const TArray<UMaterialInterface*>& Materials);
+
+	struct FBatch
+	{
+		UStaticMesh* Mesh = nullptr;
+		TArray<UMaterialInterface*> Materials;
+
+		//共有インスタンス（ホストアクタが持ち、mComponents でGCから守る）
+		UInstancedStaticMeshComponent* Component = nullptr;
+
+		//スロット → インスタンス番号、インスタンス番号 → スロット
+		TArray<int32> SlotToInstance;
+		TArray<int32> InstanceToSlot;
+
+		//スロットごとの元のコンポーネントと移動通知の登録ハンドル
+		TArray<TWeakObjectPtr<UStaticMeshComponent>> Sources;
+		TArray<FDelegateHandle> TransformHandles;
+
+		//空きスロット
+		TArray<int32> FreeSlots;
+
+		//このフレームで位置が変わったか
+		bool bDirty = false;
+	};
+
+	TArray<FBatch> mBatches;
+
+	//共有インスタンスを持つアクタ
+	UPROPERTY()
+	TObjectPtr<AActor> mHost;
+
+	//バッチが持つコンポーネントをGCから守る
+	UPROPERTY()
+	TArray<TObjectPtr<UInstancedStaticMeshComponent>> mComponents;
+};
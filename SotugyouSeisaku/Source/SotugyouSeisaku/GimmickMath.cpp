@@ -0,0 +1,408 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GimmickMath.h"
+
+namespace GimmickMath
+{
+	//ゼロとみなすブロックからプレイヤーまでの水平距離の2乗
+	static constexpr float ZeroDistanceSq = KINDA_SMALL_NUMBER * KINDA_SMALL_NUMBER;
+
+	/// @brief まとめて計算する動く床の1個分を求める（4個に満たない端数用、SIMD 版と同じ式）
+	static void EvaluateFloorOffsetAt(const FFloorBatch& Floors, int32 Index, float Time, float& OutX, float& OutY, float& OutZ)
+	{
+		Time = FMath::Max(Time, 0.0f);
+		const float Travel = Floors.TravelTime[Index];
+		const float Wait = Floors.WaitTime[Index];
+		const float Phase = FMath::Fmod(Time, 2.0f * (Travel + Wait));
+		const float Alpha = FMath::Clamp(Phase / Travel, 0.0f, 1.0f) - FMath::Clamp((Phase - Travel - Wait) / Travel, 0.0f, 1.0f);
+
+		const float Angle = FMath::Fmod(Floors.AngularSpeed[Index] * Time, 2.0f * PI);
+		float Sin;
+		float Cos;
+		FMath::SinCos(&Sin, &Cos, Angle);
+
+		OutX = Floors.RouteX[Index] * Alpha + Floors.CircleUX[Index] * Cos + Floors.CircleVX[Index] * Sin;
+		OutY = Floors.RouteY[Index] * Alpha + Floors.CircleUY[Index] * Cos + Floors.CircleVY[Index] * Sin;
+		OutZ = Floors.RouteZ[Index] * Alpha + Floors.CircleUZ[Index] * Cos + Floors.CircleVZ[Index] * Sin;
+	}
+}
+
+/// @brief 円運動かどうか
+/// @param Pattern 移動パターン
+bool GimmickMath::IsCircular(EFloorPattern Pattern)
+{
+	return Pattern == EFloorPattern::Circle_XY ||
+		Pattern == EFloorPattern::Circle_XZ ||
+		Pattern == EFloorPattern::Circle_YZ;
+}
+
+/// @brief 開始位置から終了位置までの移動量を求める
+/// @param Pattern 移動パターン
+/// @param Distance 移動距離（斜めは移動量の長さがこの距離になる）
+/// @param CustomOffset カスタムの移動量
+/// @return 移動量（円運動ではゼロ）
+FVector GimmickMath::GetRouteOffset(EFloorPattern Pattern, double Distance, const FVector& CustomOffset)
+{
+	const double HalfDist = Distance / FMath::Sqrt(2.0);
+
+	switch (Pattern)
+	{
+	case EFloorPattern::Horizontal_X://X軸方向への水平移動
+		return FVector(Distance, 0.0, 0.0);
+
+	case EFloorPattern::Horizontal_Y://Y軸方向への水平移動
+		return FVector(0.0, Distance, 0.0);
+
+	case EFloorPattern::Vertical_Z://Z軸方向への垂直移動
+		return FVector(0.0, 0.0, Distance);
+
+	case EFloorPattern::Diagonal_XY://XY平面上の斜め移動
+		return FVector(HalfDist, HalfDist, 0.0);
+
+	case EFloorPattern::Diagonal_XZ://XZ平面上の斜め移動
+		return FVector(HalfDist, 0.0, HalfDist);
+
+	case EFloorPattern::Diagonal_YZ://YZ平面上の斜め移動
+		return FVector(0.0, HalfDist, HalfDist);
+
+	case EFloorPattern::Custom:
+		return CustomOffset;
+
+	default://円運動
+		return FVector::ZeroVector;
+	}
+}
+
+/// @brief 円運動の中心からの位置を求める
+/// @param Pattern 移動パターン
+/// @param Radius 半径
+/// @param Angle 角度（ラジアン）
+/// @return 中心からの位置（円運動でなければゼロ）
+FVector GimmickMath::GetCircleOffset(EFloorPattern Pattern, double Radius, double Angle)
+{
+	double Sin;
+	double Cos;
+	FMath::SinCos(&Sin, &Cos, Angle);
+
+	switch (Pattern)
+	{
+	case EFloorPattern::Circle_XY:
+		return FVector(Cos * Radius, Sin * Radius, 0.0);
+
+	case EFloorPattern::Circle_XZ:
+		return FVector(Cos * Radius, 0.0, Sin * Radius);
+
+	case EFloorPattern::Circle_YZ:
+		return FVector(0.0, Cos * Radius, Sin * Radius);
+
+	default:
+		return FVector::ZeroVector;
+	}
+}
+
+/// @brief 目標位置に向かって一定速度で1フレーム進める
+/// @param Current 今の位置
+/// @param Target 目標位置
+/// @param DeltaTime 経過時間
+/// @param Speed 速度（cm / 秒）
+/// @param bOutArrived 目標位置まで ArriveTolerance 未満になったか
+/// @return 進めた位置
+FVector GimmickMath::StepTowards(const FVector& Current, const FVector& Target, double DeltaTime, double Speed, bool& bOutArrived)
+{
+	const FVector NewPosition = FMath::VInterpConstantTo(Current, Target, DeltaTime, Speed);
+	bOutArrived = FVector::Dist(NewPosition, Target) < ArriveTolerance;
+	return NewPosition;
+}
+
+/// @brief 円運動の角度を1フレーム進める
+/// @param Angle 今の角度（0〜2π）
+/// @param Speed 速度（cm / 秒）
+/// @param Radius 半径
+/// @param DeltaTime 経過時間
+/// @return 進めた角度（0〜2π）
+float GimmickMath::AdvanceCircleAngle(float Angle, float Speed, float Radius, float DeltaTime)
+{
+	if (Radius <= 0.0f)
+	{
+		return Angle;
+	}
+
+	//角速度 = 速度 / 半径
+	Angle += Speed / Radius * DeltaTime;
+	if (Angle >= 2.0f * PI)
+	{
+		Angle -= 2.0f * PI;
+	}
+	return Angle;
+}
+
+/// @brief 動き始めてから指定秒数後の位置を求める
+///        往復は 行き（片道の時間）→ 終了位置で待機 → 帰り → 開始位置で待機 を繰り返す
+/// @param Floor 床の設定
+/// @param Time 動き始めてからの秒数
+/// @return 開始位置（円運動では中心）からの位置
+FVector3f GimmickMath::SampleFloorOffset(const FFloorParams& Floor, float Time)
+{
+	Time = FMath::Max(Time, 0.0f);
+
+	if (IsCircular(Floor.Pattern))
+	{
+		if (Floor.Distance <= 0.0f)
+		{
+			return FVector3f::ZeroVector;
+		}
+		const float Angle = FMath::Fmod(Floor.Speed / Floor.Distance * Time, 2.0f * PI);
+		return FVector3f(GetCircleOffset(Floor.Pattern, Floor.Distance, Angle));
+	}
+
+	const FVector3f Route(GetRouteOffset(Floor.Pattern, Floor.Distance, FVector(Floor.CustomOffset)));
+	if (Floor.Speed <= 0.0f)
+	{
+		return FVector3f::ZeroVector;
+	}
+
+	const float Travel = FMath::Max(Route.Size() / Floor.Speed, SMALL_NUMBER);
+	const float Wait = FMath::Max(Floor.WaitTime, 0.0f);
+	const float Phase = FMath::Fmod(Time, 2.0f * (Travel + Wait));
+	const float Alpha = FMath::Clamp(Phase / Travel, 0.0f, 1.0f) - FMath::Clamp((Phase - Travel - Wait) / Travel, 0.0f, 1.0f);
+	return Route * Alpha;
+}
+
+void GimmickMath::FFloorBatch::Reserve(int32 Num)
+{
+	for (TArray<float>* Array : { &RouteX, &RouteY, &RouteZ, &TravelTime, &WaitTime, &AngularSpeed, &CircleUX, &CircleUY, &CircleUZ, &CircleVX, &CircleVY, &CircleVZ })
+	{
+		Array->Reserve(Num);
+	}
+}
+
+/// @brief 床を加える（SampleFloorOffset と同じ動きになるよう、往復と円運動を同じ式の係数にする）
+/// @param Floor 床の設定
+void GimmickMath::FFloorBatch::Add(const FFloorParams& Floor)
+{
+	FVector3f Route = FVector3f::ZeroVector;
+	FVector3f CircleU = FVector3f::ZeroVector;
+	FVector3f CircleV = FVector3f::ZeroVector;
+	float Travel = 1.0f;
+	float Wait = 0.0f;
+	float Angular = 0.0f;
+
+	if (IsCircular(Floor.Pattern))
+	{
+		if (Floor.Distance > 0.0f)
+		{
+			//角度 0 と π/2 の位置が円の2軸
+			CircleU = FVector3f(GetCircleOffset(Floor.Pattern, Floor.Distance, 0.0));
+			CircleV = FVector3f(GetCircleOffset(Floor.Pattern, Floor.Distance, 0.5 * PI));
+			Angular = Floor.Speed / Floor.Distance;
+		}
+	}
+	else if (Floor.Speed > 0.0f)
+	{
+		Route = FVector3f(GetRouteOffset(Floor.Pattern, Floor.Distance, FVector(Floor.CustomOffset)));
+		Travel = FMath::Max(Route.Size() / Floor.Speed, SMALL_NUMBER);
+		Wait = FMath::Max(Floor.WaitTime, 0.0f);
+	}
+
+	RouteX.Add(Route.X);
+	RouteY.Add(Route.Y);
+	RouteZ.Add(Route.Z);
+	TravelTime.Add(Travel);
+	WaitTime.Add(Wait);
+	AngularSpeed.Add(Angular);
+	CircleUX.Add(CircleU.X);
+	CircleUY.Add(CircleU.Y);
+	CircleUZ.Add(CircleU.Z);
+	CircleVX.Add(CircleV.X);
+	CircleVY.Add(CircleV.Y);
+	CircleVZ.Add(CircleV.Z);
+}
+
+/// @brief 床ごとの経過時間から位置をまとめて求める（4個ずつ SIMD で、端数は1個ずつ）
+/// @param Floors 床
+/// @param Times 床ごとの動き始めてからの秒数（Floors.Num() 個）
+/// @param OutX, OutY, OutZ 開始位置（円運動では中心）からの位置（Floors.Num() 個）
+void GimmickMath::EvaluateFloorOffsets(const FFloorBatch& Floors, const float* Times, float* OutX, float* OutY, float* OutZ)
+{
+	const int32 Num = Floors.Num();
+	const VectorRegister4Float Zero = VectorZeroFloat();
+	const VectorRegister4Float One = VectorOneFloat();
+	const VectorRegister4Float Two = VectorSetFloat1(2.0f);
+	const VectorRegister4Float TwoPi = VectorSetFloat1(2.0f * PI);
+
+	int32 i = 0;
+	for (; i + 4 <= Num; i += 4)
+	{
+		const VectorRegister4Float Time = VectorMax(VectorLoad(Times + i), Zero);
+		const VectorRegister4Float Travel = VectorLoad(Floors.TravelTime.GetData() + i);
+		const VectorRegister4Float TravelAndWait = VectorAdd(Travel, VectorLoad(Floors.WaitTime.GetData() + i));
+
+		//往復の進み具合（行きで 0→1、帰りで 1→0、待機中はそのまま）
+		const VectorRegister4Float Phase = VectorMod(Time, VectorMultiply(Two, TravelAndWait));
+		const VectorRegister4Float Out = VectorMin(VectorMax(VectorDivide(Phase, Travel), Zero), One);
+		const VectorRegister4Float Back = VectorMin(VectorMax(VectorDivide(VectorSubtract(Phase, TravelAndWait), Travel), Zero), One);
+		const VectorRegister4Float Alpha = VectorSubtract(Out, Back);
+
+		//円運動の角度
+		const VectorRegister4Float Angle = VectorMod(VectorMultiply(VectorLoad(Floors.AngularSpeed.GetData() + i), Time), TwoPi);
+		VectorRegister4Float Sin;
+		VectorRegister4Float Cos;
+		VectorSinCos(&Sin, &Cos, &Angle);
+
+		auto Axis = [&](const TArray<float>& Route, const TArray<float>& CircleU, const TArray<float>& CircleV, float* Output)
+		{
+			VectorRegister4Float Result = VectorMultiply(VectorLoad(CircleV.GetData() + i), Sin);
+			Result = VectorMultiplyAdd(VectorLoad(CircleU.GetData() + i), Cos, Result);
+			Result = VectorMultiplyAdd(VectorLoad(Route.GetData() + i), Alpha, Result);
+			VectorStore(Result, Output + i);
+		};
+		Axis(Floors.RouteX, Floors.CircleUX, Floors.CircleVX, OutX);
+		Axis(Floors.RouteY, Floors.CircleUY, Floors.CircleVY, OutY);
+		Axis(Floors.RouteZ, Floors.CircleUZ, Floors.CircleVZ, OutZ);
+	}
+
+	for (; i < Num; i++)
+	{
+		EvaluateFloorOffsetAt(Floors, i, Times[i], OutX[i], OutY[i], OutZ[i]);
+	}
+}
+
+/// @brief 押せる向きの判定に使う角度の cos を求める
+///        角度を比べる代わりに cos を比べるので、判定ごとに Acos を呼ばずに済む
+/// @param AngleDegrees 押せる面の反対側からずれてよい角度（度）
+/// @return cos（0 未満は 2 = 押せない、180 以上は -2 = どこからでも押せる）
+float GimmickMath::PushConeCos(float AngleDegrees)
+{
+	if (AngleDegrees < 0.0f)
+	{
+		return 2.0f;
+	}
+	if (AngleDegrees >= 180.0f)
+	{
+		return -2.0f;
+	}
+	return FMath::Cos(FMath::DegreesToRadians(AngleDegrees));
+}
+
+/// @brief 押せる面の向きを水平にして正規化する
+/// @param WorldPushDir ワールド座標の押せる面の向き
+/// @return 水平の単位ベクトル（真上・真下ならゼロ）
+FVector GimmickMath::GetPushDir2D(const FVector& WorldPushDir)
+{
+	return FVector(WorldPushDir.X, WorldPushDir.Y, 0.0).GetSafeNormal();
+}
+
+/// @brief ブロックからプレイヤーへの向きが、押せる面の反対側の円錐に入っているか
+///        角度 <= 押せる角度 を、-(向き・面の向き) >= cos(押せる角度) × 距離 で判定する
+/// @param ToPlayer ブロックからプレイヤーへのベクトル（高さは無視する）
+/// @param PushDir2D 水平の押せる面の向き（GetPushDir2D）
+/// @param ConeCos 押せる角度の cos（PushConeCos）
+/// @return 押せるか（プレイヤーがブロックの真上・真下なら押せない）
+bool GimmickMath::IsInPushCone(const FVector& ToPlayer, const FVector& PushDir2D, float ConeCos)
+{
+	const double LengthSq = ToPlayer.X * ToPlayer.X + ToPlayer.Y * ToPlayer.Y;
+	if (LengthSq <= ZeroDistanceSq)
+	{
+		return false;
+	}
+
+	const double NegDot = -(ToPlayer.X * PushDir2D.X + ToPlayer.Y * PushDir2D.Y);
+	return NegDot >= ConeCos * FMath::Sqrt(LengthSq);
+}
+
+void GimmickMath::FPushConeBatch::Reserve(int32 Num)
+{
+	for (TArray<float>* Array : { &BlockX, &BlockY, &DirX, &DirY, &ConeCos })
+	{
+		Array->Reserve(Num);
+	}
+}
+
+/// @brief ブロックを加える
+/// @param BlockLocation ブロックの位置
+/// @param PushDir2D 水平の押せる面の向き（GetPushDir2D）
+/// @param InConeCos 押せる角度の cos（PushConeCos）
+void GimmickMath::FPushConeBatch::Add(const FVector& BlockLocation, const FVector& PushDir2D, float InConeCos)
+{
+	BlockX.Add(BlockLocation.X);
+	BlockY.Add(BlockLocation.Y);
+	DirX.Add(PushDir2D.X);
+	DirY.Add(PushDir2D.Y);
+	ConeCos.Add(InConeCos);
+}
+
+/// @brief ブロックごとのプレイヤーの位置から押せるかをまとめて判定する（4個ずつ SIMD で、端数は1個ずつ）
+/// @param Cones ブロック
+/// @param PlayerX, PlayerY ブロックごとのプレイヤーの位置（Cones.Num() 個）
+/// @param OutCanPush 押せれば 1（Cones.Num() 個）
+void GimmickMath::TestPushCones(const FPushConeBatch& Cones, const float* PlayerX, const float* PlayerY, uint8* OutCanPush)
+{
+	const int32 Num = Cones.Num();
+	const VectorRegister4Float ZeroSq = VectorSetFloat1(ZeroDistanceSq);
+
+	int32 i = 0;
+	for (; i + 4 <= Num; i += 4)
+	{
+		const VectorRegister4Float ToX = VectorSubtract(VectorLoad(PlayerX + i), VectorLoad(Cones.BlockX.GetData() + i));
+		const VectorRegister4Float ToY = VectorSubtract(VectorLoad(PlayerY + i), VectorLoad(Cones.BlockY.GetData() + i));
+		const VectorRegister4Float LengthSq = VectorMultiplyAdd(ToX, ToX, VectorMultiply(ToY, ToY));
+
+		const VectorRegister4Float Dot = VectorMultiplyAdd(ToX, VectorLoad(Cones.DirX.GetData() + i), VectorMultiply(ToY, VectorLoad(Cones.DirY.GetData() + i)));
+		const VectorRegister4Float Limit = VectorMultiply(VectorLoad(Cones.ConeCos.GetData() + i), VectorSqrt(LengthSq));
+		const VectorRegister4Float InCone = VectorBitwiseAnd(VectorCompareGE(VectorNegate(Dot), Limit), VectorCompareGT(LengthSq, ZeroSq));
+
+		const int32 Mask = VectorMaskBits(InCone);
+		OutCanPush[i + 0] = (Mask >> 0) & 1;
+		OutCanPush[i + 1] = (Mask >> 1) & 1;
+		OutCanPush[i + 2] = (Mask >> 2) & 1;
+		OutCanPush[i + 3] = (Mask >> 3) & 1;
+	}
+
+	for (; i < Num; i++)
+	{
+		const FVector ToPlayer(PlayerX[i] - Cones.BlockX[i], PlayerY[i] - Cones.BlockY[i], 0.0f);
+		OutCanPush[i] = IsInPushCone(ToPlayer, FVector(Cones.DirX[i], Cones.DirY[i], 0.0f), Cones.ConeCos[i]) ? 1 : 0;
+	}
+}
+
+/// @brief 落ちる床の揺れを求める（水平に円を描く）
+/// @param Time 揺れ始めてからの秒数
+/// @param Frequency 揺れの速さ
+/// @param Amplitude 揺れの強さ（cm）
+/// @return 元の位置からのずれ
+FVector GimmickMath::GetShakeOffset(float Time, float Frequency, float Amplitude)
+{
+	return FVector(FMath::Sin(Time * Frequency) * Amplitude, FMath::Cos(Time * Frequency) * Amplitude, 0.0f);
+}
+
+/// @brief 揺れをまとめて求める（4個ずつ SIMD で、端数は1個ずつ）
+/// @param Times 床ごとの揺れ始めてからの秒数
+/// @param Frequencies 床ごとの揺れの速さ
+/// @param Amplitudes 床ごとの揺れの強さ
+/// @param Num 床の数
+/// @param OutX, OutY 元の位置からのずれ
+void GimmickMath::EvaluateShakeOffsets(const float* Times, const float* Frequencies, const float* Amplitudes, int32 Num, float* OutX, float* OutY)
+{
+	const VectorRegister4Float TwoPi = VectorSetFloat1(2.0f * PI);
+
+	int32 i = 0;
+	for (; i + 4 <= Num; i += 4)
+	{
+		//SIMD の sin / cos は範囲が狭いほど正確なので 0〜2π に戻してから求める
+		const VectorRegister4Float Angle = VectorMod(VectorMultiply(VectorLoad(Times + i), VectorLoad(Frequencies + i)), TwoPi);
+		VectorRegister4Float Sin;
+		VectorRegister4Float Cos;
+		VectorSinCos(&Sin, &Cos, &Angle);
+
+		const VectorRegister4Float Amplitude = VectorLoad(Amplitudes + i);
+		VectorStore(VectorMultiply(Sin, Amplitude), OutX + i);
+		VectorStore(VectorMultiply(Cos, Amplitude), OutY + i);
+	}
+
+	for (; i < Num; i++)
+	{
+		const FVector Offset = GetShakeOffset(Times[i], Frequencies[i], Amplitudes[i]);
+		OutX[i] = Offset.X;
+		OutY[i] = Offset.Y;
+	}
+}
@@ -0,0 +1,158 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/// @brief ギミックの計算（動く床の位置・押せる向き・ボタンの順番・落ちる床の揺れ）
+///
+///        Core モジュールの型だけを使う純粋な関数で、アクタ・ワールド・UObject に依存しない。
+///        アクタはこの関数を呼ぶだけの薄い包みになっていて、エンジンを起動しなくても同じ計算を確かめられる。
+///        まとめて計算する版（Evaluate* / Test*）は SoA の配列を4個ずつ SIMD レジスタで処理する。
+///        1個ずつの版との一致は自動テスト SotugyouSeisaku.Gimmick.Math（GimmickMathSpec.cpp）、処理時間は -run=GimmickBenchmark -Suite=Math で確かめる
+namespace GimmickMath
+{
+	//動く床の移動パターン（EFloorMovementPattern と同じ並び）
+	enum class EFloorPattern : uint8
+	{
+		Horizontal_X,
+		Horizontal_Y,
+		Vertical_Z,
+		Diagonal_XY,
+		Diagonal_XZ,
+		Diagonal_YZ,
+		Circle_XY,
+		Circle_XZ,
+		Circle_YZ,
+		Custom,
+	};
+
+	//到着したとみなす目標位置までの距離（cm）
+	constexpr double ArriveTolerance = 1.0;
+
+	//円運動かどうか
+	SOTUGYOUSEISAKU_API bool IsCircular(EFloorPattern Pattern);
+
+	//開始位置から終了位置までの移動量（円運動ではゼロ）
+	SOTUGYOUSEISAKU_API FVector GetRouteOffset(EFloorPattern Pattern, double Distance, const FVector& CustomOffset);
+
+	//円運動の中心からの位置（円運動でなければゼロ）
+	SOTUGYOUSEISAKU_API FVector GetCircleOffset(EFloorPattern Pattern, double Radius, double Angle);
+
+	//目標位置に向かって一定速度で1フレーム進める（bOutArrived = 目標位置まで ArriveTolerance 未満になったか）
+	SOTUGYOUSEISAKU_API FVector StepTowards(const FVector& Current, const FVector& Target, double DeltaTime, double Speed, bool& bOutArrived);
+
+	//円運動の角度を1フレーム進める（0〜2π）
+	SOTUGYOUSEISAKU_API float AdvanceCircleAngle(float Angle, float Speed, float Radius, float DeltaTime);
+
+	/// @brief 動く床の設定（まとめて計算する版・時刻から位置を求める版の入力）
+	struct FFloorParams
+	{
+		EFloorPattern Pattern = EFloorPattern::Horizontal_Y;
+		float Distance = 500.0f;
+		FVector3f CustomOffset = FVector3f(0.0f, 500.0f, 0.0f);
+		float Speed = 200.0f;
+		float WaitTime = 1.0f;
+	};
+
+	//動き始めてから Time 秒後の開始位置からの位置（往復は 行き→待機→帰り→待機 の周期、円運動は一定の角速度）
+	SOTUGYOUSEISAKU_API FVector3f SampleFloorOffset(const FFloorParams& Floor, float Time);
+
+	/// @brief まとめて計算する動く床（SoA）
+	///        往復と円運動を分けずに 移動量 × 往復の進み具合 + 円の2軸 × (cos, sin) で求める（往復では円の軸がゼロ）
+	struct SOTUGYOUSEISAKU_API FFloorBatch
+	{
+		void Reserve(int32 Num);
+		void Add(const FFloorParams& Floor);
+		int32 Num() const { return TravelTime.Num(); }
+
+		//開始位置から終了位置までの移動量
+		TArray<float> RouteX, RouteY, RouteZ;
+
+		//片道の秒数と両端での待機秒数
+		TArray<float> TravelTime, WaitTime;
+
+		//角速度（ラジアン / 秒）
+		TArray<float> AngularSpeed;
+
+		//円の2軸（半径を掛けたもの）
+		TArray<float> CircleUX, CircleUY, CircleUZ;
+		TArray<float> CircleVX, CircleVY, CircleVZ;
+	};
+
+	//床ごとの経過時間から開始位置からの位置を求める
+	SOTUGYOUSEISAKU_API void EvaluateFloorOffsets(const FFloorBatch& Floors, const float* Times, float* OutX, float* OutY, float* OutZ);
+
+	//押せる向きの判定に使う角度の cos（0 未満は押せない、180 以上はどこからでも押せる）
+	SOTUGYOUSEISAKU_API float PushConeCos(float AngleDegrees);
+
+	//押せる面の向きを水平にして正規化する（真上・真下ならゼロ）
+	SOTUGYOUSEISAKU_API FVector GetPushDir2D(const FVector& WorldPushDir);
+
+	//ブロックからプレイヤーへの向きが、押せる面の反対側の円錐（PushConeCos）に入っているか
+	SOTUGYOUSEISAKU_API bool IsInPushCone(const FVector& ToPlayer, const FVector& PushDir2D, float ConeCos);
+
+	/// @brief まとめて判定する押せるブロック（SoA）
+	struct SOTUGYOUSEISAKU_API FPushConeBatch
+	{
+		void Reserve(int32 Num);
+		void Add(const FVector& BlockLocation, const FVector& PushDir2D, float ConeCos);
+		int32 Num() const { return ConeCos.Num(); }
+
+		TArray<float> BlockX, BlockY;
+		TArray<float> DirX, DirY;
+		TArray<float> ConeCos;
+	};
+
+	//ブロックごとのプレイヤーの位置から押せるかを判定する（1 = 押せる）
+	SOTUGYOUSEISAKU_API void TestPushCones(const FPushConeBatch& Cones, const float* PlayerX, const float* PlayerY, uint8* OutCanPush);
+
+	//ボタンの順番の進み具合
+	struct FSequenceState
+	{
+		int32 Step = 0;
+		bool bCompleted = false;
+	};
+
+	//ボタンを押した結果
+	enum class ESequenceResult : uint8
+	{
+		Ignored,	//クリア済みなので何もしない
+		Advanced,	//正しいボタンを押した
+		Completed,	//正しいボタンを押して最後まで進んだ
+		Failed,		//間違ったボタンを押した
+	};
+
+	/// @brief ボタンを押したときに順番を進める
+	/// @param State 進み具合（正しければ進む）
+	/// @param Sequence 押す順番に並んだボタン
+	/// @param Num ボタンの数
+	/// @param Pressed 押されたボタン
+	/// @param bResetAfterSuccess クリア後もやり直せるか（false ならクリア後は何もしない）
+	/// @return 結果
+	template <typename ButtonType>
+	ESequenceResult PressSequenceButton(FSequenceState& State, const ButtonType* Sequence, int32 Num, const ButtonType& Pressed, bool bResetAfterSuccess)
+	{
+		if (State.bCompleted && !bResetAfterSuccess)
+		{
+			return ESequenceResult::Ignored;
+		}
+		if (State.Step < Num && Sequence[State.Step] == Pressed)
+		{
+			State.Step++;
+			if (State.Step >= Num)
+			{
+				State.bCompleted = true;
+				return ESequenceResult::Completed;
+			}
+			return ESequenceResult::Advanced;
+		}
+		return ESequenceResult::Failed;
+	}
+
+	//落ちる床の揺れ（揺れ始めてから Time 秒後の元の位置からのずれ）
+	SOTUGYOUSEISAKU_API FVector GetShakeOffset(float Time, float Frequency, float Amplitude);
+
+	//床ごとの揺れの経過時間・速さ・強さからずれをまとめて求める
+	SOTUGYOUSEISAKU_API void EvaluateShakeOffsets(const float* Times, const float* Frequencies, const float* Amplitudes, int32 Num, float* OutX, float* OutY);
+}
@@ -0,0 +1,284 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GimmickMath.h"
+#include "GimmickConfig.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+/// @brief ギミックの計算（GimmickMath）の自動テスト
+///        ワールドもアクタも作らないので、エディタの Session Frontend か
+///        -ExecCmds="Automation RunTests SotugyouSeisaku.Gimmick.Math" で数ミリ秒で終わる（処理時間は -run=GimmickBenchmark -Suite=Math）
+BEGIN_DEFINE_SPEC(FGimmickMathSpec, "SotugyouSeisaku.Gimmick.Math", EAutomationTestFlags_ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+	//まとめて計算する版と比べる数
+	static constexpr int32 Count = 4096;
+
+	//1フレームずつ進めるときの刻み（60fps）
+	static constexpr float FrameDeltaTime = 1.0f / 60.0f;
+
+	static constexpr int32 PatternCount = static_cast<int32>(GimmickMath::EFloorPattern::Custom) + 1;
+
+	/// @brief 元の押せる向きの判定（正規化して Acos で角度を比べる）
+	/// @param OutMarginDegrees 境界までの角度（丸め誤差で結果が変わりうるかの目安）
+	static bool ReferenceCanPush(const FVector& ToPlayer, const FVector& PushDir, float PushAngle, double& OutMarginDegrees)
+	{
+		FVector Dir = ToPlayer;
+		Dir.Z = 0.0f;
+		if (Dir.IsNearlyZero())
+		{
+			OutMarginDegrees = 180.0;
+			return false;
+		}
+		Dir.Normalize();
+		FVector Face = PushDir;
+		Face.Z = 0.0f;
+		Face.Normalize();
+		const double AngleDegrees = FMath::RadiansToDegrees(FMath::Acos(FMath::Clamp(-FVector::DotProduct(Dir, Face), -1.0, 1.0)));
+		OutMarginDegrees = FMath::Abs(AngleDegrees - PushAngle);
+		return AngleDegrees <= PushAngle;
+	}
+
+END_DEFINE_SPEC(FGimmickMathSpec)
+
+void FGimmickMathSpec::Define()
+{
+	using namespace GimmickMath;
+
+	Describe("FloorPattern", [this]()
+	{
+		It("maps every EFloorMovementPattern to the GimmickMath pattern of the same name", [this]()
+		{
+			//GimmickMath::EFloorPattern の並び
+			static const TCHAR* MathNames[] = {
+				TEXT("Horizontal_X"), TEXT("Horizontal_Y"), TEXT("Vertical_Z"),
+				TEXT("Diagonal_XY"), TEXT("Diagonal_XZ"), TEXT("Diagonal_YZ"),
+				TEXT("Circle_XY"), TEXT("Circle_XZ"), TEXT("Circle_YZ"),
+				TEXT("Custom"),
+			};
+			static_assert(UE_ARRAY_COUNT(MathNames) == PatternCount, "MathNames must list every GimmickMath::EFloorPattern");
+
+			const UEnum* PatternEnum = StaticEnum<EFloorMovementPattern>();
+			TestEqual(TEXT("pattern count"), PatternEnum->NumEnums() - 1, PatternCount);
+
+			for (int32 i = 0; i < PatternEnum->NumEnums() - 1; i++)
+			{
+				const FString Name = PatternEnum->GetNameStringByIndex(i);
+				const int32 Mapped = static_cast<int32>(GimmickConfig::ToMathPattern(static_cast<EFloorMovementPattern>(PatternEnum->GetValueByIndex(i))));
+				if (TestTrue(FString::Printf(TEXT("%s maps into range"), *Name), Mapped >= 0 && Mapped < PatternCount))
+				{
+					TestEqual(FString::Printf(TEXT("%s maps to"), *Name), FString(MathNames[Mapped]), Name);
+				}
+			}
+		});
+	});
+
+	Describe("MoveFloor", [this]()
+	{
+		It("moves the full distance on every straight pattern and stays put on circles", [this]()
+		{
+			for (int32 i = 0; i < PatternCount; i++)
+			{
+				const EFloorPattern Pattern = static_cast<EFloorPattern>(i);
+				const double Length = GetRouteOffset(Pattern, 500.0, FVector(0.0, 300.0, 400.0)).Size();
+				TestEqual(FString::Printf(TEXT("route offset length of pattern %d"), i), Length, IsCircular(Pattern) ? 0.0 : 500.0, 0.01);
+			}
+		});
+
+		It("samples the same position as stepping frame by frame", [this]()
+		{
+			for (int32 i = 0; i < PatternCount; i++)
+			{
+				FFloorParams Floor;
+				Floor.Pattern = static_cast<EFloorPattern>(i);
+				Floor.CustomOffset = FVector3f(0.0f, 300.0f, 400.0f);
+
+				//アクタと同じく、行き→待機→帰り→待機 を1フレームずつ進める
+				const FVector Route = GetRouteOffset(Floor.Pattern, Floor.Distance, FVector(Floor.CustomOffset));
+				FVector Position = IsCircular(Floor.Pattern) ? GetCircleOffset(Floor.Pattern, Floor.Distance, 0.0) : FVector::ZeroVector;
+				float Angle = 0.0f;
+				int32 Direction = 1;
+				float WaitElapsed = -1.0f;
+				double MaxError = 0.0;
+
+				const int32 Frames = FMath::CeilToInt32(2.0f * (Route.Size() / Floor.Speed + Floor.WaitTime) / FrameDeltaTime);
+				for (int32 Frame = 1; Frame <= Frames; Frame++)
+				{
+					if (IsCircular(Floor.Pattern))
+					{
+						Angle = AdvanceCircleAngle(Angle, Floor.Speed, Floor.Distance, FrameDeltaTime);
+						Position = GetCircleOffset(Floor.Pattern, Floor.Distance, Angle);
+					}
+					else if (WaitElapsed >= 0.0f)
+					{
+						WaitElapsed += FrameDeltaTime;
+						if (WaitElapsed >= Floor.WaitTime)
+						{
+							WaitElapsed = -1.0f;
+							Direction *= -1;
+						}
+					}
+					else
+					{
+						bool bArrived = false;
+						const FVector Target = Direction == 1 ? Route : FVector::ZeroVector;
+						Position = StepTowards(Position, Target, FrameDeltaTime, Floor.Speed, bArrived);
+						if (bArrived)
+						{
+							Position = Target;
+							WaitElapsed = 0.0f;
+						}
+					}
+					MaxError = FMath::Max(MaxError, FVector::Dist(Position, FVector(SampleFloorOffset(Floor, Frame * FrameDeltaTime))));
+				}
+
+				//待機の始まりと終わりがフレーム単位になる分はずれてよい
+				const double Tolerance = 4.0 * Floor.Speed * FrameDeltaTime;
+				TestTrue(FString::Printf(TEXT("sampled floor of pattern %d drifts %.2f cm from the stepped floor (tolerance %.2f)"), i, MaxError, Tolerance),
+					MaxError <= Tolerance);
+			}
+		});
+
+		It("evaluates batched floors like single floors", [this]()
+		{
+			FRandomStream Random(Count);
+			FFloorBatch Floors;
+			TArray<FFloorParams> FloorParams;
+			TArray<float> Times;
+			Floors.Reserve(Count);
+			FloorParams.Reserve(Count);
+			Times.Reserve(Count);
+			for (int32 i = 0; i < Count; i++)
+			{
+				FFloorParams& Floor = FloorParams.AddDefaulted_GetRef();
+				Floor.Pattern = static_cast<EFloorPattern>(Random.RandHelper(PatternCount));
+				Floor.Distance = Random.FRandRange(100.0f, 1000.0f);
+				Floor.CustomOffset = FVector3f(Random.VRand()) * Random.FRandRange(100.0f, 1000.0f);
+				Floor.Speed = Random.FRandRange(50.0f, 500.0f);
+				Floor.WaitTime = Random.FRandRange(0.0f, 2.0f);
+				Floors.Add(Floor);
+				Times.Add(Random.FRandRange(0.0f, 100.0f));
+			}
+
+			TArray<float> OutX, OutY, OutZ;
+			OutX.SetNumUninitialized(Count);
+			OutY.SetNumUninitialized(Count);
+			OutZ.SetNumUninitialized(Count);
+			EvaluateFloorOffsets(Floors, Times.GetData(), OutX.GetData(), OutY.GetData(), OutZ.GetData());
+
+			double MaxError = 0.0;
+			for (int32 i = 0; i < Count; i++)
+			{
+				MaxError = FMath::Max(MaxError, static_cast<double>(FVector3f::Dist(SampleFloorOffset(FloorParams[i], Times[i]), FVector3f(OutX[i], OutY[i], OutZ[i]))));
+			}
+			TestTrue(FString::Printf(TEXT("batched floors differ from single floors by %.4f cm"), MaxError), MaxError <= 0.05);
+		});
+	});
+
+	Describe("PushCone", [this]()
+	{
+		It("agrees with the Acos test and the batched test", [this]()
+		{
+			FRandomStream Random(Count);
+			FPushConeBatch Cones;
+			TArray<float> PlayerX, PlayerY;
+			Cones.Reserve(Count);
+			PlayerX.SetNumUninitialized(Count);
+			PlayerY.SetNumUninitialized(Count);
+
+			int32 AcosMismatches = 0;
+			for (int32 i = 0; i < Count; i++)
+			{
+				//たまに真上向き（押せる面が水平にない）・押せない角度・どこからでも押せる角度を混ぜる
+				const FVector Block(Random.FRandRange(-5000.0f, 5000.0f), Random.FRandRange(-5000.0f, 5000.0f), 0.0f);
+				const FVector PushDir = (i % 17 == 0) ? FVector::UpVector : Random.VRand();
+				const float Angle = (i % 13 == 0) ? -10.0f : (i % 11 == 0 ? 190.0f : Random.FRandRange(0.0f, 180.0f));
+				const FVector Player = Block + Random.VRand() * Random.FRandRange(50.0f, 300.0f);
+
+				const FVector PushDir2D = GetPushDir2D(PushDir);
+				const float ConeCos = PushConeCos(Angle);
+				Cones.Add(Block, PushDir2D, ConeCos);
+				PlayerX[i] = Player.X;
+				PlayerY[i] = Player.Y;
+
+				//境界ぎりぎりは丸め誤差で変わるので比べない
+				double MarginDegrees = 0.0;
+				const bool bReference = ReferenceCanPush(Player - Block, PushDir, Angle, MarginDegrees);
+				if (MarginDegrees > 0.01 && bReference != IsInPushCone(Player - Block, PushDir2D, ConeCos))
+				{
+					AcosMismatches++;
+				}
+			}
+			TestEqual(TEXT("cases where the push cone differs from the Acos test"), AcosMismatches, 0);
+
+			TArray<uint8> CanPush;
+			CanPush.SetNumUninitialized(Count);
+			TestPushCones(Cones, PlayerX.GetData(), PlayerY.GetData(), CanPush.GetData());
+
+			int32 BatchMismatches = 0;
+			for (int32 i = 0; i < Count; i++)
+			{
+				const FVector ToPlayer(PlayerX[i] - Cones.BlockX[i], PlayerY[i] - Cones.BlockY[i], 0.0f);
+				const FVector PushDir2D(Cones.DirX[i], Cones.DirY[i], 0.0f);
+				const double Margin = -(ToPlayer | PushDir2D) - Cones.ConeCos[i] * ToPlayer.Size2D();
+				if (FMath::Abs(Margin) > 0.01 && (CanPush[i] != 0) != IsInPushCone(ToPlayer, PushDir2D, Cones.ConeCos[i]))
+				{
+					BatchMismatches++;
+				}
+			}
+			TestEqual(TEXT("cases where the batched push cone differs from the single one"), BatchMismatches, 0);
+		});
+	});
+
+	Describe("ButtonSequence", [this]()
+	{
+		It("advances on the right button, fails on a wrong one and ignores presses after completion", [this]()
+		{
+			const int32 Sequence[] = { 10, 20, 30 };
+			FSequenceState State;
+
+			TestTrue(TEXT("wrong first button fails"), PressSequenceButton(State, Sequence, 3, 20, false) == ESequenceResult::Failed && State.Step == 0);
+			TestTrue(TEXT("first button advances"), PressSequenceButton(State, Sequence, 3, 10, false) == ESequenceResult::Advanced && State.Step == 1);
+			TestTrue(TEXT("skipped button fails"), PressSequenceButton(State, Sequence, 3, 30, false) == ESequenceResult::Failed && State.Step == 1);
+			TestTrue(TEXT("second button advances"), PressSequenceButton(State, Sequence, 3, 20, false) == ESequenceResult::Advanced && State.Step == 2);
+			TestTrue(TEXT("last button completes"), PressSequenceButton(State, Sequence, 3, 30, false) == ESequenceResult::Completed && State.bCompleted);
+			TestTrue(TEXT("completed sequence is ignored"), PressSequenceButton(State, Sequence, 3, 10, false) == ESequenceResult::Ignored);
+			TestTrue(TEXT("completed sequence with reset fails on a new press"), PressSequenceButton(State, Sequence, 3, 10, true) == ESequenceResult::Failed);
+
+			FSequenceState Empty;
+			TestTrue(TEXT("empty sequence fails"), PressSequenceButton(Empty, Sequence, 0, 10, false) == ESequenceResult::Failed);
+		});
+	});
+
+	Describe("Shake", [this]()
+	{
+		It("evaluates batched shakes like single shakes", [this]()
+		{
+			FRandomStream Random(Count);
+			TArray<float> Times, Frequencies, Amplitudes, OutX, OutY;
+			Times.SetNumUninitialized(Count);
+			Frequencies.SetNumUninitialized(Count);
+			Amplitudes.SetNumUninitialized(Count);
+			OutX.SetNumUninitialized(Count);
+			OutY.SetNumUninitialized(Count);
+			for (int32 i = 0; i < Count; i++)
+			{
+				Times[i] = Random.FRandRange(0.0f, 5.0f);
+				Frequencies[i] = Random.FRandRange(5.0f, 40.0f);
+				Amplitudes[i] = Random.FRandRange(1.0f, 10.0f);
+			}
+			EvaluateShakeOffsets(Times.GetData(), Frequencies.GetData(), Amplitudes.GetData(), Count, OutX.GetData(), OutY.GetData());
+
+			double MaxError = 0.0;
+			for (int32 i = 0; i < Count; i++)
+			{
+				const FVector Offset = GetShakeOffset(Times[i], Frequencies[i], Amplitudes[i]);
+				MaxError = FMath::Max(MaxError, FVector2D::Distance(FVector2D(Offset), FVector2D(OutX[i], OutY[i])));
+			}
+			TestTrue(FString::Printf(TEXT("batched shakes differ from single shakes by %.4f cm"), MaxError), MaxError <= 0.01);
+		});
+	});
+}
+
+#endif
@@ -0,0 +1,102 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GimmickBenchmarkFixture.h"
+#include "GimmickOverlapProbeComponent.h"
+#include "Gimmck_MoveFloor.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+/// @brief 動く床が上に乗っているアクターを運ぶ処理（AGimmck_MoveFloor::MoveWithRiders）の自動テスト
+///        床が乗っているアクターから離れる向きに動いても降りたことにならないか、オーバーラップの更新が床と乗っているアクターごとに1フレーム1回かを確かめる
+///        （多数の床での更新回数は -run=GimmickBenchmark -Suite=Transform）
+BEGIN_DEFINE_SPEC(FGimmickMoveFloorSpec, "SotugyouSeisaku.Gimmick.MoveFloor", EAutomationTestFlags_ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+	//計測するフレーム数（床はこの間に端に着かない）
+	static constexpr int32 Frames = 30;
+
+	UWorld* World = nullptr;
+	AGimmck_MoveFloor* Floor = nullptr;
+	AActor* Rider = nullptr;
+	UGimmickOverlapProbeComponent* RiderProbe = nullptr;
+
+	/// @brief 床の上面にわずかに重なる、オーバーラップするだけの小さなボックスを乗せる
+	///        （床は1フレームに重なりの厚みより大きく下がるので、床を先に調べると乗っているアクターが外れる）
+	void SpawnRider()
+	{
+		Rider = World->SpawnActor<AActor>(AActor::StaticClass(), FTransform::Identity);
+		RiderProbe = NewObject<UGimmickOverlapProbeComponent>(Rider);
+		Rider->SetRootComponent(RiderProbe);
+		RiderProbe->SetWorldLocation(Floor->GetActorLocation() + FVector(0.0f, 0.0f, Floor->GetComponentsBoundingBox().GetExtent().Z + 0.5f));
+		RiderProbe->RegisterComponent();
+
+		//登録したときのオーバーラップで乗るが、乗っている状態はここで確実にしておく
+		Floor->mActorsOnFloor.AddUnique(Rider);
+	}
+
+END_DEFINE_SPEC(FGimmickMoveFloorSpec)
+
+void FGimmickMoveFloorSpec::Define()
+{
+	using namespace GimmickBenchmark;
+
+	BeforeEach([this]()
+	{
+		World = CreateBenchmarkWorld(TEXT("MoveFloorSpec"));
+
+		//待たずに真下へ下がり続ける床（1フレームに10cm）
+		UGimmickMoveFloorConfig* Config = NewObject<UGimmickMoveFloorConfig>(World);
+		Config->mSettings.Pattern = EFloorMovementPattern::Custom;
+		Config->mSettings.CustomOffset = FVector(0.0f, 0.0f, -10000.0f);
+		Config->mSettings.Speed = 600.0f;
+		Config->mSettings.WaitTime = 0.0f;
+		Floor = SpawnWithMesh<AGimmck_MoveFloor>(World, FTransform(GridLocation(0)), [Config](AGimmck_MoveFloor& Spawned) { Spawned.mConfig = Config; });
+
+		SpawnRider();
+	});
+
+	AfterEach([this]()
+	{
+		DestroyBenchmarkWorld(World);
+		World = nullptr;
+		Floor = nullptr;
+		Rider = nullptr;
+		RiderProbe = nullptr;
+	});
+
+	Describe("MoveWithRiders", [this]()
+	{
+		It("carries a rider by the floor's own offset even when the floor moves out of it", [this]()
+		{
+			const FVector FloorStart = Floor->GetActorLocation();
+			const FVector RiderOffset = Rider->GetActorLocation() - FloorStart;
+
+			TickWorld(World, Frames);
+
+			TestTrue(TEXT("floor moved"), Floor->GetActorLocation().Z < FloorStart.Z - 100.0f);
+			TestTrue(TEXT("rider is still on the floor"), Floor->mActorsOnFloor.Contains(Rider));
+			TestEqual(TEXT("rider offset from the floor"), Rider->GetActorLocation() - Floor->GetActorLocation(), RiderOffset, 0.01);
+		});
+
+		It("updates overlaps once per frame for the floor and for each rider", [this]()
+		{
+			UGimmickOverlapProbeComponent* FloorProbe = UGimmickOverlapProbeComponent::AttachTo(Floor);
+			if (!TestNotNull(TEXT("floor probe"), FloorProbe))
+			{
+				return;
+			}
+
+			//動き始めのフレームを除いて数える
+			TickWorld(World, 1);
+			FloorProbe->mUpdateCount = 0;
+			RiderProbe->mUpdateCount = 0;
+
+			TickWorld(World, Frames);
+
+			TestEqual(TEXT("floor overlap updates"), FloorProbe->mUpdateCount, Frames);
+			TestEqual(TEXT("rider overlap updates"), RiderProbe->mUpdateCount, Frames);
+		});
+	});
+}
+
+#endif
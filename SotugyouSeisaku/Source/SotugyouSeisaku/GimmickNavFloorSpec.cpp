@@ -0,0 +1,70 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GimmickBenchmarkFixture.h"
+#include "AIController.h"
+#include "GameFramework/Character.h"
+#include "NavigationSystem.h"
+#include "NavigationData.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+/// @brief 動く床の時刻表付きリンク（AGimmickFloorNavLink）の自動テスト
+///        溝を挟んだ2つの地面の片側にAIを置き、床はナビメッシュに影響させずにリンクだけで反対側まで渡れるかを確かめる
+///        （避けられたナビメッシュの再構築時間は -run=GimmickBenchmark -Suite=NavFloor）
+BEGIN_DEFINE_SPEC(FGimmickNavFloorSpec, "SotugyouSeisaku.Gimmick.NavFloor", EAutomationTestFlags_ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+	//床の往復2回分より長く待っても渡れなければ失敗
+	static constexpr float TimeLimit = 30.0f;
+
+	//目的地に着いたとみなす距離（cm）
+	static constexpr float ArriveRadius = 100.0f;
+
+END_DEFINE_SPEC(FGimmickNavFloorSpec)
+
+void FGimmickNavFloorSpec::Define()
+{
+	using namespace GimmickBenchmark;
+
+	Describe("Timetabled floor link", [this]()
+	{
+		It("lets an AI cross the gap by riding the moving floor", [this]()
+		{
+			const FScopedDynamicNavMesh DynamicNavMesh;
+			UWorld* World = CreateBenchmarkWorld(TEXT("NavFloorSpec"), true);
+			const FNavFloorLevel Level = SetupNavFloorLevel(World, false);
+
+			//ナビメッシュの非同期ビルドを終わらせてから動かす
+			ANavigationData* NavData = Level.NavSys ? Level.NavSys->GetDefaultNavDataInstance() : nullptr;
+			if (TestNotNull(TEXT("navigation data"), NavData))
+			{
+				NavData->EnsureBuildCompletion();
+			}
+
+			ACharacter* Agent = World->SpawnActor<ACharacter>(Level.AgentStart, FRotator::ZeroRotator);
+			AAIController* Controller = World->SpawnActor<AAIController>();
+			if (TestNotNull(TEXT("agent"), Agent) && TestNotNull(TEXT("controller"), Controller))
+			{
+				Controller->Possess(Agent);
+				const EPathFollowingRequestResult::Type Request = Controller->MoveToLocation(Level.Goal, 50.0f);
+				TestNotEqual(TEXT("path request across the gap"), Request, EPathFollowingRequestResult::Failed);
+
+				//溝に落ちたら打ち切る
+				bool bCrossed = false;
+				float ElapsedTime = 0.0f;
+				while (!bCrossed && ElapsedTime < TimeLimit && Agent->GetActorLocation().Z > -500.0f)
+				{
+					TickWorld(World, 1);
+					ElapsedTime += FrameDeltaTime;
+					bCrossed = FVector::DistSquared2D(Agent->GetActorLocation(), Level.Goal) <= FMath::Square(ArriveRadius);
+				}
+
+				TestTrue(FString::Printf(TEXT("agent reached the far side (at %s after %.2f s)"), *Agent->GetActorLocation().ToString(), ElapsedTime), bCrossed);
+			}
+
+			DestroyBenchmarkWorld(World);
+		});
+	});
+}
+
+#endif
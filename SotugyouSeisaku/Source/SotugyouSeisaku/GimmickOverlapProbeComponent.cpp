@@ -0,0 +1,35 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GimmickOverlapProbeComponent.h"
+#include "GameFramework/Actor.h"
+
+
+UGimmickOverlapProbeComponent::UGimmickOverlapProbeComponent()
+{
+	//オーバーラップを調べないコンポーネントは2回目から更新が省かれるので、調べる設定にしておく
+	InitBoxExtent(FVector(1.0f));
+	SetCollisionProfileName(TEXT("OverlapAllDynamic"));
+	SetGenerateOverlapEvents(true);
+	SetHiddenInGame(true);
+}
+
+UGimmickOverlapProbeComponent* UGimmickOverlapProbeComponent::AttachTo(AActor* Actor)
+{
+	USceneComponent* Root = Actor ? Actor->GetRootComponent() : nullptr;
+	if (!Root)
+	{
+		return nullptr;
+	}
+
+	UGimmickOverlapProbeComponent* Probe = NewObject<UGimmickOverlapProbeComponent>(Actor);
+	Probe->SetupAttachment(Root);
+	Probe->RegisterComponent();
+	return Probe;
+}
+
+bool UGimmickOverlapProbeComponent::UpdateOverlapsImpl(const TOverlapArrayView* PendingOverlaps, bool bDoNotifies, const TOverlapArrayView* OverlapsAtEndLocation)
+{
+	mUpdateCount++;
+	return Super::UpdateOverlapsImpl(PendingOverlaps, bDoNotifies, OverlapsAtEndLocation);
+}
@@ -0,0 +1,30 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/BoxComponent.h"
+#include "GimmickOverlapProbeComponent.generated.h"
+
+/// @brief オーバーラップの更新（UpdateOverlaps）が実際に行われた回数を数える小さなボックス（ベンチマークと自動テスト用）
+///        アクタのルートに付けると、ルートのオーバーラップの更新から子として呼ばれるので、そのアクタの更新回数になる
+///        （FScopedMovementUpdate で遅らせた更新は、遅らせ終えたときの1回だけ数えられる）
+UCLASS(Transient)
+class SOTUGYOUSEISAKU_API UGimmickOverlapProbeComponent : public UBoxComponent
+{
+	GENERATED_BODY()
+
+public:
+	UGimmickOverlapProbeComponent();
+
+	/// @brief アクタのルートに数える用のボックスを付ける
+	/// @param Actor 数えるアクタ
+	/// @return 付けたボックス（ルートがなければ nullptr）
+	static UGimmickOverlapProbeComponent* AttachTo(AActor* Actor);
+
+	//オーバーラップの更新が行われた回数
+	int32 mUpdateCount = 0;
+
+protected:
+	virtual bool UpdateOverlapsImpl(const TOverlapArrayView* PendingOverlaps = nullptr, bool bDoNotifies = true, const TOverlapArrayView* OverlapsAtEndLocation = nullptr) override;
+};
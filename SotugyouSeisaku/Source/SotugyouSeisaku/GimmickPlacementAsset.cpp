@@ -0,0 +1,140 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GimmickPlacementAsset.h"
+#include "GameFramework/Actor.h"
+#include "UObject/ObjectSaveContext.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogGimmickPlacement, Log, All);
+
+#if WITH_EDITOR
+
+/// @brief テーブルの行をフラットな配列に焼き込む
+void UGimmickPlacementAsset::Bake()
+{
+	TryBake();
+}
+
+/// @brief テーブルの行をフラットな配列に焼き込む
+///        設定は種類ごとの配列に分け、同じ値の配置どうしで1つにまとめる
+/// @return 焼き込めたか
+bool UGimmickPlacementAsset::TryBake()
+{
+	//焼き込めないときは、前に焼き込んだ配列を消さずに残す
+	if (!mSourceTable)
+	{
+		UE_LOG(LogGimmickPlacement, Error, TEXT("%s: no source table to bake from"), *GetName());
+		return false;
+	}
+	if (mSourceTable->GetRowStruct() != FGimmickPlacementRow::StaticStruct())
+	{
+		UE_LOG(LogGimmickPlacement, Error, TEXT("%s: source table %s uses row struct %s, expected %s"), *GetName(), *mSourceTable->GetName(),
+			mSourceTable->GetRowStruct() ? *mSourceTable->GetRowStruct()->GetName() : TEXT("None"), *FGimmickPlacementRow::StaticStruct()->GetName());
+		return false;
+	}
+
+	mTypes.Reset();
+	mClassIndices.Reset();
+	mClasses.Reset();
+	mTransforms.Reset();
+	mBounds = FBox(ForceInit);
+	mSettingIndices.Reset();
+	mMoveFloorSettings.Reset();
+	mFallFloorSettings.Reset();
+	mButtonSettings.Reset();
+	mDoorMovements.Reset();
+	mLinkOffsets.Reset();
+	mLinks.Reset();
+
+	const TArray<FName> RowNames = mSourceTable->GetRowNames();
+
+	//行名 → インデックス（リンクの解決用）
+	TMap<FName, int32> RowIndices;
+	for (int32 i = 0; i < RowNames.Num(); i++)
+	{
+		RowIndices.Add(RowNames[i], i);
+	}
+
+	auto FindRowIndex = [this, &RowIndices](FName RowName, FName OwnerRow) -> int32
+	{
+		if (RowName.IsNone())
+		{
+			return INDEX_NONE;
+		}
+
+		const int32* Found = RowIndices.Find(RowName);
+		if (!Found)
+		{
+			UE_LOG(LogGimmickPlacement, Warning, TEXT("%s: row %s links to missing row %s"), *GetName(), *OwnerRow.ToString(), *RowName.ToString());
+			return INDEX_NONE;
+		}
+		return *Found;
+	};
+
+	const int32 Count = RowNames.Num();
+	mTypes.Reserve(Count);
+	mClassIndices.Reserve(Count);
+	mTransforms.Reserve(Count);
+	mSettingIndices.Reserve(Count);
+	mLinkOffsets.Reserve(Count + 1);
+
+	for (const FName& RowName : RowNames)
+	{
+		const FGimmickPlacementRow* Row = mSourceTable->FindRow<FGimmickPlacementRow>(RowName, TEXT("GimmickPlacementBake"));
+
+		mTypes.Add(Row->Type);
+		mClassIndices.Add(Row->ActorClass.IsNull() ? INDEX_NONE : static_cast<int16>(mClasses.AddUnique(Row->ActorClass)));
+		mTransforms.Add(FTransform3f(FRotator3f(Row->Rotation), FVector3f(Row->Location), FVector3f(Row->Scale)));
+
+		//範囲は生成するクラスの既定のコンポーネントの大きさまで広げる（メッシュのないクラスは配置位置だけ）
+		UClass* Class = Row->ActorClass.IsNull() ? GimmickPlacement::GetDefaultClass(Row->Type) : Row->ActorClass.LoadSynchronous();
+		const FBox LocalBounds = Class ? AActor::GetActorClassDefaultComponentsBoundingBox(Class) : FBox(ForceInit);
+		if (LocalBounds.IsValid)
+		{
+			mBounds += LocalBounds.TransformBy(FTransform(Row->Rotation, Row->Location, Row->Scale));
+		}
+		else
+		{
+			mBounds += Row->Location;
+		}
+
+		//種類ごとの設定（ほかの種類の値は読まない）
+		switch (Row->Type)
+		{
+		case EGimmickType::MoveFloor:		mSettingIndices.Add(mMoveFloorSettings.AddUnique(Row->MoveFloor)); break;
+		case EGimmickType::FallFloor:		mSettingIndices.Add(mFallFloorSettings.AddUnique(Row->FallFloor)); break;
+		case EGimmickType::Button:			mSettingIndices.Add(mButtonSettings.AddUnique(Row->Button)); break;
+		case EGimmickType::ButtonManager:	mSettingIndices.Add(mDoorMovements.AddUnique(FVector4f(FVector3f(Row->DoorMoveOffset), Row->DoorMoveSpeed))); break;
+		default:							mSettingIndices.Add(INDEX_NONE); break;
+		}
+
+		//リンク（マネージャーはドアとボタン、ボタンはドアのみ）
+		mLinkOffsets.Add(mLinks.Num());
+		if (Row->Type == EGimmickType::ButtonManager || Row->Type == EGimmickType::Button)
+		{
+			mLinks.Add(FindRowIndex(Row->Door, RowName));
+		}
+		if (Row->Type == EGimmickType::ButtonManager)
+		{
+			for (const FName& ButtonName : Row->Sequence)
+			{
+				mLinks.Add(FindRowIndex(ButtonName, RowName));
+			}
+		}
+	}
+	mLinkOffsets.Add(mLinks.Num());
+	return true;
+}
+
+/// @brief クック時に必ず最新のテーブルから焼き込む
+/// @param SaveContext 保存時の情報
+void UGimmickPlacementAsset::PreSave(FObjectPreSaveContext SaveContext)
+{
+	if (SaveContext.IsCooking() && !TryBake())
+	{
+		UE_LOG(LogGimmickPlacement, Error, TEXT("%s: cooking with the previously baked placement"), *GetName());
+	}
+
+	Super::PreSave(SaveContext);
+}
+
+#endif
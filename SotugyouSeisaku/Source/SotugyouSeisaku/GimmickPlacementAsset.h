@@ -0,0 +1,153 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "Engine/DataTable.h"
+#include "GimmickTypes.h"
+#include "GimmickConfig.h"
+#include "GimmickPlacementAsset.generated.h"
+
+/// @brief ギミック配置の1行（DataTable / CSVで編集する）
+///        Sequence と Door には同じテーブルの行名を書く
+USTRUCT(BlueprintType)
+struct FGimmickPlacementRow : public FTableRowBase
+{
+	GENERATED_BODY()
+
+	//ギミックの種類
+	UPROPERTY(EditAnywhere, Category = "Placement")
+	EGimmickType Type = EGimmickType::MoveFloor;
+
+	//生成するクラス（未設定なら種類ごとのC++クラス）
+	UPROPERTY(EditAnywhere, Category = "Placement")
+	TSoftClassPtr<AActor> ActorClass;
+
+	UPROPERTY(EditAnywhere, Category = "Placement")
+	FVector Location = FVector::ZeroVector;
+
+	UPROPERTY(EditAnywhere, Category = "Placement")
+	FRotator Rotation = FRotator::ZeroRotator;
+
+	UPROPERTY(EditAnywhere, Category = "Placement")
+	FVector Scale = FVector::OneVector;
+
+	//設定は種類ごとに分けて持つ（種類ごとの既定値のまま使えるように、使わない種類の値は読まない）
+
+	//動く床の設定
+	UPROPERTY(EditAnywhere, Category = "Settings", meta = (EditCondition = "Type == EGimmickType::MoveFloor", EditConditionHides))
+	FMoveFloorSettings MoveFloor;
+
+	//落ちる床の設定（崩れる様子が未設定ならクラスの設定のまま）
+	UPROPERTY(EditAnywhere, Category = "Settings", meta = (EditCondition = "Type == EGimmickType::FallFloor", EditConditionHides))
+	FFallFloorSettings FallFloor;
+
+	//ボタンの設定（押したときに動かすドア）
+	UPROPERTY(EditAnywhere, Category = "Settings", meta = (EditCondition = "Type == EGimmickType::Button", EditConditionHides))
+	FButtonSettings Button;
+
+	//マネージャー：ドアの移動量
+	UPROPERTY(EditAnywhere, Category = "Settings", meta = (EditCondition = "Type == EGimmickType::ButtonManager", EditConditionHides))
+	FVector DoorMoveOffset = FVector(0.0f, 0.0f, 300.0f);
+
+	//マネージャー：ドアの移動速度
+	UPROPERTY(EditAnywhere, Category = "Settings", meta = (EditCondition = "Type == EGimmickType::ButtonManager", EditConditionHides))
+	float DoorMoveSpeed = 200.0f;
+
+	//ボタン・マネージャー：動かすドアの行名
+	UPROPERTY(EditAnywhere, Category = "Links")
+	FName Door;
+
+	//マネージャー：押す順番に並べたボタンの行名
+	UPROPERTY(EditAnywhere, Category = "Links")
+	TArray<FName> Sequence;
+};
+
+namespace GimmickPlacement
+{
+	/// @brief 種類ごとの既定のクラス（行の ActorClass が未設定のときに生成する）
+	SOTUGYOUSEISAKU_API UClass* GetDefaultClass(EGimmickType Type);
+}
+
+/// @brief ギミック配置をフラットな配列に焼き込んだデータアセット
+///        クック時にDataTableから焼き込み、実行時は AGimmickPlacementSpawner がまとめて生成する
+///        1つのアセットが1部屋で、生成するクラスは "Gimmick" バンドルとして UGimmickPreloadSubsystem が非同期で先読みする
+UCLASS(BlueprintType)
+class SOTUGYOUSEISAKU_API UGimmickPlacementAsset : public UPrimaryDataAsset
+{
+	GENERATED_BODY()
+
+public:
+#if WITH_EDITORONLY_DATA
+	//焼き込み元のテーブル（行の型は FGimmickPlacementRow）
+	UPROPERTY(EditAnywhere, Category = "Source", meta = (RequiredAssetDataTags = "RowStructure=/Script/SotugyouSeisaku.GimmickPlacementRow"))
+	TObjectPtr<UDataTable> mSourceTable;
+#endif
+
+#if WITH_EDITOR
+	//テーブルからフラットな配列を作り直す
+	UFUNCTION(CallInEditor, Category = "Source")
+	void Bake();
+
+	/// @brief テーブルからフラットな配列を作り直す
+	/// @return 焼き込めたか（テーブルがない・行の型が違うときはエラーを出し、焼き込み済みの配列はそのまま）
+	bool TryBake();
+
+	virtual void PreSave(FObjectPreSaveContext SaveContext) override;
+#endif
+
+	//配置数
+	int32 Num() const { return mTypes.Num(); }
+
+	//リンク（マネージャー：[ドア, ボタン...]、ボタン：[ドア]、なしは INDEX_NONE）
+	TConstArrayView<int32> GetLinks(int32 Index) const
+	{
+		return MakeArrayView(mLinks.GetData() + mLinkOffsets[Index], mLinkOffsets[Index + 1] - mLinkOffsets[Index]);
+	}
+
+	//種類
+	UPROPERTY(VisibleAnywhere, Category = "Baked")
+	TArray<EGimmickType> mTypes;
+
+	//生成するクラス（mClasses へのインデックス、INDEX_NONE = 種類ごとのC++クラス）
+	UPROPERTY(VisibleAnywhere, Category = "Baked")
+	TArray<int16> mClassIndices;
+
+	UPROPERTY(VisibleAnywhere, Category = "Baked", meta = (AssetBundles = "Gimmick"))
+	TArray<TSoftClassPtr<AActor>> mClasses;
+
+	//トランスフォーム
+	UPROPERTY(VisibleAnywhere, Category = "Baked")
+	TArray<FTransform3f> mTransforms;
+
+	//配置したギミックのメッシュを囲む箱（配置用アクタからの相対位置、近づいたかの判定に使う）
+	UPROPERTY(VisibleAnywhere, Category = "Baked")
+	FBox mBounds = FBox(ForceInit);
+
+	//配置ごとの、種類ごとの設定の配列へのインデックス（設定を持たない種類は INDEX_NONE）
+	UPROPERTY(VisibleAnywhere, Category = "Baked")
+	TArray<int32> mSettingIndices;
+
+	//種類ごとの設定（同じ値の配置どうしで1つにまとめる）
+	UPROPERTY(VisibleAnywhere, Category = "Baked")
+	TArray<FMoveFloorSettings> mMoveFloorSettings;
+
+	UPROPERTY(VisibleAnywhere, Category = "Baked")
+	TArray<FFallFloorSettings> mFallFloorSettings;
+
+	UPROPERTY(VisibleAnywhere, Category = "Baked")
+	TArray<FButtonSettings> mButtonSettings;
+
+	//マネージャーのドアの動き（XYZ = 移動量, W = 速度）
+	UPROPERTY(VisibleAnywhere, Category = "Baked")
+	TArray<FVector4f> mDoorMovements;
+
+	//リンクの開始位置（要素数は配置数 + 1）
+	UPROPERTY(VisibleAnywhere, Category = "Baked")
+	TArray<int32> mLinkOffsets;
+
+	//全配置のリンクを連結したもの
+	UPROPERTY(VisibleAnywhere, Category = "Baked")
+	TArray<int32> mLinks;
+};
@@ -0,0 +1,374 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GimmickPlacementSpawner.h"
+#include "GimmickPlacementAsset.h"
+#include "Gimmck_MoveFloor.h"
+#include "Gimmick_Button.h"
+#include "Gimmick_ButtonManager.h"
+#include "Gimmick_FallFloor.h"
+#include "Gimmick_PushBlock.h"
+#include "GimmickPreloadSubsystem.h"
+#include "GimmickReplicationGraph.h"
+#include "Engine/World.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerController.h"
+#include "Net/UnrealNetwork.h"
+
+namespace GimmickPlacement
+{
+	//プレイヤーが近づいたかを確かめる間隔（秒）
+	constexpr float PreloadCheckInterval = 0.25f;
+
+	/// @brief 同じ値の設定を1つの共有設定にまとめる（配置ごとに設定を持たせない）
+	/// @param Outer 作った共有設定の Outer
+	/// @param Configs 値 → 作った共有設定
+	/// @param Owned 作った共有設定を持ち続ける配列
+	/// @param Settings 設定
+	/// @return 共有設定
+	template <typename ConfigType, typename SettingsType>
+	ConfigType* FindOrAddConfig(UObject* Outer, TMap<SettingsType, ConfigType*>& Configs, TArray<TObjectPtr<UObject>>& Owned, const SettingsType& Settings)
+	{
+		if (ConfigType** Found = Configs.Find(Settings))
+		{
+			return *Found;
+		}
+
+		ConfigType* Config = NewObject<ConfigType>(Outer, NAME_None, RF_Transient);
+		Config->mSettings = Settings;
+		Owned.Add(Config);
+		return Configs.Add(Settings, Config);
+	}
+
+	/// @brief 種類ごとの既定のクラス
+	/// @param Type ギミックの種類
+	/// @return 生成するクラス（種類ごとのクラスがなければ nullptr）
+	UClass* GetDefaultClass(EGimmickType Type)
+	{
+		switch (Type)
+		{
+		case EGimmickType::MoveFloor:		return AGimmck_MoveFloor::StaticClass();
+		case EGimmickType::FallFloor:		return AGimmick_FallFloor::StaticClass();
+		case EGimmickType::Button:			return AGimmick_Button::StaticClass();
+		case EGimmickType::ButtonManager:	return AGimmick_ButtonManager::StaticClass();
+		case EGimmickType::PushBlock:		return AGimmick_PushBlock::StaticClass();
+		default:							return nullptr;
+		}
+	}
+}
+
+/// @brief コンストラクタ　配置用アクタの設定
+AGimmickPlacementSpawner::AGimmickPlacementSpawner()
+{
+	PrimaryActorTick.bCanEverTick = false;
+
+	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
+
+	//生成したことだけをクライアントに知らせる（どこにいるクライアントでも同じ部屋を生成するので、全員に送る）
+	bReplicates = true;
+	bAlwaysRelevant = true;
+	NetDormancy = DORM_Initial;
+}
+
+void AGimmickPlacementSpawner::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME(AGimmickPlacementSpawner, bServerSpawned);
+}
+
+/// @brief クライアントで、サーバーが生成するのを待って生成するか
+bool AGimmickPlacementSpawner::ShouldWaitForServer() const
+{
+	return GetNetMode() == NM_Client;
+}
+
+void AGimmickPlacementSpawner::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (mPreloadDistance <= 0.0f)
+	{
+		//クライアントは先読みだけしておき、サーバーが生成したのが複製されてから生成する
+		if (ShouldWaitForServer())
+		{
+			Preload();
+		}
+		else
+		{
+			SpawnAll();
+		}
+		return;
+	}
+
+	CheckPlayerDistance();
+}
+
+void AGimmickPlacementSpawner::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UGimmickReplicationGraph* Graph = UGimmickReplicationGraph::Get(GetWorld()))
+	{
+		Graph->RemoveRoom(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+/// @brief 近づくのを待たずに先読みを始める
+void AGimmickPlacementSpawner::Preload()
+{
+	if (bPreloadRequested || bSpawned || !mPlacement)
+	{
+		return;
+	}
+	bPreloadRequested = true;
+
+	if (UGimmickTimerSubsystem* Timers = GetWorld()->GetSubsystem<UGimmickTimerSubsystem>())
+	{
+		Timers->ClearTimer(mCheckTimer);
+	}
+
+	UGimmickPreloadSubsystem* Preloader = GetWorld()->GetSubsystem<UGimmickPreloadSubsystem>();
+	if (!Preloader)
+	{
+		OnPreloaded();
+		return;
+	}
+	Preloader->RequestPreload(mPlacement, FSimpleDelegate::CreateUObject(this, &AGimmickPlacementSpawner::OnPreloaded));
+}
+
+/// @brief プレイヤーが配置範囲に mPreloadDistance まで近づいたかを確かめる
+void AGimmickPlacementSpawner::CheckPlayerDistance()
+{
+	if (!mPlacement)
+	{
+		return;
+	}
+
+	const FBox Bounds = mPlacement->mBounds.TransformBy(GetActorTransform());
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		const APlayerController* Controller = It->Get();
+		const APawn* Pawn = Controller ? Controller->GetPawn() : nullptr;
+		if (Pawn && (!Bounds.IsValid || Bounds.ComputeSquaredDistanceToPoint(Pawn->GetActorLocation()) <= FMath::Square(mPreloadDistance)))
+		{
+			Preload();
+			return;
+		}
+	}
+
+	//まだ遠いので、少し後にもう一度確かめる
+	if (UGimmickTimerSubsystem* Timers = GetWorld()->GetSubsystem<UGimmickTimerSubsystem>())
+	{
+		mCheckTimer = Timers->SetTimer(this, GimmickPlacement::PreloadCheckInterval, [this]()
+		{
+			CheckPlayerDistance();
+		});
+	}
+}
+
+/// @brief 先読みが終わったら生成する
+///        読み込み済みの保存データのうちこの部屋の分は、登録簿が休眠中の状態として持っていて登録時に復元される
+void AGimmickPlacementSpawner::OnPreloaded()
+{
+	bPreloaded = true;
+
+	//クライアントはサーバーが生成するまで待つ（OnRep_ServerSpawned で生成する）
+	if (ShouldWaitForServer() && !bServerSpawned)
+	{
+		return;
+	}
+	SpawnAll();
+}
+
+/// @brief サーバーが生成したことが複製されたら生成する
+///        先読みがまだなら始め、読み込み終わってから生成する（サーバーのギミックは部屋の近くの接続にだけ送られ、近くにいるクライアントは自分の距離で先読みを済ませている）
+void AGimmickPlacementSpawner::OnRep_ServerSpawned()
+{
+	if (!bServerSpawned)
+	{
+		return;
+	}
+
+	if (bPreloaded)
+	{
+		SpawnAll();
+	}
+	else
+	{
+		Preload();
+	}
+}
+
+/// @brief 配置データのギミックをまとめて生成する
+///        全アクタを遅延生成 → リンクを設定 → まとめて FinishSpawning（BeginPlay）の順で行う
+void AGimmickPlacementSpawner::SpawnAll()
+{
+	LLM_SCOPE_BYTAG(Gimmick);
+
+	if (!mPlacement || !GetWorld() || bSpawned)
+	{
+		return;
+	}
+	bSpawned = true;
+
+	//生成したことをクライアントに知らせる
+	if (!ShouldWaitForServer() && !IsNetMode(NM_Standalone))
+	{
+		bServerSpawned = true;
+		FlushNetDormancy();
+	}
+
+	const int32 Count = mPlacement->Num();
+	const FTransform SpawnerTransform = GetActorTransform();
+
+	//サーバーでは部屋の範囲を登録し、中のギミックを部屋の中か近くにいる接続にだけ送る
+	if (UGimmickReplicationGraph* Graph = UGimmickReplicationGraph::Get(GetWorld()))
+	{
+		Graph->AddRoom(this, mPlacement->mBounds.TransformBy(SpawnerTransform));
+	}
+
+	//クラスを解決（先読みした部屋はロード済み、BeginPlay で生成する部屋は未ロードならここで読み込む）
+	//ゲームプレイ中にここで読み込んだ場合は同期読み込みとして数える
+	GimmickLoading::FSyncLoadScope LoadScope(this, TEXT("AGimmickPlacementSpawner::SpawnAll"));
+	TArray<UClass*> Classes;
+	Classes.Reserve(mPlacement->mClasses.Num());
+	for (const TSoftClassPtr<AActor>& SoftClass : mPlacement->mClasses)
+	{
+		Classes.Add(SoftClass.LoadSynchronous());
+	}
+
+	//1. 遅延生成と設定（設定は同じ値の配置どうしで共有設定を1つ作って参照させ、クラスの上書きより配置の値を優先する）
+	TMap<FMoveFloorSettings, UGimmickMoveFloorConfig*> MoveFloorConfigs;
+	TMap<FFallFloorSettings, UGimmickFallFloorConfig*> FallFloorConfigs;
+	TMap<FButtonSettings, UGimmickButtonConfig*> ButtonConfigs;
+	mSpawnedActors.Reset(Count);
+	TArray<FTransform> Transforms;
+	Transforms.Reserve(Count);
+	for (int32 i = 0; i < Count; i++)
+	{
+		const EGimmickType Type = mPlacement->mTypes[i];
+		const int16 ClassIndex = mPlacement->mClassIndices[i];
+		UClass* Class = Classes.IsValidIndex(ClassIndex) ? Classes[ClassIndex] : GimmickPlacement::GetDefaultClass(Type);
+
+		const FTransform Transform = FTransform(mPlacement->mTransforms[i]) * SpawnerTransform;
+		Transforms.Add(Transform);
+
+		//各マシンで同じ名前にして、サーバーのギミックと名前で結び付ける
+		FActorSpawnParameters SpawnParams;
+		SpawnParams.Name = FName(*FString::Printf(TEXT("%s_Gimmick%d"), *GetName(), i));
+		SpawnParams.OverrideLevel = GetLevel();
+		SpawnParams.Owner = this;
+		SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+		SpawnParams.bDeferConstruction = true;
+
+		AActor* Actor = Class ? GetWorld()->SpawnActor<AActor>(Class, Transform, SpawnParams) : nullptr;
+		mSpawnedActors.Add(Actor);
+		if (!Actor)
+		{
+			continue;
+		}
+
+		if (Actor->GetIsReplicated())
+		{
+			Actor->SetNetAddressable();
+
+			//レベルに配置したギミック（DORM_Initial）と違い、クライアントのものと結び付けるために1回送ってから休止する
+			if (Actor->NetDormancy == DORM_Initial)
+			{
+				Actor->NetDormancy = DORM_DormantAll;
+			}
+		}
+
+		//種類ごとの設定（行の種類と生成したクラスが合わない配置は、クラスの設定のまま）
+		const int32 SettingIndex = mPlacement->mSettingIndices[i];
+		switch (Type)
+		{
+		case EGimmickType::MoveFloor:
+			if (AGimmck_MoveFloor* Floor = Cast<AGimmck_MoveFloor>(Actor))
+			{
+				Floor->mConfig = GimmickPlacement::FindOrAddConfig(this, MoveFloorConfigs, mSharedConfigs, mPlacement->mMoveFloorSettings[SettingIndex]);
+				Floor->mOverrides = nullptr;
+			}
+			break;
+
+		case EGimmickType::FallFloor:
+			if (AGimmick_FallFloor* FallFloor = Cast<AGimmick_FallFloor>(Actor))
+			{
+				//崩れる様子は床のメッシュごとの焼き込みなので、表で指定していなければクラスの設定のまま
+				FFallFloorSettings Settings = mPlacement->mFallFloorSettings[SettingIndex];
+				if (!Settings.CollapseCache)
+				{
+					Settings.CollapseCache = FallFloor->GetSettings().CollapseCache;
+				}
+				FallFloor->mConfig = GimmickPlacement::FindOrAddConfig(this, FallFloorConfigs, mSharedConfigs, Settings);
+				FallFloor->mOverrides = nullptr;
+			}
+			break;
+
+		case EGimmickType::Button:
+			if (AGimmick_Button* Button = Cast<AGimmick_Button>(Actor))
+			{
+				Button->mConfig = GimmickPlacement::FindOrAddConfig(this, ButtonConfigs, mSharedConfigs, mPlacement->mButtonSettings[SettingIndex]);
+				Button->mOverrides = nullptr;
+			}
+			break;
+
+		case EGimmickType::ButtonManager:
+			if (AGimmick_ButtonManager* Manager = Cast<AGimmick_ButtonManager>(Actor))
+			{
+				const FVector4f& DoorMovement = mPlacement->mDoorMovements[SettingIndex];
+				Manager->SetDoorMovement(FVector(DoorMovement.X, DoorMovement.Y, DoorMovement.Z), DoorMovement.W);
+			}
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	auto GetLinkedActor = [this](int32 LinkIndex) -> AActor*
+	{
+		return mSpawnedActors.IsValidIndex(LinkIndex) ? mSpawnedActors[LinkIndex].Get() : nullptr;
+	};
+
+	//2. リンクを設定（BeginPlay でドアの初期位置を保存するので FinishSpawning より前に行う）
+	for (int32 i = 0; i < Count; i++)
+	{
+		const TConstArrayView<int32> Links = mPlacement->GetLinks(i);
+		if (Links.Num() == 0)
+		{
+			continue;
+		}
+
+		if (AGimmick_Button* Button = Cast<AGimmick_Button>(mSpawnedActors[i]))
+		{
+			Button->SetTargetDoor(GetLinkedActor(Links[0]));
+		}
+		else if (AGimmick_ButtonManager* Manager = Cast<AGimmick_ButtonManager>(mSpawnedActors[i]))
+		{
+			TArray<AGimmick_Button*> Sequence;
+			Sequence.Reserve(Links.Num() - 1);
+			for (int32 j = 1; j < Links.Num(); j++)
+			{
+				if (AGimmick_Button* SequenceButton = Cast<AGimmick_Button>(GetLinkedActor(Links[j])))
+				{
+					Sequence.Add(SequenceButton);
+				}
+			}
+			Manager->SetupSequence(Sequence, GetLinkedActor(Links[0]));
+		}
+	}
+
+	//3. まとめて生成を完了（ドアがボタンより先に初期化されるよう、その他 → ギミックの順）
+	for (int32 Pass = 0; Pass < 2; Pass++)
+	{
+		for (int32 i = 0; i < Count; i++)
+		{
+			const bool bIsOther = mPlacement->mTypes[i] == EGimmickType::Other;
+			if (mSpawnedActors[i] && bIsOther == (Pass == 0))
+			{
+				mSpawnedActors[i]->FinishSpawning(Transforms[i]);
+			}
+		}
+	}
+}
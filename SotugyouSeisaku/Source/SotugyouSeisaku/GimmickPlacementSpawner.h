@@ -0,0 +1,85 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "GimmickTimerSubsystem.h"
+#include "GimmickPlacementSpawner.generated.h"
+
+class UGimmickPlacementAsset;
+
+/// @brief 焼き込んだギミック配置データからギミックをまとめて生成するアクタ
+///        ギミックを1つずつレベルに置く代わりに、このアクタを1つ置いてデータアセットを指定する
+///        mPreloadDistance を設定した部屋は、プレイヤーが近づいたらクラスを非同期で先読みし、読み込み終わってから生成する
+///        （ゲームプレイ中の生成で同期読み込みを起こさない）
+///        ネットワークでは各マシンが同じ名前で生成し、サーバーのギミックと名前で結び付ける（生成自体は複製しない）
+///        生成するかはサーバーが決め（どれかのプレイヤーが近づいたら）、クライアントはそれが複製されてから生成する
+///        （クライアントは自分のプレイヤーの距離では先読みだけ行う。サーバーより遅れて生成すると、送られてきたギミックと結び付けられない）
+UCLASS()
+class SOTUGYOUSEISAKU_API AGimmickPlacementSpawner : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	AGimmickPlacementSpawner();
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+public:
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+public:
+	//生成する配置データ
+	UPROPERTY(EditAnywhere, Category = "Placement")
+	TObjectPtr<UGimmickPlacementAsset> mPlacement;
+
+	//プレイヤーが配置範囲にこの距離まで近づいたら先読みを始め、読み込み終わったら生成する（0 = BeginPlay で生成する）
+	UPROPERTY(EditAnywhere, Category = "Placement", meta = (ClampMin = "0"))
+	float mPreloadDistance = 0.0f;
+
+	//生成したアクタ（配置データと同じ順番）
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<AActor>> mSpawnedActors;
+
+	//生成したギミックが参照する共有設定（同じ値の配置で1つ）
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<UObject>> mSharedConfigs;
+
+	//近づくのを待たずに先読みを始める（読み込み終わったら生成する）
+	UFUNCTION(BlueprintCallable, Category = "Placement")
+	void Preload();
+
+	//生成済みか
+	bool HasSpawned() const { return bSpawned; }
+
+private:
+	//配置データのギミックをまとめて生成する
+	void SpawnAll();
+
+	//プレイヤーが近づいたかを確かめ、近ければ先読みを始める
+	void CheckPlayerDistance();
+
+	//先読みが終わったら生成する（クライアントはサーバーが生成するまで待つ）
+	void OnPreloaded();
+
+	//サーバーが生成したことが複製されたら、先読みが終わっていれば生成する
+	UFUNCTION()
+	void OnRep_ServerSpawned();
+
+	//クライアントで、サーバーが生成するのを待って生成するか
+	bool ShouldWaitForServer() const;
+
+	//近づいたかを確かめるタイマー
+	FGimmickTimerHandle mCheckTimer;
+
+	//サーバーが生成したか（クライアントはこれを待って生成する）
+	UPROPERTY(ReplicatedUsing = OnRep_ServerSpawned)
+	bool bServerSpawned = false;
+
+	bool bPreloadRequested = false;
+	bool bPreloaded = false;
+	bool bSpawned = false;
+};
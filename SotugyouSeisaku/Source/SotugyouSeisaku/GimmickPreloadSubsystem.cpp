@@ -0,0 +1,257 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GimmickPreloadSubsystem.h"
+#include "GimmickPlacementAsset.h"
+#include "Engine/AssetManager.h"
+#include "Engine/StreamableManager.h"
+#include "Engine/World.h"
+#include "UObject/UObjectGlobals.h"
+#include <atomic>
+
+DEFINE_LOG_CATEGORY_STATIC(LogGimmickPreload, Log, All);
+
+const FName GimmickLoading::BundleName(TEXT("Gimmick"));
+
+namespace GimmickLoading
+{
+	//ゲームプレイ中のギミックの処理の名前（処理の外なら nullptr）
+	static thread_local const TCHAR* GCurrentPath = nullptr;
+
+	//BeginPlay してから終わっていないワールドの数（ゲームプレイ中か）
+	static std::atomic<int32> GPlayingWorlds{ 0 };
+
+	static std::atomic<int32> GSyncLoadCount{ 0 };
+	static std::atomic<int32> GGameplaySyncLoadCount{ 0 };
+	static std::atomic<int32> GGimmickSyncLoadCount{ 0 };
+
+	/// @brief 同期読み込みが起きたときに呼ばれる
+	///        ゲームプレイ中ならヒッチとして数えて警告を出し、ギミックの処理の中なら Shipping 以外では ensure も出す
+	///        （コマンドレットは数を自分で報告するので ensure は出さない）
+	/// @param PackageName 読み込んだパッケージ名
+	static void OnSyncLoadPackage(const FString& PackageName)
+	{
+		GSyncLoadCount++;
+		if (GCurrentPath)
+		{
+			GGameplaySyncLoadCount++;
+			GGimmickSyncLoadCount++;
+			UE_LOG(LogGimmickPreload, Warning, TEXT("Synchronous load of %s during %s (preload the room bundle before spawning)"), *PackageName, GCurrentPath);
+#if !UE_BUILD_SHIPPING
+			if (!IsRunningCommandlet())
+			{
+				ensureMsgf(false, TEXT("Synchronous load of %s during %s hitches the game thread"), *PackageName, GCurrentPath);
+			}
+#endif
+		}
+		else if (IsInGameThread() && GPlayingWorlds > 0)
+		{
+			GGameplaySyncLoadCount++;
+			UE_LOG(LogGimmickPreload, Warning, TEXT("Synchronous load of %s during gameplay (hitches the game thread)"), *PackageName);
+		}
+	}
+}
+
+/// @brief コンストラクタ　ゲームプレイ中なら範囲に入る
+/// @param Context ワールドを持つオブジェクト
+/// @param Path ログに出す処理の名前
+GimmickLoading::FSyncLoadScope::FSyncLoadScope(const UObject* Context, const TCHAR* Path)
+	: mPrevPath(GCurrentPath)
+{
+	const UWorld* World = Context ? Context->GetWorld() : nullptr;
+	if (World && World->HasBegunPlay())
+	{
+		GCurrentPath = Path;
+	}
+}
+
+GimmickLoading::FSyncLoadScope::~FSyncLoadScope()
+{
+	GCurrentPath = mPrevPath;
+}
+
+/// @brief 同期読み込みの監視を始める
+void GimmickLoading::StartTracking()
+{
+	static bool bStarted = false;
+	if (!bStarted)
+	{
+		FCoreUObjectDelegates::OnSyncLoadPackage.AddStatic(&GimmickLoading::OnSyncLoadPackage);
+		bStarted = true;
+	}
+}
+
+int32 GimmickLoading::GetSyncLoadCount()
+{
+	return GSyncLoadCount;
+}
+
+int32 GimmickLoading::GetGameplaySyncLoadCount()
+{
+	return GGameplaySyncLoadCount;
+}
+
+int32 GimmickLoading::GetGimmickSyncLoadCount()
+{
+	return GGimmickSyncLoadCount;
+}
+
+void GimmickLoading::ResetSyncLoadCounts()
+{
+	GSyncLoadCount = 0;
+	GGameplaySyncLoadCount = 0;
+	GGimmickSyncLoadCount = 0;
+}
+
+void UGimmickPreloadSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	GimmickLoading::StartTracking();
+}
+
+void UGimmickPreloadSubsystem::Deinitialize()
+{
+	for (TPair<TObjectKey<UGimmickPlacementAsset>, FRoomLoad>& Pair : mRooms)
+	{
+		if (Pair.Value.Handle.IsValid())
+		{
+			Pair.Value.Handle->ReleaseHandle();
+		}
+	}
+	mRooms.Empty();
+
+	//ゲームプレイ中に起きた同期読み込みの数を出す（コマンドレット以外でも、ヒッチがあったことを1行で分かるように）
+	if (mGameplaySyncLoadsAtBeginPlay != INDEX_NONE)
+	{
+		GimmickLoading::GPlayingWorlds--;
+
+		//途中で数を 0 に戻した場合（ベンチマーク）は戻した後の数
+		const int32 GameplaySyncLoads = GimmickLoading::GetGameplaySyncLoadCount();
+		const int32 GimmickSyncLoads = GimmickLoading::GetGimmickSyncLoadCount();
+		const int32 GameplayInWorld = GameplaySyncLoads >= mGameplaySyncLoadsAtBeginPlay ? GameplaySyncLoads - mGameplaySyncLoadsAtBeginPlay : GameplaySyncLoads;
+		const int32 GimmickInWorld = GimmickSyncLoads >= mGimmickSyncLoadsAtBeginPlay ? GimmickSyncLoads - mGimmickSyncLoadsAtBeginPlay : GimmickSyncLoads;
+		UE_CLOG(GameplayInWorld > 0, LogGimmickPreload, Warning, TEXT("%s: %d synchronous loads during gameplay (%d on gimmick paths)"), *GetWorld()->GetName(), GameplayInWorld, GimmickInWorld);
+		mGameplaySyncLoadsAtBeginPlay = INDEX_NONE;
+		mGimmickSyncLoadsAtBeginPlay = INDEX_NONE;
+	}
+
+	Super::Deinitialize();
+}
+
+/// @brief ワールドの BeginPlay から、同期読み込みをゲームプレイ中のものとして数える
+void UGimmickPreloadSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	mGameplaySyncLoadsAtBeginPlay = GimmickLoading::GetGameplaySyncLoadCount();
+	mGimmickSyncLoadsAtBeginPlay = GimmickLoading::GetGimmickSyncLoadCount();
+	GimmickLoading::GPlayingWorlds++;
+}
+
+bool UGimmickPreloadSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+/// @brief 部屋のバンドルを非同期で読み込む
+///        アセットマネージャーに登録された配置データならプライマリアセットのバンドルとして、
+///        未登録なら配置データが参照するクラスを直接、非同期で読み込む
+/// @param Placement 部屋の配置データ
+/// @param OnLoaded 読み込み終わったら呼ぶ処理
+void UGimmickPreloadSubsystem::RequestPreload(const UGimmickPlacementAsset* Placement, FSimpleDelegate OnLoaded)
+{
+	if (!Placement)
+	{
+		return;
+	}
+
+	//読み込み済みならすぐ呼ぶ、読み込み中なら終わるのを待つ
+	const TObjectKey<UGimmickPlacementAsset> Key(Placement);
+	if (FRoomLoad* Room = mRooms.Find(Key))
+	{
+		if (Room->bLoaded)
+		{
+			OnLoaded.ExecuteIfBound();
+		}
+		else
+		{
+			Room->Waiting.Add(MoveTemp(OnLoaded));
+		}
+		return;
+	}
+
+	FRoomLoad& Room = mRooms.Add(Key);
+	Room.Waiting.Add(MoveTemp(OnLoaded));
+
+	const double StartTime = FPlatformTime::Seconds();
+	TWeakObjectPtr<UGimmickPreloadSubsystem> WeakThis(this);
+	FStreamableDelegate OnComplete = FStreamableDelegate::CreateLambda([WeakThis, Key, StartTime, RoomName = Placement->GetName()]()
+	{
+		UE_LOG(LogGimmickPreload, Log, TEXT("Preloaded gimmick bundle of %s in %.1f ms"), *RoomName, (FPlatformTime::Seconds() - StartTime) * 1000.0);
+		if (UGimmickPreloadSubsystem* This = WeakThis.Get())
+		{
+			This->OnRoomLoaded(Key);
+		}
+	});
+
+	TSharedPtr<FStreamableHandle> Handle;
+	UAssetManager* AssetManager = UAssetManager::GetIfInitialized();
+	const FPrimaryAssetId AssetId = Placement->GetPrimaryAssetId();
+	if (AssetManager && AssetManager->GetPrimaryAssetPath(AssetId).IsValid())
+	{
+		Handle = AssetManager->LoadPrimaryAsset(AssetId, { GimmickLoading::BundleName }, OnComplete);
+	}
+	else
+	{
+		TArray<FSoftObjectPath> Paths;
+		for (const TSoftClassPtr<AActor>& SoftClass : Placement->mClasses)
+		{
+			if (!SoftClass.IsNull() && !SoftClass.Get())
+			{
+				Paths.Add(SoftClass.ToSoftObjectPath());
+			}
+		}
+		if (Paths.Num() > 0)
+		{
+			Handle = UAssetManager::GetStreamableManager().RequestAsyncLoad(MoveTemp(Paths), OnComplete);
+		}
+	}
+
+	//読み込み済みで完了の通知が先に来た場合は mRooms に登録済み（bLoaded）なので、ハンドルだけ保持する
+	if (FRoomLoad* Added = mRooms.Find(Key))
+	{
+		Added->Handle = Handle;
+	}
+
+	//読み込むものがない
+	if (!Handle.IsValid())
+	{
+		OnRoomLoaded(Key);
+	}
+}
+
+/// @brief 部屋のバンドルを読み込み終わったか
+/// @param Placement 部屋の配置データ
+bool UGimmickPreloadSubsystem::IsPreloaded(const UGimmickPlacementAsset* Placement) const
+{
+	const FRoomLoad* Room = mRooms.Find(TObjectKey<UGimmickPlacementAsset>(Placement));
+	return Room && Room->bLoaded;
+}
+
+/// @brief 部屋のバンドルを読み込み終わったら、待っている処理を呼ぶ
+/// @param Key 部屋の配置データ
+void UGimmickPreloadSubsystem::OnRoomLoaded(TObjectKey<UGimmickPlacementAsset> Key)
+{
+	FRoomLoad* Room = mRooms.Find(Key);
+	if (!Room || Room->bLoaded)
+	{
+		return;
+	}
+
+	Room->bLoaded = true;
+	TArray<FSimpleDelegate> Waiting = MoveTemp(Room->Waiting);
+	for (const FSimpleDelegate& OnLoaded : Waiting)
+	{
+		OnLoaded.ExecuteIfBound();
+	}
+}
@@ -0,0 +1,90 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "UObject/ObjectKey.h"
+#include "Engine/StreamableManager.h"
+#include "GimmickPreloadSubsystem.generated.h"
+
+class UGimmickPlacementAsset;
+
+namespace GimmickLoading
+{
+	//部屋ごとのギミックのクラス・アセットをまとめたバンドル名
+	extern SOTUGYOUSEISAKU_API const FName BundleName;
+
+	/// @brief ギミックの処理（生成・再生成・タイマー・予定した処理・演出）の間に起きた同期読み込みを数える範囲
+	///        ワールドの BeginPlay 後（ゲームプレイ中）の同期読み込みだけを数え、警告を出す（Shipping 以外では ensure も出す）
+	///        範囲の外でもゲームプレイ中の同期読み込みは数え、警告を出す（どの処理で起きたかは出せない）
+	struct SOTUGYOUSEISAKU_API FSyncLoadScope
+	{
+		/// @param Context ワールドを持つオブジェクト
+		/// @param Path ログに出す処理の名前
+		FSyncLoadScope(const UObject* Context, const TCHAR* Path);
+		~FSyncLoadScope();
+
+	private:
+		const TCHAR* mPrevPath = nullptr;
+	};
+
+	//同期読み込みの監視を始める（何度呼んでもよい）
+	SOTUGYOUSEISAKU_API void StartTracking();
+
+	//監視を始めてからの同期読み込みの数（全体 / ゲームプレイ中 / ギミックの処理の中）
+	SOTUGYOUSEISAKU_API int32 GetSyncLoadCount();
+	SOTUGYOUSEISAKU_API int32 GetGameplaySyncLoadCount();
+	SOTUGYOUSEISAKU_API int32 GetGimmickSyncLoadCount();
+
+	//数を 0 に戻す
+	SOTUGYOUSEISAKU_API void ResetSyncLoadCounts();
+}
+
+/// @brief 部屋ごとのギミックのクラス・アセット（UGimmickPlacementAsset の "Gimmick" バンドル）を非同期で先読みするサブシステム
+///
+///        プレイヤーが部屋に近づいたら AGimmickPlacementSpawner が先読みを頼み、読み込み終わってから生成するので、
+///        ゲームプレイ中のギミックの生成で同期読み込みが起きない。
+///        先読みしたものはワールドが終わるまで保持する（落ちる床の再生成などでも読み込み直さない）。
+UCLASS()
+class SOTUGYOUSEISAKU_API UGimmickPreloadSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+
+	/// @brief 部屋のバンドルを非同期で読み込む
+	/// @param Placement 部屋の配置データ
+	/// @param OnLoaded 読み込み終わったら呼ぶ処理（読み込み済みならすぐ呼ぶ）
+	void RequestPreload(const UGimmickPlacementAsset* Placement, FSimpleDelegate OnLoaded);
+
+	//部屋のバンドルを読み込み終わったか
+	bool IsPreloaded(const UGimmickPlacementAsset* Placement) const;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	//部屋のバンドルを読み込み終わったら、待っている処理を呼ぶ
+	void OnRoomLoaded(TObjectKey<UGimmickPlacementAsset> Key);
+
+	//部屋ごとの読み込み状況
+	struct FRoomLoad
+	{
+		//読み込みハンドル（保持している間は読み込んだものが解放されない）
+		TSharedPtr<FStreamableHandle> Handle;
+
+		//読み込み終わるのを待っている処理
+		TArray<FSimpleDelegate> Waiting;
+
+		bool bLoaded = false;
+	};
+	TMap<TObjectKey<UGimmickPlacementAsset>, FRoomLoad> mRooms;
+
+	//BeginPlay した時点の同期読み込みの数（ワールドが終わるときにゲームプレイ中の数をログに出す、BeginPlay 前なら -1）
+	int32 mGameplaySyncLoadsAtBeginPlay = INDEX_NONE;
+	int32 mGimmickSyncLoadsAtBeginPlay = INDEX_NONE;
+};
@@ -0,0 +1,911 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GimmickPuzzleValidateCommandlet.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "Components/PrimitiveComponent.h"
+#include "UObject/Package.h"
+#include "Async/ParallelFor.h"
+#include "Math/RandomStream.h"
+#include "Gimmick_Button.h"
+#include "Gimmick_ButtonManager.h"
+#include "Gimmick_PushBlock.h"
+#include "GimmickMath.h"
+#include <atomic>
+
+DEFINE_LOG_CATEGORY_STATIC(LogGimmickPuzzle, Log, All);
+
+namespace GimmickPuzzle
+{
+	//盤面の最大マス数（ビットボード1枚を uint64 4語で表す）
+	constexpr int32 MaxCells = 256;
+	constexpr int32 MaxWords = MaxCells / 64;
+
+	//押せる向きの組み合わせの最大数（同じ組み合わせのブロックは区別しない）
+	constexpr int32 MaxClasses = 4;
+
+	//ボタンを押す順番の最大長
+	constexpr int32 MaxSequence = 64;
+
+	//並列に展開するときの1タスク分の状態数
+	constexpr int32 ExpandChunkSize = 512;
+
+	//盤面の外周に足す余白（マス）
+	constexpr int32 GridMargin = 2;
+
+	//4方向（+X, -X, +Y, -Y）
+	constexpr int32 NumDirs = 4;
+	const FIntPoint DirOffsets[NumDirs] = { FIntPoint(1, 0), FIntPoint(-1, 0), FIntPoint(0, 1), FIntPoint(0, -1) };
+
+	/// @brief 盤面の各マスを1ビットで表すビットボード
+	struct FBitboard
+	{
+		uint64 Words[MaxWords] = {};
+
+		bool Test(int32 Cell) const { return (Words[Cell >> 6] >> (Cell & 63)) & 1; }
+		void Set(int32 Cell) { Words[Cell >> 6] |= 1ull << (Cell & 63); }
+		void Clear(int32 Cell) { Words[Cell >> 6] &= ~(1ull << (Cell & 63)); }
+
+		bool Intersects(const uint64* Other, int32 NumWords) const
+		{
+			for (int32 i = 0; i < NumWords; i++)
+			{
+				if (Words[i] & Other[i])
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+
+		int32 Num() const
+		{
+			int32 Count = 0;
+			for (uint64 Word : Words)
+			{
+				Count += FMath::CountBits(Word);
+			}
+			return Count;
+		}
+	};
+
+	/// @brief 盤面に落とし込んだ1部屋分のパズル
+	struct FPuzzle
+	{
+		int32 Width = 0;
+		int32 Height = 0;
+		int32 NumWords = 0;
+
+		//ブロックが入れないマス（壁・床のないマス・盤面の外周）
+		FBitboard Walls;
+
+		//プレイヤーが立てるマス（プレイヤーはブロックと重なれるので、ブロックの配置によらない）
+		FBitboard PlayerArea;
+
+		//押せる向きの組み合わせごとのブロックの初期配置（同じ組み合わせのブロックは入れ替えても同じ状態）
+		int32 NumClasses = 0;
+		uint8 ClassDirMask[MaxClasses] = {};
+		FBitboard StartBlocks[MaxClasses];
+
+		//押す順番に並んだボタンのマス
+		TArray<int32> Sequence;
+
+		int32 NumCells() const { return Width * Height; }
+		int32 DirStep(int32 Dir) const { return DirOffsets[Dir].X + DirOffsets[Dir].Y * Width; }
+	};
+
+	enum class ESolveResult : uint8
+	{
+		Solved,
+		Unsolvable,
+		LimitReached,
+	};
+
+	/// @brief 1回分の探索結果
+	struct FSolveOutput
+	{
+		ESolveResult Result = ESolveResult::Unsolvable;
+		int32 Pushes = INDEX_NONE;
+		int64 States = 0;
+		double Ms = 0.0;
+	};
+
+	/// @brief 同じ状態を2回展開しないための置換表（Zobrist ハッシュだけを持つ、ロックなしで並列に追加できる）
+	///        64ビットのハッシュを状態の同一視に使う（部屋の大きさでは衝突は無視できる）
+	class FTranspositionTable
+	{
+	public:
+		explicit FTranspositionTable(int64 MaxStates)
+			: mMaxStates(MaxStates)
+		{
+			const uint64 Capacity = FMath::RoundUpToPowerOfTwo64(static_cast<uint64>(FMath::Max<int64>(MaxStates, 1024)) * 2);
+			mMask = Capacity - 1;
+			mSlots = MakeUnique<std::atomic<uint64>[]>(Capacity);
+			for (uint64 i = 0; i < Capacity; i++)
+			{
+				mSlots[i].store(0, std::memory_order_relaxed);
+			}
+		}
+
+		/// @brief 状態を追加する
+		/// @return 初めて見た状態なら true（上限に達したら false を返して IsFull が true になる）
+		bool Insert(uint64 Hash)
+		{
+			//0 は空きの印なので別の値にする
+			const uint64 Key = Hash ? Hash : 1;
+			for (uint64 Index = Key & mMask; ; Index = (Index + 1) & mMask)
+			{
+				uint64 Expected = mSlots[Index].load(std::memory_order_relaxed);
+				if (Expected == Key)
+				{
+					return false;
+				}
+				if (Expected == 0)
+				{
+					if (mSlots[Index].compare_exchange_strong(Expected, Key, std::memory_order_relaxed))
+					{
+						if (mNum.fetch_add(1, std::memory_order_relaxed) + 1 >= mMaxStates)
+						{
+							bFull.store(true, std::memory_order_relaxed);
+						}
+						return true;
+					}
+					if (Expected == Key)
+					{
+						return false;
+					}
+				}
+			}
+		}
+
+		bool IsFull() const { return bFull.load(std::memory_order_relaxed); }
+		int64 Num() const { return mNum.load(std::memory_order_relaxed); }
+
+	private:
+		TUniquePtr<std::atomic<uint64>[]> mSlots;
+		uint64 mMask = 0;
+		int64 mMaxStates = 0;
+		std::atomic<int64> mNum{ 0 };
+		std::atomic<bool> bFull{ false };
+	};
+
+	/// @brief 押し回数を1段ずつ増やす幅優先探索で、ボタンを順番どおり押し切るまでの最少の押し回数を求める
+	///
+	///        状態は [ハッシュ][押した数][組み合わせごとのビットボード] を uint64 の並びで表し、各段の状態を平らな配列に詰める。
+	///        プレイヤーはブロックと重なれるので、プレイヤーの位置は状態に含めない（押す側のマスに立てるかだけを見る）。
+	class FSolver
+	{
+	public:
+		/// @param InPuzzle 解くパズル
+		/// @param bInPlayerPresses プレイヤーもボタンを踏めるか（false なら設計どおりブロックだけが押す）
+		/// @param MaxStates 探索する状態数の上限
+		FSolver(const FPuzzle& InPuzzle, bool bInPlayerPresses, int64 MaxStates)
+			: mPuzzle(InPuzzle)
+			, bPlayerPresses(bInPlayerPresses)
+			, mTable(MaxStates)
+		{
+			mNumBoardWords = mPuzzle.NumClasses * mPuzzle.NumWords;
+			mStride = 2 + mNumBoardWords;
+
+			//乱数は固定の種から作る（結果を毎回同じにする）
+			FRandomStream Random(0x5A0B);
+			auto Random64 = [&Random]()
+			{
+				return (static_cast<uint64>(Random.GetUnsignedInt()) << 32) | Random.GetUnsignedInt();
+			};
+			mZobristBlock.SetNumUninitialized(MaxClasses * MaxCells);
+			for (uint64& Value : mZobristBlock)
+			{
+				Value = Random64();
+			}
+			mZobristStep.SetNumUninitialized(mPuzzle.Sequence.Num() + 1);
+			for (uint64& Value : mZobristStep)
+			{
+				Value = Random64();
+			}
+
+			BuildLiveCells();
+		}
+
+		FSolveOutput Solve()
+		{
+			const double StartTime = FPlatformTime::Seconds();
+			FSolveOutput Output;
+			const int32 SequenceNum = mPuzzle.Sequence.Num();
+
+			//最初の状態
+			TArray<uint64> Frontier;
+			Frontier.SetNumZeroed(mStride);
+			uint64 Hash = 0;
+			for (int32 Class = 0; Class < mPuzzle.NumClasses; Class++)
+			{
+				for (int32 Word = 0; Word < mPuzzle.NumWords; Word++)
+				{
+					Frontier[2 + Class * mPuzzle.NumWords + Word] = mPuzzle.StartBlocks[Class].Words[Word];
+				}
+				for (int32 Cell = 0; Cell < mPuzzle.NumCells(); Cell++)
+				{
+					if (mPuzzle.StartBlocks[Class].Test(Cell))
+					{
+						Hash ^= ZobristBlock(Class, Cell);
+					}
+				}
+			}
+			const int32 Step = PressByPlayer(0, Frontier.GetData() + 2);
+			Hash ^= mZobristStep[Step];
+			Frontier[0] = Hash;
+			Frontier[1] = Step;
+			mTable.Insert(Hash);
+
+			if (Step >= SequenceNum)
+			{
+				Output.Result = ESolveResult::Solved;
+				Output.Pushes = 0;
+			}
+
+			for (int32 Depth = 0; Output.Result == ESolveResult::Unsolvable && Frontier.Num() > 0; Depth++)
+			{
+				const int32 NumStates = Frontier.Num() / mStride;
+				const int32 NumChunks = FMath::DivideAndRoundUp(NumStates, ExpandChunkSize);
+
+				//タスクごとに次の段を書き出してから繋げる（書き出し先を分けるので同期しない）
+				TArray<TArray<uint64>> ChunkOutputs;
+				ChunkOutputs.SetNum(NumChunks);
+				std::atomic<bool> bFound{ false };
+
+				ParallelFor(NumChunks, [&](int32 Chunk)
+				{
+					const int32 Begin = Chunk * ExpandChunkSize;
+					const int32 End = FMath::Min(Begin + ExpandChunkSize, NumStates);
+					for (int32 i = Begin; i < End; i++)
+					{
+						if (bFound.load(std::memory_order_relaxed) || mTable.IsFull())
+						{
+							return;
+						}
+						if (Expand(Frontier.GetData() + i * mStride, ChunkOutputs[Chunk]))
+						{
+							bFound.store(true, std::memory_order_relaxed);
+						}
+					}
+				});
+
+				if (bFound.load())
+				{
+					Output.Result = ESolveResult::Solved;
+					Output.Pushes = Depth + 1;
+					break;
+				}
+				if (mTable.IsFull())
+				{
+					Output.Result = ESolveResult::LimitReached;
+					break;
+				}
+
+				Frontier.Reset();
+				for (const TArray<uint64>& ChunkOutput : ChunkOutputs)
+				{
+					Frontier.Append(ChunkOutput);
+				}
+			}
+
+			Output.States = mTable.Num();
+			Output.Ms = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+			return Output;
+		}
+
+	private:
+		uint64 ZobristBlock(int32 Class, int32 Cell) const { return mZobristBlock[Class * MaxCells + Cell]; }
+
+		bool IsOccupied(const uint64* Boards, int32 Cell) const
+		{
+			for (int32 Class = 0; Class < mPuzzle.NumClasses; Class++)
+			{
+				if ((Boards[Class * mPuzzle.NumWords + (Cell >> 6)] >> (Cell & 63)) & 1)
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+
+		/// @brief プレイヤーが踏めるボタンを順番どおり踏んだ後の押した数を求める
+		///        間違った順番で踏んでもやり直しにはならないので、次のボタンに行けるなら踏んで損はない
+		int32 PressByPlayer(int32 Step, const uint64* Boards) const
+		{
+			if (bPlayerPresses)
+			{
+				while (Step < mPuzzle.Sequence.Num())
+				{
+					const int32 Cell = mPuzzle.Sequence[Step];
+					if (!mPuzzle.PlayerArea.Test(Cell) || IsOccupied(Boards, Cell))
+					{
+						break;
+					}
+					Step++;
+				}
+			}
+			return Step;
+		}
+
+		/// @brief ボタンごとに、ブロックを置くとそのボタンまで押して運べる可能性のあるマスを求める（他のブロックは無視）
+		///        ボタンのマスから逆向きに引いていき、押す側にプレイヤーが立てるマスだけを辿る
+		void BuildLiveCells()
+		{
+			const int32 SequenceNum = mPuzzle.Sequence.Num();
+			mLive.SetNum(MaxClasses * SequenceNum);
+			mNeedsBlock.SetNum(SequenceNum);
+
+			for (int32 Index = 0; Index < SequenceNum; Index++)
+			{
+				//プレイヤーが踏めるボタンにはブロックが要らない
+				mNeedsBlock[Index] = !(bPlayerPresses && mPuzzle.PlayerArea.Test(mPuzzle.Sequence[Index]));
+
+				for (int32 Class = 0; Class < mPuzzle.NumClasses; Class++)
+				{
+					FBitboard& Live = mLive[Class * SequenceNum + Index];
+					TArray<int32, TInlineAllocator<MaxCells>> Open;
+					Open.Add(mPuzzle.Sequence[Index]);
+					Live.Set(mPuzzle.Sequence[Index]);
+					while (Open.Num() > 0)
+					{
+						const int32 Cell = Open.Pop(EAllowShrinking::No);
+						for (int32 Dir = 0; Dir < NumDirs; Dir++)
+						{
+							if (!(mPuzzle.ClassDirMask[Class] & (1 << Dir)))
+							{
+								continue;
+							}
+
+							//Dir に押して Cell に来る前のマスと、そのときプレイヤーが立つマス
+							const int32 From = Cell - mPuzzle.DirStep(Dir);
+							const int32 Behind = From - mPuzzle.DirStep(Dir);
+							if (From < 0 || Behind < 0 || Live.Test(From) || mPuzzle.Walls.Test(From) || !mPuzzle.PlayerArea.Test(Behind))
+							{
+								continue;
+							}
+							Live.Set(From);
+							Open.Add(From);
+						}
+					}
+				}
+			}
+		}
+
+		/// @brief 残りのボタンのどれかに、もうどのブロックも届かないか
+		bool IsDeadlocked(const uint64* Boards, int32 Step) const
+		{
+			const int32 SequenceNum = mPuzzle.Sequence.Num();
+			for (int32 Index = Step; Index < SequenceNum; Index++)
+			{
+				if (!mNeedsBlock[Index])
+				{
+					continue;
+				}
+
+				bool bReachable = false;
+				for (int32 Class = 0; Class < mPuzzle.NumClasses && !bReachable; Class++)
+				{
+					bReachable = mLive[Class * SequenceNum + Index].Intersects(&Boards[Class * mPuzzle.NumWords], mPuzzle.NumWords);
+				}
+				if (!bReachable)
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+
+		/// @brief 1つの状態から1回押した状態を全て作り、初めて見る状態を次の段に加える
+		/// @param State 展開する状態
+		/// @param OutNext 次の段の書き出し先
+		/// @return ボタンを全て押し切れる状態が見つかったら true
+		bool Expand(const uint64* State, TArray<uint64>& OutNext)
+		{
+			const uint64 Hash = State[0];
+			const int32 Step = static_cast<int32>(State[1]);
+			const uint64* Boards = State + 2;
+			const int32 SequenceNum = mPuzzle.Sequence.Num();
+
+			for (int32 Class = 0; Class < mPuzzle.NumClasses; Class++)
+			{
+				for (int32 Word = 0; Word < mPuzzle.NumWords; Word++)
+				{
+					for (uint64 Bits = Boards[Class * mPuzzle.NumWords + Word]; Bits; Bits &= Bits - 1)
+					{
+						const int32 Cell = Word * 64 + static_cast<int32>(FMath::CountTrailingZeros64(Bits));
+						for (int32 Dir = 0; Dir < NumDirs; Dir++)
+						{
+							if (!(mPuzzle.ClassDirMask[Class] & (1 << Dir)))
+							{
+								continue;
+							}
+
+							//盤面の外周は壁なので、ブロックの隣のマスは必ず盤面の中にある
+							const int32 Target = Cell + mPuzzle.DirStep(Dir);
+							const int32 Behind = Cell - mPuzzle.DirStep(Dir);
+							if (mPuzzle.Walls.Test(Target) || IsOccupied(Boards, Target) || !mPuzzle.PlayerArea.Test(Behind))
+							{
+								continue;
+							}
+
+							uint64 Next[MaxClasses * MaxWords];
+							FMemory::Memcpy(Next, Boards, mNumBoardWords * sizeof(uint64));
+							uint64* ClassBoard = &Next[Class * mPuzzle.NumWords];
+							ClassBoard[Cell >> 6] &= ~(1ull << (Cell & 63));
+							ClassBoard[Target >> 6] |= 1ull << (Target & 63);
+
+							//次に押すボタンにブロックが乗ったら1つ進む
+							int32 NextStep = Step;
+							if (NextStep < SequenceNum && mPuzzle.Sequence[NextStep] == Target)
+							{
+								NextStep++;
+							}
+							NextStep = PressByPlayer(NextStep, Next);
+							if (NextStep >= SequenceNum)
+							{
+								return true;
+							}
+
+							if (IsDeadlocked(Next, NextStep))
+							{
+								continue;
+							}
+
+							const uint64 NextHash = Hash ^ ZobristBlock(Class, Cell) ^ ZobristBlock(Class, Target)
+								^ mZobristStep[Step] ^ mZobristStep[NextStep];
+							if (!mTable.Insert(NextHash))
+							{
+								continue;
+							}
+
+							OutNext.Add(NextHash);
+							OutNext.Add(NextStep);
+							OutNext.Append(Next, mNumBoardWords);
+						}
+					}
+				}
+			}
+			return false;
+		}
+
+		const FPuzzle& mPuzzle;
+		bool bPlayerPresses = false;
+		int32 mNumBoardWords = 0;
+		int32 mStride = 0;
+
+		FTranspositionTable mTable;
+		TArray<uint64> mZobristBlock;
+		TArray<uint64> mZobristStep;
+
+		//[組み合わせ × ボタン] ごとの、ブロックを置くとそのボタンまで運べる可能性のあるマス
+		TArray<FBitboard> mLive;
+
+		//ブロックで押す必要のあるボタンか
+		TArray<bool> mNeedsBlock;
+	};
+
+	/// @brief 盤面に落とし込む設定
+	struct FBuildSettings
+	{
+		//1マスの大きさ（0 ならブロックの大きさに合わせる）
+		float CellSize = 0.0f;
+
+		//ボタンからこの距離（cm）以内のブロックをその部屋のブロックとみなす
+		float RoomRadius = 2000.0f;
+	};
+
+	/// @brief 1部屋分の検証対象
+	struct FRoom
+	{
+		FString Name;
+		FPuzzle Puzzle;
+		float CellSize = 0.0f;
+		int32 NumBlocks = 0;
+
+		//押す順番に並んだボタンの名前（Puzzle.Sequence と同じ並び）
+		TArray<FString> ButtonNames;
+	};
+
+	/// @brief ブロックを押せる向きを求める（CanBePushedByPlayer と同じく、押す向きと押せる面の方向の角度が mPushAngle 以内）
+	uint8 ComputeDirMask(const AGimmick_PushBlock* Block)
+	{
+		const FVector WorldPushDir = GimmickMath::GetPushDir2D(Block->GetActorRotation().RotateVector(Block->mPushDir));
+		const float ConeCos = GimmickMath::PushConeCos(Block->mPushAngle + KINDA_SMALL_NUMBER);
+
+		//押して動かす向きの反対側に立つので、プレイヤーへの向きは動かす向きの逆
+		uint8 Mask = 0;
+		for (int32 Dir = 0; Dir < NumDirs; Dir++)
+		{
+			const FVector ToPlayer(-DirOffsets[Dir].X, -DirOffsets[Dir].Y, 0.0f);
+			if (GimmickMath::IsInPushCone(ToPlayer, WorldPushDir, ConeCos))
+			{
+				Mask |= 1 << Dir;
+			}
+		}
+		return Mask;
+	}
+
+	/// @brief ボタンマネージャー1つ分の部屋を盤面に落とし込む
+	/// @param World 部屋のあるワールド
+	/// @param Manager 部屋のボタンマネージャー
+	/// @param Blocks 部屋のブロック
+	/// @param Settings 落とし込む設定
+	/// @param OutRoom 落とし込んだ部屋
+	/// @param OutError 落とし込めなかった理由
+	/// @return 落とし込めたか
+	bool BuildRoom(UWorld* World, const AGimmick_ButtonManager* Manager, const TArray<AGimmick_PushBlock*>& Blocks,
+		const FBuildSettings& Settings, FRoom& OutRoom, FString& OutError)
+	{
+		FPuzzle& Puzzle = OutRoom.Puzzle;
+		OutRoom.Name = Manager->GetName();
+		OutRoom.NumBlocks = Blocks.Num();
+
+		const TArray<AGimmick_Button*>& Sequence = Manager->GetButtonSequence();
+		if (Sequence.Num() > MaxSequence)
+		{
+			OutError = FString::Printf(TEXT("sequence has %d buttons (max %d)"), Sequence.Num(), MaxSequence);
+			return false;
+		}
+
+		//マスの大きさと、ブロックの当たり判定の高さ・チャンネル
+		const UPrimitiveComponent* BlockBody = Blocks.Num() > 0 ? Cast<UPrimitiveComponent>(Blocks[0]->GetRootComponent()) : nullptr;
+		FVector BlockOrigin = FVector::ZeroVector;
+		FVector BlockExtent(50.0f);
+		if (Blocks.Num() > 0)
+		{
+			Blocks[0]->GetActorBounds(true, BlockOrigin, BlockExtent);
+		}
+		else
+		{
+			BlockOrigin = Sequence[0]->GetActorLocation() + FVector(0.0f, 0.0f, BlockExtent.Z);
+		}
+		const float CellSize = Settings.CellSize > 0.0f ? Settings.CellSize : FMath::Max(BlockExtent.X, BlockExtent.Y) * 2.0f;
+		OutRoom.CellSize = CellSize;
+
+		const ECollisionChannel Channel = BlockBody ? BlockBody->GetCollisionObjectType() : ECC_WorldDynamic;
+		const FCollisionResponseParams Responses = BlockBody ? FCollisionResponseParams(BlockBody->GetCollisionResponseToChannels()) : FCollisionResponseParams::DefaultResponseParam;
+
+		//ボタンとブロックを囲む範囲に余白を足し、ブロックの中心がマスの中心に来るように原点を揃える
+		FBox Bounds(ForceInit);
+		for (const AGimmick_Button* Button : Sequence)
+		{
+			Bounds += Button->GetActorLocation();
+		}
+		for (const AGimmick_PushBlock* Block : Blocks)
+		{
+			Bounds += Block->GetActorLocation();
+		}
+		const FVector2D Aligned(BlockOrigin.X - CellSize * 0.5f, BlockOrigin.Y - CellSize * 0.5f);
+		const FVector2D Origin(
+			Aligned.X - FMath::CeilToFloat((Aligned.X - Bounds.Min.X) / CellSize + GridMargin) * CellSize,
+			Aligned.Y - FMath::CeilToFloat((Aligned.Y - Bounds.Min.Y) / CellSize + GridMargin) * CellSize);
+		Puzzle.Width = FMath::CeilToInt((Bounds.Max.X - Origin.X) / CellSize) + GridMargin;
+		Puzzle.Height = FMath::CeilToInt((Bounds.Max.Y - Origin.Y) / CellSize) + GridMargin;
+		if (Puzzle.NumCells() > MaxCells)
+		{
+			OutError = FString::Printf(TEXT("room is %dx%d cells of %.0fcm (max %d cells), reduce -RoomRadius or raise -CellSize"),
+				Puzzle.Width, Puzzle.Height, CellSize, MaxCells);
+			return false;
+		}
+		Puzzle.NumWords = FMath::DivideAndRoundUp(Puzzle.NumCells(), 64);
+
+		auto ToCell = [&](const FVector& Location)
+		{
+			const int32 X = FMath::FloorToInt((Location.X - Origin.X) / CellSize);
+			const int32 Y = FMath::FloorToInt((Location.Y - Origin.Y) / CellSize);
+			return Y * Puzzle.Width + X;
+		};
+
+		//壁と床を物理クエリで調べる（部屋のブロックとボタンは無視する、プレイヤーはブロックと重なるので Pawn は壁にならない）
+		FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(GimmickPuzzleValidate), false);
+		QueryParams.AddIgnoredActor(Manager);
+		for (const AGimmick_PushBlock* Block : Blocks)
+		{
+			QueryParams.AddIgnoredActor(Block);
+		}
+		for (const AGimmick_Button* Button : Sequence)
+		{
+			QueryParams.AddIgnoredActor(Button);
+		}
+		const FCollisionShape CellShape = FCollisionShape::MakeBox(FVector(CellSize * 0.45f, CellSize * 0.45f, BlockExtent.Z * 0.8f));
+		for (int32 Y = 0; Y < Puzzle.Height; Y++)
+		{
+			for (int32 X = 0; X < Puzzle.Width; X++)
+			{
+				const int32 Cell = Y * Puzzle.Width + X;
+				if (X == 0 || Y == 0 || X == Puzzle.Width - 1 || Y == Puzzle.Height - 1)
+				{
+					Puzzle.Walls.Set(Cell);
+					continue;
+				}
+
+				const FVector Center(Origin.X + (X + 0.5f) * CellSize, Origin.Y + (Y + 0.5f) * CellSize, BlockOrigin.Z);
+				const bool bBlocked = World->OverlapBlockingTestByChannel(Center, FQuat::Identity, Channel, CellShape, QueryParams, Responses);
+				const bool bHasFloor = World->LineTraceTestByChannel(Center, Center - FVector(0.0f, 0.0f, BlockExtent.Z + CellSize * 0.5f), Channel, QueryParams, Responses);
+				if (bBlocked || !bHasFloor)
+				{
+					Puzzle.Walls.Set(Cell);
+				}
+			}
+		}
+
+		//プレイヤーが立てるのは、壁でないマスのうち一番広く繋がった範囲
+		FBitboard Visited = Puzzle.Walls;
+		for (int32 Start = 0; Start < Puzzle.NumCells(); Start++)
+		{
+			if (Visited.Test(Start))
+			{
+				continue;
+			}
+
+			FBitboard Area;
+			TArray<int32, TInlineAllocator<MaxCells>> Open;
+			Open.Add(Start);
+			Visited.Set(Start);
+			while (Open.Num() > 0)
+			{
+				const int32 Cell = Open.Pop(EAllowShrinking::No);
+				Area.Set(Cell);
+				for (int32 Dir = 0; Dir < NumDirs; Dir++)
+				{
+					const int32 Next = Cell + Puzzle.DirStep(Dir);
+					if (!Visited.Test(Next))
+					{
+						Visited.Set(Next);
+						Open.Add(Next);
+					}
+				}
+			}
+			if (Area.Num() > Puzzle.PlayerArea.Num())
+			{
+				Puzzle.PlayerArea = Area;
+			}
+		}
+
+		//ブロックを押せる向きの組み合わせごとに分ける
+		for (const AGimmick_PushBlock* Block : Blocks)
+		{
+			const int32 Cell = ToCell(Block->GetActorLocation());
+			if (Puzzle.Walls.Test(Cell))
+			{
+				OutError = FString::Printf(TEXT("%s starts in a blocked cell"), *Block->GetName());
+				return false;
+			}
+
+			const uint8 Mask = ComputeDirMask(Block);
+			int32 Class = 0;
+			while (Class < Puzzle.NumClasses && Puzzle.ClassDirMask[Class] != Mask)
+			{
+				Class++;
+			}
+			if (Class == MaxClasses)
+			{
+				OutError = FString::Printf(TEXT("more than %d different push directions"), MaxClasses);
+				return false;
+			}
+			if (Class == Puzzle.NumClasses)
+			{
+				Puzzle.ClassDirMask[Puzzle.NumClasses++] = Mask;
+			}
+
+			for (int32 Other = 0; Other < Puzzle.NumClasses; Other++)
+			{
+				if (Puzzle.StartBlocks[Other].Test(Cell))
+				{
+					OutError = FString::Printf(TEXT("%s shares a cell with another block"), *Block->GetName());
+					return false;
+				}
+			}
+			Puzzle.StartBlocks[Class].Set(Cell);
+		}
+
+		for (const AGimmick_Button* Button : Sequence)
+		{
+			Puzzle.Sequence.Add(ToCell(Button->GetActorLocation()));
+			OutRoom.ButtonNames.Add(Button->GetName());
+		}
+		return true;
+	}
+
+	/// @brief 結果の表示名
+	const TCHAR* ResultName(const FSolveOutput& Output)
+	{
+		switch (Output.Result)
+		{
+		case ESolveResult::Solved:
+			return TEXT("solvable");
+		case ESolveResult::LimitReached:
+			return TEXT("unknown (state limit)");
+		default:
+			return TEXT("UNSOLVABLE");
+		}
+	}
+
+	/// @brief 検証の集計
+	struct FSummary
+	{
+		int32 Rooms = 0;
+		int32 Unsolvable = 0;
+		int32 Shortcuts = 0;
+		int32 Skipped = 0;
+	};
+
+	/// @brief 1つのマップの部屋を全て検証する
+	/// @param MapName 検証するマップのパッケージ名
+	/// @param Settings 盤面に落とし込む設定
+	/// @param MaxStates 1回の探索の状態数の上限
+	/// @param OutSummary 集計の加算先
+	/// @return マップを読み込めたか
+	bool ValidateMap(const FString& MapName, const FBuildSettings& Settings, int64 MaxStates, FSummary& OutSummary)
+	{
+		UPackage* Package = LoadPackage(nullptr, *MapName, LOAD_None);
+		UWorld* World = Package ? UWorld::FindWorldInPackage(Package) : nullptr;
+		if (!World)
+		{
+			UE_LOG(LogGimmickPuzzle, Error, TEXT("Failed to load map %s"), *MapName);
+			return false;
+		}
+
+		//物理クエリだけ使えればよいので、描画・ナビ・AI・物理シミュレーションなしで初期化する
+		World->AddToRoot();
+		FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Editor);
+		WorldContext.SetCurrentWorld(World);
+		if (!World->bIsWorldInitialized)
+		{
+			World->InitWorld(UWorld::InitializationValues()
+				.AllowAudioPlayback(false)
+				.RequiresHitProxies(false)
+				.CreatePhysicsScene(true)
+				.CreateNavigation(false)
+				.CreateAISystem(false)
+				.ShouldSimulatePhysics(false)
+				.EnableTraceCollision(true));
+		}
+		World->UpdateWorldComponents(true, false);
+
+		//ボタンマネージャーごとに、ボタンの近くのブロックを部屋に割り当てる（先に見つかった部屋が優先）
+		TArray<AGimmick_PushBlock*> FreeBlocks;
+		for (TActorIterator<AGimmick_PushBlock> It(World); It; ++It)
+		{
+			FreeBlocks.Add(*It);
+		}
+
+		for (TActorIterator<AGimmick_ButtonManager> It(World); It; ++It)
+		{
+			const AGimmick_ButtonManager* Manager = *It;
+			const TArray<AGimmick_Button*>& Sequence = Manager->GetButtonSequence();
+			if (Sequence.Num() == 0 || Sequence.Contains(nullptr))
+			{
+				UE_LOG(LogGimmickPuzzle, Warning, TEXT("[%s] %s: button sequence is empty or has unset entries, skipped"), *MapName, *Manager->GetName());
+				OutSummary.Skipped++;
+				continue;
+			}
+
+			TArray<AGimmick_PushBlock*> Blocks;
+			for (int32 i = FreeBlocks.Num() - 1; i >= 0; i--)
+			{
+				for (const AGimmick_Button* Button : Sequence)
+				{
+					if (FVector::DistSquared2D(FreeBlocks[i]->GetActorLocation(), Button->GetActorLocation()) <= FMath::Square(Settings.RoomRadius))
+					{
+						Blocks.Add(FreeBlocks[i]);
+						FreeBlocks.RemoveAtSwap(i, EAllowShrinking::No);
+						break;
+					}
+				}
+			}
+
+			FRoom Room;
+			FString Error;
+			if (!BuildRoom(World, Manager, Blocks, Settings, Room, Error))
+			{
+				UE_LOG(LogGimmickPuzzle, Warning, TEXT("[%s] %s: %s, skipped"), *MapName, *Manager->GetName(), *Error);
+				OutSummary.Skipped++;
+				continue;
+			}
+			OutSummary.Rooms++;
+
+			UE_LOG(LogGimmickPuzzle, Display, TEXT("[%s] %s: %dx%d cells of %.0fcm, %d blocks, %d buttons in sequence"),
+				*MapName, *Room.Name, Room.Puzzle.Width, Room.Puzzle.Height, Room.CellSize, Room.NumBlocks, Room.Puzzle.Sequence.Num());
+
+			//設計どおり（ブロックだけがボタンを押す）
+			FSolver Designed(Room.Puzzle, false, MaxStates);
+			const FSolveOutput DesignedOutput = Designed.Solve();
+			UE_LOG(LogGimmickPuzzle, Display, TEXT("    designed: %s, %d pushes (%lld states, %.1f ms)"),
+				ResultName(DesignedOutput), DesignedOutput.Pushes, DesignedOutput.States, DesignedOutput.Ms);
+			if (DesignedOutput.Result == ESolveResult::Unsolvable)
+			{
+				UE_LOG(LogGimmickPuzzle, Error, TEXT("[%s] %s cannot be solved by pushing blocks onto the buttons in order"), *MapName, *Room.Name);
+				OutSummary.Unsolvable++;
+			}
+
+			//近道（プレイヤーも自分でボタンを踏める）
+			FSolver Actual(Room.Puzzle, true, MaxStates);
+			const FSolveOutput ActualOutput = Actual.Solve();
+			UE_LOG(LogGimmickPuzzle, Display, TEXT("    with player presses: %s, %d pushes (%lld states, %.1f ms)"),
+				ResultName(ActualOutput), ActualOutput.Pushes, ActualOutput.States, ActualOutput.Ms);
+
+			const bool bShortcut = ActualOutput.Result == ESolveResult::Solved
+				&& (DesignedOutput.Result != ESolveResult::Solved || ActualOutput.Pushes < DesignedOutput.Pushes);
+			if (bShortcut)
+			{
+				TArray<FString> Pressable;
+				for (int32 i = 0; i < Room.Puzzle.Sequence.Num(); i++)
+				{
+					if (Room.Puzzle.PlayerArea.Test(Room.Puzzle.Sequence[i]))
+					{
+						Pressable.AddUnique(Room.ButtonNames[i]);
+					}
+				}
+				UE_LOG(LogGimmickPuzzle, Warning, TEXT("[%s] %s has a shortcut: the player can step on %s and open it in %d pushes%s"),
+					*MapName, *Room.Name, *FString::Join(Pressable, TEXT(", ")), ActualOutput.Pushes,
+					ActualOutput.Pushes == 0 ? TEXT(" (no block needed)") : TEXT(""));
+				OutSummary.Shortcuts++;
+			}
+		}
+
+		if (FreeBlocks.Num() > 0)
+		{
+			UE_LOG(LogGimmickPuzzle, Display, TEXT("[%s] %d push blocks are not near any button sequence"), *MapName, FreeBlocks.Num());
+		}
+
+		GEngine->DestroyWorldContext(World);
+		World->DestroyWorld(false);
+		World->RemoveFromRoot();
+		CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS);
+		return true;
+	}
+}
+
+UGimmickPuzzleValidateCommandlet::UGimmickPuzzleValidateCommandlet()
+{
+	IsClient = false;
+	IsEditor = true;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+/// @brief コマンドレットのエントリポイント
+/// @param Params コマンドライン引数
+/// @return 0 = 全ての部屋が解ける、1 = 解けない部屋（-FailOnShortcut なら近道のある部屋）がある、またはマップを読み込めない
+int32 UGimmickPuzzleValidateCommandlet::Main(const FString& Params)
+{
+	using namespace GimmickPuzzle;
+
+	FString Maps;
+	FBuildSettings Settings;
+	int64 MaxStates = 4000000;
+
+	FParse::Value(*Params, TEXT("Map="), Maps);
+	FParse::Value(*Params, TEXT("CellSize="), Settings.CellSize);
+	FParse::Value(*Params, TEXT("RoomRadius="), Settings.RoomRadius);
+	FParse::Value(*Params, TEXT("MaxStates="), MaxStates);
+	const bool bFailOnShortcut = FParse::Param(*Params, TEXT("FailOnShortcut"));
+
+	TArray<FString> MapNames;
+	Maps.ParseIntoArray(MapNames, TEXT("+"));
+	if (MapNames.Num() == 0)
+	{
+		UE_LOG(LogGimmickPuzzle, Error, TEXT("No map given, use -Map=/Game/Maps/<Name>[+<Name>...]"));
+		return 1;
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+	FSummary Summary;
+	int32 FailedMaps = 0;
+	for (const FString& MapName : MapNames)
+	{
+		if (!ValidateMap(MapName, Settings, MaxStates, Summary))
+		{
+			FailedMaps++;
+		}
+	}
+
+	UE_LOG(LogGimmickPuzzle, Display, TEXT("Validated %d rooms in %d maps (%.2f s): %d unsolvable, %d with shortcuts, %d skipped"),
+		Summary.Rooms, MapNames.Num(), FPlatformTime::Seconds() - StartTime, Summary.Unsolvable, Summary.Shortcuts, Summary.Skipped);
+
+	const bool bFailed = FailedMaps > 0 || Summary.Unsolvable > 0 || (bFailOnShortcut && Summary.Shortcuts > 0);
+	return bFailed ? 1 : 0;
+}
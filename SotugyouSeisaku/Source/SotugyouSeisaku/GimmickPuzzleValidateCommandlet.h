@@ -0,0 +1,33 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "GimmickPuzzleValidateCommandlet.generated.h"
+
+/// @brief 押せるブロックとボタンのパズルが解けるかをビルド時に確かめるコマンドレット
+///
+///        マップを描画なしで読み込み、ボタンマネージャーごとに1部屋として
+///        壁・ブロック（mPushDir / mPushAngle から求めた押せる向き）・ボタンと押す順番をマス目の盤面に落とし込み、倉庫番として解く。
+///        盤面はビットボード、同じ状態の判定は Zobrist ハッシュの置換表、解けない配置は枝刈りし、探索の各段を並列に展開する。
+///
+///        部屋ごとに次の2通りを解いて報告する
+///        ・設計どおり: ブロックだけがボタンを押す → 解けるか、最少の押し回数
+///        ・近道: プレイヤーも自分でボタンを踏める（実行時と同じ）→ 設計より少ない押し回数で開くなら近道として警告する
+///
+///        実行例:
+///        UnrealEditor-Cmd SotugyouSeisaku.uproject -run=GimmickPuzzleValidate -nullrhi -unattended
+///            -Map=/Game/Maps/Stage1+/Game/Maps/Stage2 [-CellSize=<cm>] [-RoomRadius=2000] [-MaxStates=4000000] [-FailOnShortcut]
+///
+///        解けない部屋があれば（-FailOnShortcut なら近道のある部屋も）1 を返すので、コンテンツのビルドを止められる
+UCLASS()
+class SOTUGYOUSEISAKU_API UGimmickPuzzleValidateCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UGimmickPuzzleValidateCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
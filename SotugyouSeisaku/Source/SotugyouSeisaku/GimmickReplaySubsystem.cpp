@@ -0,0 +1,695 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GimmickReplaySubsystem.h"
+#include "GimmickEvents.h"
+#include "SotugyouSeisakuCharacter.h"
+#include "EnhancedInputSubsystems.h"
+#include "Engine/LocalPlayer.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/PlatformFileManager.h"
+#include "HAL/Runnable.h"
+#include "HAL/RunnableThread.h"
+#include "Async/MappedFileHandle.h"
+#include "Containers/Queue.h"
+#include "Misc/App.h"
+#include "Misc/DateTime.h"
+#include "Misc/Paths.h"
+#include <atomic>
+
+DEFINE_LOG_CATEGORY_STATIC(LogGimmickReplay, Log, All);
+
+namespace GimmickReplay
+{
+	//ファイル先頭の識別子とバージョン
+	constexpr uint8 Magic[4] = { 'G', 'R', 'P', 'L' };
+	constexpr uint16 FormatVersion = 1;
+	constexpr int64 FileHeaderSize = 8;
+
+	//チャンクヘッダ（ペイロードサイズ + フレーム数）
+	constexpr int64 ChunkHeaderSize = 8;
+
+	//このサイズを超えたらチャンクを書き込みスレッドに渡す
+	constexpr int32 ChunkFlushSize = 32 * 1024;
+
+	//入力値の量子化（1/1000単位）
+	constexpr double InputQuantize = 1000.0;
+
+	//レコードの種類
+	enum class ERecordTag : uint8
+	{
+		Frame = 0,		//フレームの区切り（フレーム時間の差分）
+		Input,			//入力（種類 + 値の差分）
+		NewGimmick,		//初出のギミックのイベント（種類 + 64bitのID）
+		KnownGimmick,	//既出のギミックのイベント（種類 + 短縮番号）
+	};
+
+	void WriteVarint(TArray<uint8>& Out, uint64 Value)
+	{
+		while (Value >= 0x80)
+		{
+			Out.Add(static_cast<uint8>(Value) | 0x80);
+			Value >>= 7;
+		}
+		Out.Add(static_cast<uint8>(Value));
+	}
+
+	uint64 ZigZag(int64 Value)
+	{
+		return (static_cast<uint64>(Value) << 1) ^ static_cast<uint64>(Value >> 63);
+	}
+
+	int64 UnZigZag(uint64 Value)
+	{
+		return static_cast<int64>(Value >> 1) ^ -static_cast<int64>(Value & 1);
+	}
+
+	void WriteUInt32(uint8* Out, uint32 Value)
+	{
+		for (int32 i = 0; i < 4; i++)
+		{
+			Out[i] = static_cast<uint8>(Value >> (i * 8));
+		}
+	}
+
+	uint32 ReadUInt32(const uint8* In)
+	{
+		uint32 Value = 0;
+		for (int32 i = 0; i < 4; i++)
+		{
+			Value |= static_cast<uint32>(In[i]) << (i * 8);
+		}
+		return Value;
+	}
+
+	//入力ごとの値の型
+	EInputActionValueType GetValueType(EGimmickReplayInput Input)
+	{
+		return (Input == EGimmickReplayInput::Move || Input == EGimmickReplayInput::Look)
+			? EInputActionValueType::Axis2D
+			: EInputActionValueType::Boolean;
+	}
+}
+
+/// @brief 記録ファイルをバックグラウンドで書き込むスレッド
+class FGimmickReplayWriter : public FRunnable
+{
+public:
+	explicit FGimmickReplayWriter(IFileHandle* InFile)
+		: mFile(InFile)
+		, mWakeEvent(FPlatformProcess::GetSynchEventFromPool())
+	{
+		mThread.Reset(FRunnableThread::Create(this, TEXT("GimmickReplayWriter"), 0, TPri_BelowNormal));
+	}
+
+	virtual ~FGimmickReplayWriter()
+	{
+		//残りのチャンクを書き切ってから終了する
+		bStopRequested = true;
+		mWakeEvent->Trigger();
+		mThread->WaitForCompletion();
+		mThread.Reset();
+		FPlatformProcess::ReturnSynchEventToPool(mWakeEvent);
+	}
+
+	//チャンクを書き込み待ちに積む（ゲームスレッドからのみ呼ぶ）
+	void Enqueue(TArray<uint8>&& Chunk)
+	{
+		mPending.Enqueue(MoveTemp(Chunk));
+		mWakeEvent->Trigger();
+	}
+
+	virtual uint32 Run() override
+	{
+		while (true)
+		{
+			WritePending();
+			if (bStopRequested)
+			{
+				WritePending();
+				break;
+			}
+			mWakeEvent->Wait();
+		}
+
+		mFile->Flush();
+		return 0;
+	}
+
+private:
+	void WritePending()
+	{
+		TArray<uint8> Chunk;
+		while (mPending.Dequeue(Chunk))
+		{
+			mFile->Write(Chunk.GetData(), Chunk.Num());
+		}
+	}
+
+	TUniquePtr<IFileHandle> mFile;
+	TQueue<TArray<uint8>, EQueueMode::Spsc> mPending;
+	FEvent* mWakeEvent = nullptr;
+	TUniquePtr<FRunnableThread> mThread;
+	std::atomic<bool> bStopRequested { false };
+};
+
+/// @brief 記録ファイルをメモリマップでチャンクごとに読む
+class FGimmickReplayReader
+{
+public:
+	static TUniquePtr<FGimmickReplayReader> Open(const FString& FilePath)
+	{
+		TUniquePtr<IMappedFileHandle> Handle(FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*FilePath));
+		if (!Handle || Handle->GetFileSize() < GimmickReplay::FileHeaderSize)
+		{
+			return nullptr;
+		}
+
+		//ヘッダを確認
+		TUniquePtr<IMappedFileRegion> Header(Handle->MapRegion(0, GimmickReplay::FileHeaderSize));
+		if (!Header || FMemory::Memcmp(Header->GetMappedPtr(), GimmickReplay::Magic, 4) != 0)
+		{
+			return nullptr;
+		}
+		const uint8* HeaderPtr = Header->GetMappedPtr();
+		const uint16 Version = static_cast<uint16>(HeaderPtr[4] | (HeaderPtr[5] << 8));
+		if (Version != GimmickReplay::FormatVersion)
+		{
+			UE_LOG(LogGimmickReplay, Error, TEXT("Unsupported replay version %d: %s"), Version, *FilePath);
+			return nullptr;
+		}
+
+		TUniquePtr<FGimmickReplayReader> Reader(new FGimmickReplayReader());
+		Reader->mHandle = MoveTemp(Handle);
+		Reader->mNextChunkOffset = GimmickReplay::FileHeaderSize;
+		return Reader;
+	}
+
+	//現在のチャンクを読み終えていれば次のチャンクをマップする（戻り値 = まだ読めるデータがあるか）
+	bool EnsureData()
+	{
+		while (mCursor >= mSize)
+		{
+			mRegion.Reset();
+			mData = nullptr;
+			mSize = 0;
+			mCursor = 0;
+
+			const int64 FileSize = mHandle->GetFileSize();
+			if (mNextChunkOffset + GimmickReplay::ChunkHeaderSize > FileSize)
+			{
+				return false;
+			}
+
+			uint32 PayloadSize = 0;
+			{
+				TUniquePtr<IMappedFileRegion> ChunkHeader(mHandle->MapRegion(mNextChunkOffset, GimmickReplay::ChunkHeaderSize));
+				if (!ChunkHeader)
+				{
+					return false;
+				}
+				PayloadSize = GimmickReplay::ReadUInt32(ChunkHeader->GetMappedPtr());
+			}
+
+			const int64 PayloadOffset = mNextChunkOffset + GimmickReplay::ChunkHeaderSize;
+			if (PayloadOffset + PayloadSize > FileSize)
+			{
+				//書き込み途中で終わったチャンクは無視する
+				return false;
+			}
+
+			mNextChunkOffset = PayloadOffset + PayloadSize;
+			if (PayloadSize == 0)
+			{
+				continue;
+			}
+
+			mRegion.Reset(mHandle->MapRegion(PayloadOffset, PayloadSize));
+			if (!mRegion)
+			{
+				return false;
+			}
+			mData = mRegion->GetMappedPtr();
+			mSize = PayloadSize;
+		}
+		return true;
+	}
+
+	//次のバイトを読まずに確認する（EnsureData()の後に呼ぶ）
+	uint8 PeekByte() const { return mData[mCursor]; }
+
+	uint8 ReadByte()
+	{
+		return mCursor < mSize ? mData[mCursor++] : 0;
+	}
+
+	uint64 ReadVarint()
+	{
+		uint64 Value = 0;
+		for (int32 Shift = 0; Shift < 64 && mCursor < mSize; Shift += 7)
+		{
+			const uint8 Byte = mData[mCursor++];
+			Value |= static_cast<uint64>(Byte & 0x7F) << Shift;
+			if ((Byte & 0x80) == 0)
+			{
+				break;
+			}
+		}
+		return Value;
+	}
+
+	uint64 ReadFixed64()
+	{
+		uint64 Value = 0;
+		for (int32 i = 0; i < 8; i++)
+		{
+			Value |= static_cast<uint64>(ReadByte()) << (i * 8);
+		}
+		return Value;
+	}
+
+	//差分復元用の状態
+	int64 mPrevFrameMicros = 0;
+	FIntPoint mPrevInputValues[static_cast<int32>(EGimmickReplayInput::Count)];
+	uint32 mGimmickCount = 0;
+
+private:
+	FGimmickReplayReader()
+	{
+		for (FIntPoint& Value : mPrevInputValues)
+		{
+			Value = FIntPoint::ZeroValue;
+		}
+	}
+
+	TUniquePtr<IMappedFileHandle> mHandle;
+	TUniquePtr<IMappedFileRegion> mRegion;
+	const uint8* mData = nullptr;
+	int64 mSize = 0;
+	int64 mCursor = 0;
+	int64 mNextChunkOffset = 0;
+};
+
+UGimmickReplaySubsystem::UGimmickReplaySubsystem()
+{
+}
+
+UGimmickReplaySubsystem::~UGimmickReplaySubsystem()
+{
+}
+
+void UGimmickReplaySubsystem::Deinitialize()
+{
+	StopRecording();
+	StopPlayback();
+
+	Super::Deinitialize();
+}
+
+TStatId UGimmickReplaySubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UGimmickReplaySubsystem, STATGROUP_Tickables);
+}
+
+bool UGimmickReplaySubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+/// @brief 記録ファイルの既定の保存先
+FString UGimmickReplaySubsystem::GetDefaultReplayDir()
+{
+	return FPaths::ProjectSavedDir() / TEXT("Replays");
+}
+
+/// @brief 記録を開始する
+/// @param FilePath 記録ファイルのパス
+/// @return 開始できたか
+bool UGimmickReplaySubsystem::StartRecording(const FString& FilePath)
+{
+	LLM_SCOPE_BYTAG(Gimmick_Recorder);
+
+	if (IsRecording() || IsPlaying())
+	{
+		return false;
+	}
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	PlatformFile.CreateDirectoryTree(*FPaths::GetPath(FilePath));
+
+	IFileHandle* File = PlatformFile.OpenWrite(*FilePath);
+	if (!File)
+	{
+		UE_LOG(LogGimmickReplay, Error, TEXT("Failed to open replay file: %s"), *FilePath);
+		return false;
+	}
+
+	//ファイルヘッダ
+	uint8 Header[GimmickReplay::FileHeaderSize] = { 0 };
+	FMemory::Memcpy(Header, GimmickReplay::Magic, 4);
+	Header[4] = static_cast<uint8>(GimmickReplay::FormatVersion & 0xFF);
+	Header[5] = static_cast<uint8>(GimmickReplay::FormatVersion >> 8);
+	File->Write(Header, sizeof(Header));
+
+	mWriter = MakeUnique<FGimmickReplayWriter>(File);
+	mFrameRecords.Reset();
+	mChunk.Reset();
+	mChunk.AddZeroed(GimmickReplay::ChunkHeaderSize);
+	mChunkFrameCount = 0;
+	mPrevFrameMicros = 0;
+	for (FIntPoint& Value : mPrevInputValues)
+	{
+		Value = FIntPoint::ZeroValue;
+	}
+	mGimmickIndices.Reset();
+
+	mGimmickEventHandle = GimmickEvents::OnGimmickEvent().AddUObject(this, &UGimmickReplaySubsystem::RecordGimmickEvent);
+
+	UE_LOG(LogGimmickReplay, Log, TEXT("Recording replay: %s"), *FilePath);
+	return true;
+}
+
+/// @brief 記録を終了し、残りのデータを書き出す
+void UGimmickReplaySubsystem::StopRecording()
+{
+	if (!IsRecording())
+	{
+		return;
+	}
+
+	GimmickEvents::OnGimmickEvent().Remove(mGimmickEventHandle);
+	mGimmickEventHandle.Reset();
+
+	//書きかけのフレームとチャンクを渡してからスレッドを止める
+	if (mFrameRecords.Num() > 0)
+	{
+		FlushFrame(0.0f);
+	}
+	if (mChunkFrameCount > 0)
+	{
+		GimmickReplay::WriteUInt32(mChunk.GetData(), mChunk.Num() - GimmickReplay::ChunkHeaderSize);
+		GimmickReplay::WriteUInt32(mChunk.GetData() + 4, mChunkFrameCount);
+		mWriter->Enqueue(MoveTemp(mChunk));
+	}
+	mWriter.Reset();
+	mChunk.Reset();
+
+	UE_LOG(LogGimmickReplay, Log, TEXT("Replay recording stopped"));
+}
+
+/// @brief 再生を開始する
+/// @param FilePath 記録ファイルのパス
+/// @param bMaxSpeed 最速で再生するか
+/// @return 開始できたか
+bool UGimmickReplaySubsystem::StartPlayback(const FString& FilePath, bool bMaxSpeed)
+{
+	LLM_SCOPE_BYTAG(Gimmick_Recorder);
+
+	if (IsRecording() || IsPlaying())
+	{
+		return false;
+	}
+
+	mReader = FGimmickReplayReader::Open(FilePath);
+	if (!mReader)
+	{
+		UE_LOG(LogGimmickReplay, Error, TEXT("Failed to open replay: %s"), *FilePath);
+		return false;
+	}
+
+	bPlaybackMaxSpeed = bMaxSpeed;
+	mPlaybackElapsed = 0.0;
+	mPlaybackFrameTime = 0.0;
+
+	//最速再生では記録時のフレーム時間を固定で使い、待たずに次のフレームへ進める
+	if (bPlaybackMaxSpeed)
+	{
+		bPrevUseFixedTimeStep = FApp::UseFixedTimeStep();
+		mPrevFixedDeltaTime = FApp::GetFixedDeltaTime();
+		FApp::SetUseFixedTimeStep(true);
+	}
+
+	UE_LOG(LogGimmickReplay, Log, TEXT("Playing replay: %s (%s)"), *FilePath, bMaxSpeed ? TEXT("max speed") : TEXT("original speed"));
+	return true;
+}
+
+/// @brief 再生を終了する
+void UGimmickReplaySubsystem::StopPlayback()
+{
+	if (!IsPlaying())
+	{
+		return;
+	}
+
+	if (bPlaybackMaxSpeed)
+	{
+		FApp::SetUseFixedTimeStep(bPrevUseFixedTimeStep);
+		FApp::SetFixedDeltaTime(mPrevFixedDeltaTime);
+	}
+	mReader.Reset();
+
+	UE_LOG(LogGimmickReplay, Log, TEXT("Replay playback stopped"));
+}
+
+void UGimmickReplaySubsystem::Tick(float DeltaTime)
+{
+	LLM_SCOPE_BYTAG(Gimmick_Recorder);
+
+	//記録：このフレームの入力とイベントをまとめて1フレーム分として書く
+	if (IsRecording())
+	{
+		FlushFrame(DeltaTime);
+	}
+
+	if (IsPlaying())
+	{
+		if (bPlaybackMaxSpeed)
+		{
+			//1Tickにつき記録の1フレーム
+			if (!PlaybackFrame())
+			{
+				StopPlayback();
+			}
+		}
+		else
+		{
+			//記録時と同じ時間間隔で進める
+			mPlaybackElapsed += DeltaTime;
+			while (IsPlaying() && mPlaybackFrameTime <= mPlaybackElapsed)
+			{
+				if (!PlaybackFrame())
+				{
+					StopPlayback();
+				}
+			}
+		}
+	}
+}
+
+/// @brief このフレームの入力を記録する
+/// @param Input 入力の種類
+/// @param Value 入力値
+void UGimmickReplaySubsystem::RecordInput(EGimmickReplayInput Input, const FInputActionValue& Value)
+{
+	if (!IsRecording())
+	{
+		return;
+	}
+
+	const FVector2D Axis = Value.Get<FVector2D>();
+	const FIntPoint Quantized(
+		FMath::RoundToInt32(Axis.X * GimmickReplay::InputQuantize),
+		FMath::RoundToInt32(Axis.Y * GimmickReplay::InputQuantize));
+
+	FIntPoint& Prev = mPrevInputValues[static_cast<int32>(Input)];
+	mFrameRecords.Add(static_cast<uint8>(GimmickReplay::ERecordTag::Input));
+	mFrameRecords.Add(static_cast<uint8>(Input));
+	GimmickReplay::WriteVarint(mFrameRecords, GimmickReplay::ZigZag(Quantized.X - Prev.X));
+	GimmickReplay::WriteVarint(mFrameRecords, GimmickReplay::ZigZag(Quantized.Y - Prev.Y));
+	Prev = Quantized;
+}
+
+/// @brief ギミックの状態遷移を記録する
+/// @param Type イベントの種類
+/// @param Gimmick イベントを発生させたギミック
+void UGimmickReplaySubsystem::RecordGimmickEvent(EGimmickEventType Type, const AActor* Gimmick)
+{
+	if (!Gimmick || Gimmick->GetWorld() != GetWorld())
+	{
+		return;
+	}
+
+	const uint64 Id = GimmickIds::GetStableId(Gimmick);
+	if (const uint32* Index = mGimmickIndices.Find(Id))
+	{
+		mFrameRecords.Add(static_cast<uint8>(GimmickReplay::ERecordTag::KnownGimmick));
+		mFrameRecords.Add(static_cast<uint8>(Type));
+		GimmickReplay::WriteVarint(mFrameRecords, *Index);
+		return;
+	}
+
+	//初出のギミックは64bitのIDを書いて短縮番号を割り当てる
+	mGimmickIndices.Add(Id, mGimmickIndices.Num());
+	mFrameRecords.Add(static_cast<uint8>(GimmickReplay::ERecordTag::NewGimmick));
+	mFrameRecords.Add(static_cast<uint8>(Type));
+	for (int32 i = 0; i < 8; i++)
+	{
+		mFrameRecords.Add(static_cast<uint8>(Id >> (i * 8)));
+	}
+}
+
+/// @brief 記録中のフレームをチャンクに追加し、一定サイズを超えたら書き込みスレッドに渡す
+/// @param DeltaTime フレーム間の経過時間
+void UGimmickReplaySubsystem::FlushFrame(float DeltaTime)
+{
+	const int64 FrameMicros = FMath::RoundToInt64(DeltaTime * 1000000.0);
+	mChunk.Add(static_cast<uint8>(GimmickReplay::ERecordTag::Frame));
+	GimmickReplay::WriteVarint(mChunk, GimmickReplay::ZigZag(FrameMicros - mPrevFrameMicros));
+	mPrevFrameMicros = FrameMicros;
+
+	mChunk.Append(mFrameRecords);
+	mFrameRecords.Reset();
+	mChunkFrameCount++;
+
+	if (mChunk.Num() >= GimmickReplay::ChunkFlushSize)
+	{
+		GimmickReplay::WriteUInt32(mChunk.GetData(), mChunk.Num() - GimmickReplay::ChunkHeaderSize);
+		GimmickReplay::WriteUInt32(mChunk.GetData() + 4, mChunkFrameCount);
+		mWriter->Enqueue(MoveTemp(mChunk));
+
+		mChunk.Reset(GimmickReplay::ChunkFlushSize * 2);
+		mChunk.AddZeroed(GimmickReplay::ChunkHeaderSize);
+		mChunkFrameCount = 0;
+	}
+}
+
+/// @brief 記録されたフレームを1つ読み、入力を注入する
+/// @return フレームを読めたか（ファイルの終わりならfalse）
+bool UGimmickReplaySubsystem::PlaybackFrame()
+{
+	using namespace GimmickReplay;
+
+	FGimmickReplayReader& Reader = *mReader;
+	if (!Reader.EnsureData())
+	{
+		return false;
+	}
+
+	if (Reader.ReadByte() != static_cast<uint8>(ERecordTag::Frame))
+	{
+		UE_LOG(LogGimmickReplay, Error, TEXT("Corrupted replay: frame marker expected"));
+		return false;
+	}
+
+	const int64 FrameMicros = Reader.mPrevFrameMicros + UnZigZag(Reader.ReadVarint());
+	Reader.mPrevFrameMicros = FrameMicros;
+	mPlaybackFrameTime += FrameMicros / 1000000.0;
+
+	if (bPlaybackMaxSpeed && FrameMicros > 0)
+	{
+		FApp::SetFixedDeltaTime(FrameMicros / 1000000.0);
+	}
+
+	//次のフレームの区切りまでレコードを処理する
+	while (Reader.EnsureData() && Reader.PeekByte() != static_cast<uint8>(ERecordTag::Frame))
+	{
+		const ERecordTag Tag = static_cast<ERecordTag>(Reader.ReadByte());
+		switch (Tag)
+		{
+		case ERecordTag::Input:
+		{
+			const uint8 InputIndex = Reader.ReadByte();
+			if (InputIndex >= static_cast<uint8>(EGimmickReplayInput::Count))
+			{
+				return false;
+			}
+
+			FIntPoint& Prev = Reader.mPrevInputValues[InputIndex];
+			Prev.X += static_cast<int32>(UnZigZag(Reader.ReadVarint()));
+			Prev.Y += static_cast<int32>(UnZigZag(Reader.ReadVarint()));
+
+			const EGimmickReplayInput Input = static_cast<EGimmickReplayInput>(InputIndex);
+			const FVector Value(Prev.X / InputQuantize, Prev.Y / InputQuantize, 0.0);
+			InjectInput(Input, FInputActionValue(GetValueType(Input), Value));
+		}
+		break;
+
+		case ERecordTag::NewGimmick:
+			//ギミックのイベントは調査用の記録なので再生時は読み飛ばす
+			Reader.ReadByte();
+			Reader.ReadFixed64();
+			Reader.mGimmickCount++;
+			break;
+
+		case ERecordTag::KnownGimmick:
+			Reader.ReadByte();
+			Reader.ReadVarint();
+			break;
+
+		default:
+			UE_LOG(LogGimmickReplay, Error, TEXT("Corrupted replay: unknown record %d"), static_cast<int32>(Tag));
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/// @brief 入力を操作キャラクターにEnhanced Input経由で注入する
+/// @param Input 入力の種類
+/// @param Value 入力値
+void UGimmickReplaySubsystem::InjectInput(EGimmickReplayInput Input, const FInputActionValue& Value)
+{
+	APlayerController* PlayerController = GetWorld()->GetFirstPlayerController();
+	ASotugyouSeisakuCharacter* Character = PlayerController ? Cast<ASotugyouSeisakuCharacter>(PlayerController->GetPawn()) : nullptr;
+	if (!Character)
+	{
+		return;
+	}
+
+	UInputAction* Action = Character->GetReplayInputAction(Input);
+	UEnhancedInputLocalPlayerSubsystem* InputSubsystem = ULocalPlayer::GetSubsystem<UEnhancedInputLocalPlayerSubsystem>(PlayerController->GetLocalPlayer());
+	if (Action && InputSubsystem)
+	{
+		//記録値はマッピングのモディファイア適用後の値なので、モディファイアなしで注入する
+		InputSubsystem->InjectInputForAction(Action, Value, {}, {});
+	}
+}
+
+//コンソールコマンド
+static FAutoConsoleCommandWithWorldAndArgs GGimmickReplayRecordCommand(
+	TEXT("Gimmick.Replay.Record"),
+	TEXT("Start recording input and gimmick events. Usage: Gimmick.Replay.Record [FileName]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (UGimmickReplaySubsystem* Replay = World ? World->GetSubsystem<UGimmickReplaySubsystem>() : nullptr)
+		{
+			const FString FileName = Args.Num() > 0 ? Args[0] : FString::Printf(TEXT("Replay_%s.grpl"), *FDateTime::Now().ToString());
+			Replay->StartRecording(FPaths::IsRelative(FileName) ? UGimmickReplaySubsystem::GetDefaultReplayDir() / FileName : FileName);
+		}
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs GGimmickReplayPlayCommand(
+	TEXT("Gimmick.Replay.Play"),
+	TEXT("Play back a recorded replay. Usage: Gimmick.Replay.Play <FileName> [max]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		UGimmickReplaySubsystem* Replay = World ? World->GetSubsystem<UGimmickReplaySubsystem>() : nullptr;
+		if (Replay && Args.Num() > 0)
+		{
+			const bool bMaxSpeed = Args.Num() > 1 && Args[1].Equals(TEXT("max"), ESearchCase::IgnoreCase);
+			Replay->StartPlayback(FPaths::IsRelative(Args[0]) ? UGimmickReplaySubsystem::GetDefaultReplayDir() / Args[0] : Args[0], bMaxSpeed);
+		}
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs GGimmickReplayStopCommand(
+	TEXT("Gimmick.Replay.Stop"),
+	TEXT("Stop replay recording or playback."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (UGimmickReplaySubsystem* Replay = World ? World->GetSubsystem<UGimmickReplaySubsystem>() : nullptr)
+		{
+			Replay->StopRecording();
+			Replay->StopPlayback();
+		}
+	}));
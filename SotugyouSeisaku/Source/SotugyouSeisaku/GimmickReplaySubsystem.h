@@ -0,0 +1,106 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "InputActionValue.h"
+#include "GimmickTypes.h"
+#include "GimmickReplaySubsystem.generated.h"
+
+class FGimmickReplayWriter;
+class FGimmickReplayReader;
+
+/// @brief 入力とギミックの状態遷移を記録・再生するサブシステム
+///
+///        記録ファイルはチャンク単位の追記専用バイナリで、可変長整数と差分で圧縮する。
+///        書き込みはバックグラウンドスレッド、再生はメモリマップで読むので長時間の記録でも全体をメモリに載せない。
+///
+///        コンソールコマンド:
+///        Gimmick.Replay.Record [ファイル名]
+///        Gimmick.Replay.Play <ファイル名> [max]
+///        Gimmick.Replay.Stop
+UCLASS()
+class SOTUGYOUSEISAKU_API UGimmickReplaySubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	UGimmickReplaySubsystem();
+	virtual ~UGimmickReplaySubsystem();
+
+	virtual void Deinitialize() override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	//記録開始・終了
+	bool StartRecording(const FString& FilePath);
+	void StopRecording();
+
+	//再生開始・終了（bMaxSpeed = 記録時の間隔を無視して1フレームずつ最速で再生）
+	bool StartPlayback(const FString& FilePath, bool bMaxSpeed);
+	void StopPlayback();
+
+	bool IsRecording() const { return mWriter != nullptr; }
+	bool IsPlaying() const { return mReader != nullptr; }
+
+	//このフレームの入力を記録する（キャラクターの入力バインドから呼ばれる）
+	void RecordInput(EGimmickReplayInput Input, const FInputActionValue& Value);
+
+	//記録ファイルの既定の保存先
+	static FString GetDefaultReplayDir();
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	//ギミックの状態遷移を記録する
+	void RecordGimmickEvent(EGimmickEventType Type, const AActor* Gimmick);
+
+	//記録中のフレームをチャンクに書き出す
+	void FlushFrame(float DeltaTime);
+
+	//記録されたフレームを1つ読み、入力を注入する（戻り値 = フレームを読めたか）
+	bool PlaybackFrame();
+
+	//入力を操作キャラクターに注入する
+	void InjectInput(EGimmickReplayInput Input, const FInputActionValue& Value);
+
+	//書き込みスレッド
+	TUniquePtr<FGimmickReplayWriter> mWriter;
+
+	//再生用の読み込み
+	TUniquePtr<FGimmickReplayReader> mReader;
+
+	//記録中のフレームのレコード
+	TArray<uint8> mFrameRecords;
+
+	//書き込み待ちのチャンク
+	TArray<uint8> mChunk;
+
+	//チャンク内のフレーム数
+	uint32 mChunkFrameCount = 0;
+
+	//差分圧縮用：前回のフレーム時間（マイクロ秒）
+	int64 mPrevFrameMicros = 0;
+
+	//差分圧縮用：入力ごとの前回の値（1/1000単位）
+	FIntPoint mPrevInputValues[static_cast<int32>(EGimmickReplayInput::Count)];
+
+	//ギミックIDの短縮番号（初出時だけ64bitのIDを書く）
+	TMap<uint64, uint32> mGimmickIndices;
+
+	//状態遷移イベントの登録ハンドル
+	FDelegateHandle mGimmickEventHandle;
+
+	//再生：最速モードか
+	bool bPlaybackMaxSpeed = false;
+
+	//再生：再生開始からの経過時間と、読み込んだフレームの時刻
+	double mPlaybackElapsed = 0.0;
+	double mPlaybackFrameTime = 0.0;
+
+	//再生：最速モードに入る前の固定フレーム設定
+	bool bPrevUseFixedTimeStep = false;
+	double mPrevFixedDeltaTime = 0.0;
+};
@@ -0,0 +1,449 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GimmickReplicationGraph.h"
+#include "GimmickStateInterface.h"
+#include "GimmickTypes.h"
+#include "Engine/NetConnection.h"
+#include "Engine/NetDriver.h"
+#include "Engine/ReplicationDriver.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "Misc/CommandLine.h"
+#include "Misc/DelayedAutoRegister.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "UObject/Package.h"
+#include "UObject/UObjectIterator.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogGimmickReplication, Log, All);
+
+DECLARE_CYCLE_STAT(TEXT("Replicate Actors"), STAT_GimmickReplicateActors, STATGROUP_Gimmick);
+
+static TAutoConsoleVariable<bool> CVarGimmickReplicationGraph(
+	TEXT("Gimmick.ReplicationGraph"),
+	true,
+	TEXT("Use the gimmick replication graph for the game net driver (read when the net driver is created)."));
+
+namespace GimmickReplication
+{
+	//ゲーム用のネットドライバーにだけギミック向けのグラフを作る
+	//（DefaultEngine.ini の IpNetDriver に指定するとビーコンなど同じクラスのネットドライバーすべてに付くため、コードで選ぶ）
+	static FDelayedAutoRegisterHelper RegisterReplicationDriver(EDelayedRegisterRunPhase::EndOfEngineInit, []()
+	{
+		UReplicationDriver::CreateReplicationDriverDelegate().BindLambda([](UNetDriver* ForNetDriver, const FURL& URL, UWorld* World) -> UReplicationDriver*
+		{
+			if (ForNetDriver && ForNetDriver->NetDriverName == NAME_GameNetDriver && CVarGimmickReplicationGraph.GetValueOnGameThread())
+			{
+				return NewObject<UGimmickReplicationGraph>(GetTransientPackage());
+			}
+			return nullptr;
+		});
+	});
+}
+
+void UGimmickReplicationGraphNode_Rooms::NotifyAddNetworkActor(const FNewReplicatedActorInfo& ActorInfo)
+{
+	AddActorToRoom(ActorInfo.Actor);
+}
+
+bool UGimmickReplicationGraphNode_Rooms::NotifyRemoveNetworkActor(const FNewReplicatedActorInfo& ActorInfo, bool bWarnIfNotFound)
+{
+	for (FRoom& Room : mRooms)
+	{
+		if (Room.Actors.RemoveFast(ActorInfo.Actor))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void UGimmickReplicationGraphNode_Rooms::NotifyResetAllNetworkActors()
+{
+	for (FRoom& Room : mRooms)
+	{
+		Room.Actors.Reset();
+	}
+}
+
+/// @brief 接続の視点が部屋の範囲（＋余白）に入っている部屋のアクタを集める
+/// @param Params 接続の視点と集めたリストの追加先
+void UGimmickReplicationGraphNode_Rooms::GatherActorListsForConnection(const FConnectionGatherActorListParameters& Params)
+{
+	const FVector Margin(mMargin);
+	for (const FRoom& Room : mRooms)
+	{
+		if (Room.Actors.Num() == 0)
+		{
+			continue;
+		}
+
+		const FBox Bounds(Room.Bounds.Min - Margin, Room.Bounds.Max + Margin);
+		for (const FNetViewer& Viewer : Params.Viewers)
+		{
+			if (Bounds.IsInsideOrOn(Viewer.ViewLocation))
+			{
+				Params.OutGatheredReplicationLists.AddReplicationActorList(Room.Actors);
+				break;
+			}
+		}
+	}
+}
+
+/// @brief 部屋を追加する
+/// @param Owner 部屋の持ち主（配置用アクタ）
+/// @param Bounds 部屋の範囲（ワールド座標）
+void UGimmickReplicationGraphNode_Rooms::AddRoom(const AActor* Owner, const FBox& Bounds)
+{
+	if (!Bounds.IsValid)
+	{
+		return;
+	}
+
+	FRoom& Room = mRooms.AddDefaulted_GetRef();
+	Room.Owner = Owner;
+	Room.Bounds = Bounds;
+}
+
+/// @brief 部屋を取り除く
+/// @param Owner 部屋の持ち主
+/// @param OutActors 部屋に残っていたアクタを追加する配列
+void UGimmickReplicationGraphNode_Rooms::RemoveRoom(const AActor* Owner, TArray<AActor*>& OutActors)
+{
+	const TObjectKey<AActor> Key(Owner);
+	for (int32 i = mRooms.Num() - 1; i >= 0; i--)
+	{
+		if (mRooms[i].Owner == Key)
+		{
+			for (AActor* Actor : mRooms[i].Actors)
+			{
+				OutActors.Add(Actor);
+			}
+			mRooms.RemoveAtSwap(i);
+		}
+	}
+}
+
+/// @brief 位置が入っている部屋にアクタを追加する
+/// @param Actor 追加するアクタ
+/// @param OutRoom 追加した部屋の持ち主
+/// @return 追加したか
+bool UGimmickReplicationGraphNode_Rooms::AddActorToRoom(AActor* Actor, TObjectKey<AActor>* OutRoom)
+{
+	const FVector Location = Actor->GetActorLocation();
+	for (FRoom& Room : mRooms)
+	{
+		if (Room.Bounds.IsInsideOrOn(Location))
+		{
+			Room.Actors.Add(Actor);
+			if (OutRoom)
+			{
+				*OutRoom = Room.Owner;
+			}
+			return true;
+		}
+	}
+	return false;
+}
+
+/// @brief 位置が入っている部屋の持ち主を探す（AddActorToRoom と同じ順に調べる）
+/// @param Location 位置
+/// @return 部屋の持ち主（どの部屋にも入っていなければ空）
+TObjectKey<AActor> UGimmickReplicationGraphNode_Rooms::FindRoom(const FVector& Location) const
+{
+	for (const FRoom& Room : mRooms)
+	{
+		if (Room.Bounds.IsInsideOrOn(Location))
+		{
+			return Room.Owner;
+		}
+	}
+	return TObjectKey<AActor>();
+}
+
+/// @brief 位置が部屋の範囲に入っているか
+/// @param Room 部屋の持ち主
+/// @param Location 位置
+bool UGimmickReplicationGraphNode_Rooms::IsInRoom(const TObjectKey<AActor>& Room, const FVector& Location) const
+{
+	const FRoom* Found = mRooms.FindByPredicate([&Room](const FRoom& Candidate) { return Candidate.Owner == Room; });
+	return Found && Found->Bounds.IsInsideOrOn(Location);
+}
+
+/// @brief クラスごとの送る頻度・距離を設定する（ギミックは設定ファイルの値にする）
+void UGimmickReplicationGraph::InitGlobalActorClassSettings()
+{
+	Super::InitGlobalActorClassSettings();
+
+	FClassReplicationInfo GimmickInfo;
+	GimmickInfo.SetCullDistanceSquared(FMath::Square(mGimmickCullDistance));
+	GimmickInfo.ReplicationPeriodFrame = GetReplicationPeriodFrameForFrequency(mGimmickNetUpdateFrequency);
+
+	for (TObjectIterator<UClass> It; It; ++It)
+	{
+		UClass* Class = *It;
+		if (Class->IsChildOf(AActor::StaticClass()) && Class->ImplementsInterface(UGimmickStateInterface::StaticClass())
+			&& !Class->HasAnyClassFlags(CLASS_Abstract | CLASS_Deprecated | CLASS_NewerVersionExists)
+			&& GetDefault<AActor>(Class)->GetIsReplicated())
+		{
+			GlobalActorReplicationInfoMap.SetClassInfo(Class, GimmickInfo);
+		}
+	}
+}
+
+void UGimmickReplicationGraph::InitGlobalGraphNodes()
+{
+	Super::InitGlobalGraphNodes();
+
+	GridNode->CellSize = mGridCellSize;
+
+	mRoomNode = CreateNewNode<UGimmickReplicationGraphNode_Rooms>();
+	mRoomNode->mMargin = mRoomMargin;
+	AddGlobalGraphNode(mRoomNode);
+
+	//計測の報告の設定
+	FParse::Value(FCommandLine::Get(), TEXT("GimmickNetReport="), mReportPath);
+	FParse::Value(FCommandLine::Get(), TEXT("GimmickNetReportClients="), mReportClients);
+	FParse::Value(FCommandLine::Get(), TEXT("GimmickNetReportSeconds="), mReportSeconds);
+}
+
+/// @brief 追加されたアクタをノードに振り分ける
+///        部屋の範囲に入るギミックは部屋のノード、それ以外は UBasicReplicationGraph と同じ（ギミックは休止を考慮した空間グリッド）
+///        動くギミックは、後で部屋をまたいだときに振り分け直せるよう今いる部屋を覚えておく
+void UGimmickReplicationGraph::RouteAddNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& GlobalInfo)
+{
+	if (ActorInfo.Actor->Implements<UGimmickStateInterface>())
+	{
+		TObjectKey<AActor> Room;
+		const bool bInRoom = mRoomNode->AddActorToRoom(ActorInfo.Actor, &Room);
+		if (IsMovingGimmick(ActorInfo.Actor))
+		{
+			mMovingGimmicks.Add({ ActorInfo.Actor, Room });
+		}
+		if (bInRoom)
+		{
+			return;
+		}
+	}
+
+	Super::RouteAddNetworkActorToNodes(ActorInfo, GlobalInfo);
+}
+
+void UGimmickReplicationGraph::RouteRemoveNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo)
+{
+	mMovingGimmicks.RemoveAllSwap([&ActorInfo](const FMovingGimmick& Moving) { return Moving.Actor == ActorInfo.Actor; });
+
+	if (ActorInfo.Actor->Implements<UGimmickStateInterface>() && mRoomNode->NotifyRemoveNetworkActor(ActorInfo))
+	{
+		return;
+	}
+
+	Super::RouteRemoveNetworkActorToNodes(ActorInfo);
+}
+
+/// @brief 部屋をまたいで動くギミックか
+///        動く床と押せるブロックだけが配置した位置から離れる（ほかのギミックは追加したときの振り分けのまま）
+/// @param Actor 調べるアクタ
+bool UGimmickReplicationGraph::IsMovingGimmick(const AActor* Actor)
+{
+	const IGimmickStateInterface* Gimmick = Cast<IGimmickStateInterface>(Actor);
+	const EGimmickType Type = Gimmick ? Gimmick->GetGimmickType() : EGimmickType::Other;
+	return Type == EGimmickType::MoveFloor || Type == EGimmickType::PushBlock;
+}
+
+/// @brief 動くギミックのうち、今いる部屋が変わったものを振り分け直す
+///        部屋から出たら空間グリッドへ、部屋に入ったらその部屋のノードへ移す
+void UGimmickReplicationGraph::UpdateMovingGimmickRooms()
+{
+	for (int32 i = mMovingGimmicks.Num() - 1; i >= 0; i--)
+	{
+		FMovingGimmick& Moving = mMovingGimmicks[i];
+		AActor* Actor = Moving.Actor.Get();
+		if (!Actor)
+		{
+			mMovingGimmicks.RemoveAtSwap(i);
+			continue;
+		}
+
+		//同じ部屋の中にいる間は部屋を探し直さない
+		const FVector Location = Actor->GetActorLocation();
+		const bool bWasInRoom = Moving.Room != TObjectKey<AActor>();
+		if (bWasInRoom && mRoomNode->IsInRoom(Moving.Room, Location))
+		{
+			continue;
+		}
+
+		const TObjectKey<AActor> NewRoom = mRoomNode->FindRoom(Location);
+		if (NewRoom == Moving.Room)
+		{
+			continue;
+		}
+
+		const FNewReplicatedActorInfo ActorInfo(Actor);
+		if (bWasInRoom)
+		{
+			mRoomNode->NotifyRemoveNetworkActor(ActorInfo);
+		}
+		else
+		{
+			Super::RouteRemoveNetworkActorToNodes(ActorInfo);
+		}
+
+		if (NewRoom != TObjectKey<AActor>())
+		{
+			mRoomNode->AddActorToRoom(Actor);
+		}
+		else
+		{
+			Super::RouteAddNetworkActorToNodes(ActorInfo, GlobalActorReplicationInfoMap.Get(Actor));
+		}
+		Moving.Room = NewRoom;
+	}
+}
+
+/// @brief 全接続にアクタを送る（処理時間と送信量を計測する）
+/// @param DeltaSeconds フレーム間の経過時間
+int32 UGimmickReplicationGraph::ServerReplicateActors(float DeltaSeconds)
+{
+	SCOPE_CYCLE_COUNTER(STAT_GimmickReplicateActors);
+
+	const double StartTime = FPlatformTime::Seconds();
+	UpdateMovingGimmickRooms();
+	const int32 Result = Super::ServerReplicateActors(DeltaSeconds);
+
+	mStats.Frames++;
+	mStats.ReplicateSeconds += FPlatformTime::Seconds() - StartTime;
+	mStats.ElapsedSeconds += DeltaSeconds;
+	if (const UNetDriver* Driver = NetDriver)
+	{
+		mStats.OutBytes = static_cast<int64>(Driver->OutTotalBytes) - mStatsStartBytes;
+	}
+
+	if (!mReportPath.IsEmpty())
+	{
+		UpdateNetReport(DeltaSeconds);
+	}
+	return Result;
+}
+
+/// @brief ワールドのゲーム用ネットドライバーのグラフを取得する
+/// @param World 対象のワールド
+UGimmickReplicationGraph* UGimmickReplicationGraph::Get(const UWorld* World)
+{
+	const UNetDriver* Driver = World ? World->GetNetDriver() : nullptr;
+	return Driver && Driver->IsServer() ? Cast<UGimmickReplicationGraph>(Driver->GetReplicationDriver()) : nullptr;
+}
+
+/// @brief 部屋を追加する
+/// @param Owner 部屋の持ち主（配置用アクタ）
+/// @param Bounds 部屋の範囲（ワールド座標）
+void UGimmickReplicationGraph::AddRoom(const AActor* Owner, const FBox& Bounds)
+{
+	mRoomNode->AddRoom(Owner, Bounds);
+}
+
+/// @brief 部屋を取り除き、残っていたアクタを空間グリッドに移す
+/// @param Owner 部屋の持ち主
+void UGimmickReplicationGraph::RemoveRoom(const AActor* Owner)
+{
+	TArray<AActor*> Actors;
+	mRoomNode->RemoveRoom(Owner, Actors);
+
+	//この部屋にいた動くギミックは部屋の外として扱う（次に別の部屋に入ったら振り分け直す）
+	const TObjectKey<AActor> Key(Owner);
+	for (FMovingGimmick& Moving : mMovingGimmicks)
+	{
+		if (Moving.Room == Key)
+		{
+			Moving.Room = TObjectKey<AActor>();
+		}
+	}
+
+	for (AActor* Actor : Actors)
+	{
+		if (IsValid(Actor))
+		{
+			Super::RouteAddNetworkActorToNodes(FNewReplicatedActorInfo(Actor), GlobalActorReplicationInfoMap.Get(Actor));
+		}
+	}
+}
+
+/// @brief 計測をやり直す
+void UGimmickReplicationGraph::ResetNetStats()
+{
+	mStats = FNetStats();
+	const UNetDriver* Driver = NetDriver;
+	mStatsStartBytes = Driver ? static_cast<int64>(Driver->OutTotalBytes) : 0;
+}
+
+/// @brief 指定した数のクライアントが入ったら計測を始め、一定時間たったら報告を書き出して終了する
+/// @param DeltaSeconds フレーム間の経過時間
+void UGimmickReplicationGraph::UpdateNetReport(float DeltaSeconds)
+{
+	const UNetDriver* Driver = NetDriver;
+	if (!Driver)
+	{
+		return;
+	}
+
+	if (!bReportStarted)
+	{
+		//ログインを終えた（プレイヤーコントローラーのある）接続を数える
+		int32 Clients = 0;
+		for (const UNetConnection* Connection : Driver->ClientConnections)
+		{
+			Clients += (Connection && Connection->PlayerController) ? 1 : 0;
+		}
+		if (Clients < mReportClients)
+		{
+			return;
+		}
+
+		bReportStarted = true;
+		ResetNetStats();
+		UE_LOG(LogGimmickReplication, Display, TEXT("%d clients connected, measuring replication for %.0f s"), Clients, mReportSeconds);
+		return;
+	}
+
+	if (mStats.ElapsedSeconds < mReportSeconds)
+	{
+		return;
+	}
+
+	const int32 Clients = FMath::Max(mReportClients, 1);
+	const double ReplicateMs = mStats.Frames > 0 ? mStats.ReplicateSeconds * 1000.0 / mStats.Frames : 0.0;
+	const double BytesPerSecond = mStats.ElapsedSeconds > 0.0 ? mStats.OutBytes / mStats.ElapsedSeconds : 0.0;
+	const FString Json = FString::Printf(TEXT("{\"clients\":%d,\"frames\":%d,\"seconds\":%.2f,\"replicate_ms\":%.4f,\"out_bytes_per_second\":%.1f,\"out_bytes_per_client_per_second\":%.1f}"),
+		mReportClients, mStats.Frames, mStats.ElapsedSeconds, ReplicateMs, BytesPerSecond, BytesPerSecond / Clients);
+
+	UE_LOG(LogGimmickReplication, Display, TEXT("Replication report: %s"), *Json);
+	FFileHelper::SaveStringToFile(Json, *mReportPath);
+
+	mReportPath.Empty();
+	FPlatformMisc::RequestExit(false);
+}
+
+//コンソールコマンド
+static FAutoConsoleCommandWithWorldAndArgs GimmickNetReportCommand(
+	TEXT("Gimmick.NetReport"),
+	TEXT("Print replication graph CPU time and bandwidth since the last reset (pass 'reset' to start over)."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		UGimmickReplicationGraph* Graph = UGimmickReplicationGraph::Get(World);
+		if (!Graph)
+		{
+			UE_LOG(LogGimmickReplication, Display, TEXT("No gimmick replication graph on this world (server only)"));
+			return;
+		}
+
+		if (Args.Num() > 0 && Args[0] == TEXT("reset"))
+		{
+			Graph->ResetNetStats();
+			return;
+		}
+
+		const UGimmickReplicationGraph::FNetStats& Stats = Graph->GetNetStats();
+		UE_LOG(LogGimmickReplication, Display, TEXT("Replicate %.3f ms/frame over %d frames, sent %.1f KB/s"),
+			Stats.Frames > 0 ? Stats.ReplicateSeconds * 1000.0 / Stats.Frames : 0.0, Stats.Frames,
+			Stats.ElapsedSeconds > 0.0 ? Stats.OutBytes / 1024.0 / Stats.ElapsedSeconds : 0.0);
+	}));
@@ -0,0 +1,153 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BasicReplicationGraph.h"
+#include "UObject/ObjectKey.h"
+#include "GimmickReplicationGraph.generated.h"
+
+/// @brief 部屋（AGimmickPlacementSpawner の配置範囲）ごとにギミックをまとめ、
+///        部屋の中か近くにいる接続にだけ送るノード
+UCLASS()
+class SOTUGYOUSEISAKU_API UGimmickReplicationGraphNode_Rooms : public UReplicationGraphNode
+{
+	GENERATED_BODY()
+
+public:
+	virtual void NotifyAddNetworkActor(const FNewReplicatedActorInfo& ActorInfo) override;
+	virtual bool NotifyRemoveNetworkActor(const FNewReplicatedActorInfo& ActorInfo, bool bWarnIfNotFound = true) override;
+	virtual void NotifyResetAllNetworkActors() override;
+	virtual void GatherActorListsForConnection(const FConnectionGatherActorListParameters& Params) override;
+
+	/// @brief 部屋を追加する
+	/// @param Owner 部屋の持ち主（配置用アクタ）
+	/// @param Bounds 部屋の範囲（ワールド座標）
+	void AddRoom(const AActor* Owner, const FBox& Bounds);
+
+	/// @brief 部屋を取り除く
+	/// @param Owner 部屋の持ち主
+	/// @param OutActors 部屋に残っていたアクタを追加する配列
+	void RemoveRoom(const AActor* Owner, TArray<AActor*>& OutActors);
+
+	/// @brief 位置が入っている部屋にアクタを追加する
+	/// @param OutRoom 追加した部屋の持ち主（nullptr なら返さない）
+	/// @return 追加したか（どの部屋にも入っていなければ false）
+	bool AddActorToRoom(AActor* Actor, TObjectKey<AActor>* OutRoom = nullptr);
+
+	/// @brief 位置が入っている部屋の持ち主（どの部屋にも入っていなければ空）
+	TObjectKey<AActor> FindRoom(const FVector& Location) const;
+
+	/// @brief 位置が部屋の範囲に入っているか
+	bool IsInRoom(const TObjectKey<AActor>& Room, const FVector& Location) const;
+
+	//部屋の範囲の外側で、部屋のアクタを送る距離（cm）
+	float mMargin = 1500.0f;
+
+private:
+	struct FRoom
+	{
+		TObjectKey<AActor> Owner;
+		FBox Bounds;
+		FActorRepListRefView Actors;
+	};
+	TArray<FRoom> mRooms;
+};
+
+/// @brief ギミック向けのレプリケーショングラフ
+///
+///        接続数 × アクタ数の関連性判定をしないよう、ギミックを次のノードに振り分ける
+///        ・部屋の配置範囲に入るギミック → 部屋のノード（部屋の中か近くにいる接続にだけ送る）
+///        ・それ以外 → 空間グリッド（休止を考慮、カリング距離以内の接続にだけ送る）
+///        動く床と押せるブロックは毎フレーム位置を確かめ、部屋から出たり別の部屋に入ったりしたら振り分け直す。
+///        ギミックは状態が変わるまで休止しており、GimmickEvents::Emit で起こされたときだけ送られる。
+///        ギミック以外のアクタは UBasicReplicationGraph と同じ振り分け。
+///
+///        ゲーム用のネットドライバー（GameNetDriver）にだけ、UReplicationDriver::CreateReplicationDriverDelegate で作る
+///        （ビーコンなどほかのネットドライバーはエンジンの既定のまま）。Gimmick.ReplicationGraph 0 で使わない。
+///        サーバーを -GimmickNetReport=<json> -GimmickNetReportClients=<数> [-GimmickNetReportSeconds=30] で起動すると、
+///        指定した数のクライアントが入ってから一定時間のレプリケーションの処理時間と送信量を書き出して終了する
+///        （GimmickBenchmark コマンドレットの -Suite=Replication で使う）
+UCLASS(Transient, config = Engine)
+class SOTUGYOUSEISAKU_API UGimmickReplicationGraph : public UBasicReplicationGraph
+{
+	GENERATED_BODY()
+
+public:
+	virtual void InitGlobalActorClassSettings() override;
+	virtual void InitGlobalGraphNodes() override;
+	virtual void RouteAddNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& GlobalInfo) override;
+	virtual void RouteRemoveNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo) override;
+	virtual int32 ServerReplicateActors(float DeltaSeconds) override;
+
+	/// @brief ワールドのゲーム用ネットドライバーのグラフを取得する
+	/// @return このクラスのグラフ（サーバーでなければ nullptr）
+	static UGimmickReplicationGraph* Get(const UWorld* World);
+
+	/// @brief 部屋を追加する（その後に追加されたアクタから部屋に振り分けられる）
+	void AddRoom(const AActor* Owner, const FBox& Bounds);
+
+	/// @brief 部屋を取り除く（残っていたアクタは空間グリッドに移す）
+	void RemoveRoom(const AActor* Owner);
+
+	/// @brief レプリケーションの計測値
+	struct FNetStats
+	{
+		int32 Frames = 0;
+		double ReplicateSeconds = 0.0;
+		int64 OutBytes = 0;
+		double ElapsedSeconds = 0.0;
+	};
+
+	//計測を始めてからの値
+	const FNetStats& GetNetStats() const { return mStats; }
+
+	//計測をやり直す
+	void ResetNetStats();
+
+	//空間グリッドの1マスの大きさ（cm）
+	UPROPERTY(config)
+	float mGridCellSize = 10000.0f;
+
+	//ギミックを送る距離（cm）
+	UPROPERTY(config)
+	float mGimmickCullDistance = 8000.0f;
+
+	//ギミックを送る頻度（回/秒、休止から起こされたときはすぐ送る）
+	UPROPERTY(config)
+	float mGimmickNetUpdateFrequency = 10.0f;
+
+	//部屋の範囲の外側で、部屋のギミックを送る距離（cm）
+	UPROPERTY(config)
+	float mRoomMargin = 1500.0f;
+
+private:
+	//計測の報告を書き出す（-GimmickNetReport を指定したとき）
+	void UpdateNetReport(float DeltaSeconds);
+
+	//部屋をまたいで動くギミックを、今いる部屋（部屋の外なら空間グリッド）に振り分け直す
+	void UpdateMovingGimmickRooms();
+
+	//部屋をまたいで動くギミック（動く床・押せるブロック）か
+	static bool IsMovingGimmick(const AActor* Actor);
+
+	UPROPERTY()
+	TObjectPtr<UGimmickReplicationGraphNode_Rooms> mRoomNode;
+
+	//動くギミックと、今入っている部屋の持ち主（部屋の外なら空）
+	struct FMovingGimmick
+	{
+		TWeakObjectPtr<AActor> Actor;
+		TObjectKey<AActor> Room;
+	};
+	TArray<FMovingGimmick> mMovingGimmicks;
+
+	FNetStats mStats;
+	int64 mStatsStartBytes = 0;
+
+	//-GimmickNetReport の設定
+	FString mReportPath;
+	int32 mReportClients = 0;
+	float mReportSeconds = 30.0f;
+	bool bReportStarted = false;
+};
@@ -0,0 +1,211 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GimmickBenchmarkFixture.h"
+#include "GimmickSaveSubsystem.h"
+#include "GimmickSubsystem.h"
+#include "GimmickTypes.h"
+#include "Gimmck_MoveFloor.h"
+#include "Gimmick_FallFloor.h"
+#include "EngineUtils.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+/// @brief 進行状況の保存データ（UGimmickSaveSubsystem::CaptureWorldState / ApplyWorldState）の自動テスト
+///        空ワールドに動く床と落ちる床を置き、保存した後に時間を進めてから読み込んで、保存したときの状態に戻るかを確かめる
+///        休眠中（セルのアンロードで外れた）ギミックが保存され、読み込み後に登録されたときに復元されるかも確かめる
+///        （保存・読み込みの処理時間は -run=GimmickBenchmark -Suite=Save）
+BEGIN_DEFINE_SPEC(FGimmickSaveSpec, "SotugyouSeisaku.Gimmick.Save", EAutomationTestFlags_ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+	static constexpr int32 MoveFloorCount = 8;
+	static constexpr int32 FallFloorCount = 4;
+
+	//落ちる床の設定（秒）
+	static constexpr float DeleteDelay = 0.5f;
+	static constexpr float RespawnDelay = 2.0f;
+
+	UWorld* World = nullptr;
+	UGimmickSubsystem* Gimmicks = nullptr;
+	AActor* Presser = nullptr;
+	TArray<AGimmick_FallFloor*> FallFloors;
+
+	/// @brief 秒数をフレーム数にする（タイマーの刻みをまたぐよう1フレーム多めにする）
+	static int32 FramesFor(float Seconds)
+	{
+		return FMath::CeilToInt(Seconds / GimmickBenchmark::FrameDeltaTime) + 1;
+	}
+
+	/// @brief 立っている落ちる床の固定ID
+	TSet<uint64> StandingFallFloors() const
+	{
+		TSet<uint64> Ids;
+		for (TActorIterator<AGimmick_FallFloor> It(World); It; ++It)
+		{
+			Ids.Add(GimmickIds::GetStableId(*It));
+		}
+		return Ids;
+	}
+
+	/// @brief 動く床の位置（生成した順）
+	TArray<FVector> MoveFloorLocations() const
+	{
+		TArray<FVector> Locations;
+		for (TActorIterator<AGimmck_MoveFloor> It(World); It; ++It)
+		{
+			Locations.Add(It->GetActorLocation());
+		}
+		return Locations;
+	}
+
+	/// @brief 固定IDの落ちる床が揺れているか（立っていなければ false）
+	bool IsShaking(uint64 Id) const
+	{
+		for (TActorIterator<AGimmick_FallFloor> It(World); It; ++It)
+		{
+			if (GimmickIds::GetStableId(*It) == Id)
+			{
+				return It->bIsShaking;
+			}
+		}
+		return false;
+	}
+
+END_DEFINE_SPEC(FGimmickSaveSpec)
+
+void FGimmickSaveSpec::Define()
+{
+	using namespace GimmickBenchmark;
+
+	BeforeEach([this]()
+	{
+		World = CreateBenchmarkWorld(TEXT("SaveSpec"));
+		Gimmicks = World->GetSubsystem<UGimmickSubsystem>();
+
+		const FScenario Scenarios[] = { MakeMoveFloorScenario(EFloorMovementPattern::Horizontal_X) };
+		Presser = SetupScenarios(World, Scenarios, MoveFloorCount).Presser;
+
+		UGimmickFallFloorConfig* Config = NewObject<UGimmickFallFloorConfig>(World);
+		Config->mSettings.DeleteDelay = DeleteDelay;
+		Config->mSettings.RespawnDelay = RespawnDelay;
+		FallFloors.Reset();
+		for (int32 i = 0; i < FallFloorCount; i++)
+		{
+			FallFloors.Add(SpawnWithMesh<AGimmick_FallFloor>(World, FTransform(GridLocation(MoveFloorCount + i)), [Config](AGimmick_FallFloor& Floor) { Floor.mConfig = Config; }));
+		}
+	});
+
+	AfterEach([this]()
+	{
+		FallFloors.Reset();
+		Presser = nullptr;
+		Gimmicks = nullptr;
+		DestroyBenchmarkWorld(World);
+		World = nullptr;
+	});
+
+	Describe("CaptureWorldState and ApplyWorldState", [this]()
+	{
+		It("restores moving floors, fallen floors and shaking floors to the saved moment", [this]()
+		{
+			TArray<uint64> Ids;
+			for (AGimmick_FallFloor* Floor : FallFloors)
+			{
+				Ids.Add(GimmickIds::GetStableId(Floor));
+			}
+
+			//0, 1 番は落ちて再生成待ち、2 番は揺れている途中、3 番は立ったままのところで保存する
+			FallFloors[0]->OnTriggerBeginOverlap(nullptr, Presser, nullptr, 0, false, FHitResult());
+			FallFloors[1]->OnTriggerBeginOverlap(nullptr, Presser, nullptr, 0, false, FHitResult());
+			TickWorld(World, FramesFor(DeleteDelay));
+			FallFloors[2]->OnTriggerBeginOverlap(nullptr, Presser, nullptr, 0, false, FHitResult());
+
+			const TArray<uint8> Blob = UGimmickSaveSubsystem::CaptureWorldState(World);
+			const TArray<FVector> SavedLocations = MoveFloorLocations();
+			const TSet<uint64> SavedStanding = StandingFallFloors();
+			TestEqual(TEXT("fallen floors waiting to respawn when saved"), Gimmicks->GetAbsentGimmicks().Num(), 2);
+			TestTrue(TEXT("floors 2 and 3 stand when saved"), SavedStanding.Contains(Ids[2]) && SavedStanding.Contains(Ids[3]));
+
+			//保存した後に進める（0, 1 番は再生成され、2 番は落ち、動く床は動く）
+			TickWorld(World, FramesFor(RespawnDelay));
+			TestTrue(TEXT("floors 0 and 1 respawned before loading"), StandingFallFloors().Contains(Ids[0]) && StandingFallFloors().Contains(Ids[1]));
+			TestFalse(TEXT("floor 2 fell before loading"), StandingFallFloors().Contains(Ids[2]));
+
+			const int32 Applied = UGimmickSaveSubsystem::ApplyWorldState(World, Blob);
+			TestEqual(TEXT("applied gimmicks"), Applied, MoveFloorCount + FallFloorCount);
+			TestEqual(TEXT("states kept dormant"), Gimmicks->NumDormant(), 0);
+
+			const TArray<FVector> LoadedLocations = MoveFloorLocations();
+			if (TestEqual(TEXT("moving floors"), LoadedLocations.Num(), SavedLocations.Num()))
+			{
+				for (int32 i = 0; i < SavedLocations.Num(); i++)
+				{
+					TestTrue(FString::Printf(TEXT("moving floor %d is back at %s (now %s)"), i, *SavedLocations[i].ToString(), *LoadedLocations[i].ToString()),
+						LoadedLocations[i].Equals(SavedLocations[i], 0.1));
+				}
+			}
+
+			TestTrue(TEXT("the same falling floors stand as when saved"), StandingFallFloors().Difference(SavedStanding).IsEmpty() && SavedStanding.Difference(StandingFallFloors()).IsEmpty());
+			TestEqual(TEXT("fallen floors waiting to respawn after loading"), Gimmicks->GetAbsentGimmicks().Num(), 2);
+			TestTrue(TEXT("floor 2 shakes again after loading"), IsShaking(Ids[2]));
+			TestFalse(TEXT("floor 3 is not shaking after loading"), IsShaking(Ids[3]));
+		});
+
+		It("re-arms the delete and respawn timers with the time that was left", [this]()
+		{
+			TArray<uint64> Ids;
+			for (AGimmick_FallFloor* Floor : FallFloors)
+			{
+				Ids.Add(GimmickIds::GetStableId(Floor));
+			}
+
+			//0 番は落ちた直後（再生成まで約 RespawnDelay）、1 番は踏んだ直後（落ちるまで DeleteDelay）のところで保存する
+			FallFloors[0]->OnTriggerBeginOverlap(nullptr, Presser, nullptr, 0, false, FHitResult());
+			TickWorld(World, FramesFor(DeleteDelay));
+			FallFloors[1]->OnTriggerBeginOverlap(nullptr, Presser, nullptr, 0, false, FHitResult());
+			const TArray<uint8> Blob = UGimmickSaveSubsystem::CaptureWorldState(World);
+
+			TickWorld(World, FramesFor(RespawnDelay + DeleteDelay));
+			UGimmickSaveSubsystem::ApplyWorldState(World, Blob);
+			TestFalse(TEXT("floor 0 is removed again after loading"), StandingFallFloors().Contains(Ids[0]));
+			TestTrue(TEXT("floor 1 stands after loading"), StandingFallFloors().Contains(Ids[1]));
+
+			//1 番は残り時間で落ちる
+			TickWorld(World, FramesFor(DeleteDelay));
+			TestFalse(TEXT("floor 1 falls after the delete delay that was left"), StandingFallFloors().Contains(Ids[1]));
+			TestFalse(TEXT("floor 0 is still waiting to respawn"), StandingFallFloors().Contains(Ids[0]));
+
+			//0 番は残り時間で同じIDのまま再生成される
+			TickWorld(World, FramesFor(RespawnDelay - DeleteDelay));
+			TestTrue(TEXT("floor 0 respawns after the respawn delay that was left"), StandingFallFloors().Contains(Ids[0]));
+			TestFalse(TEXT("floor 1 is still waiting to respawn"), StandingFallFloors().Contains(Ids[1]));
+		});
+
+		It("saves gimmicks whose cell is unloaded and restores them when they are registered again", [this]()
+		{
+			AGimmck_MoveFloor* Floor = *TActorIterator<AGimmck_MoveFloor>(World);
+			TickWorld(World, 10);
+
+			//セルのアンロードと同じく休眠させてから保存する
+			const FVector SavedLocation = Floor->GetActorLocation();
+			Gimmicks->UnregisterGimmick(Floor, EEndPlayReason::RemovedFromWorld);
+			const TArray<uint8> Blob = UGimmickSaveSubsystem::CaptureWorldState(World);
+
+			//一度戻して別の位置で休眠させ直し、保存データの状態で上書きされることを確かめる
+			Gimmicks->RegisterGimmick(Floor);
+			Floor->SetActorLocation(SavedLocation + FVector(0.0f, 0.0f, 1000.0f));
+			Gimmicks->UnregisterGimmick(Floor, EEndPlayReason::RemovedFromWorld);
+
+			const int32 Applied = UGimmickSaveSubsystem::ApplyWorldState(World, Blob);
+			TestEqual(TEXT("applied gimmicks"), Applied, MoveFloorCount - 1 + FallFloorCount);
+			TestEqual(TEXT("states kept dormant"), Gimmicks->NumDormant(), 1);
+
+			//セルが再ロードされて登録されたときに、保存したときの状態に戻る
+			Gimmicks->RegisterGimmick(Floor);
+			TestEqual(TEXT("states kept dormant after registering"), Gimmicks->NumDormant(), 0);
+			TestTrue(FString::Printf(TEXT("floor is back at %s (now %s)"), *SavedLocation.ToString(), *Floor->GetActorLocation().ToString()),
+				Floor->GetActorLocation().Equals(SavedLocation, 0.1));
+		});
+	});
+}
+
+#endif
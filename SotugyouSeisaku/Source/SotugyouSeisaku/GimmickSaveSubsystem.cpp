@@ -0,0 +1,335 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GimmickSaveSubsystem.h"
+#include "GimmickStateInterface.h"
+#include "GimmickTypes.h"
+#include "GimmickSubsystem.h"
+#include "Engine/GameInstance.h"
+#include "Engine/World.h"
+#include "Async/Async.h"
+#include "Tasks/Task.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogGimmickSave, Log, All);
+
+namespace GimmickSave
+{
+	//ファイル先頭の識別子とバージョン
+	constexpr uint32 Magic = 0x56415347; // 'GSAV'
+	constexpr uint16 FormatVersion = 2;
+
+	//項目に休眠していた秒数を持つようになったバージョン（1 にはない）
+	constexpr uint16 DormantSecondsVersion = 2;
+
+	/// @brief 保存データの項目を1つ書く
+	/// @param Writer 書き込み先
+	/// @param Id ギミックの固定ID
+	/// @param GimmickType ギミックの種類
+	/// @param DormantSeconds 休眠していた秒数（登録中・一時的に消えているギミックは 0）
+	/// @param SerializeState (FArchive&) に状態を書く処理
+	template <typename FuncType>
+	void WriteEntry(FArchive& Writer, uint64 Id, EGimmickType GimmickType, float DormantSeconds, FuncType&& SerializeState)
+	{
+		uint8 Type = static_cast<uint8>(GimmickType);
+		uint16 Size = 0;
+		Writer << Id << Type << DormantSeconds;
+
+		//サイズは状態を書いた後で埋める
+		const int64 SizeOffset = Writer.Tell();
+		Writer << Size;
+		SerializeState(Writer);
+
+		const int64 EndOffset = Writer.Tell();
+		Size = static_cast<uint16>(EndOffset - SizeOffset - sizeof(uint16));
+		Writer.Seek(SizeOffset);
+		Writer << Size;
+		Writer.Seek(EndOffset);
+	}
+}
+
+/// @brief 保存データの既定の保存先
+/// @param SlotName スロット名
+FString UGimmickSaveSubsystem::GetSlotPath(const FString& SlotName)
+{
+	return FPaths::ProjectSavedDir() / TEXT("SaveGames") / (SlotName + TEXT(".gsav"));
+}
+
+/// @brief ワールドのギミック状態を保存データにまとめる
+///        形式: [Magic][Version][予備][個数] + 個数 × [ID(8)][種類(1)][休眠していた秒数(4)][サイズ(2)][状態]
+///        登録中のギミックに加え、一時的に消えているギミックとセルのアンロードで休眠中のギミックも含める
+/// @param World 対象のワールド
+/// @return 保存データ
+TArray<uint8> UGimmickSaveSubsystem::CaptureWorldState(UWorld* World)
+{
+	LLM_SCOPE_BYTAG(Gimmick_Save);
+
+	TArray<uint8> Blob;
+	FMemoryWriter Writer(Blob);
+
+	uint32 Magic = GimmickSave::Magic;
+	uint16 Version = GimmickSave::FormatVersion;
+	uint16 Reserved = 0;
+	uint32 Count = 0;
+	Writer << Magic << Version << Reserved << Count;
+
+	const UGimmickSubsystem* Gimmicks = World->GetSubsystem<UGimmickSubsystem>();
+	if (!Gimmicks)
+	{
+		return Blob;
+	}
+
+	Gimmicks->ForEachGimmick([Gimmicks, &Writer, &Count](AActor* Gimmick)
+	{
+		IGimmickStateInterface* State = Cast<IGimmickStateInterface>(Gimmick);
+		GimmickSave::WriteEntry(Writer, Gimmicks->GetGimmickId(Gimmick), State->GetGimmickType(), 0.0f, [State](FArchive& Ar)
+		{
+			State->SerializeGimmickState(Ar);
+		});
+		Count++;
+	});
+
+	//一時的に消えているギミック（落ちて再生成を待つ床など）も同じ形式で書く
+	for (const TPair<uint64, UGimmickSubsystem::FAbsentGimmick>& Absent : Gimmicks->GetAbsentGimmicks())
+	{
+		GimmickSave::WriteEntry(Writer, Absent.Key, Absent.Value.Type, 0.0f, Absent.Value.Serialize);
+		Count++;
+	}
+
+	//セルのアンロードで休眠中のギミックは、外れたときの状態と休眠していた秒数を書く
+	Gimmicks->ForEachDormantState([&Writer, &Count](uint64 Id, EGimmickType Type, TConstArrayView<uint8> State, float DormantSeconds)
+	{
+		GimmickSave::WriteEntry(Writer, Id, Type, DormantSeconds, [State](FArchive& Ar)
+		{
+			Ar.Serialize(const_cast<uint8*>(State.GetData()), State.Num());
+		});
+		Count++;
+	});
+
+	Writer.Seek(sizeof(Magic) + sizeof(Version) + sizeof(Reserved));
+	Writer << Count;
+	return Blob;
+}
+
+/// @brief 保存データをワールドのギミックにまとめて適用する
+///        まだロードされていないギミックの分は登録簿に休眠中の状態として渡し、ロードされて登録されたときに復元させる
+/// @param World 対象のワールド
+/// @param Blob 保存データ
+/// @return 適用したギミックの数（休眠中として渡した分は含まない）
+int32 UGimmickSaveSubsystem::ApplyWorldState(UWorld* World, const TArray<uint8>& Blob)
+{
+	LLM_SCOPE_BYTAG(Gimmick_Save);
+
+	FMemoryReader Reader(Blob);
+
+	uint32 Magic = 0;
+	uint16 Version = 0;
+	uint16 Reserved = 0;
+	uint32 Count = 0;
+	Reader << Magic << Version << Reserved << Count;
+
+	if (Reader.IsError() || Magic != GimmickSave::Magic || Version > GimmickSave::FormatVersion)
+	{
+		UE_LOG(LogGimmickSave, Error, TEXT("Invalid gimmick save data (version %d)"), Version);
+		return 0;
+	}
+
+	UGimmickSubsystem* Registry = World->GetSubsystem<UGimmickSubsystem>();
+	if (!Registry)
+	{
+		return 0;
+	}
+
+	//ID → ギミックの対応表を一度だけ作る（保存データで落ちていた床は適用中に削除されるので、登録簿を直接たどらない）
+	TMap<uint64, IGimmickStateInterface*> Gimmicks;
+	Gimmicks.Reserve(Registry->Num());
+	Registry->ForEachGimmick([Registry, &Gimmicks](AActor* Gimmick)
+	{
+		Gimmicks.Add(Registry->GetGimmickId(Gimmick), Cast<IGimmickStateInterface>(Gimmick));
+	});
+
+	int32 AppliedCount = 0;
+	int32 DormantCount = 0;
+	for (uint32 i = 0; i < Count && !Reader.IsError(); i++)
+	{
+		uint64 Id = 0;
+		uint8 Type = 0;
+		float DormantSeconds = 0.0f;
+		uint16 Size = 0;
+		Reader << Id << Type;
+		if (Version >= GimmickSave::DormantSecondsVersion)
+		{
+			Reader << DormantSeconds;
+		}
+		Reader << Size;
+
+		const int64 StateOffset = Reader.Tell();
+		if (Reader.IsError() || StateOffset + Size > Blob.Num())
+		{
+			break;
+		}
+		const TConstArrayView<uint8> StateBytes(Blob.GetData() + StateOffset, Size);
+
+		//種類が違うギミックは読み飛ばす
+		IGimmickStateInterface** State = Gimmicks.Find(Id);
+		const UGimmickSubsystem::FAbsentGimmick* Absent = State ? nullptr : Registry->GetAbsentGimmicks().Find(Id);
+		if (State && static_cast<uint8>((*State)->GetGimmickType()) == Type)
+		{
+			FMemoryReaderView StateReader(StateBytes);
+			(*State)->SerializeGimmickState(StateReader);
+
+			//保存したときは休眠していたギミック。休眠していた分を進める
+			if (DormantSeconds > 0.0f)
+			{
+				(*State)->AdvanceGimmickState(DormantSeconds);
+			}
+			AppliedCount++;
+		}
+		else if (Absent && static_cast<uint8>(Absent->Type) == Type)
+		{
+			//いま消えているギミック（落ちて再生成を待つ床など）。読み込みで登録が外れることがあるので処理を写してから呼ぶ
+			const TFunction<void(FArchive&)> Serialize = Absent->Serialize;
+			FMemoryReaderView StateReader(StateBytes);
+			Serialize(StateReader);
+			AppliedCount++;
+		}
+		else if (!State && !Absent && Type < static_cast<uint8>(EGimmickType::Count))
+		{
+			//まだロードされていないギミック（アンロード中のセル、先読みしてから生成する部屋）
+			Registry->AddDormantState(Id, static_cast<EGimmickType>(Type), StateBytes, DormantSeconds);
+			DormantCount++;
+		}
+
+		Reader.Seek(StateOffset + Size);
+	}
+
+	UE_LOG(LogGimmickSave, Verbose, TEXT("Kept %d gimmick states dormant until their gimmicks are loaded"), DormantCount);
+	return AppliedCount;
+}
+
+/// @brief 現在のワールドのギミック状態を保存する
+/// @param SlotName スロット名
+void UGimmickSaveSubsystem::SaveProgress(const FString& SlotName)
+{
+	UWorld* World = GetGameInstance()->GetWorld();
+	if (!World)
+	{
+		return;
+	}
+
+	//状態の取り出しはゲームスレッドで（アクタに触るため）
+	const double CaptureStart = FPlatformTime::Seconds();
+	TArray<uint8> Blob = CaptureWorldState(World);
+	const double CaptureMs = (FPlatformTime::Seconds() - CaptureStart) * 1000.0;
+
+	UE_LOG(LogGimmickSave, Log, TEXT("Captured gimmick state: %d bytes in %.3f ms"), Blob.Num(), CaptureMs);
+
+	//書き込みはバックグラウンドで行い、一時ファイルから置き換えて書きかけのファイルを残さない
+	mPendingIOCount++;
+	const FString Path = GetSlotPath(SlotName);
+	TWeakObjectPtr<UGimmickSaveSubsystem> WeakThis(this);
+	UE::Tasks::Launch(UE_SOURCE_LOCATION, [WeakThis, Path, Blob = MoveTemp(Blob)]()
+	{
+		const double WriteStart = FPlatformTime::Seconds();
+		const FString TempPath = Path + TEXT(".tmp");
+		const bool bSaved = FFileHelper::SaveArrayToFile(Blob, *TempPath) && IFileManager::Get().Move(*Path, *TempPath, true);
+		const double WriteMs = (FPlatformTime::Seconds() - WriteStart) * 1000.0;
+
+		AsyncTask(ENamedThreads::GameThread, [WeakThis, Path, bSaved, WriteMs]()
+		{
+			if (WeakThis.IsValid())
+			{
+				WeakThis->mPendingIOCount--;
+			}
+			UE_LOG(LogGimmickSave, Log, TEXT("%s gimmick state to %s in %.3f ms"), bSaved ? TEXT("Saved") : TEXT("Failed to save"), *Path, WriteMs);
+		});
+	});
+}
+
+/// @brief 保存データを読み込む（ファイル読み込みは非同期）
+/// @param SlotName スロット名
+/// @param bApplyToCurrentWorld 読み込み後すぐ現在のワールドに適用するか
+void UGimmickSaveSubsystem::LoadProgress(const FString& SlotName, bool bApplyToCurrentWorld)
+{
+	LLM_SCOPE_BYTAG(Gimmick_Save);
+
+	mPendingIOCount++;
+	const FString Path = GetSlotPath(SlotName);
+	TWeakObjectPtr<UGimmickSaveSubsystem> WeakThis(this);
+	UE::Tasks::Launch(UE_SOURCE_LOCATION, [WeakThis, Path, bApplyToCurrentWorld]()
+	{
+		TArray<uint8> Blob;
+		const bool bLoaded = FFileHelper::LoadFileToArray(Blob, *Path, FILEREAD_Silent);
+
+		AsyncTask(ENamedThreads::GameThread, [WeakThis, Path, bLoaded, bApplyToCurrentWorld, Blob = MoveTemp(Blob)]() mutable
+		{
+			UGimmickSaveSubsystem* This = WeakThis.Get();
+			if (!This)
+			{
+				return;
+			}
+			This->mPendingIOCount--;
+
+			if (!bLoaded)
+			{
+				UE_LOG(LogGimmickSave, Warning, TEXT("No gimmick save data: %s"), *Path);
+				return;
+			}
+
+			This->mPendingBlob = MoveTemp(Blob);
+
+			UWorld* World = This->GetGameInstance()->GetWorld();
+			if (bApplyToCurrentWorld && World && World->HasBegunPlay())
+			{
+				This->ApplyPendingState(World);
+			}
+		});
+	});
+}
+
+/// @brief 読み込み済みの状態をワールドのギミックにまとめて適用する
+/// @param World 対象のワールド
+void UGimmickSaveSubsystem::ApplyPendingState(UWorld* World)
+{
+	if (!World || mPendingBlob.Num() == 0)
+	{
+		return;
+	}
+
+	const double ApplyStart = FPlatformTime::Seconds();
+	const int32 AppliedCount = ApplyWorldState(World, mPendingBlob);
+	const double ApplyMs = (FPlatformTime::Seconds() - ApplyStart) * 1000.0;
+
+	UE_LOG(LogGimmickSave, Log, TEXT("Applied %d gimmick states (%d bytes) in %.3f ms"), AppliedCount, mPendingBlob.Num(), ApplyMs);
+
+	//まだロードされていないギミックの分は登録簿が休眠中の状態として持つので、ここでは残さない
+	mPendingBlob.Reset();
+}
+
+//コンソールコマンド
+static FAutoConsoleCommandWithWorldAndArgs GGimmickSaveCommand(
+	TEXT("Gimmick.Save"),
+	TEXT("Save puzzle progress. Usage: Gimmick.Save [SlotName]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		UGameInstance* GameInstance = World ? World->GetGameInstance() : nullptr;
+		if (UGimmickSaveSubsystem* Save = GameInstance ? GameInstance->GetSubsystem<UGimmickSaveSubsystem>() : nullptr)
+		{
+			Save->SaveProgress(Args.Num() > 0 ? Args[0] : TEXT("Default"));
+		}
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs GGimmickLoadCommand(
+	TEXT("Gimmick.Load"),
+	TEXT("Load puzzle progress into the current level. Usage: Gimmick.Load [SlotName]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		UGameInstance* GameInstance = World ? World->GetGameInstance() : nullptr;
+		if (UGimmickSaveSubsystem* Save = GameInstance ? GameInstance->GetSubsystem<UGimmickSaveSubsystem>() : nullptr)
+		{
+			Save->LoadProgress(Args.Num() > 0 ? Args[0] : TEXT("Default"), true);
+		}
+	}));
@@ -0,0 +1,58 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/GameInstanceSubsystem.h"
+#include "GimmickSaveSubsystem.generated.h"
+
+/// @brief パズルの進行状況（ギミックの実行時状態）を保存・読み込みするサブシステム
+///
+///        保存データは「ギミックID → 状態」のバージョン付きバイナリ。
+///        落ちて再生成を待っている床のように一時的にアクタがないギミックも、再生成までの残り時間を同じIDで保存し、
+///        読み込み時は床を削除して再生成のタイマーを掛け直す。
+///        ギミックからの状態の取り出しだけゲームスレッドで行い、ファイル書き込みはバックグラウンドで行う。
+///        セルのアンロードで休眠中のギミックも、外れたときの状態と休眠していた秒数を同じIDで保存する。
+///        読み込んだ状態はゲームモードの StartPlay（全アクタの BeginPlay 後、最初の描画前）でまとめて適用する。
+///        その時点でまだロードされていないギミック（アンロード中のセル、AGimmickPlacementSpawner の先読み待ちの部屋）の分は
+///        UGimmickSubsystem に休眠中の状態として渡し、ロードされて登録されたときに復元させる。
+///
+///        コンソールコマンド:
+///        Gimmick.Save [スロット名]
+///        Gimmick.Load [スロット名]
+UCLASS()
+class SOTUGYOUSEISAKU_API UGimmickSaveSubsystem : public UGameInstanceSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	//現在のワールドのギミック状態を保存する（ファイル書き込みは非同期）
+	UFUNCTION(BlueprintCallable, Category = "Gimmick Save")
+	void SaveProgress(const FString& SlotName);
+
+	//保存データを読み込み、次のレベル開始時に適用する（bApplyToCurrentWorld なら読み込み後すぐ現在のワールドに適用）
+	UFUNCTION(BlueprintCallable, Category = "Gimmick Save")
+	void LoadProgress(const FString& SlotName, bool bApplyToCurrentWorld = true);
+
+	//読み込み済みの状態をワールドのギミックにまとめて適用する（ゲームモードから呼ばれる）
+	void ApplyPendingState(UWorld* World);
+
+	//保存・読み込み中か
+	bool IsBusy() const { return mPendingIOCount > 0; }
+
+	//保存データの既定の保存先
+	static FString GetSlotPath(const FString& SlotName);
+
+	//ワールドのギミック状態を保存データにまとめる
+	static TArray<uint8> CaptureWorldState(UWorld* World);
+
+	//保存データをワールドのギミックに適用する（戻り値 = 適用したギミックの数、まだロードされていないギミックの分は休眠中の状態にする）
+	static int32 ApplyWorldState(UWorld* World, const TArray<uint8>& Blob);
+
+private:
+	//読み込み済みで未適用の保存データ
+	TArray<uint8> mPendingBlob;
+
+	//保存・読み込み中のリクエスト数
+	int32 mPendingIOCount = 0;
+};
@@ -0,0 +1,268 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GimmickSchedulerSubsystem.h"
+#include "GimmickTypes.h"
+#include "GimmickPreloadSubsystem.h"
+#include "Engine/World.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("Scheduler Tick"), STAT_GimmickSchedulerTick, STATGROUP_Gimmick);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Scheduler Critical Tasks"), STAT_GimmickSchedulerCritical, STATGROUP_Gimmick);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Scheduler Queue Depth"), STAT_GimmickSchedulerQueueDepth, STATGROUP_Gimmick);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Scheduler Deferred Tasks"), STAT_GimmickSchedulerDeferred, STATGROUP_Gimmick);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Scheduler Budget Used (us)"), STAT_GimmickSchedulerBudgetUsed, STATGROUP_Gimmick);
+
+static TAutoConsoleVariable<bool> CVarGimmickSchedulerEnable(
+	TEXT("Gimmick.Scheduler.Enable"),
+	true,
+	TEXT("Run deferrable gimmick work within the frame budget (0 = run everything every frame)."));
+
+static TAutoConsoleVariable<float> CVarGimmickSchedulerBudgetUs(
+	TEXT("Gimmick.Scheduler.BudgetUs"),
+	500.0f,
+	TEXT("Per-frame budget in microseconds for deferrable gimmick work."));
+
+static TAutoConsoleVariable<int32> CVarGimmickSchedulerMaxDeferFrames(
+	TEXT("Gimmick.Scheduler.MaxDeferFrames"),
+	30,
+	TEXT("Deferrable work that has waited this many frames runs regardless of the budget."));
+
+static TAutoConsoleVariable<float> CVarGimmickSchedulerCriticalDistance(
+	TEXT("Gimmick.Scheduler.CriticalDistance"),
+	3000.0f,
+	TEXT("Work tied to an actor within this distance (cm) of any player (pawn, or view target without one) runs every frame."));
+
+namespace GimmickScheduler
+{
+	//優先度ごとの基本点と、1フレーム待つごとに加える点（Low でも10フレーム待てば Normal の待ちなしと並ぶ）
+	constexpr int32 PriorityScores[] = { 0, 200, 100, 0 };
+	constexpr int32 AgingScorePerFrame = 10;
+
+	//Critical 扱いの処理の点（予算に関係なく先に実行する）
+	constexpr int32 CriticalScore = MAX_int32;
+}
+
+void UGimmickSchedulerSubsystem::Deinitialize()
+{
+	mTasks.Empty();
+	mCandidates.Empty();
+
+	Super::Deinitialize();
+}
+
+bool UGimmickSchedulerSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UGimmickSchedulerSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UGimmickSchedulerSubsystem, STATGROUP_Tickables);
+}
+
+/// @brief 毎フレームの処理を登録する
+/// @param Owner 持ち主（破棄されたら自動で登録解除）
+/// @param Priority 優先度
+/// @param Work 処理（引数は前回実行してからの経過時間）
+/// @param DistanceActor プレイヤーとの距離で Critical 扱いにするときの基準
+/// @return 登録した処理のハンドル
+FGimmickTaskHandle UGimmickSchedulerSubsystem::RegisterTask(const UObject* Owner, EGimmickTaskPriority Priority, TFunction<void(float)> Work, const AActor* DistanceActor)
+{
+	LLM_SCOPE_BYTAG(Gimmick_Scheduler);
+
+	TUniquePtr<FTask> Task = MakeUnique<FTask>();
+	Task->Owner = Owner;
+	Task->DistanceActor = DistanceActor;
+	Task->Work = MoveTemp(Work);
+	Task->Priority = Priority;
+	Task->Serial = mNextSerial++;
+
+	FGimmickTaskHandle Handle;
+	Handle.Serial = Task->Serial;
+	Handle.Index = mTasks.Add(MoveTemp(Task));
+	return Handle;
+}
+
+/// @brief 登録を解除する
+/// @param Handle 解除する処理のハンドル（無効になる）
+void UGimmickSchedulerSubsystem::UnregisterTask(FGimmickTaskHandle& Handle)
+{
+	if (Handle.IsValid() && mTasks.IsValidIndex(Handle.Index) && mTasks[Handle.Index]->Serial == Handle.Serial)
+	{
+		//実行中の処理は実行が終わってから削除する
+		if (Handle.Index == mRunningIndex)
+		{
+			mTasks[Handle.Index]->bRemoved = true;
+		}
+		else
+		{
+			mTasks.RemoveAt(Handle.Index);
+		}
+	}
+	Handle = FGimmickTaskHandle();
+}
+
+/// @brief 1回だけ実行する処理を追加する
+/// @param Owner 持ち主（実行前に破棄されたら実行しない）
+/// @param Priority 優先度
+/// @param Work 処理
+void UGimmickSchedulerSubsystem::EnqueueOnce(const UObject* Owner, EGimmickTaskPriority Priority, TFunction<void()> Work)
+{
+	LLM_SCOPE_BYTAG(Gimmick_Scheduler);
+
+	FGimmickTaskHandle Handle = RegisterTask(Owner, Priority, [Work = MoveTemp(Work)](float) { Work(); });
+	mTasks[Handle.Index]->bOnce = true;
+}
+
+/// @brief 処理を1つ実行する
+/// @param Index 実行する処理のインデックス
+void UGimmickSchedulerSubsystem::RunTask(int32 Index)
+{
+	FTask* Task = mTasks[Index].Get();
+	const float PendingTime = Task->PendingTime;
+	Task->PendingTime = 0.0f;
+	Task->WaitedFrames = 0;
+
+	mRunningIndex = Index;
+	Task->Work(PendingTime);
+	mRunningIndex = INDEX_NONE;
+
+	if (Task->bOnce || Task->bRemoved)
+	{
+		mTasks.RemoveAt(Index);
+	}
+}
+
+/// @brief Critical の処理をすべて実行し、残りを予算内で優先度順に実行する
+/// @param DeltaTime フレーム間の経過時間
+void UGimmickSchedulerSubsystem::Tick(float DeltaTime)
+{
+	LLM_SCOPE_BYTAG(Gimmick_Scheduler);
+	SCOPE_CYCLE_COUNTER(STAT_GimmickSchedulerTick);
+	GimmickLoading::FSyncLoadScope LoadScope(this, TEXT("UGimmickSchedulerSubsystem::Tick"));
+
+	const bool bEnabled = CVarGimmickSchedulerEnable.GetValueOnGameThread();
+	const double BudgetSeconds = CVarGimmickSchedulerBudgetUs.GetValueOnGameThread() * 1e-6;
+	const int32 MaxDeferFrames = CVarGimmickSchedulerMaxDeferFrames.GetValueOnGameThread();
+	const float CriticalDistance = CVarGimmickSchedulerCriticalDistance.GetValueOnGameThread();
+
+	//距離で Critical 扱いにするための、すべてのプレイヤーの位置（サーバーでは接続しているクライアントのプレイヤーも含める）
+	TArray<FVector, TInlineAllocator<8>> PlayerLocations;
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		const APlayerController* PlayerController = It->Get();
+		if (!PlayerController)
+		{
+			continue;
+		}
+
+		//操作しているポーンがなければ、見ているもの（観戦中のカメラなど）を基準にする
+		const AActor* Viewer = PlayerController->GetPawn();
+		if (!Viewer)
+		{
+			Viewer = PlayerController->GetViewTarget();
+		}
+		if (Viewer)
+		{
+			PlayerLocations.Add(Viewer->GetActorLocation());
+		}
+	}
+	const float CriticalDistanceSquared = CriticalDistance * CriticalDistance;
+
+	//いちばん近いプレイヤーとの距離で判定する
+	auto IsNearAnyPlayer = [&PlayerLocations, CriticalDistanceSquared](const FVector& Location)
+	{
+		for (const FVector& PlayerLocation : PlayerLocations)
+		{
+			if (FVector::DistSquared(PlayerLocation, Location) <= CriticalDistanceSquared)
+			{
+				return true;
+			}
+		}
+		return false;
+	};
+
+	//経過時間を溜め、順位を付ける（ここでは処理を実行しないので配列を安全に走査できる）
+	mCandidates.Reset();
+	int32 CriticalCount = 0;
+	for (TSparseArray<TUniquePtr<FTask>>::TIterator It(mTasks); It; ++It)
+	{
+		FTask& Task = **It;
+		if (!Task.Owner.IsValid())
+		{
+			It.RemoveCurrent();
+			continue;
+		}
+
+		Task.PendingTime += DeltaTime;
+
+		const AActor* DistanceActor = Task.DistanceActor.Get();
+		const bool bCritical = !bEnabled
+			|| Task.Priority == EGimmickTaskPriority::Critical
+			|| Task.WaitedFrames >= MaxDeferFrames
+			|| (DistanceActor && IsNearAnyPlayer(DistanceActor->GetActorLocation()));
+
+		FCandidate& Candidate = mCandidates.AddDefaulted_GetRef();
+		Candidate.Index = It.GetIndex();
+		Candidate.Serial = Task.Serial;
+		Candidate.Score = bCritical ? GimmickScheduler::CriticalScore
+			: GimmickScheduler::PriorityScores[static_cast<int32>(Task.Priority)] + Task.WaitedFrames * GimmickScheduler::AgingScorePerFrame;
+		CriticalCount += bCritical ? 1 : 0;
+	}
+
+	//点の高い順に取り出す
+	auto HigherScore = [](const FCandidate& A, const FCandidate& B) { return A.Score > B.Score; };
+	mCandidates.Heapify(HigherScore);
+
+	const int32 QueueDepth = mCandidates.Num() - CriticalCount;
+	double DeferrableStart = 0.0;
+
+	while (mCandidates.Num() > 0)
+	{
+		const FCandidate& Top = mCandidates.HeapTop();
+		const bool bCritical = Top.Score == GimmickScheduler::CriticalScore;
+
+		//Critical が終わったら予算の計測を始め、予算を使い切ったら残りは次のフレームへ
+		if (!bCritical)
+		{
+			if (DeferrableStart == 0.0)
+			{
+				DeferrableStart = FPlatformTime::Seconds();
+			}
+			else if (FPlatformTime::Seconds() - DeferrableStart >= BudgetSeconds)
+			{
+				break;
+			}
+		}
+
+		FCandidate Candidate;
+		mCandidates.HeapPop(Candidate, HigherScore, EAllowShrinking::No);
+
+		//実行中の他の処理に削除・再登録されていたら飛ばす
+		if (mTasks.IsValidIndex(Candidate.Index) && mTasks[Candidate.Index]->Serial == Candidate.Serial)
+		{
+			RunTask(Candidate.Index);
+		}
+	}
+
+	const double BudgetUsedUs = DeferrableStart > 0.0 ? (FPlatformTime::Seconds() - DeferrableStart) * 1e6 : 0.0;
+
+	//実行できなかった処理は待ったフレーム数を増やす（エイジング）
+	for (const FCandidate& Candidate : mCandidates)
+	{
+		if (mTasks.IsValidIndex(Candidate.Index) && mTasks[Candidate.Index]->Serial == Candidate.Serial)
+		{
+			mTasks[Candidate.Index]->WaitedFrames++;
+		}
+	}
+
+	mLastQueueDepth = QueueDepth;
+	mLastBudgetUsedUs = BudgetUsedUs;
+
+	SET_DWORD_STAT(STAT_GimmickSchedulerCritical, CriticalCount);
+	SET_DWORD_STAT(STAT_GimmickSchedulerQueueDepth, QueueDepth);
+	SET_DWORD_STAT(STAT_GimmickSchedulerDeferred, mCandidates.Num());
+	SET_FLOAT_STAT(STAT_GimmickSchedulerBudgetUsed, BudgetUsedUs);
+}
@@ -0,0 +1,113 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "GimmickSchedulerSubsystem.generated.h"
+
+//ギミックの処理の優先度
+enum class EGimmickTaskPriority : uint8
+{
+	Critical,	//毎フレーム必ず実行する
+	High,		//以下は予算内で優先度の高い順に実行する（後回し可）
+	Normal,
+	Low,
+};
+
+/// @brief 登録した処理へのハンドル
+struct FGimmickTaskHandle
+{
+	int32 Index = INDEX_NONE;
+	uint32 Serial = 0;
+
+	bool IsValid() const { return Index != INDEX_NONE; }
+};
+
+/// @brief 見た目だけの処理や遅れても困らない処理を、1フレームの時間予算内で実行するスケジューラ
+///
+///        Critical の処理は毎フレーム実行する。それ以外は優先度と待ったフレーム数（エイジング）で順位を付け、
+///        予算（マイクロ秒）を使い切るまで順に実行する。後回しになった処理には経過時間が溜まり、次に実行されたときにまとめて渡される。
+///        距離の基準にするアクタを指定した処理は、どれかのプレイヤー（ポーン、なければ見ているもの）の近くにある間は Critical として扱う。
+///
+///        コンソール変数:
+///        Gimmick.Scheduler.Enable 0/1（0 なら全部毎フレーム実行）
+///        Gimmick.Scheduler.BudgetUs（1フレームの予算）
+///        Gimmick.Scheduler.MaxDeferFrames（これ以上待った処理は予算に関係なく実行）
+///        Gimmick.Scheduler.CriticalDistance（この距離以内なら Critical 扱い）
+///
+///        統計: stat Gimmick
+UCLASS()
+class SOTUGYOUSEISAKU_API UGimmickSchedulerSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	/// @brief 毎フレームの処理を登録する
+	/// @param Owner 持ち主（破棄されたら自動で登録解除）
+	/// @param Priority 優先度
+	/// @param Work 処理（引数は前回実行してからの経過時間）
+	/// @param DistanceActor いちばん近いプレイヤーとの距離で Critical 扱いにするときの基準（不要なら nullptr）
+	FGimmickTaskHandle RegisterTask(const UObject* Owner, EGimmickTaskPriority Priority, TFunction<void(float)> Work, const AActor* DistanceActor = nullptr);
+
+	//登録を解除する（ハンドルは無効になる）
+	void UnregisterTask(FGimmickTaskHandle& Handle);
+
+	//1回だけ実行する処理を追加する
+	void EnqueueOnce(const UObject* Owner, EGimmickTaskPriority Priority, TFunction<void()> Work);
+
+	//統計
+	int32 GetQueueDepth() const { return mLastQueueDepth; }
+	double GetLastBudgetUsedUs() const { return mLastBudgetUsedUs; }
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	struct FTask
+	{
+		TWeakObjectPtr<const UObject> Owner;
+		TWeakObjectPtr<const AActor> DistanceActor;
+		TFunction<void(float)> Work;
+		EGimmickTaskPriority Priority = EGimmickTaskPriority::Normal;
+
+		//前回実行してから溜まった時間
+		float PendingTime = 0.0f;
+
+		//実行されずに待ったフレーム数
+		int32 WaitedFrames = 0;
+
+		uint32 Serial = 0;
+		bool bOnce = false;
+
+		//実行中に登録解除された
+		bool bRemoved = false;
+	};
+
+	//処理を1つ実行する（1回だけの処理なら削除する）
+	void RunTask(int32 Index);
+
+	//実行中に登録・解除されても処理本体が動かないように、要素はポインタで持つ
+	TSparseArray<TUniquePtr<FTask>> mTasks;
+	uint32 mNextSerial = 1;
+
+	//実行中の処理のインデックス
+	int32 mRunningIndex = INDEX_NONE;
+
+	//後回しにできる処理の候補（毎フレーム使い回す）
+	struct FCandidate
+	{
+		int32 Index;
+		uint32 Serial;
+		int32 Score;
+	};
+	TArray<FCandidate> mCandidates;
+
+	//前フレームの統計
+	int32 mLastQueueDepth = 0;
+	double mLastBudgetUsedUs = 0.0;
+};
@@ -0,0 +1,98 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GimmickSequenceAsyncActions.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+
+/// @brief ギミックのイベントを待つ非同期ノードを作る
+/// @param WorldContextObject ワールドの取得元
+/// @param EventType 待つイベントの種類
+/// @param Gimmick イベントを発生させるギミック（nullptr ならどのギミックでもよい）
+/// @return 非同期ノード
+UGimmickWaitEventAsyncAction* UGimmickWaitEventAsyncAction::WaitForGimmickEvent(UObject* WorldContextObject, EGimmickEventType EventType, AActor* Gimmick)
+{
+	UWorld* World = GEngine->GetWorldFromContextObject(WorldContextObject, EGetWorldErrorMode::LogAndReturnNull);
+
+	UGimmickWaitEventAsyncAction* Action = NewObject<UGimmickWaitEventAsyncAction>();
+	Action->mWorld = World;
+	Action->mEventType = EventType;
+	Action->mGimmick = Gimmick;
+	Action->RegisterWithGameInstance(World);
+	return Action;
+}
+
+void UGimmickWaitEventAsyncAction::Activate()
+{
+	UWorld* World = mWorld.Get();
+	UGimmickSequenceSubsystem* Sequences = World ? World->GetSubsystem<UGimmickSequenceSubsystem>() : nullptr;
+	if (!Sequences)
+	{
+		SetReadyToDestroy();
+		return;
+	}
+
+	mHandle = Sequences->Run(FGimmickSequence()
+		.WaitEvent(mEventType, mGimmick.Get())
+		.Do([this]()
+		{
+			mHandle = FGimmickSequenceHandle();
+			OnEvent.Broadcast();
+			SetReadyToDestroy();
+		}), this);
+}
+
+void UGimmickWaitEventAsyncAction::SetReadyToDestroy()
+{
+	//イベントが来る前に破棄される場合は待ちを解除する
+	if (UGimmickSequenceSubsystem* Sequences = mWorld.IsValid() ? mWorld->GetSubsystem<UGimmickSequenceSubsystem>() : nullptr)
+	{
+		Sequences->Cancel(mHandle);
+	}
+
+	Super::SetReadyToDestroy();
+}
+
+/// @brief 指定した秒数待つ非同期ノードを作る
+/// @param WorldContextObject ワールドの取得元
+/// @param Seconds 待つ秒数
+/// @return 非同期ノード
+UGimmickWaitSecondsAsyncAction* UGimmickWaitSecondsAsyncAction::WaitGimmickSeconds(UObject* WorldContextObject, float Seconds)
+{
+	UWorld* World = GEngine->GetWorldFromContextObject(WorldContextObject, EGetWorldErrorMode::LogAndReturnNull);
+
+	UGimmickWaitSecondsAsyncAction* Action = NewObject<UGimmickWaitSecondsAsyncAction>();
+	Action->mWorld = World;
+	Action->mSeconds = Seconds;
+	Action->RegisterWithGameInstance(World);
+	return Action;
+}
+
+void UGimmickWaitSecondsAsyncAction::Activate()
+{
+	UWorld* World = mWorld.Get();
+	UGimmickSequenceSubsystem* Sequences = World ? World->GetSubsystem<UGimmickSequenceSubsystem>() : nullptr;
+	if (!Sequences)
+	{
+		SetReadyToDestroy();
+		return;
+	}
+
+	mHandle = Sequences->Run(FGimmickSequence()
+		.WaitSeconds(mSeconds)
+		.Do([this]()
+		{
+			mHandle = FGimmickSequenceHandle();
+			OnElapsed.Broadcast();
+			SetReadyToDestroy();
+		}), this);
+}
+
+void UGimmickWaitSecondsAsyncAction::SetReadyToDestroy()
+{
+	if (UGimmickSequenceSubsystem* Sequences = mWorld.IsValid() ? mWorld->GetSubsystem<UGimmickSequenceSubsystem>() : nullptr)
+	{
+		Sequences->Cancel(mHandle);
+	}
+
+	Super::SetReadyToDestroy();
+}
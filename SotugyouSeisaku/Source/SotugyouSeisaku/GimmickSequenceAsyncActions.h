@@ -0,0 +1,65 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Kismet/BlueprintAsyncActionBase.h"
+#include "GimmickTypes.h"
+#include "GimmickSequenceSubsystem.h"
+#include "GimmickSequenceAsyncActions.generated.h"
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE(FGimmickAsyncActionPin);
+
+/// @brief ギミックのイベントを待つ非同期ノード（待っている間はTickしない）
+UCLASS()
+class SOTUGYOUSEISAKU_API UGimmickWaitEventAsyncAction : public UBlueprintAsyncActionBase
+{
+	GENERATED_BODY()
+
+public:
+	/// @brief ギミックのイベントを待つ
+	/// @param WorldContextObject ワールドの取得元
+	/// @param EventType 待つイベントの種類（ドアの到着・床の到着など）
+	/// @param Gimmick イベントを発生させるギミック（未指定ならどのギミックでもよい）
+	UFUNCTION(BlueprintCallable, Category = "Gimmick|Sequence", meta = (BlueprintInternalUseOnly = "true", WorldContext = "WorldContextObject"))
+	static UGimmickWaitEventAsyncAction* WaitForGimmickEvent(UObject* WorldContextObject, EGimmickEventType EventType, AActor* Gimmick);
+
+	virtual void Activate() override;
+	virtual void SetReadyToDestroy() override;
+
+	//イベントが来た
+	UPROPERTY(BlueprintAssignable)
+	FGimmickAsyncActionPin OnEvent;
+
+private:
+	TWeakObjectPtr<UWorld> mWorld;
+	EGimmickEventType mEventType = EGimmickEventType::Count;
+	TWeakObjectPtr<AActor> mGimmick;
+	FGimmickSequenceHandle mHandle;
+};
+
+/// @brief 指定した秒数待つ非同期ノード（Delay と違い、待っている間は毎フレームの確認をしない）
+UCLASS()
+class SOTUGYOUSEISAKU_API UGimmickWaitSecondsAsyncAction : public UBlueprintAsyncActionBase
+{
+	GENERATED_BODY()
+
+public:
+	/// @brief 指定した秒数待つ
+	/// @param WorldContextObject ワールドの取得元
+	/// @param Seconds 待つ秒数
+	UFUNCTION(BlueprintCallable, Category = "Gimmick|Sequence", meta = (BlueprintInternalUseOnly = "true", WorldContext = "WorldContextObject"))
+	static UGimmickWaitSecondsAsyncAction* WaitGimmickSeconds(UObject* WorldContextObject, float Seconds);
+
+	virtual void Activate() override;
+	virtual void SetReadyToDestroy() override;
+
+	//時間が経った
+	UPROPERTY(BlueprintAssignable)
+	FGimmickAsyncActionPin OnElapsed;
+
+private:
+	TWeakObjectPtr<UWorld> mWorld;
+	float mSeconds = 0.0f;
+	FGimmickSequenceHandle mHandle;
+};
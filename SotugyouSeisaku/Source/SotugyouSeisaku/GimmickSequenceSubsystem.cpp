@@ -0,0 +1,239 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GimmickSequenceSubsystem.h"
+#include "GimmickEvents.h"
+#include "Engine/World.h"
+
+/// @brief 処理を実行する手順を追加する
+/// @param Action 実行する処理
+FGimmickSequence& FGimmickSequence::Do(TFunction<void()> Action)
+{
+	FStep& Step = mSteps.AddDefaulted_GetRef();
+	Step.Type = EStepType::Do;
+	Step.Action = MoveTemp(Action);
+	return *this;
+}
+
+/// @brief 時間待ちの手順を追加する
+/// @param Seconds 待つ秒数（0 以下なら次のフレームまで）
+FGimmickSequence& FGimmickSequence::WaitSeconds(float Seconds)
+{
+	FStep& Step = mSteps.AddDefaulted_GetRef();
+	Step.Type = EStepType::WaitSeconds;
+	Step.Seconds = Seconds;
+	return *this;
+}
+
+/// @brief イベント待ちの手順を追加する
+/// @param Type 待つイベントの種類
+/// @param Gimmick イベントを発生させるギミック（nullptr ならどのギミックでもよい）
+FGimmickSequence& FGimmickSequence::WaitEvent(EGimmickEventType Type, const AActor* Gimmick)
+{
+	FStep& Step = mSteps.AddDefaulted_GetRef();
+	Step.Type = EStepType::WaitEvent;
+	Step.Event = Type;
+	Step.Gimmick = Gimmick;
+	Step.bAnyGimmick = Gimmick == nullptr;
+	return *this;
+}
+
+void UGimmickSequenceSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	//時間待ちはタイミングホイールに登録する
+	mTimers = Collection.InitializeDependency<UGimmickTimerSubsystem>();
+
+	mEventHandle = GimmickEvents::OnGimmickEvent().AddUObject(this, &UGimmickSequenceSubsystem::OnGimmickEvent);
+}
+
+void UGimmickSequenceSubsystem::Deinitialize()
+{
+	GimmickEvents::OnGimmickEvent().Remove(mEventHandle);
+	if (mTimers)
+	{
+		for (FRunning& Running : mSequences)
+		{
+			mTimers->ClearTimer(Running.Timer);
+		}
+	}
+
+	mSequences.Empty();
+	for (TArray<int32>& Waiters : mEventWaiters)
+	{
+		Waiters.Empty();
+	}
+
+	Super::Deinitialize();
+}
+
+bool UGimmickSequenceSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+/// @brief 手順を開始する
+/// @param Sequence 実行する手順
+/// @param Owner 持ち主（破棄されたら続きを実行しない）
+/// @return 実行中の手順のハンドル（最後まで実行し終わっていたら無効）
+FGimmickSequenceHandle UGimmickSequenceSubsystem::Run(FGimmickSequence&& Sequence, const UObject* Owner)
+{
+	LLM_SCOPE_BYTAG(Gimmick_Sequences);
+
+	FRunning Running;
+	Running.Sequence = MoveTemp(Sequence);
+	Running.Owner = Owner;
+	Running.bHasOwner = Owner != nullptr;
+	Running.Serial = mNextSerial++;
+
+	FGimmickSequenceHandle Handle;
+	Handle.Serial = Running.Serial;
+	Handle.Index = mSequences.Add(MoveTemp(Running));
+
+	Advance(Handle.Index);
+
+	//待たずに最後まで実行し終わった
+	if (!mSequences.IsValidIndex(Handle.Index) || mSequences[Handle.Index].Serial != Handle.Serial)
+	{
+		Handle = FGimmickSequenceHandle();
+	}
+	return Handle;
+}
+
+/// @brief 実行中の手順を中止する
+/// @param Handle 中止する手順のハンドル（無効になる）
+void UGimmickSequenceSubsystem::Cancel(FGimmickSequenceHandle& Handle)
+{
+	if (Handle.IsValid() && mSequences.IsValidIndex(Handle.Index) && mSequences[Handle.Index].Serial == Handle.Serial)
+	{
+		RemoveWaits(Handle.Index);
+		mSequences.RemoveAt(Handle.Index);
+	}
+	Handle = FGimmickSequenceHandle();
+}
+
+/// @brief 次の待ちまで手順を進める（最後まで実行したら削除する）
+/// @param Index 進める手順のインデックス
+void UGimmickSequenceSubsystem::Advance(int32 Index)
+{
+	LLM_SCOPE_BYTAG(Gimmick_Sequences);
+
+	const uint32 Serial = mSequences[Index].Serial;
+
+	while (true)
+	{
+		//処理の中で別の手順が追加されると配列が移動するので、毎回取り直す
+		FRunning& Running = mSequences[Index];
+		if ((Running.bHasOwner && !Running.Owner.IsValid()) || Running.Step >= Running.Sequence.mSteps.Num())
+		{
+			mSequences.RemoveAt(Index);
+			return;
+		}
+
+		FGimmickSequence::FStep& Step = Running.Sequence.mSteps[Running.Step++];
+		switch (Step.Type)
+		{
+		case FGimmickSequence::EStepType::Do:
+		{
+			//各手順は1回しか実行しないので取り出して呼ぶ
+			TFunction<void()> Action = MoveTemp(Step.Action);
+			if (Action)
+			{
+				Action();
+			}
+
+			//処理の中で中止された
+			if (!mSequences.IsValidIndex(Index) || mSequences[Index].Serial != Serial)
+			{
+				return;
+			}
+			break;
+		}
+
+		case FGimmickSequence::EStepType::WaitSeconds:
+		{
+			//タイマーはワールドのサブシステムが持つ（アクタが削除されても消えない、0 秒以下なら次の刻み）
+			Running.Timer = mTimers->SetTimer(this, Step.Seconds, [this, Index, Serial]()
+			{
+				OnTimerElapsed(Index, Serial);
+			});
+			return;
+		}
+
+		case FGimmickSequence::EStepType::WaitEvent:
+			mEventWaiters[static_cast<int32>(Step.Event)].Add(Index);
+			return;
+		}
+	}
+}
+
+/// @brief 待ちを解除する
+/// @param Index 対象の手順のインデックス
+void UGimmickSequenceSubsystem::RemoveWaits(int32 Index)
+{
+	FRunning& Running = mSequences[Index];
+	if (Running.Timer.IsValid())
+	{
+		mTimers->ClearTimer(Running.Timer);
+	}
+
+	//待っているのは直前に実行した手順
+	if (Running.Step > 0)
+	{
+		const FGimmickSequence::FStep& Step = Running.Sequence.mSteps[Running.Step - 1];
+		if (Step.Type == FGimmickSequence::EStepType::WaitEvent)
+		{
+			mEventWaiters[static_cast<int32>(Step.Event)].RemoveSingleSwap(Index, EAllowShrinking::No);
+		}
+	}
+}
+
+/// @brief ギミックのイベントを受け取り、待っていた手順を進める
+/// @param Type イベントの種類
+/// @param Gimmick イベントを発生させたギミック
+void UGimmickSequenceSubsystem::OnGimmickEvent(EGimmickEventType Type, const AActor* Gimmick)
+{
+	TArray<int32>& Waiters = mEventWaiters[static_cast<int32>(Type)];
+	if (Waiters.Num() == 0 || (Gimmick && Gimmick->GetWorld() != GetWorld()))
+	{
+		return;
+	}
+
+	//進める手順を先に取り出す（進める途中で待ち行列が変わるため）
+	struct FReady
+	{
+		int32 Index;
+		uint32 Serial;
+	};
+	TArray<FReady, TInlineAllocator<16>> Ready;
+	for (int32 i = Waiters.Num() - 1; i >= 0; i--)
+	{
+		const FRunning& Running = mSequences[Waiters[i]];
+		const FGimmickSequence::FStep& Step = Running.Sequence.mSteps[Running.Step - 1];
+		if (Step.bAnyGimmick || Step.Gimmick.Get() == Gimmick)
+		{
+			Ready.Add({ Waiters[i], Running.Serial });
+			Waiters.RemoveAtSwap(i, EAllowShrinking::No);
+		}
+	}
+
+	for (const FReady& Entry : Ready)
+	{
+		if (mSequences.IsValidIndex(Entry.Index) && mSequences[Entry.Index].Serial == Entry.Serial)
+		{
+			Advance(Entry.Index);
+		}
+	}
+}
+
+/// @brief 時間待ちが終わったときに呼ばれる
+/// @param Index 対象の手順のインデックス
+/// @param Serial 対象の手順の通し番号（中止・再利用の確認用）
+void UGimmickSequenceSubsystem::OnTimerElapsed(int32 Index, uint32 Serial)
+{
+	if (mSequences.IsValidIndex(Index) && mSequences[Index].Serial == Serial)
+	{
+		mSequences[Index].Timer.Invalidate();
+		Advance(Index);
+	}
+}
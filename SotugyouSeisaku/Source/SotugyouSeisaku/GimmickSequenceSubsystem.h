@@ -0,0 +1,130 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "GimmickTimerSubsystem.h"
+#include "GimmickTypes.h"
+#include "GimmickSequenceSubsystem.generated.h"
+
+/// @brief ギミックの手順（処理・時間待ち・イベント待ちの並び）
+///
+///        例: ドアが開き切ったら1秒待って床を動かし、床が着いたら落ちる床を落とす
+///        Sequences->Run(FGimmickSequence()
+///            .WaitEvent(EGimmickEventType::DoorArrived, Manager)
+///            .WaitSeconds(1.0f)
+///            .Do([Floor]() { Floor->Depart(); })
+///            .WaitEvent(EGimmickEventType::MoveFloorArrived, Floor)
+///            .Do([FallFloor]() { FallFloor->DeleteFloor(); }));
+class SOTUGYOUSEISAKU_API FGimmickSequence
+{
+public:
+	//処理を実行する
+	FGimmickSequence& Do(TFunction<void()> Action);
+
+	//指定した秒数待つ（0 以下なら次のフレームまで待つ）
+	FGimmickSequence& WaitSeconds(float Seconds);
+
+	//ギミックのイベントを待つ（Gimmick が nullptr ならどのギミックのイベントでもよい）
+	FGimmickSequence& WaitEvent(EGimmickEventType Type, const AActor* Gimmick = nullptr);
+
+	int32 NumSteps() const { return mSteps.Num(); }
+
+private:
+	friend class UGimmickSequenceSubsystem;
+
+	enum class EStepType : uint8
+	{
+		Do,
+		WaitSeconds,
+		WaitEvent,
+	};
+
+	struct FStep
+	{
+		EStepType Type = EStepType::Do;
+		TFunction<void()> Action;
+		float Seconds = 0.0f;
+		EGimmickEventType Event = EGimmickEventType::Count;
+		TWeakObjectPtr<const AActor> Gimmick;
+		bool bAnyGimmick = true;
+	};
+
+	TArray<FStep> mSteps;
+};
+
+/// @brief 実行中の手順へのハンドル
+struct FGimmickSequenceHandle
+{
+	int32 Index = INDEX_NONE;
+	uint32 Serial = 0;
+
+	bool IsValid() const { return Index != INDEX_NONE; }
+};
+
+/// @brief ギミックの手順を、Tickせずにイベントとタイマーで進めるサブシステム
+///
+///        待っている手順は、イベント待ちなら種類ごとの待ち行列に、時間待ちならギミックのタイミングホイール（UGimmickTimerSubsystem）に入るだけで、
+///        どのアクタもこのサブシステムもTickしない。イベント（GimmickEvents::Emit）やタイマーが来たら次の待ちまで一気に進める。
+///        タイマーはワールドのサブシステムが持つので、手順の途中でギミックが削除されても時間待ちは続く。
+///        Blueprint からは UGimmickWaitEventAsyncAction / UGimmickWaitSecondsAsyncAction の非同期ノードで使う。
+UCLASS()
+class SOTUGYOUSEISAKU_API UGimmickSequenceSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	/// @brief 手順を開始する（最初の待ちまではこの中で実行される）
+	/// @param Sequence 実行する手順
+	/// @param Owner 持ち主（破棄されたら続きを実行しない、不要なら nullptr）
+	/// @return 実行中の手順のハンドル（最後まで実行し終わっていたら無効）
+	FGimmickSequenceHandle Run(FGimmickSequence&& Sequence, const UObject* Owner = nullptr);
+
+	//実行中の手順を中止する（ハンドルは無効になる）
+	void Cancel(FGimmickSequenceHandle& Handle);
+
+	//実行中（待ち中）の手順の数
+	int32 NumRunning() const { return mSequences.Num(); }
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	struct FRunning
+	{
+		FGimmickSequence Sequence;
+		TWeakObjectPtr<const UObject> Owner;
+		bool bHasOwner = false;
+		int32 Step = 0;
+		uint32 Serial = 0;
+		FGimmickTimerHandle Timer;
+	};
+
+	//次の待ちまで進める（最後まで実行したら削除する）
+	void Advance(int32 Index);
+
+	//待ちを解除する
+	void RemoveWaits(int32 Index);
+
+	//ギミックのイベントを受け取る
+	void OnGimmickEvent(EGimmickEventType Type, const AActor* Gimmick);
+
+	//時間待ちが終わったときに呼ばれる
+	void OnTimerElapsed(int32 Index, uint32 Serial);
+
+	TSparseArray<FRunning> mSequences;
+	uint32 mNextSerial = 1;
+
+	//イベントの種類ごとの、そのイベントを待っている手順
+	TArray<int32> mEventWaiters[static_cast<int32>(EGimmickEventType::Count)];
+
+	FDelegateHandle mEventHandle;
+
+	//時間待ちに使うタイミングホイール
+	UPROPERTY()
+	TObjectPtr<UGimmickTimerSubsystem> mTimers;
+};
@@ -0,0 +1,184 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GimmickSpatialHash.h"
+
+FGimmickSpatialHash::FGimmickSpatialHash(float InCellSize)
+	: mCellSize(FMath::Max(InCellSize, 1.0f))
+	, mInvCellSize(1.0f / FMath::Max(InCellSize, 1.0f))
+{
+}
+
+/// @brief 要素を追加する
+/// @param Id 要素のID
+/// @param Location 位置
+/// @param Category 種類（0〜31）
+void FGimmickSpatialHash::Insert(int32 Id, const FVector& Location, uint8 Category)
+{
+	check(Id >= 0 && Category < 32);
+
+	if (Id >= mSlots.Num())
+	{
+		const int32 NewNum = FMath::Max(Id + 1, mSlots.Num() * 2);
+		mLocations.SetNumUninitialized(NewNum);
+		mCellKeys.SetNumUninitialized(NewNum);
+		mCategories.SetNumUninitialized(NewNum);
+
+		const int32 OldNum = mSlots.Num();
+		mSlots.SetNumUninitialized(NewNum);
+		for (int32 i = OldNum; i < NewNum; i++)
+		{
+			mSlots[i] = INDEX_NONE;
+		}
+	}
+
+	if (Contains(Id))
+	{
+		Remove(Id);
+	}
+
+	const FIntVector Key = ToCell(Location);
+	TArray<int32>& Ids = mCells.FindOrAdd(Key);
+
+	mLocations[Id] = Location;
+	mCellKeys[Id] = Key;
+	mCategories[Id] = Category;
+	mSlots[Id] = Ids.Add(Id);
+	mCount++;
+}
+
+/// @brief 要素を削除する
+/// @param Id 要素のID
+void FGimmickSpatialHash::Remove(int32 Id)
+{
+	if (!Contains(Id))
+	{
+		return;
+	}
+
+	RemoveFromCell(Id);
+	mSlots[Id] = INDEX_NONE;
+	mCount--;
+}
+
+/// @brief 要素の位置を更新する
+/// @param Id 要素のID
+/// @param Location 新しい位置
+/// @return セルが変わったか
+bool FGimmickSpatialHash::Update(int32 Id, const FVector& Location)
+{
+	if (!Contains(Id))
+	{
+		return false;
+	}
+
+	mLocations[Id] = Location;
+
+	const FIntVector Key = ToCell(Location);
+	if (Key == mCellKeys[Id])
+	{
+		return false;
+	}
+
+	RemoveFromCell(Id);
+	TArray<int32>& Ids = mCells.FindOrAdd(Key);
+	mCellKeys[Id] = Key;
+	mSlots[Id] = Ids.Add(Id);
+	return true;
+}
+
+/// @brief すべての要素を削除する
+void FGimmickSpatialHash::Reset()
+{
+	mCells.Reset();
+	mLocations.Reset();
+	mCellKeys.Reset();
+	mSlots.Reset();
+	mCategories.Reset();
+	mCount = 0;
+}
+
+/// @brief 最も近い要素を探す
+/// @param Center 中心
+/// @param MaxRadius 探す最大距離
+/// @param Mask 対象の種類のマスク
+/// @return 見つかった要素のID（なければ INDEX_NONE）
+int32 FGimmickSpatialHash::FindNearest(const FVector& Center, float MaxRadius, uint32 Mask) const
+{
+	int32 BestId = INDEX_NONE;
+	float BestDistSquared = MaxRadius * MaxRadius;
+
+	const FIntVector CenterCell = ToCell(Center);
+	const int32 MaxRing = FMath::CeilToInt32(MaxRadius * mInvCellSize);
+
+	for (int32 Ring = 0; Ring <= MaxRing; Ring++)
+	{
+		//このリングのセルは中心から (Ring - 1) * セルサイズ より遠いので、それより近い候補があれば終了
+		if (BestId != INDEX_NONE)
+		{
+			const float RingDistance = (Ring - 1) * mCellSize;
+			if (RingDistance > 0.0f && RingDistance * RingDistance > BestDistSquared)
+			{
+				break;
+			}
+		}
+
+		for (int32 Z = -Ring; Z <= Ring; Z++)
+		{
+			for (int32 Y = -Ring; Y <= Ring; Y++)
+			{
+				//リングの外殻だけを走査する
+				const bool bOnShellYZ = FMath::Abs(Y) == Ring || FMath::Abs(Z) == Ring;
+				const int32 XStep = bOnShellYZ ? 1 : FMath::Max(2 * Ring, 1);
+
+				for (int32 X = -Ring; X <= Ring; X += XStep)
+				{
+					const TArray<int32>* Ids = mCells.Find(CenterCell + FIntVector(X, Y, Z));
+					if (!Ids)
+					{
+						continue;
+					}
+
+					for (int32 Id : *Ids)
+					{
+						if ((Mask & CategoryMask(mCategories[Id])) == 0)
+						{
+							continue;
+						}
+
+						const float DistSquared = FVector::DistSquared(Center, mLocations[Id]);
+						if (DistSquared <= BestDistSquared)
+						{
+							BestDistSquared = DistSquared;
+							BestId = Id;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	return BestId;
+}
+
+/// @brief セルから要素を外す
+/// @param Id 要素のID
+void FGimmickSpatialHash::RemoveFromCell(int32 Id)
+{
+	TArray<int32>* Ids = mCells.Find(mCellKeys[Id]);
+	if (!Ids)
+	{
+		return;
+	}
+
+	//最後の要素を空いた位置に移し、その要素の位置を更新する
+	const int32 Slot = mSlots[Id];
+	const int32 LastId = Ids->Last();
+	(*Ids)[Slot] = LastId;
+	mSlots[LastId] = Slot;
+	Ids->Pop(EAllowShrinking::No);
+
+	if (Ids->Num() == 0)
+	{
+		mCells.Remove(mCellKeys[Id]);
+	}
+}
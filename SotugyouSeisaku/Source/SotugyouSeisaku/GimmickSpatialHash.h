@@ -0,0 +1,136 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/// @brief 一様グリッドの空間ハッシュ
+///        要素は呼び出し側が決めるID（0以上の整数）で管理し、種類（0〜31）ごとに絞り込んで検索できる。
+///        検索はメモリ確保をしない（確保するのは追加・セル移動時のみ）。
+class SOTUGYOUSEISAKU_API FGimmickSpatialHash
+{
+public:
+	explicit FGimmickSpatialHash(float InCellSize = 1000.0f);
+
+	//要素を追加・削除する
+	void Insert(int32 Id, const FVector& Location, uint8 Category);
+	void Remove(int32 Id);
+
+	//要素の位置を更新する（戻り値 = セルが変わったか）
+	bool Update(int32 Id, const FVector& Location);
+
+	//すべての要素を削除する
+	void Reset();
+
+	bool Contains(int32 Id) const { return mSlots.IsValidIndex(Id) && mSlots[Id] != INDEX_NONE; }
+	const FVector& GetLocation(int32 Id) const { return mLocations[Id]; }
+	int32 Num() const { return mCount; }
+	float GetCellSize() const { return mCellSize; }
+
+	//種類の絞り込み用マスク
+	static constexpr uint32 AllCategories = ~0u;
+	static uint32 CategoryMask(uint8 Category) { return 1u << Category; }
+
+	/// @brief 箱の中にある要素を列挙する
+	/// @param Box 検索範囲
+	/// @param Mask 対象の種類のマスク
+	/// @param Visit (int32 Id, const FVector& Location) を受け取る関数
+	template<typename FuncType>
+	void ForEachInBox(const FBox& Box, uint32 Mask, FuncType&& Visit) const
+	{
+		const FIntVector MinCell = ToCell(Box.Min);
+		const FIntVector MaxCell = ToCell(Box.Max);
+
+		auto VisitCell = [this, &Box, Mask, &Visit](const TArray<int32>& Ids)
+		{
+			for (int32 Id : Ids)
+			{
+				if ((Mask & CategoryMask(mCategories[Id])) != 0 && Box.IsInsideOrOn(mLocations[Id]))
+				{
+					Visit(Id, mLocations[Id]);
+				}
+			}
+		};
+
+		//範囲内のセル数が使用中のセル数より多いなら、使用中のセルを直接走査する
+		const int64 RangeCellCount = static_cast<int64>(MaxCell.X - MinCell.X + 1) * (MaxCell.Y - MinCell.Y + 1) * (MaxCell.Z - MinCell.Z + 1);
+		if (RangeCellCount > mCells.Num())
+		{
+			for (const TPair<FIntVector, TArray<int32>>& Cell : mCells)
+			{
+				const FIntVector& Key = Cell.Key;
+				if (Key.X >= MinCell.X && Key.X <= MaxCell.X && Key.Y >= MinCell.Y && Key.Y <= MaxCell.Y && Key.Z >= MinCell.Z && Key.Z <= MaxCell.Z)
+				{
+					VisitCell(Cell.Value);
+				}
+			}
+			return;
+		}
+
+		for (int32 Z = MinCell.Z; Z <= MaxCell.Z; Z++)
+		{
+			for (int32 Y = MinCell.Y; Y <= MaxCell.Y; Y++)
+			{
+				for (int32 X = MinCell.X; X <= MaxCell.X; X++)
+				{
+					if (const TArray<int32>* Ids = mCells.Find(FIntVector(X, Y, Z)))
+					{
+						VisitCell(*Ids);
+					}
+				}
+			}
+		}
+	}
+
+	/// @brief 球の中にある要素を列挙する
+	/// @param Center 中心
+	/// @param Radius 半径
+	/// @param Mask 対象の種類のマスク
+	/// @param Visit (int32 Id, const FVector& Location) を受け取る関数
+	template<typename FuncType>
+	void ForEachInRadius(const FVector& Center, float Radius, uint32 Mask, FuncType&& Visit) const
+	{
+		const float RadiusSquared = Radius * Radius;
+		ForEachInBox(FBox(Center - FVector(Radius), Center + FVector(Radius)), Mask,
+			[&Center, RadiusSquared, &Visit](int32 Id, const FVector& Location)
+			{
+				if (FVector::DistSquared(Center, Location) <= RadiusSquared)
+				{
+					Visit(Id, Location);
+				}
+			});
+	}
+
+	/// @brief 最も近い要素を探す（近いセルから順に外側へ広げる）
+	/// @param Center 中心
+	/// @param MaxRadius 探す最大距離
+	/// @param Mask 対象の種類のマスク
+	/// @return 見つかった要素のID（なければ INDEX_NONE）
+	int32 FindNearest(const FVector& Center, float MaxRadius, uint32 Mask) const;
+
+private:
+	FIntVector ToCell(const FVector& Location) const
+	{
+		return FIntVector(
+			FMath::FloorToInt32(Location.X * mInvCellSize),
+			FMath::FloorToInt32(Location.Y * mInvCellSize),
+			FMath::FloorToInt32(Location.Z * mInvCellSize));
+	}
+
+	//セルから要素を外す（セル内の最後の要素と入れ替える）
+	void RemoveFromCell(int32 Id);
+
+	float mCellSize;
+	float mInvCellSize;
+
+	//セル → セル内の要素ID
+	TMap<FIntVector, TArray<int32>> mCells;
+
+	//IDごとの情報（IDで直接引く）
+	TArray<FVector> mLocations;
+	TArray<FIntVector> mCellKeys;
+	TArray<int32> mSlots;		//セル内の位置（INDEX_NONE = 未登録）
+	TArray<uint8> mCategories;
+
+	int32 mCount = 0;
+};
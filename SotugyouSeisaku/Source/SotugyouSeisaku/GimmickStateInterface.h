@@ -0,0 +1,38 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Interface.h"
+#include "GimmickTypes.h"
+#include "GimmickStateInterface.generated.h"
+
+UINTERFACE(MinimalAPI)
+class UGimmickStateInterface : public UInterface
+{
+	GENERATED_BODY()
+};
+
+/// @brief セーブやストリーミングで保存・復元するギミックの実行時状態
+class SOTUGYOUSEISAKU_API IGimmickStateInterface
+{
+	GENERATED_BODY()
+
+public:
+	//ギミックの種類（保存データの検証用）
+	virtual EGimmickType GetGimmickType() const = 0;
+
+	//実行時状態を読み書きする（Ar.IsLoading() なら復元、BeginPlay後に呼ばれる）
+	virtual void SerializeGimmickState(FArchive& Ar) = 0;
+
+	//止まっていた時間分だけ状態を進める（ストリーミングで復元した直後に呼ばれる、時間で動かないギミックは何もしない）
+	virtual void AdvanceGimmickState(float Seconds) {}
+
+	//時間飛ばしで状態を進める（UGimmickSubsystem::AdvanceGimmicks から呼ばれる）
+	//タイマーはこの後タイミングホイールが期限の順に呼ぶので、タイマーを待たずに閉じた式で進められる分だけ進める
+	//既定は AdvanceGimmickState と同じ（掛け直すタイマーは飛ばした後の時刻が基準になる）
+	virtual void FastForwardGimmickState(float Seconds) { AdvanceGimmickState(Seconds); }
+
+	//作り直したギミックが元のギミックの固定IDを引き継ぐときのID（0 ならレベルのパッケージ名とアクタ名から求める）
+	virtual uint64 GetInheritedGimmickId() const { return 0; }
+};
@@ -0,0 +1,444 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GimmickSubsystem.h"
+#include "GimmickStateInterface.h"
+#include "GimmickTimerSubsystem.h"
+#include "Gimmick_PushBlock.h"
+#include "Engine/World.h"
+#include "Engine/Level.h"
+#include "Components/PrimitiveComponent.h"
+#include "PhysicsEngine/BodyInstance.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogGimmickRegistry, Log, All);
+
+namespace GimmickRegistry
+{
+	//空間ハッシュのセルの大きさ（cm）。ギミック同士の間隔と検索半径がだいたいこの程度
+	constexpr float CellSize = 1000.0f;
+}
+
+UGimmickSubsystem::UGimmickSubsystem()
+	: mSpatialHash(GimmickRegistry::CellSize)
+{
+}
+
+void UGimmickSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	mLevelRemovedHandle = FWorldDelegates::LevelRemovedFromWorld.AddUObject(this, &UGimmickSubsystem::OnLevelRemovedFromWorld);
+}
+
+void UGimmickSubsystem::Deinitialize()
+{
+	FWorldDelegates::LevelRemovedFromWorld.Remove(mLevelRemovedHandle);
+
+	mEntries.Empty();
+	mEntryIndices.Empty();
+	for (int32 i = 0; i < static_cast<int32>(EGimmickType::Count); i++)
+	{
+		mTypeLists[i].Empty();
+		mTypeEntryIndices[i].Empty();
+	}
+	mSpatialHash.Reset();
+	mDormantStates.Empty();
+	mAbsentGimmicks.Empty();
+
+	Super::Deinitialize();
+}
+
+bool UGimmickSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+/// @brief ギミックを登録する
+/// @param Gimmick 登録するアクタ（IGimmickStateInterface を実装していること）
+void UGimmickSubsystem::RegisterGimmick(AActor* Gimmick)
+{
+	LLM_SCOPE_BYTAG(Gimmick_Registry);
+
+	IGimmickStateInterface* State = Cast<IGimmickStateInterface>(Gimmick);
+	if (!State || mEntryIndices.Contains(Gimmick))
+	{
+		return;
+	}
+
+	FEntry Entry;
+	Entry.Actor = Gimmick;
+	Entry.Id = GimmickIds::GetStableId(Gimmick);
+	Entry.Type = State->GetGimmickType();
+
+	const int32 TypeIndex = static_cast<int32>(Entry.Type);
+	const int32 Index = mEntries.Add(Entry);
+	mEntries[Index].TypeSlot = mTypeLists[TypeIndex].Add(Gimmick);
+	mTypeEntryIndices[TypeIndex].Add(Index);
+
+	mEntryIndices.Add(Gimmick, Index);
+	mSpatialHash.Insert(Index, Gimmick->GetActorLocation(), static_cast<uint8>(Entry.Type));
+
+	//休眠中の状態があれば復元し、止まっていた時間分を進める
+	FDormantState Dormant;
+	if (mDormantStates.RemoveAndCopyValue(Entry.Id, Dormant) && Dormant.Type == Entry.Type)
+	{
+		FMemoryReader Reader(Dormant.State);
+		State->SerializeGimmickState(Reader);
+		State->AdvanceGimmickState(static_cast<float>(GetGimmickTime() - Dormant.UnloadTime));
+
+		//復元で位置が変わる。落ちていた床は復元で削除されて登録も外れている
+		UpdateGimmickLocation(Gimmick);
+	}
+}
+
+/// @brief ギミックの登録を解除する
+/// @param Gimmick 登録解除するアクタ
+/// @param EndPlayReason EndPlay の理由（RemovedFromWorld なら状態を休眠させる）
+void UGimmickSubsystem::UnregisterGimmick(AActor* Gimmick, EEndPlayReason::Type EndPlayReason)
+{
+	LLM_SCOPE_BYTAG(Gimmick_Registry);
+
+	int32 Index = INDEX_NONE;
+	if (!mEntryIndices.RemoveAndCopyValue(Gimmick, Index))
+	{
+		return;
+	}
+
+	const FEntry& Entry = mEntries[Index];
+	const int32 TypeIndex = static_cast<int32>(Entry.Type);
+
+	//セルのアンロードで外れる場合だけ状態を残す（破棄・レベル移動・終了では残さない）
+	if (EndPlayReason == EEndPlayReason::RemovedFromWorld)
+	{
+		FDormantState& Dormant = mDormantStates.FindOrAdd(Entry.Id);
+		Dormant.State.Reset();
+		Dormant.UnloadTime = GetGimmickTime();
+		Dormant.Type = Entry.Type;
+
+		FMemoryWriter Writer(Dormant.State);
+		Cast<IGimmickStateInterface>(Gimmick)->SerializeGimmickState(Writer);
+		Dormant.State.Shrink();
+	}
+
+	//種類ごとの配列は最後の要素と入れ替えて詰める
+	TArray<AActor*>& TypeList = mTypeLists[TypeIndex];
+	TArray<int32>& TypeEntryIndices = mTypeEntryIndices[TypeIndex];
+	const int32 Slot = Entry.TypeSlot;
+	TypeList.RemoveAtSwap(Slot, EAllowShrinking::No);
+	TypeEntryIndices.RemoveAtSwap(Slot, EAllowShrinking::No);
+	if (TypeEntryIndices.IsValidIndex(Slot))
+	{
+		mEntries[TypeEntryIndices[Slot]].TypeSlot = Slot;
+	}
+
+	mSpatialHash.Remove(Index);
+	mEntries.RemoveAt(Index);
+}
+
+/// @brief 動くギミックの位置を更新する
+/// @param Gimmick 動いたアクタ
+void UGimmickSubsystem::UpdateGimmickLocation(const AActor* Gimmick)
+{
+	if (const int32* Index = mEntryIndices.Find(Gimmick))
+	{
+		mSpatialHash.Update(*Index, Gimmick->GetActorLocation());
+	}
+}
+
+/// @brief 休眠中の状態の合計バイト数
+int64 UGimmickSubsystem::GetDormantBytes() const
+{
+	int64 Bytes = mDormantStates.GetAllocatedSize();
+	for (const TPair<uint64, FDormantState>& Dormant : mDormantStates)
+	{
+		Bytes += Dormant.Value.State.GetAllocatedSize();
+	}
+	return Bytes;
+}
+
+/// @brief まだ登録されていないギミックの状態を休眠中として持つ
+/// @param Id ギミックの固定ID
+/// @param Type ギミックの種類
+/// @param State SerializeGimmickState で書き出した状態
+/// @param DormantSeconds 保存したときにすでに休眠していた秒数
+void UGimmickSubsystem::AddDormantState(uint64 Id, EGimmickType Type, TConstArrayView<uint8> State, float DormantSeconds)
+{
+	LLM_SCOPE_BYTAG(Gimmick_Registry);
+
+	FDormantState& Dormant = mDormantStates.FindOrAdd(Id);
+	Dormant.State = TArray<uint8>(State.GetData(), State.Num());
+	Dormant.UnloadTime = GetGimmickTime() - DormantSeconds;
+	Dormant.Type = Type;
+}
+
+/// @brief ギミックの固定IDを取得する
+/// @param Gimmick 対象のアクタ
+/// @return 登録時に計算した固定ID（未登録なら 0）
+uint64 UGimmickSubsystem::GetGimmickId(const AActor* Gimmick) const
+{
+	const int32* Index = mEntryIndices.Find(Gimmick);
+	return Index ? mEntries[*Index].Id : 0;
+}
+
+/// @brief 一時的にワールドから消えているギミックを登録する
+/// @param Id 消えたギミックの固定ID
+/// @param Type ギミックの種類
+/// @param Level 消えたギミックがいたレベル
+/// @param Serialize 状態を読み書きする処理
+/// @param Cancel 戻ってくるためのタイマーなどを止める処理
+void UGimmickSubsystem::AddAbsentGimmick(uint64 Id, EGimmickType Type, ULevel* Level, TFunction<void(FArchive&)> Serialize, TFunction<void()> Cancel)
+{
+	LLM_SCOPE_BYTAG(Gimmick_Registry);
+
+	FAbsentGimmick& Absent = mAbsentGimmicks.FindOrAdd(Id);
+	Absent.Type = Type;
+	Absent.Level = Level;
+	Absent.Serialize = MoveTemp(Serialize);
+	Absent.Cancel = MoveTemp(Cancel);
+}
+
+/// @brief 一時的に消えていたギミックの登録を解除する
+/// @param Id 消えていたギミックの固定ID
+void UGimmickSubsystem::RemoveAbsentGimmick(uint64 Id)
+{
+	mAbsentGimmicks.Remove(Id);
+}
+
+/// @brief 外れたレベルにいた一時的に消えているギミックを、休眠中の状態に移す
+///        レベルと一緒に消えないタイマーで戻ってくると、再ロードで登録される元のギミックと同じIDで2つになるので止める
+/// @param Level 外れたレベル（nullptr ならワールドの終了なので何もしない）
+/// @param World レベルが外れたワールド
+void UGimmickSubsystem::OnLevelRemovedFromWorld(ULevel* Level, UWorld* World)
+{
+	if (!Level || World != GetWorld())
+	{
+		return;
+	}
+
+	LLM_SCOPE_BYTAG(Gimmick_Registry);
+
+	for (auto It = mAbsentGimmicks.CreateIterator(); It; ++It)
+	{
+		FAbsentGimmick& Absent = It.Value();
+		if (Absent.Level.Get() != Level)
+		{
+			continue;
+		}
+
+		FDormantState& Dormant = mDormantStates.FindOrAdd(It.Key());
+		Dormant.State.Reset();
+		Dormant.UnloadTime = GetGimmickTime();
+		Dormant.Type = Absent.Type;
+
+		FMemoryWriter Writer(Dormant.State);
+		Absent.Serialize(Writer);
+		Dormant.State.Shrink();
+
+		if (Absent.Cancel)
+		{
+			Absent.Cancel();
+		}
+		It.RemoveCurrent();
+	}
+}
+
+/// @brief 指定した種類で半径内にあるギミックを集める
+/// @param Type ギミックの種類
+/// @param Center 中心
+/// @param Radius 半径
+/// @param OutGimmicks 見つかったギミックを追加する配列
+/// @return 追加した数
+int32 UGimmickSubsystem::GetGimmicksInRadius(EGimmickType Type, const FVector& Center, float Radius, TArray<AActor*>& OutGimmicks) const
+{
+	const int32 PrevNum = OutGimmicks.Num();
+	ForEachGimmickInRadius(Type, Center, Radius, [&OutGimmicks](AActor* Gimmick)
+	{
+		OutGimmicks.Add(Gimmick);
+	});
+	return OutGimmicks.Num() - PrevNum;
+}
+
+/// @brief 最も近いギミックを探す
+/// @param Type ギミックの種類
+/// @param Location 基準の位置
+/// @param MaxRadius 探す最大距離
+/// @return 見つかったギミック（なければ nullptr）
+AActor* UGimmickSubsystem::FindNearestGimmick(EGimmickType Type, const FVector& Location, float MaxRadius) const
+{
+	const int32 Index = mSpatialHash.FindNearest(Location, MaxRadius, FGimmickSpatialHash::CategoryMask(static_cast<uint8>(Type)));
+	return Index != INDEX_NONE ? mEntries[Index].Actor : nullptr;
+}
+
+/// @brief 最も近い押せるブロックを探す
+/// @param Location 基準の位置
+/// @param MaxRadius 探す最大距離
+/// @return 見つかったブロック（なければ nullptr）
+AGimmick_PushBlock* UGimmickSubsystem::FindNearestPushBlock(const FVector& Location, float MaxRadius) const
+{
+	return static_cast<AGimmick_PushBlock*>(FindNearestGimmick(EGimmickType::PushBlock, Location, MaxRadius));
+}
+
+/// @brief すべてのギミックを指定した秒数後の状態に飛ばす
+/// @param Seconds 飛ばす秒数
+void UGimmickSubsystem::AdvanceGimmicks(float Seconds)
+{
+	LLM_SCOPE_BYTAG(Gimmick_Registry);
+
+	if (Seconds <= 0.0f)
+	{
+		return;
+	}
+
+	UGimmickTimerSubsystem* Timers = GetWorld()->GetSubsystem<UGimmickTimerSubsystem>();
+
+	//進める途中で登録・解除が起きても大丈夫なように先に集める
+	TArray<AActor*> Gimmicks;
+	Gimmicks.Reserve(mEntries.Num());
+	for (const FEntry& Entry : mEntries)
+	{
+		Gimmicks.Add(Entry.Actor);
+	}
+
+	//時間の式で動くギミックを一度に進める（ここで掛け直すタイマーは飛ばした後の時刻が基準）
+	if (Timers)
+	{
+		Timers->SetScheduleOffset(Seconds);
+	}
+	for (AActor* Gimmick : Gimmicks)
+	{
+		Cast<IGimmickStateInterface>(Gimmick)->FastForwardGimmickState(Seconds);
+		UpdateGimmickLocation(Gimmick);
+	}
+	if (Timers)
+	{
+		Timers->SetScheduleOffset(0.0f);
+
+		//タイマーを期限の順に呼ぶ（呼んだ処理が登録したタイマーも期限が来ていれば呼ばれる）
+		const int32 Fired = Timers->AdvanceTimers(Seconds);
+		UE_LOG(LogGimmickRegistry, Verbose, TEXT("Advanced %d gimmicks by %.2f s, %d timers fired"), Gimmicks.Num(), Seconds, Fired);
+	}
+
+	mSkippedSeconds += Seconds;
+}
+
+/// @brief ギミックの時刻を取得する
+/// @return ワールドの時間に AdvanceGimmicks で飛ばした時間を足したもの
+double UGimmickSubsystem::GetGimmickTime() const
+{
+	return GetWorld()->GetTimeSeconds() + mSkippedSeconds;
+}
+
+/// @brief 登録済みのギミックのメモリ使用量をクラスごとに集計する
+///        オーバーラップなどのデリゲートの登録先はエンジン全体の領域にあるのでここには含まれない（LLM の Gimmick タグで確認する）
+/// @param World 対象のワールド
+/// @return クラスごとの集計（合計の大きい順）
+TArray<FGimmickClassMemory> UGimmickSubsystem::GatherMemoryReport(const UWorld* World)
+{
+	TArray<FGimmickClassMemory> Report;
+	const UGimmickSubsystem* Gimmicks = World ? World->GetSubsystem<UGimmickSubsystem>() : nullptr;
+	if (!Gimmicks)
+	{
+		return Report;
+	}
+
+	TMap<const UClass*, int32> ClassIndices;
+	Gimmicks->ForEachGimmick([&Report, &ClassIndices](AActor* Gimmick)
+	{
+		const UClass* Class = Gimmick->GetClass();
+		int32& Index = ClassIndices.FindOrAdd(Class, INDEX_NONE);
+		if (Index == INDEX_NONE)
+		{
+			Index = Report.AddDefaulted();
+			Report[Index].Class = Class;
+		}
+		FGimmickClassMemory& Memory = Report[Index];
+
+		Memory.Count++;
+		Memory.ObjectBytes += Class->GetStructureSize();
+		Memory.ResourceBytes += Gimmick->GetResourceSizeBytes(EResourceSizeMode::Exclusive);
+		for (UActorComponent* Component : Gimmick->GetComponents())
+		{
+			Memory.Components++;
+			Memory.ObjectBytes += Component->GetClass()->GetStructureSize();
+			Memory.ResourceBytes += Component->GetResourceSizeBytes(EResourceSizeMode::Exclusive);
+
+			const UPrimitiveComponent* Primitive = Cast<UPrimitiveComponent>(Component);
+			const FBodyInstance* Body = Primitive ? Primitive->GetBodyInstance() : nullptr;
+			if (Body && Body->IsValidBodyInstance())
+			{
+				FResourceSizeEx BodySize(EResourceSizeMode::Exclusive);
+				Body->GetBodyInstanceResourceSizeEx(BodySize);
+				Memory.PhysicsBytes += BodySize.GetTotalMemoryBytes();
+			}
+		}
+	});
+
+	Report.Sort([](const FGimmickClassMemory& A, const FGimmickClassMemory& B)
+	{
+		return A.GetTotalBytes() > B.GetTotalBytes();
+	});
+	return Report;
+}
+
+//コンソールコマンド
+static FAutoConsoleCommandWithWorldAndArgs GGimmickMemReportCommand(
+	TEXT("Gimmick.MemReport"),
+	TEXT("Print instance count, bytes per instance (object + GetResourceSizeEx, of which physics) and totals per gimmick class."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		const TArray<FGimmickClassMemory> Report = UGimmickSubsystem::GatherMemoryReport(World);
+
+		UE_LOG(LogGimmickRegistry, Display, TEXT("%-32s %8s %10s %12s %12s %12s %12s"), TEXT("Class"), TEXT("Count"), TEXT("Comps/Inst"), TEXT("Object/Inst"), TEXT("Res/Inst"), TEXT("Phys/Inst"), TEXT("Total KB"));
+		FGimmickClassMemory Total;
+		for (const FGimmickClassMemory& Memory : Report)
+		{
+			const double Count = FMath::Max(Memory.Count, 1);
+			UE_LOG(LogGimmickRegistry, Display, TEXT("%-32s %8d %10.1f %12.0f %12.0f %12.0f %12.1f"),
+				*GetNameSafe(Memory.Class), Memory.Count, Memory.Components / Count, Memory.ObjectBytes / Count, Memory.ResourceBytes / Count, Memory.PhysicsBytes / Count, Memory.GetTotalBytes() / 1024.0);
+
+			Total.Count += Memory.Count;
+			Total.Components += Memory.Components;
+			Total.ObjectBytes += Memory.ObjectBytes;
+			Total.ResourceBytes += Memory.ResourceBytes;
+			Total.PhysicsBytes += Memory.PhysicsBytes;
+		}
+		UE_LOG(LogGimmickRegistry, Display, TEXT("Total: %d gimmicks, %d components, object %.1f KB, resource %.1f KB (physics %.1f KB), %.1f KB"),
+			Total.Count, Total.Components, Total.ObjectBytes / 1024.0, Total.ResourceBytes / 1024.0, Total.PhysicsBytes / 1024.0, Total.GetTotalBytes() / 1024.0);
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs GGimmickAdvanceCommand(
+	TEXT("Gimmick.Advance"),
+	TEXT("Jump every gimmick in the world forward by <Seconds> without ticking the frames in between."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		UGimmickSubsystem* Gimmicks = World ? World->GetSubsystem<UGimmickSubsystem>() : nullptr;
+		if (!Gimmicks || Args.Num() == 0)
+		{
+			return;
+		}
+
+		const float Seconds = FCString::Atof(*Args[0]);
+		const double Start = FPlatformTime::Seconds();
+		Gimmicks->AdvanceGimmicks(Seconds);
+		UE_LOG(LogGimmickRegistry, Display, TEXT("Advanced %d gimmicks by %.2f s in %.3f ms"), Gimmicks->Num(), Seconds, (FPlatformTime::Seconds() - Start) * 1000.0);
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs GGimmickRegistryStatsCommand(
+	TEXT("Gimmick.Registry.Stats"),
+	TEXT("Print the number of registered gimmicks per type."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		const UGimmickSubsystem* Gimmicks = World ? World->GetSubsystem<UGimmickSubsystem>() : nullptr;
+		if (!Gimmicks)
+		{
+			return;
+		}
+
+		UE_LOG(LogGimmickRegistry, Display, TEXT("Registered gimmicks: %d, dormant: %d (%lld bytes)"), Gimmicks->Num(), Gimmicks->NumDormant(), Gimmicks->GetDormantBytes());
+		for (int32 i = 0; i < static_cast<int32>(EGimmickType::Count); i++)
+		{
+			const EGimmickType Type = static_cast<EGimmickType>(i);
+			UE_LOG(LogGimmickRegistry, Display, TEXT("  %s: %d"), *UEnum::GetValueAsString(Type), Gimmicks->GetGimmicksOfType(Type).Num());
+		}
+	}));
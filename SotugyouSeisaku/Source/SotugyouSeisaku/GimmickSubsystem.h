@@ -0,0 +1,244 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "GimmickTypes.h"
+#include "GimmickSpatialHash.h"
+#include "GimmickSubsystem.generated.h"
+
+class AGimmick_PushBlock;
+
+/// @brief ギミックのクラスごとのメモリ使用量
+struct FGimmickClassMemory
+{
+	const UClass* Class = nullptr;
+
+	//インスタンス数とコンポーネント数
+	int32 Count = 0;
+	int32 Components = 0;
+
+	//アクタとコンポーネントのオブジェクト自体のサイズ
+	int64 ObjectBytes = 0;
+
+	//GetResourceSizeEx（Exclusive）の合計（コンポーネントの物理ボディ・シーンプロキシ、ギミックが持つ配列など）
+	int64 ResourceBytes = 0;
+
+	//ResourceBytes のうち物理ボディの分
+	int64 PhysicsBytes = 0;
+
+	int64 GetTotalBytes() const { return ObjectBytes + ResourceBytes; }
+};
+
+/// @brief ワールド内のギミックの登録簿
+///
+///        ギミックは BeginPlay で登録、EndPlay で登録解除する。
+///        種類ごとの配列と空間ハッシュを持ち、ワールド全体を走査せずに種類・距離・範囲で検索できる。
+///        検索（ForEach系・GetGimmicksInRadius・FindNearest）はメモリ確保をしない。
+///
+///        World Partition のセルやサブレベルがアンロードされて外れるギミックは、状態を固定IDごとの小さなバイト列で
+///        保持しておき（休眠）、再ロードで登録されたときに復元して、止まっていた時間分を計算で進める。
+///        保存データの読み込みでまだロードされていないギミックの状態も休眠中として持ち、ロードされて登録されたときに復元する。
+///        落ちて再生成を待つ床のようにアクタが一時的にないギミックは、状態の読み書きだけを固定IDで登録しておき、保存データに含める。
+///        そのギミックがいたセルがアンロードされたら、その時点の状態を休眠中の状態に移し、戻ってくる処理は止める。
+///
+///        AdvanceGimmicks でワールドのギミックをまとめて数秒〜数時間先の状態に飛ばせる（テスト・観戦・待ち時間のスキップ用）。
+///
+///        コンソールコマンド:
+///        Gimmick.Registry.Stats
+///        Gimmick.Advance <Seconds>
+///        Gimmick.MemReport
+UCLASS()
+class SOTUGYOUSEISAKU_API UGimmickSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	UGimmickSubsystem();
+
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	//ギミックを登録する（IGimmickStateInterface を実装したアクタ、休眠中の状態があれば復元する）
+	void RegisterGimmick(AActor* Gimmick);
+
+	//ギミックの登録を解除する（ストリーミングで外れる場合は状態を休眠させる）
+	void UnregisterGimmick(AActor* Gimmick, EEndPlayReason::Type EndPlayReason);
+
+	//動くギミックの位置を更新する（同じセル内の移動なら位置を書き換えるだけ）
+	void UpdateGimmickLocation(const AActor* Gimmick);
+
+	//登録数
+	int32 Num() const { return mEntries.Num(); }
+
+	//休眠中のギミックの数と、保持している状態の合計バイト数
+	int32 NumDormant() const { return mDormantStates.Num(); }
+	int64 GetDormantBytes() const;
+
+	//まだ登録されていないギミックの状態を休眠中として持つ（保存データの読み込み用、登録されたときに復元する）
+	//DormantSeconds = 保存したときにすでに休眠していた秒数（復元するときにその分も進める）
+	void AddDormantState(uint64 Id, EGimmickType Type, TConstArrayView<uint8> State, float DormantSeconds = 0.0f);
+
+	/// @brief 休眠中のギミックの状態を列挙する（保存データに含めるため）
+	/// @param Visit (uint64 Id, EGimmickType Type, TConstArrayView<uint8> State, float DormantSeconds) を受け取る関数
+	template<typename FuncType>
+	void ForEachDormantState(FuncType&& Visit) const
+	{
+		const double Now = GetGimmickTime();
+		for (const TPair<uint64, FDormantState>& Dormant : mDormantStates)
+		{
+			Visit(Dormant.Key, Dormant.Value.Type, TConstArrayView<uint8>(Dormant.Value.State), static_cast<float>(Now - Dormant.Value.UnloadTime));
+		}
+	}
+
+	//種類ごとのギミック一覧
+	TConstArrayView<AActor*> GetGimmicksOfType(EGimmickType Type) const { return mTypeLists[static_cast<int32>(Type)]; }
+
+	//ギミックの固定ID（登録時に計算したものを返す、未登録なら 0）
+	uint64 GetGimmickId(const AActor* Gimmick) const;
+
+	/// @brief 一時的にワールドから消えているギミック（落ちて再生成を待つ床など）
+	///        アクタはないが保存データには含めたいので、登録中のギミックと同じ形式で状態を読み書きする処理を持つ
+	struct FAbsentGimmick
+	{
+		EGimmickType Type = EGimmickType::Other;
+
+		//消えたギミックがいたレベル（セルのアンロードでこのレベルが外れたら休眠中の状態に移す）
+		TWeakObjectPtr<ULevel> Level;
+
+		//SerializeGimmickState と同じ形式で状態を読み書きする（読み込みで消えたままでなくなるなら、中で登録を解除してよい）
+		TFunction<void(FArchive&)> Serialize;
+
+		//戻ってくるためのタイマーなどを止める（休眠中の状態に移したとき）
+		TFunction<void()> Cancel;
+	};
+
+	//一時的に消えているギミックを登録する（同じIDがあれば置き換える）
+	void AddAbsentGimmick(uint64 Id, EGimmickType Type, ULevel* Level, TFunction<void(FArchive&)> Serialize, TFunction<void()> Cancel);
+
+	//一時的に消えていたギミックの登録を解除する（戻ってきたとき）
+	void RemoveAbsentGimmick(uint64 Id);
+
+	//一時的に消えているギミック（固定ID → 状態の読み書き）
+	const TMap<uint64, FAbsentGimmick>& GetAbsentGimmicks() const { return mAbsentGimmicks; }
+
+	//範囲内のギミックを OutGimmicks に追加する（戻り値 = 追加した数、配列を使い回せばメモリ確保しない）
+	int32 GetGimmicksInRadius(EGimmickType Type, const FVector& Center, float Radius, TArray<AActor*>& OutGimmicks) const;
+
+	//最も近いギミック（MaxRadius 以内になければ nullptr）
+	AActor* FindNearestGimmick(EGimmickType Type, const FVector& Location, float MaxRadius) const;
+
+	//最も近い押せるブロック
+	AGimmick_PushBlock* FindNearestPushBlock(const FVector& Location, float MaxRadius) const;
+
+	/// @brief すべてのギミックを指定した秒数後の状態に飛ばす（途中のフレームを1つずつTickしない）
+	///        動く床・ドアのような時間の式で動くギミックは一度に計算で進め、落ちる床の削除・再生成や手順の時間待ちなどの
+	///        タイマーはタイミングホイールが期限の順に呼ぶ。処理時間はギミックとタイマーの数に比例し、飛ばす時間の長さには比例しない。
+	///        式で進めるギミックは先に飛ばした後の状態になるので、途中で呼ばれるタイマーの処理（手順の Do など）はその状態に対して行われる
+	/// @param Seconds 飛ばす秒数
+	UFUNCTION(BlueprintCallable, Category = "Gimmick")
+	void AdvanceGimmicks(float Seconds);
+
+	//登録済みのギミックのメモリ使用量をクラスごとに集計する（合計の大きい順）
+	static TArray<FGimmickClassMemory> GatherMemoryReport(const UWorld* World);
+
+	/// @brief すべてのギミックを列挙する
+	/// @param Visit (AActor* Gimmick) を受け取る関数
+	template<typename FuncType>
+	void ForEachGimmick(FuncType&& Visit) const
+	{
+		for (const FEntry& Entry : mEntries)
+		{
+			Visit(Entry.Actor);
+		}
+	}
+
+	/// @brief 指定した種類で半径内にあるギミックを列挙する
+	/// @param Type ギミックの種類
+	/// @param Center 中心
+	/// @param Radius 半径
+	/// @param Visit (AActor* Gimmick) を受け取る関数
+	template<typename FuncType>
+	void ForEachGimmickInRadius(EGimmickType Type, const FVector& Center, float Radius, FuncType&& Visit) const
+	{
+		mSpatialHash.ForEachInRadius(Center, Radius, FGimmickSpatialHash::CategoryMask(static_cast<uint8>(Type)),
+			[this, &Visit](int32 Index, const FVector&)
+			{
+				Visit(mEntries[Index].Actor);
+			});
+	}
+
+	/// @brief 範囲（部屋など）の中にあるすべての種類のギミックを列挙する
+	/// @param Bounds 範囲
+	/// @param Visit (AActor* Gimmick) を受け取る関数
+	template<typename FuncType>
+	void ForEachGimmickInBounds(const FBox& Bounds, FuncType&& Visit) const
+	{
+		mSpatialHash.ForEachInBox(Bounds, FGimmickSpatialHash::AllCategories,
+			[this, &Visit](int32 Index, const FVector&)
+			{
+				Visit(mEntries[Index].Actor);
+			});
+	}
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	struct FEntry
+	{
+		//登録中のアクタ（EndPlay で必ず登録解除されるので生ポインタで持つ）
+		AActor* Actor = nullptr;
+
+		//固定ID
+		uint64 Id = 0;
+
+		EGimmickType Type = EGimmickType::Other;
+
+		//種類ごとの配列内の位置
+		int32 TypeSlot = INDEX_NONE;
+	};
+
+	//登録情報（インデックスを空間ハッシュのIDに使う）
+	TSparseArray<FEntry> mEntries;
+
+	//アクタ → 登録情報のインデックス
+	TMap<const AActor*, int32> mEntryIndices;
+
+	//種類ごとのギミック一覧と、対応する登録情報のインデックス
+	TArray<AActor*> mTypeLists[static_cast<int32>(EGimmickType::Count)];
+	TArray<int32> mTypeEntryIndices[static_cast<int32>(EGimmickType::Count)];
+
+	FGimmickSpatialHash mSpatialHash;
+
+	//休眠中のギミックの状態
+	struct FDormantState
+	{
+		//SerializeGimmickState で書き出した状態
+		TArray<uint8> State;
+
+		//外れたときのワールド時間
+		double UnloadTime = 0.0;
+
+		EGimmickType Type = EGimmickType::Other;
+	};
+
+	//固定ID → 休眠中の状態
+	TMap<uint64, FDormantState> mDormantStates;
+
+	//固定ID → 一時的に消えているギミック
+	TMap<uint64, FAbsentGimmick> mAbsentGimmicks;
+
+	//レベル（World Partition のセル・サブレベル）が外れたときの通知
+	FDelegateHandle mLevelRemovedHandle;
+
+	//外れたレベルにいた一時的に消えているギミックを、休眠中の状態に移す（戻ってくるのはレベルの再ロードで登録されたとき）
+	void OnLevelRemovedFromWorld(ULevel* Level, UWorld* World);
+
+	//AdvanceGimmicks で飛ばした時間の合計（休眠中のギミックもその分進める）
+	double mSkippedSeconds = 0.0;
+
+	//ギミックの時刻（ワールドの時間 + 飛ばした時間）
+	double GetGimmickTime() const;
+};
@@ -0,0 +1,322 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GimmickTimerSubsystem.h"
+#include "GimmickTypes.h"
+#include "GimmickPreloadSubsystem.h"
+
+DECLARE_CYCLE_STAT(TEXT("Timer Wheel Tick"), STAT_GimmickTimerTick, STATGROUP_Gimmick);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Timers Active"), STAT_GimmickTimersActive, STATGROUP_Gimmick);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Timers Fired"), STAT_GimmickTimersFired, STATGROUP_Gimmick);
+
+/// @brief コンストラクタ
+/// @param InResolution 1刻みの秒数
+FGimmickTimingWheel::FGimmickTimingWheel(double InResolution)
+	: mResolution(FMath::Max(InResolution, 0.001))
+{
+	for (int32& Head : mSlotHeads)
+	{
+		Head = INDEX_NONE;
+	}
+	for (uint64& Mask : mSlotMasks)
+	{
+		Mask = 0;
+	}
+}
+
+/// @brief タイマーを登録する
+/// @param Seconds 何秒後に呼ぶか
+/// @param Callback 呼ぶ処理
+/// @param Owner 持ち主
+/// @return 登録したタイマーのハンドル
+FGimmickTimerHandle FGimmickTimingWheel::Schedule(float Seconds, TFunction<void()> Callback, const UObject* Owner)
+{
+	LLM_SCOPE_BYTAG(Gimmick_Timers);
+
+	//端数の時間も含めて期限の刻みを求める（最低でも次の刻み）
+	const double Ticks = FMath::CeilToDouble((FMath::Max(Seconds, 0.0f) + mAccumulated) / mResolution);
+
+	FTimer Timer;
+	Timer.Callback = MoveTemp(Callback);
+	Timer.Owner = Owner;
+	Timer.bHasOwner = Owner != nullptr;
+	Timer.ExpireTick = mCurrentTick + FMath::Max<uint64>(static_cast<uint64>(Ticks), 1);
+	Timer.Serial = mNextSerial++;
+
+	FGimmickTimerHandle Handle;
+	Handle.Serial = Timer.Serial;
+	Handle.Index = mTimers.Add(MoveTemp(Timer));
+	Link(Handle.Index);
+	return Handle;
+}
+
+/// @brief タイマーを解除する
+/// @param Handle 解除するタイマーのハンドル（無効になる）
+void FGimmickTimingWheel::Cancel(FGimmickTimerHandle& Handle)
+{
+	if (IsValidHandle(Handle))
+	{
+		//期限が来て呼ぶのを待っているものは枠に入っていない（呼ぶときに通し番号で弾かれる）
+		Unlink(Handle.Index);
+		mTimers.RemoveAt(Handle.Index);
+	}
+	Handle.Invalidate();
+}
+
+bool FGimmickTimingWheel::IsValidHandle(const FGimmickTimerHandle& Handle) const
+{
+	return Handle.IsValid() && mTimers.IsValidIndex(Handle.Index) && mTimers[Handle.Index].Serial == Handle.Serial;
+}
+
+/// @brief タイマーが呼ばれる前か
+/// @param Handle タイマーのハンドル
+bool FGimmickTimingWheel::IsActive(const FGimmickTimerHandle& Handle) const
+{
+	return IsValidHandle(Handle);
+}
+
+/// @brief 呼ばれるまでの残り秒数を取得する
+/// @param Handle タイマーのハンドル
+/// @return 残り秒数（登録されていなければ -1）
+float FGimmickTimingWheel::GetRemaining(const FGimmickTimerHandle& Handle) const
+{
+	if (!IsValidHandle(Handle))
+	{
+		return -1.0f;
+	}
+
+	const uint64 ExpireTick = mTimers[Handle.Index].ExpireTick;
+	const double Remaining = ExpireTick > mCurrentTick ? (ExpireTick - mCurrentTick) * mResolution - mAccumulated : 0.0;
+	return static_cast<float>(FMath::Max(Remaining, 0.0));
+}
+
+/// @brief 期限に応じた枠に入れる
+///        残りの刻み数が 64 未満なら1段目、64^2 未満なら2段目…のように、期限の刻みの該当する桁で枠を決める
+/// @param Index タイマーのインデックス
+void FGimmickTimingWheel::Link(int32 Index)
+{
+	FTimer& Timer = mTimers[Index];
+	const uint64 Remaining = Timer.ExpireTick > mCurrentTick ? Timer.ExpireTick - mCurrentTick : 0;
+
+	int32 Level = 0;
+	while (Level < LevelCount - 1 && Remaining >= (1ull << (SlotBits * (Level + 1))))
+	{
+		Level++;
+	}
+
+	//最上段にも収まらない先の期限は最上段の一番先の枠に入れ、回ってきたら入れ直す
+	uint64 Tick = Timer.ExpireTick;
+	const uint64 MaxTick = mCurrentTick + (1ull << (SlotBits * LevelCount)) - 1;
+	if (Tick > MaxTick)
+	{
+		Tick = MaxTick;
+	}
+
+	const int32 Slot = Level * SlotCount + static_cast<int32>((Tick >> (SlotBits * Level)) & (SlotCount - 1));
+	Timer.Slot = Slot;
+	Timer.Prev = INDEX_NONE;
+	Timer.Next = mSlotHeads[Slot];
+	if (Timer.Next != INDEX_NONE)
+	{
+		mTimers[Timer.Next].Prev = Index;
+	}
+	mSlotHeads[Slot] = Index;
+	mSlotMasks[Level] |= 1ull << (Slot & (SlotCount - 1));
+}
+
+/// @brief 枠から外す
+/// @param Index タイマーのインデックス
+void FGimmickTimingWheel::Unlink(int32 Index)
+{
+	FTimer& Timer = mTimers[Index];
+	if (Timer.Slot == INDEX_NONE)
+	{
+		return;
+	}
+
+	if (Timer.Prev != INDEX_NONE)
+	{
+		mTimers[Timer.Prev].Next = Timer.Next;
+	}
+	else
+	{
+		mSlotHeads[Timer.Slot] = Timer.Next;
+		if (Timer.Next == INDEX_NONE)
+		{
+			mSlotMasks[Timer.Slot / SlotCount] &= ~(1ull << (Timer.Slot & (SlotCount - 1)));
+		}
+	}
+	if (Timer.Next != INDEX_NONE)
+	{
+		mTimers[Timer.Next].Prev = Timer.Prev;
+	}
+
+	Timer.Slot = INDEX_NONE;
+	Timer.Prev = INDEX_NONE;
+	Timer.Next = INDEX_NONE;
+}
+
+/// @brief 1刻み進める
+void FGimmickTimingWheel::Step()
+{
+	mCurrentTick++;
+
+	//下の段が一周したら、上の段の今の枠を振り分け直す（期限が今の刻みのものは1段目の今の枠に入る）
+	for (int32 Level = 1; Level < LevelCount; Level++)
+	{
+		if ((mCurrentTick & ((1ull << (SlotBits * Level)) - 1)) != 0)
+		{
+			break;
+		}
+
+		const int32 Slot = Level * SlotCount + static_cast<int32>((mCurrentTick >> (SlotBits * Level)) & (SlotCount - 1));
+		int32 Index = mSlotHeads[Slot];
+		mSlotHeads[Slot] = INDEX_NONE;
+		mSlotMasks[Level] &= ~(1ull << (Slot & (SlotCount - 1)));
+		while (Index != INDEX_NONE)
+		{
+			const int32 Next = mTimers[Index].Next;
+			Link(Index);
+			Index = Next;
+		}
+	}
+
+	//1段目の今の枠のタイマーは全部期限が来ている
+	const int32 Slot = static_cast<int32>(mCurrentTick & (SlotCount - 1));
+	int32 Index = mSlotHeads[Slot];
+	mSlotHeads[Slot] = INDEX_NONE;
+	mSlotMasks[0] &= ~(1ull << Slot);
+	while (Index != INDEX_NONE)
+	{
+		FTimer& Timer = mTimers[Index];
+		const int32 Next = Timer.Next;
+		Timer.Slot = INDEX_NONE;
+		Timer.Prev = INDEX_NONE;
+		Timer.Next = INDEX_NONE;
+		mExpired.Add({ Index, Timer.Serial });
+		Index = Next;
+	}
+}
+
+/// @brief 時間を進め、期限が来たタイマーをまとめて呼ぶ
+/// @param DeltaTime 進める秒数
+/// @return 呼んだタイマーの数
+int32 FGimmickTimingWheel::Advance(float DeltaTime)
+{
+	mAccumulated += FMath::Max(DeltaTime, 0.0f);
+	uint64 Ticks = static_cast<uint64>(mAccumulated / mResolution);
+	mAccumulated -= Ticks * mResolution;
+
+	//タイマーがなければ刻みを数えるだけ
+	if (mTimers.Num() == 0)
+	{
+		mCurrentTick += Ticks;
+		return 0;
+	}
+
+	int32 Fired = 0;
+	while (Ticks > 0)
+	{
+		//次に枠を見る刻みの手前までは何も起きないので飛ばす
+		const uint64 Skip = FMath::Min(GetNextActiveTick() - mCurrentTick - 1, Ticks - 1);
+		mCurrentTick += Skip;
+		Ticks -= Skip;
+
+		Step();
+		Ticks--;
+
+		//刻みごとに呼ぶ（呼んだ処理が登録したタイマーも、期限が来ていれば同じ呼び出しの中で呼ばれる）
+		for (int32 i = 0; i < mExpired.Num(); i++)
+		{
+			const FExpired Expired = mExpired[i];
+			if (!mTimers.IsValidIndex(Expired.Index) || mTimers[Expired.Index].Serial != Expired.Serial)
+			{
+				continue;
+			}
+
+			//呼ぶ前に削除する（処理の中で同じ場所に登録し直せるように）
+			FTimer& Timer = mTimers[Expired.Index];
+			TFunction<void()> Callback = MoveTemp(Timer.Callback);
+			const bool bOwnerAlive = !Timer.bHasOwner || Timer.Owner.IsValid();
+			mTimers.RemoveAt(Expired.Index);
+
+			if (bOwnerAlive && Callback)
+			{
+				Callback();
+				Fired++;
+			}
+		}
+		mExpired.Reset();
+	}
+	return Fired;
+}
+
+/// @brief 次に枠を見る必要のある刻みを求める
+///        1段目は毎刻み、2段目以降は下の段が一周する刻みに自分の枠を見るので、段ごとに今の次から最初に使われている枠を探す
+/// @return 刻み（どの枠も空なら MAX_uint64）
+uint64 FGimmickTimingWheel::GetNextActiveTick() const
+{
+	uint64 NextTick = MAX_uint64;
+	for (int32 Level = 0; Level < LevelCount; Level++)
+	{
+		const uint64 Mask = mSlotMasks[Level];
+		if (Mask == 0)
+		{
+			continue;
+		}
+
+		//この段の今の枠の次から一周先の今の枠までで、最初に使われている枠
+		const int32 Shift = SlotBits * Level;
+		const uint64 Unit = mCurrentTick >> Shift;
+		const int32 From = static_cast<int32>((Unit + 1) & (SlotCount - 1));
+		const uint64 Rotated = From == 0 ? Mask : (Mask >> From) | (Mask << (SlotCount - From));
+		const uint64 Offset = FMath::CountTrailingZeros64(Rotated) + 1;
+		NextTick = FMath::Min(NextTick, (Unit + Offset) << Shift);
+	}
+	return NextTick;
+}
+
+/// @brief すべてのタイマーを呼ばずに解除する
+void FGimmickTimingWheel::Reset()
+{
+	mTimers.Empty();
+	mExpired.Empty();
+	for (int32& Head : mSlotHeads)
+	{
+		Head = INDEX_NONE;
+	}
+	for (uint64& Mask : mSlotMasks)
+	{
+		Mask = 0;
+	}
+}
+
+void UGimmickTimerSubsystem::Deinitialize()
+{
+	mWheel.Reset();
+
+	Super::Deinitialize();
+}
+
+bool UGimmickTimerSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UGimmickTimerSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UGimmickTimerSubsystem, STATGROUP_Tickables);
+}
+
+/// @brief 時間を進め、期限が来たタイマーを呼ぶ
+/// @param DeltaTime フレーム間の経過時間
+void UGimmickTimerSubsystem::Tick(float DeltaTime)
+{
+	LLM_SCOPE_BYTAG(Gimmick_Timers);
+	SCOPE_CYCLE_COUNTER(STAT_GimmickTimerTick);
+	GimmickLoading::FSyncLoadScope LoadScope(this, TEXT("UGimmickTimerSubsystem::Tick"));
+
+	const int32 Fired = mWheel.Advance(DeltaTime);
+
+	SET_DWORD_STAT(STAT_GimmickTimersActive, mWheel.Num());
+	SET_DWORD_STAT(STAT_GimmickTimersFired, Fired);
+}
@@ -0,0 +1,163 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "GimmickTimerSubsystem.generated.h"
+
+/// @brief 登録したタイマーへのハンドル
+struct FGimmickTimerHandle
+{
+	int32 Index = INDEX_NONE;
+	uint32 Serial = 0;
+
+	bool IsValid() const { return Index != INDEX_NONE; }
+	void Invalidate() { Index = INDEX_NONE; Serial = 0; }
+};
+
+/// @brief 階層タイミングホイール（登録・解除は O(1)、期限が来たタイマーはまとめて呼ぶ）
+///
+///        時間を分解能（既定 10ms）単位の刻みで数え、64 枠 × 4 段の輪に期限ごとに振り分ける。
+///        1段目は次の 64 刻み、2段目以降はそれぞれ 64 倍ずつ先の期限を受け持ち、
+///        下の段が一周するたびに上の段の1枠分を下の段に振り分け直す（期限の近いものだけが毎刻み見られる）。
+///        1刻みの処理は枠1つ分のリストをたどるだけなので、登録されているタイマーの数には比例しない。
+///        段ごとに使われている枠をビットで持ち、どの枠も見る必要のない刻みはまとめて飛ばす（長い時間を一度に進めても刻みの数には比例しない）。
+class SOTUGYOUSEISAKU_API FGimmickTimingWheel
+{
+public:
+	static constexpr int32 SlotBits = 6;
+	static constexpr int32 SlotCount = 1 << SlotBits;
+	static constexpr int32 LevelCount = 4;
+
+	/// @param InResolution 1刻みの秒数
+	explicit FGimmickTimingWheel(double InResolution = 0.01);
+
+	/// @brief タイマーを登録する
+	/// @param Seconds 何秒後に呼ぶか（1刻み未満なら次の刻みで呼ぶ）
+	/// @param Callback 呼ぶ処理
+	/// @param Owner 持ち主（破棄されていたら呼ばない、不要なら nullptr）
+	FGimmickTimerHandle Schedule(float Seconds, TFunction<void()> Callback, const UObject* Owner = nullptr);
+
+	//タイマーを解除する（ハンドルは無効になる）
+	void Cancel(FGimmickTimerHandle& Handle);
+
+	//タイマーが呼ばれる前か
+	bool IsActive(const FGimmickTimerHandle& Handle) const;
+
+	//呼ばれるまでの残り秒数（登録されていなければ -1）
+	float GetRemaining(const FGimmickTimerHandle& Handle) const;
+
+	/// @brief 時間を進め、期限が来たタイマーを期限の順にまとめて呼ぶ
+	/// @param DeltaTime 進める秒数
+	/// @return 呼んだタイマーの数
+	int32 Advance(float DeltaTime);
+
+	//登録中のタイマーの数
+	int32 Num() const { return mTimers.Num(); }
+
+	//すべてのタイマーを呼ばずに解除する
+	void Reset();
+
+private:
+	struct FTimer
+	{
+		TFunction<void()> Callback;
+		TWeakObjectPtr<const UObject> Owner;
+		bool bHasOwner = false;
+		uint64 ExpireTick = 0;
+		uint32 Serial = 0;
+
+		//枠のリスト（mSlotHeads の添字、期限が来て呼ぶのを待っている間は INDEX_NONE）
+		int32 Slot = INDEX_NONE;
+		int32 Prev = INDEX_NONE;
+		int32 Next = INDEX_NONE;
+	};
+
+	//期限に応じた枠に入れる
+	void Link(int32 Index);
+
+	//枠から外す
+	void Unlink(int32 Index);
+
+	//1刻み進める（期限が来たタイマーを mExpired に移す）
+	void Step();
+
+	//次に枠を見る必要のある刻み（どの枠も空なら MAX_uint64）
+	uint64 GetNextActiveTick() const;
+
+	bool IsValidHandle(const FGimmickTimerHandle& Handle) const;
+
+	TSparseArray<FTimer> mTimers;
+	int32 mSlotHeads[LevelCount * SlotCount];
+
+	//段ごとの、タイマーの入っている枠のビット
+	uint64 mSlotMasks[LevelCount];
+
+	double mResolution;
+	uint64 mCurrentTick = 0;
+
+	//まだ刻みにならない端数の時間
+	double mAccumulated = 0.0;
+
+	uint32 mNextSerial = 1;
+
+	//期限が来たタイマー（毎回使い回す）
+	struct FExpired
+	{
+		int32 Index;
+		uint32 Serial;
+	};
+	TArray<FExpired> mExpired;
+};
+
+/// @brief ギミックの待ち時間・遅延・再生成などのタイマーを、ワールドに1つのタイミングホイールでまとめて扱うサブシステム
+///
+///        アクタごとに FTimerHandle を持ったりTickで経過時間を数えたりせず、期限を登録しておけば
+///        このサブシステムのTickで期限が来たものだけがまとめて呼ばれる。
+///        統計: stat Gimmick
+UCLASS()
+class SOTUGYOUSEISAKU_API UGimmickTimerSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	/// @brief タイマーを登録する
+	/// @param Owner 持ち主（破棄されていたら呼ばない、不要なら nullptr）
+	/// @param Seconds 何秒後に呼ぶか
+	/// @param Callback 呼ぶ処理
+	FGimmickTimerHandle SetTimer(const UObject* Owner, float Seconds, TFunction<void()> Callback) { return mWheel.Schedule(Seconds + mScheduleOffset, MoveTemp(Callback), Owner); }
+
+	//タイマーを解除する（ハンドルは無効になる）
+	void ClearTimer(FGimmickTimerHandle& Handle) { mWheel.Cancel(Handle); }
+
+	//タイマーが呼ばれる前か
+	bool IsTimerActive(const FGimmickTimerHandle& Handle) const { return mWheel.IsActive(Handle); }
+
+	//呼ばれるまでの残り秒数（登録されていなければ -1）
+	float GetTimerRemaining(const FGimmickTimerHandle& Handle) const { return mWheel.GetRemaining(Handle); }
+
+	//登録中のタイマーの数
+	int32 NumTimers() const { return mWheel.Num(); }
+
+	/// @brief 時間を飛ばす（期限が来たタイマーを期限の順に呼ぶ、空の刻みは飛ばすので飛ばす時間の長さには比例しない）
+	/// @param Seconds 飛ばす秒数
+	/// @return 呼んだタイマーの数
+	int32 AdvanceTimers(float Seconds) { return mWheel.Advance(Seconds); }
+
+	//これから登録するタイマーの期限を Seconds だけ後ろにずらす（時間飛ばしで、飛ばした後の状態から掛け直すタイマー用、0 で戻す）
+	void SetScheduleOffset(float Seconds) { mScheduleOffset = FMath::Max(Seconds, 0.0f); }
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	FGimmickTimingWheel mWheel;
+
+	//登録するタイマーの期限に足す秒数（時間飛ばしの間だけ使う）
+	float mScheduleOffset = 0.0f;
+};
@@ -0,0 +1,182 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GimmickTimerSubsystem.h"
+#include "GimmickConfig.h"
+#include "UObject/Package.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+/// @brief ギミックのタイミングホイール（FGimmickTimingWheel）の自動テスト
+///        期限の順に呼ばれるか、解除・残り時間・持ち主の破棄が正しく扱われるかを確かめる
+///        （FTimerManager との処理時間の比較は -run=GimmickBenchmark -Suite=Timers）
+BEGIN_DEFINE_SPEC(FGimmickTimingWheelSpec, "SotugyouSeisaku.Gimmick.TimingWheel", EAutomationTestFlags_ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+	//1刻みの秒数（既定値）
+	static constexpr double Resolution = 0.01;
+
+	//登録する順番はばらばらで、4段すべてにまたがる期限（秒）
+	static constexpr float Delays[] = { 41.0f, 0.3f, 3000.0f, 0.005f, 7.5f, 1.0f, 300.0f, 0.64f };
+	static constexpr int32 DelayCount = UE_ARRAY_COUNT(Delays);
+
+	/// @brief Delays をすべて登録し、呼ばれた順に期限を Fired に積む
+	static void ScheduleAll(FGimmickTimingWheel& Wheel, TArray<float>& Fired)
+	{
+		for (const float Delay : Delays)
+		{
+			Wheel.Schedule(Delay, [&Fired, Delay]() { Fired.Add(Delay); });
+		}
+	}
+
+	/// @brief Delays を昇順に並べたもの
+	static TArray<float> SortedDelays()
+	{
+		TArray<float> Sorted(Delays, DelayCount);
+		Sorted.Sort();
+		return Sorted;
+	}
+
+END_DEFINE_SPEC(FGimmickTimingWheelSpec)
+
+void FGimmickTimingWheelSpec::Define()
+{
+	Describe("Advance", [this]()
+	{
+		It("fires timers in expiry order when all of them expire in one call", [this]()
+		{
+			FGimmickTimingWheel Wheel(Resolution);
+			TArray<float> Fired;
+			ScheduleAll(Wheel, Fired);
+			TestEqual(TEXT("registered timers"), Wheel.Num(), DelayCount);
+
+			TestEqual(TEXT("fired count"), Wheel.Advance(3001.0f), DelayCount);
+			TestEqual(TEXT("fired order"), Fired, SortedDelays());
+			TestEqual(TEXT("timers left"), Wheel.Num(), 0);
+		});
+
+		It("fires each timer on the frame its expiry passes when stepped frame by frame", [this]()
+		{
+			FGimmickTimingWheel Wheel(Resolution);
+			TArray<float> Fired;
+			TArray<double> FiredAt;
+			double Now = 0.0;
+			for (const float Delay : Delays)
+			{
+				Wheel.Schedule(Delay, [&Fired, &FiredAt, &Now, Delay]() { Fired.Add(Delay); FiredAt.Add(Now); });
+			}
+
+			//フレームの時間は刻みの倍数にしない（端数の持ち越しも確かめる）
+			constexpr float FrameTime = 1.0f / 60.0f;
+			while (Wheel.Num() > 0 && Now < 3001.0)
+			{
+				Now += FrameTime;
+				Wheel.Advance(FrameTime);
+			}
+
+			TestEqual(TEXT("fired order"), Fired, SortedDelays());
+			for (int32 i = 0; i < Fired.Num(); i++)
+			{
+				//期限を過ぎてから、1刻みと1フレーム以内に呼ばれる
+				TestTrue(FString::Printf(TEXT("timer of %.3f s fired at %.3f s"), Fired[i], FiredAt[i]),
+					FiredAt[i] >= Fired[i] - 1e-3 && FiredAt[i] <= Fired[i] + Resolution + FrameTime + 1e-3);
+			}
+		});
+
+		It("does not fire a timer before its expiry", [this]()
+		{
+			FGimmickTimingWheel Wheel(Resolution);
+			int32 Calls = 0;
+			Wheel.Schedule(1.0f, [&Calls]() { Calls++; });
+
+			TestEqual(TEXT("fired before expiry"), Wheel.Advance(0.98f), 0);
+			TestEqual(TEXT("calls before expiry"), Calls, 0);
+			TestEqual(TEXT("fired after expiry"), Wheel.Advance(0.04f), 1);
+			TestEqual(TEXT("calls after expiry"), Calls, 1);
+		});
+
+		It("fires a timer scheduled for less than one tick on the next tick", [this]()
+		{
+			FGimmickTimingWheel Wheel(Resolution);
+			int32 Calls = 0;
+			Wheel.Schedule(0.0f, [&Calls]() { Calls++; });
+
+			TestEqual(TEXT("fired on the next tick"), Wheel.Advance(static_cast<float>(Resolution)), 1);
+			TestEqual(TEXT("calls"), Calls, 1);
+		});
+
+		It("skips timers whose owner has been destroyed", [this]()
+		{
+			FGimmickTimingWheel Wheel(Resolution);
+			UObject* Alive = NewObject<UGimmickMoveFloorConfig>(GetTransientPackage());
+			UObject* Destroyed = NewObject<UGimmickMoveFloorConfig>(GetTransientPackage());
+			int32 AliveCalls = 0;
+			int32 DestroyedCalls = 0;
+			Wheel.Schedule(0.1f, [&AliveCalls]() { AliveCalls++; }, Alive);
+			Wheel.Schedule(0.1f, [&DestroyedCalls]() { DestroyedCalls++; }, Destroyed);
+			Destroyed->MarkAsGarbage();
+
+			TestEqual(TEXT("fired count"), Wheel.Advance(0.2f), 1);
+			TestEqual(TEXT("calls with a live owner"), AliveCalls, 1);
+			TestEqual(TEXT("calls with a destroyed owner"), DestroyedCalls, 0);
+			TestEqual(TEXT("timers left"), Wheel.Num(), 0);
+		});
+	});
+
+	Describe("Cancel", [this]()
+	{
+		It("keeps a cancelled timer from firing and invalidates its handle", [this]()
+		{
+			FGimmickTimingWheel Wheel(Resolution);
+			int32 CancelledCalls = 0;
+			int32 KeptCalls = 0;
+			FGimmickTimerHandle Cancelled = Wheel.Schedule(0.5f, [&CancelledCalls]() { CancelledCalls++; });
+			FGimmickTimerHandle Kept = Wheel.Schedule(0.5f, [&KeptCalls]() { KeptCalls++; });
+
+			Wheel.Cancel(Cancelled);
+			TestFalse(TEXT("cancelled handle is valid"), Cancelled.IsValid());
+			TestFalse(TEXT("cancelled timer is active"), Wheel.IsActive(Cancelled));
+			TestTrue(TEXT("other timer is active"), Wheel.IsActive(Kept));
+
+			TestEqual(TEXT("fired count"), Wheel.Advance(1.0f), 1);
+			TestEqual(TEXT("calls of the cancelled timer"), CancelledCalls, 0);
+			TestEqual(TEXT("calls of the other timer"), KeptCalls, 1);
+		});
+
+		It("ignores a handle whose timer has already fired", [this]()
+		{
+			FGimmickTimingWheel Wheel(Resolution);
+			FGimmickTimerHandle Fired = Wheel.Schedule(0.1f, []() {});
+			Wheel.Advance(0.2f);
+
+			//同じ場所に登録し直されたタイマーを消さない
+			int32 Calls = 0;
+			Wheel.Schedule(0.1f, [&Calls]() { Calls++; });
+			Wheel.Cancel(Fired);
+
+			TestEqual(TEXT("timers left"), Wheel.Num(), 1);
+			TestEqual(TEXT("fired count"), Wheel.Advance(0.2f), 1);
+			TestEqual(TEXT("calls"), Calls, 1);
+		});
+	});
+
+	Describe("GetRemaining", [this]()
+	{
+		It("returns the time left within one tick and -1 once the timer has fired", [this]()
+		{
+			FGimmickTimingWheel Wheel(Resolution);
+			const FGimmickTimerHandle Handle = Wheel.Schedule(2.0f, []() {});
+
+			TestEqual(TEXT("remaining when scheduled"), Wheel.GetRemaining(Handle), 2.0f, static_cast<float>(Resolution) + 1e-4f);
+			Wheel.Advance(0.5f);
+			TestEqual(TEXT("remaining after 0.5 s"), Wheel.GetRemaining(Handle), 1.5f, static_cast<float>(Resolution) + 1e-4f);
+			Wheel.Advance(0.333f);
+			TestEqual(TEXT("remaining after 0.833 s"), Wheel.GetRemaining(Handle), 1.167f, static_cast<float>(Resolution) + 1e-4f);
+
+			Wheel.Advance(2.0f);
+			TestFalse(TEXT("active after firing"), Wheel.IsActive(Handle));
+			TestEqual(TEXT("remaining after firing"), Wheel.GetRemaining(Handle), -1.0f);
+		});
+	});
+}
+
+#endif
@@ -0,0 +1,152 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GimmickTypes.h"
+#include "GimmickStateInterface.h"
+#include "GameFramework/Actor.h"
+#include "Engine/Level.h"
+#include "Engine/World.h"
+#include "Components/PrimitiveComponent.h"
+#include "UObject/Package.h"
+#include "UObject/UObjectHash.h"
+#include "Misc/App.h"
+#include "Hash/CityHash.h"
+#include "HAL/IConsoleManager.h"
+
+LLM_DEFINE_TAG(Gimmick);
+LLM_DEFINE_TAG(Gimmick_Registry);
+LLM_DEFINE_TAG(Gimmick_Timers);
+LLM_DEFINE_TAG(Gimmick_Scheduler);
+LLM_DEFINE_TAG(Gimmick_Sequences);
+LLM_DEFINE_TAG(Gimmick_Events);
+LLM_DEFINE_TAG(Gimmick_Instances);
+LLM_DEFINE_TAG(Gimmick_Recorder);
+LLM_DEFINE_TAG(Gimmick_Save);
+
+static TAutoConsoleVariable<int32> CVarGimmickServerProfile(
+	TEXT("Gimmick.ServerProfile"),
+	1,
+	TEXT("Strip cosmetic gimmick work (fall floor shake, button press offset, shared instance rendering, feedback):\n")
+	TEXT("0 = never, 1 = on dedicated servers and processes that cannot render (including commandlets)."));
+
+/// @brief 起動ごとに変わらないギミックのIDを求める
+/// @param Gimmick IDを求めるアクタ
+/// @return 64bitのID（アクタが無効なら0）
+uint64 GimmickIds::GetStableId(const AActor* Gimmick)
+{
+	if (!Gimmick)
+	{
+		return 0;
+	}
+
+	//作り直したギミック（再生成した落ちる床など）は元のギミックのIDを使う
+	if (const IGimmickStateInterface* State = Cast<IGimmickStateInterface>(Gimmick))
+	{
+		if (const uint64 InheritedId = State->GetInheritedGimmickId())
+		{
+			return InheritedId;
+		}
+	}
+
+	//PIEではパッケージ名に接頭辞が付くので取り除く
+	FString Path;
+	if (const ULevel* Level = Gimmick->GetLevel())
+	{
+		Path = UWorld::RemovePIEPrefix(Level->GetPackage()->GetName());
+	}
+	Path += TEXT(".");
+	Path += Gimmick->GetFName().ToString();
+
+	return CityHash64(reinterpret_cast<const char*>(*Path), Path.Len() * sizeof(TCHAR));
+}
+
+/// @brief 見た目だけの処理を行うか
+/// @param WorldContext 判定するワールドのオブジェクト
+bool GimmickCosmetics::ShouldRun(const UObject* WorldContext)
+{
+	if (CVarGimmickServerProfile.GetValueOnGameThread() == 0)
+	{
+		return true;
+	}
+
+	if (IsRunningDedicatedServer() || !FApp::CanEverRender())
+	{
+		return false;
+	}
+
+	//エディタから起動した専用サーバーのワールド
+	const UWorld* World = WorldContext ? WorldContext->GetWorld() : nullptr;
+	return !World || World->GetNetMode() != NM_DedicatedServer;
+}
+
+/// @brief 見た目だけのコンポーネントを取り除く
+/// @param Component 対象のコンポーネント
+/// @return 取り除いたか
+bool GimmickCosmetics::StripVisualComponent(UPrimitiveComponent* Component)
+{
+	if (!Component || ShouldRun(Component))
+	{
+		return false;
+	}
+
+	//当たり判定に使うもの・ほかのコンポーネントの親は残す
+	const AActor* Owner = Component->GetOwner();
+	if (Component->GetCollisionEnabled() != ECollisionEnabled::NoCollision
+		|| Component->GetAttachChildren().Num() > 0
+		|| (Owner && Owner->GetRootComponent() == Component))
+	{
+		return false;
+	}
+
+	Component->DestroyComponent();
+	return true;
+}
+
+/// @brief 以前の版にあったルートを取り除き、その位置を新しいルートに移す
+/// @param Gimmick 読み込んだアクタ
+/// @param NewRoot 新しいルート
+/// @return 以前のルートがあって移したか
+bool GimmickMigration::MigrateRemovedRoot(AActor* Gimmick, USceneComponent* NewRoot)
+{
+	if (!Gimmick || !NewRoot)
+	{
+		return false;
+	}
+
+	//コンストラクタで作らなくなったルートも、保存されたデータからはそのまま読み込まれる
+	USceneComponent* OldRoot = FindObjectFast<USceneComponent>(Gimmick, TEXT("Root"));
+	if (!OldRoot || OldRoot == NewRoot)
+	{
+		return false;
+	}
+
+	//以前のルートはアクタの位置そのもの、子の相対位置は以前のルートからのもの
+	const FTransform OldRootTransform = OldRoot->GetRelativeTransform();
+	const FTransform NewRootTransform = NewRoot->GetAttachParent() == OldRoot
+		? NewRoot->GetRelativeTransform() * OldRootTransform
+		: OldRootTransform;
+
+	TArray<USceneComponent*> Children;
+	ForEachObjectWithOuter(Gimmick, [OldRoot, NewRoot, &Children](UObject* Object)
+	{
+		USceneComponent* Component = Cast<USceneComponent>(Object);
+		if (Component && Component != NewRoot && Component->GetAttachParent() == OldRoot)
+		{
+			Children.Add(Component);
+		}
+	}, false);
+
+	NewRoot->SetupAttachment(nullptr);
+	NewRoot->SetRelativeTransform_Direct(NewRootTransform);
+	for (USceneComponent* Child : Children)
+	{
+		Child->SetupAttachment(NewRoot, Child->GetAttachSocketName());
+		Child->SetRelativeTransform_Direct((Child->GetRelativeTransform() * OldRootTransform).GetRelativeTransform(NewRootTransform));
+	}
+	Gimmick->SetRootComponent(NewRoot);
+
+	//以前のルートは保存し直すときに書き出さない
+	Gimmick->RemoveOwnedComponent(OldRoot);
+	OldRoot->Rename(nullptr, GetTransientPackage(), REN_DontCreateRedirectors | REN_DoNotDirty | REN_NonTransactional);
+	OldRoot->MarkAsGarbage();
+	return true;
+}
@@ -0,0 +1,101 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/LowLevelMemTracker.h"
+#include "GimmickTypes.generated.h"
+
+//ギミック関連の統計（stat Gimmick）
+DECLARE_STATS_GROUP(TEXT("Gimmick"), STATGROUP_Gimmick, STATCAT_Advanced);
+
+//Low Level Memory Tracker のタグ（-llm で起動し、stat LLMFULL / memreport で確認する）
+//Gimmick = ギミックのアクタとコンポーネント、Gimmick/〜 = 各サブシステムの内部データ
+LLM_DECLARE_TAG_API(Gimmick, SOTUGYOUSEISAKU_API);
+LLM_DECLARE_TAG_API(Gimmick_Registry, SOTUGYOUSEISAKU_API);
+LLM_DECLARE_TAG_API(Gimmick_Timers, SOTUGYOUSEISAKU_API);
+LLM_DECLARE_TAG_API(Gimmick_Scheduler, SOTUGYOUSEISAKU_API);
+LLM_DECLARE_TAG_API(Gimmick_Sequences, SOTUGYOUSEISAKU_API);
+LLM_DECLARE_TAG_API(Gimmick_Events, SOTUGYOUSEISAKU_API);
+LLM_DECLARE_TAG_API(Gimmick_Instances, SOTUGYOUSEISAKU_API);
+LLM_DECLARE_TAG_API(Gimmick_Recorder, SOTUGYOUSEISAKU_API);
+LLM_DECLARE_TAG_API(Gimmick_Save, SOTUGYOUSEISAKU_API);
+
+//ギミックの種類
+UENUM(BlueprintType)
+enum class EGimmickType : uint8
+{
+	MoveFloor UMETA(DisplayName = "動く床"),
+	FallFloor UMETA(DisplayName = "落ちる床"),
+	Button UMETA(DisplayName = "ボタン"),
+	ButtonManager UMETA(DisplayName = "ボタンマネージャー"),
+	PushBlock UMETA(DisplayName = "押せるブロック"),
+	Other UMETA(DisplayName = "その他（ドアなど）"),
+
+	Count UMETA(Hidden)
+};
+
+//ギミックの状態遷移イベントの種類（記録ファイルに保存するので値は変えないこと、追加は末尾に）
+UENUM(BlueprintType)
+enum class EGimmickEventType : uint8
+{
+	MoveFloorDeparted = 0,	//動く床が移動を開始した
+	MoveFloorArrived,		//動く床が端に到着した
+	FallFloorTriggered,		//落ちる床が踏まれて揺れ始めた
+	FallFloorFallen,		//落ちる床が削除された
+	FallFloorRespawned,		//落ちる床が再生成された
+	ButtonPressed,			//ボタンが押された
+	ButtonReleased,			//ボタンが離された
+	SequenceAdvanced,		//正しい順番でボタンが押された
+	SequenceCompleted,		//すべてのボタンを正しい順番で押した
+	SequenceFailed,			//間違ったボタンが押された
+	BlockPushStarted,		//ブロックを押し始めた
+	BlockPushStopped,		//ブロックを押すのをやめた
+	DoorArrived,			//ボタン・ボタンマネージャーが動かすドアが目標位置に着いた
+
+	Count UMETA(Hidden)
+};
+
+//記録する入力の種類（記録ファイルに保存するので値は変えないこと）
+enum class EGimmickReplayInput : uint8
+{
+	Move = 0,
+	Look,
+	Jump,
+	Push,
+
+	Count
+};
+
+namespace GimmickIds
+{
+	/// @brief 起動ごとに変わらないギミックのIDを求める
+	///        レベルのパッケージ名とアクタ名から計算するので、エディタで配置したアクタなら毎回同じ値になる
+	///        作り直したギミック（再生成した落ちる床など）は元のギミックのIDを引き継ぐ
+	SOTUGYOUSEISAKU_API uint64 GetStableId(const AActor* Gimmick);
+}
+
+namespace GimmickCosmetics
+{
+	/// @brief 見た目だけの処理（床の揺れ・ボタンの沈み込み・共有インスタンス描画・演出）を行うか
+	///        専用サーバーと描画できないプロセス（-nullrhi など）では行わない
+	///        （Gimmick.ServerProfile、0 = 常に行う、1 = 自動）
+	/// @param WorldContext 判定するワールドのオブジェクト
+	SOTUGYOUSEISAKU_API bool ShouldRun(const UObject* WorldContext);
+
+	/// @brief 見た目の処理を行わないプロセスで、見た目だけのコンポーネント（コリジョンなし・子なし・ルート以外）を取り除く
+	/// @param Component 対象のコンポーネント
+	/// @return 取り除いたか（true なら呼び出し側はポインタを捨てる）
+	SOTUGYOUSEISAKU_API bool StripVisualComponent(UPrimitiveComponent* Component);
+}
+
+namespace GimmickMigration
+{
+	/// @brief 以前の版にあったルート（"Root" という名前の USceneComponent）を取り除き、その位置・回転・大きさを新しいルートに移す
+	///        動く床・落ちる床・ボタンはメッシュをルートにしたので、それより前に配置したアクタは位置を以前のルートに保存している
+	///        以前のルートに付いていた子は、見た目の位置が変わらないよう新しいルートからの相対に直して付け替える
+	/// @param Gimmick 読み込んだアクタ（PostLoad から呼ぶ）
+	/// @param NewRoot 新しいルート
+	/// @return 以前のルートがあって移したか
+	SOTUGYOUSEISAKU_API bool MigrateRemovedRoot(AActor* Gimmick, USceneComponent* NewRoot);
+}
@@ -5,40 +5,46 @@
 #include "Components/StaticMeshComponent.h"
 #include "Gimmick_ButtonManager.h"
 #include "Gimmick_PushBlock.h"
+#include "GimmickEvents.h"
+#include "GimmickSubsystem.h"
+#include "GimmickSchedulerSubsystem.h"
+#include "GimmickTypes.h"
 
 // Sets default values
 
 /// @brief コンストラクタ　ボタンの各種設定
 AGimmick_Button::AGimmick_Button()
 {
- 	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
+	LLM_SCOPE_BYTAG(Gimmick);
+
+	//ドアの移動は遅らせるとプレイヤーの通り道が変わるので、スケジューラに任せず毎フレームTickで行う
 	PrimaryActorTick.bCanEverTick = true;
 
-	//ルートコンポーネント作成
-	mRoot = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
-	RootComponent = mRoot;
+	//サーバーから複製する（押された・離されたときだけ起こす）
+	bReplicates = true;
+	NetDormancy = DORM_Initial;
+
+	//ボタンの土台のメッシュ（ルートにする）
+	mMesh2 = CreateDefaultSubobject<UStaticMeshComponent>(TEXT("ButtonBaseMesh"));
+	mMesh2->SetMobility(EComponentMobility::Movable);
+	RootComponent = mMesh2;
 
-	//ボタンのメッシュ
+	//ボタンのメッシュ（押されると沈む）
 	mMesh = CreateDefaultSubobject<UStaticMeshComponent>(TEXT("ButtonMesh"));
 	mMesh->SetupAttachment(RootComponent);
-	mMesh2 = CreateDefaultSubobject<UStaticMeshComponent>(TEXT("ButtonBaseMesh"));
-	mMesh2->SetupAttachment(RootComponent);
 
 	//トリガーボックス（ボタンの判定エリア）
 	mTriggerBox = CreateDefaultSubobject<UBoxComponent>(TEXT("TriggerBox"));
 	mTriggerBox->SetupAttachment(RootComponent);
 	mTriggerBox->SetBoxExtent(FVector(60.0f, 60.0f, 25.0f));//サイズ調整可能
 	mTriggerBox->SetCollisionResponseToAllChannels(ECR_Overlap);
-
-	//デフォルト設定
-	mMoveDir = FVector(400.0f, 0.0f, 0.0f);
-	mMoveSpeed = 300.0f;
-	bReturnToOriginal = true;
 }
 
 // Called when the game starts or when spawned
 void AGimmick_Button::BeginPlay()
 {
+	LLM_SCOPE_BYTAG(Gimmick);
+
 	Super::BeginPlay();
 
 	//オーバーラップイベントをバインド
@@ -49,8 +55,54 @@ void AGimmick_Button::BeginPlay()
 	if (mTargetDoor)
 	{
 		mBlockOriginalPosition = mTargetDoor->GetActorLocation();
-		mBlockTargetPosition = mBlockOriginalPosition + mMoveDir;	
+		mBlockTargetPosition = mBlockOriginalPosition + GetSettings().MoveDir;	
+	}
+
+	//ボタンのメッシュの元の位置を保存
+	mMeshRestLocation = mMesh->GetRelativeLocation();
+
+	//専用サーバーなどでは、コリジョンのないボタンのメッシュは見た目だけなので取り除く
+	if (GimmickCosmetics::StripVisualComponent(mMesh))
+	{
+		mMesh = nullptr;
+	}
+
+	//同じメッシュのギミックとまとめて描画する
+	if (bUseInstancedRendering && UGimmickInstanceSubsystem::IsEnabled())
+	{
+		if (UGimmickInstanceSubsystem* Instances = GetWorld()->GetSubsystem<UGimmickInstanceSubsystem>())
+		{
+			if (mMesh)
+			{
+				mMeshInstance = Instances->AddInstance(mMesh);
+			}
+			mBaseMeshInstance = Instances->AddInstance(mMesh2);
+		}
+	}
+
+	//ギミック登録簿に登録（保存されていた状態があればここで復元される）
+	if (UGimmickSubsystem* Gimmicks = GetWorld()->GetSubsystem<UGimmickSubsystem>())
+	{
+		Gimmicks->RegisterGimmick(this);
+	}
+}
+
+void AGimmick_Button::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	//共有インスタンスを解放
+	if (UGimmickInstanceSubsystem* Instances = GetWorld()->GetSubsystem<UGimmickInstanceSubsystem>())
+	{
+		Instances->RemoveInstance(mMeshInstance);
+		Instances->RemoveInstance(mBaseMeshInstance);
 	}
+
+	//ギミック登録簿から削除（ストリーミングで外れる場合は状態を保存）
+	if (UGimmickSubsystem* Gimmicks = GetWorld()->GetSubsystem<UGimmickSubsystem>())
+	{
+		Gimmicks->UnregisterGimmick(this, EndPlayReason);
+	}
+
+	Super::EndPlay(EndPlayReason);
 }
 
 // Called every frame
@@ -65,6 +117,29 @@ void AGimmick_Button::Tick(float DeltaTime)
 	}
 }
 
+/// @brief 実行時状態を保存・復元する関数
+///        押されているかはオーバーラップから決まるので、ドアの位置だけを保存する
+/// @param Ar 読み書きするアーカイブ
+void AGimmick_Button::SerializeGimmickState(FArchive& Ar)
+{
+	FVector3f DoorLocation(mTargetDoor ? mTargetDoor->GetActorLocation() : FVector::ZeroVector);
+
+	Ar << DoorLocation;
+
+	if (Ar.IsLoading() && mTargetDoor)
+	{
+		mTargetDoor->SetActorLocation(FVector(DoorLocation));
+	}
+}
+
+/// @brief 止まっていた時間分だけドアを動かす関数
+/// @param Seconds 進める時間（秒）
+void AGimmick_Button::AdvanceGimmickState(float Seconds)
+{
+	//ドアは一定速度で動くので、まとめた時間で1回動かせば同じ位置になる
+	MoveBlock(Seconds);
+}
+
 /// @brief プレイヤーがボタンを踏んだかをチェックする
 /// @param OverlappedComponent イベントを発生させた自身のコリジョン
 /// @param OtherActor トリガー範囲に入ったアクタ
@@ -84,13 +159,10 @@ void AGimmick_Button::OnTriggerBeginOverlap(UPrimitiveComponent* OverlappedCompo
 		{
 			bIsPressed = true;
 
+			GimmickEvents::Emit(EGimmickEventType::ButtonPressed, this);
+
 			//ボタンのメッシュを少し下げる
-			if (mMesh)
-			{
-				FVector NewLocation = mMesh->GetRelativeLocation();
-				NewLocation.Z -= 10.0f;//5cm下げる
-				mMesh->SetRelativeLocation(NewLocation);
-			}
+			ApplyPressOffset();
 
 			//ボタンマネージャーに通知（複数ボタンシステム）
 			if (mButtonManager)
@@ -120,13 +192,10 @@ void AGimmick_Button::OnTriggerEndOverlap(UPrimitiveComponent* OverlappedCompone
 			mOverlappingActorCount = 0;
 			bIsPressed = false;
 
+			GimmickEvents::Emit(EGimmickEventType::ButtonReleased, this);
+
 			//ボタンのメッシュを元に戻す
-			if (mMesh)
-			{
-				FVector NewLocation = mMesh->GetRelativeLocation();
-				NewLocation.Z += 10.0f; //元に戻す
-				mMesh->SetRelativeLocation(NewLocation);
-			}
+			ApplyPressOffset();
 
 			//ボタンマネージャーに通知
 			if (mButtonManager)
@@ -137,6 +206,36 @@ void AGimmick_Button::OnTriggerEndOverlap(UPrimitiveComponent* OverlappedCompone
 	}
 }
 
+/// @brief 押されているかに合わせてボタンのメッシュを沈める・戻す
+///        見た目だけなので低優先度で後回しにする（実行時の状態を見るので、何回呼ばれても結果は同じ）
+void AGimmick_Button::ApplyPressOffset()
+{
+	//専用サーバーなどでは沈み込みを反映しない
+	if (!mMesh || !GimmickCosmetics::ShouldRun(this))
+	{
+		return;
+	}
+
+	auto Apply = [this]()
+	{
+		if (mMesh)
+		{
+			FVector NewLocation = mMeshRestLocation;
+			NewLocation.Z -= bIsPressed ? 10.0f : 0.0f;//押されている間は10cm下げる
+			mMesh->SetRelativeLocation(NewLocation);
+		}
+	};
+
+	if (UGimmickSchedulerSubsystem* Scheduler = GetWorld()->GetSubsystem<UGimmickSchedulerSubsystem>())
+	{
+		Scheduler->EnqueueOnce(this, EGimmickTaskPriority::Low, Apply);
+	}
+	else
+	{
+		Apply();
+	}
+}
+
 /// @brief ブロックを動かす
 /// @param DeltaTime 移動する時間
 void AGimmick_Button::MoveBlock(float DeltaTime)
@@ -156,7 +255,7 @@ void AGimmick_Button::MoveBlock(float DeltaTime)
 	else
 	{
 		//押されていない → 元の位置へ（設定による）
-		if (bReturnToOriginal)
+		if (GetSettings().bReturnToOriginal)
 		{
 			TargetPosition = mBlockOriginalPosition;
 		}
@@ -172,24 +271,53 @@ void AGimmick_Button::MoveBlock(float DeltaTime)
 		CurrentPosition,
 		TargetPosition,
 		DeltaTime,
-		mMoveSpeed
+		GetSettings().MoveSpeed
 	);
 
-	mTargetDoor->SetActorLocation(NewPosition);
+	//止まっているドアは更新しない
+	if (!NewPosition.Equals(CurrentPosition))
+	{
+		mTargetDoor->SetActorLocation(NewPosition);
+	}
 
-	//デバッグ：目標位置に到達したらログ出力
-	if (FVector::Dist(NewPosition, TargetPosition) < 1.0f)
+	//目標位置に着いた瞬間に通知する（手順の待ちなどに使う）
+	const bool bArrived = FVector::Dist(NewPosition, TargetPosition) < 1.0f;
+	if (bArrived && !bDoorArrived)
 	{
-		static bool bReachedTarget = false;
-		if (!bReachedTarget)
-		{
-			UE_LOG(LogTemp, Log, TEXT("Block reached target position"));
-			bReachedTarget = true;
-		}
+		GimmickEvents::Emit(EGimmickEventType::DoorArrived, this);
 	}
-	else
+	bDoorArrived = bArrived;
+}
+
+#if WITH_EDITORONLY_DATA
+/// @brief 読み込み時に、以前のルートの位置をメッシュに、ボタンごとに保存していた以前の設定を個別の上書きに移す
+void AGimmick_Button::PostLoad()
+{
+	Super::PostLoad();
+
+	//以前の版で別に持っていたルートに保存されている位置を、ルートにしたメッシュに移す
+	GimmickMigration::MigrateRemovedRoot(this, mMesh2);
+
+	//アーキタイプ（ブループリントのクラスの既定値など）と違う値だけがこのアクタに保存されているので、アーキタイプの値と比べる
+	//（クラスの既定値と比べると、アーキタイプで変えた値をクラスの既定値に戻したアクタを移せない）
+	//移した後も値は戻さない（アーキタイプから値を引き継いだアクタは同じ値になり、二重に移さない）
+	const AGimmick_Button* Archetype = Cast<AGimmick_Button>(GetArchetype());
+	if (!Archetype)
+	{
+		Archetype = GetDefault<AGimmick_Button>();
+	}
+	auto Overrides = [this]() { return UGimmickConfigOverrides::FindOrAdd(this, mOverrides); };
+	if (mMoveDir_DEPRECATED != Archetype->mMoveDir_DEPRECATED)
+	{
+		Overrides()->Set(EGimmickConfigParam::DoorMoveDir, mMoveDir_DEPRECATED);
+	}
+	if (mMoveSpeed_DEPRECATED != Archetype->mMoveSpeed_DEPRECATED)
+	{
+		Overrides()->Set(EGimmickConfigParam::DoorMoveSpeed, mMoveSpeed_DEPRECATED);
+	}
+	if (bReturnToOriginal_DEPRECATED != Archetype->bReturnToOriginal_DEPRECATED)
 	{
-		static bool bReachedTarget = true;
-		bReachedTarget = false;
+		Overrides()->Set(EGimmickConfigParam::ReturnToOriginal, bReturnToOriginal_DEPRECATED ? 1.0f : 0.0f);
 	}
 }
+#endif
@@ -6,18 +6,18 @@
 #include "GameFramework/Actor.h"
 #include "Gimmick_PushBlock.h"
 #include "Components/BoxComponent.h"
+#include "GimmickStateInterface.h"
+#include "GimmickInstanceSubsystem.h"
+#include "GimmickConfig.h"
 #include "Gimmick_Button.generated.h"
 
 class AGimmick_ButtonManager;
 
 UCLASS()
-class SOTUGYOUSEISAKU_API AGimmick_Button : public AActor
+class SOTUGYOUSEISAKU_API AGimmick_Button : public AActor, public IGimmickStateInterface
 {
 	GENERATED_BODY()
 
-	UPROPERTY(VisibleAnywhere)
-	TObjectPtr<USceneComponent> mRoot;
-
 	UPROPERTY(VisibleAnywhere)
 	TObjectPtr<UStaticMeshComponent> mMesh;
 
@@ -40,6 +40,7 @@ public:
 protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 	
 
@@ -47,6 +48,11 @@ public:
 	// Called every frame
 	virtual void Tick(float DeltaTime) override;
 
+	//IGimmickStateInterface
+	virtual EGimmickType GetGimmickType() const override { return EGimmickType::Button; }
+	virtual void SerializeGimmickState(FArchive& Ar) override;
+	virtual void AdvanceGimmickState(float Seconds) override;
+
 	//オーバーラップイベント
 	UFUNCTION()
 	void OnTriggerBeginOverlap(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor,
@@ -59,38 +65,69 @@ public:
 	//マネージャーを設定（マネージャーから呼ばれる）
 	void SetButtonManager(AGimmick_ButtonManager* Manager) { mButtonManager = Manager; }
 
+	//動かすドアを設定（BeginPlay前にコードから配置する場合に使用）
+	void SetTargetDoor(AActor* TargetDoor) { mTargetDoor = TargetDoor; }
+
 	//ボタンが押されているか取得
 	bool IsPressed() const { return bIsPressed; }
 
 	//ブロックを移動させる
 	void MoveBlock(float DeltaTime);
 
-	//ブロックの移動方向（ローカル座標）
-	UPROPERTY(EditAnywhere, Category = "Button Settings")
-	FVector mMoveDir = FVector(0.0f, 200.0f, 0.0f); // デフォルトはY軸方向に200cm
+	//押されているかに合わせてボタンのメッシュを沈める・戻す
+	void ApplyPressOffset();
 
-	//移動速度（cm/秒）
+	//共有設定（ドアの動かし方が同じボタンで1つのアセットを参照する、未設定ならクラスの既定値）
 	UPROPERTY(EditAnywhere, Category = "Button Settings")
-	float mMoveSpeed = 200.0f;
+	TObjectPtr<UGimmickButtonConfig> mConfig;
 
-	//ボタンを離したら元に戻すか
-	UPROPERTY(EditAnywhere, Category = "Button Settings")
-	bool bReturnToOriginal = true;
+	//このボタンだけの上書き（上書きするボタンだけが持つ）
+	UPROPERTY(EditAnywhere, Instanced, Category = "Button Settings")
+	TObjectPtr<UGimmickConfigOverrides> mOverrides;
+
+	//実際に使う設定（共有設定に上書きを適用したもの）
+	const FButtonSettings& GetSettings() const { return GimmickConfig::Resolve(mConfig.Get(), mOverrides.Get()); }
 
 	//ボタンが押されているか
 	UPROPERTY(VisibleAnywhere, Category = "Button State")
 	bool bIsPressed = false;
 
+	//同じメッシュのギミックと共有インスタンスでまとめて描画するか
+	UPROPERTY(EditAnywhere, Category = "Rendering")
+	bool bUseInstancedRendering = true;
+
+	//共有インスタンスのハンドル（ボタン・土台）
+	FGimmickInstanceHandle mMeshInstance;
+	FGimmickInstanceHandle mBaseMeshInstance;
+
 	//ブロックの初期位置
 	FVector mBlockOriginalPosition;
 
 	//ブロックの目標位置
 	FVector mBlockTargetPosition;
 
+	//ドアが目標位置に着いているか（着いた瞬間に DoorArrived を通知する）
+	bool bDoorArrived = true;
+
+	//ボタンのメッシュの押されていないときの位置（相対）
+	FVector mMeshRestLocation;
+
 	//現在ボタンに乗っているアクターの数
 	int32 mOverlappingActorCount = 0;
 
 	//ボタンマネージャー（複数ボタンシステム用）
 	UPROPERTY()
 	AGimmick_ButtonManager* mButtonManager = nullptr;
+
+#if WITH_EDITORONLY_DATA
+	//読み込み時に以前のルートの位置をメッシュへ移し、共有設定を参照する前にボタンごとに保存していた設定を上書きへ移す
+	virtual void PostLoad() override;
+
+	UPROPERTY()
+	FVector mMoveDir_DEPRECATED = FVector(400.0f, 0.0f, 0.0f);
+	UPROPERTY()
+	float mMoveSpeed_DEPRECATED = 300.0f;
+	UPROPERTY()
+	bool bReturnToOriginal_DEPRECATED = true;
+#endif
 };
@@ -2,12 +2,22 @@
 
 #include "Gimmick_ButtonManager.h"
 #include "Gimmick_Button.h"
+#include "GimmickEvents.h"
+#include "GimmickSubsystem.h"
+#include "GimmickMath.h"
 
 /// @brief コンストラクタ　ボタンマネージャーの各種設定
 AGimmick_ButtonManager::AGimmick_ButtonManager()
 {
+	LLM_SCOPE_BYTAG(Gimmick);
+
+	//ドアの移動は遅らせるとプレイヤーの通り道が変わるので、スケジューラに任せず毎フレームTickで行う
 	PrimaryActorTick.bCanEverTick = true;
 
+	//サーバーから複製する（手順が進んだときだけ起こす）
+	bReplicates = true;
+	NetDormancy = DORM_Initial;
+
 	mDoorMoveOffset = FVector(400.0f, 0.0f, 0.0f);
 	mDoorMoveSpeed = 200.0f;
 	bResetOnFailure = true;
@@ -16,6 +26,8 @@ AGimmick_ButtonManager::AGimmick_ButtonManager()
 
 void AGimmick_ButtonManager::BeginPlay()
 {
+	LLM_SCOPE_BYTAG(Gimmick);
+
 	Super::BeginPlay();
 
 	//ドアの初期位置を保存
@@ -33,6 +45,23 @@ void AGimmick_ButtonManager::BeginPlay()
 			mButtonSequence[i]->SetButtonManager(this);
 		}
 	}
+
+	//ギミック登録簿に登録（保存されていた状態があればここで復元される）
+	if (UGimmickSubsystem* Gimmicks = GetWorld()->GetSubsystem<UGimmickSubsystem>())
+	{
+		Gimmicks->RegisterGimmick(this);
+	}
+}
+
+void AGimmick_ButtonManager::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	//ギミック登録簿から削除（ストリーミングで外れる場合は状態を保存）
+	if (UGimmickSubsystem* Gimmicks = GetWorld()->GetSubsystem<UGimmickSubsystem>())
+	{
+		Gimmicks->UnregisterGimmick(this, EndPlayReason);
+	}
+
+	Super::EndPlay(EndPlayReason);
 }
 
 void AGimmick_ButtonManager::Tick(float DeltaTime)
@@ -46,34 +75,98 @@ void AGimmick_ButtonManager::Tick(float DeltaTime)
 	}
 }
 
+/// @brief 実行時状態を保存・復元する関数
+/// @param Ar 読み書きするアーカイブ
+void AGimmick_ButtonManager::SerializeGimmickState(FArchive& Ar)
+{
+	uint16 CurrentStep = static_cast<uint16>(mCurrentStep);
+	uint8 Flags = (bSequenceCompleted ? 1 : 0) | (bDoorOpen ? 2 : 0);
+	FVector3f DoorLocation(mTargetDoor ? mTargetDoor->GetActorLocation() : FVector::ZeroVector);
+
+	Ar << CurrentStep << Flags << DoorLocation;
+
+	if (Ar.IsLoading())
+	{
+		mCurrentStep = FMath::Min<int32>(CurrentStep, mButtonSequence.Num());
+		bSequenceCompleted = (Flags & 1) != 0;
+		bDoorOpen = (Flags & 2) != 0;
+		if (mTargetDoor)
+		{
+			mTargetDoor->SetActorLocation(FVector(DoorLocation));
+		}
+	}
+}
+
+/// @brief メモリ使用量にボタンの配列の分を加える
+/// @param CumulativeResourceSize 加算先
+void AGimmick_ButtonManager::GetResourceSizeEx(FResourceSizeEx& CumulativeResourceSize)
+{
+	Super::GetResourceSizeEx(CumulativeResourceSize);
+
+	CumulativeResourceSize.AddDedicatedSystemMemoryBytes(mButtonSequence.GetAllocatedSize());
+}
+
+/// @brief 止まっていた時間分だけドアを動かす関数
+/// @param Seconds 進める時間（秒）
+void AGimmick_ButtonManager::AdvanceGimmickState(float Seconds)
+{
+	//ドアは一定速度で動くので、まとめた時間で1回動かせば同じ位置になる
+	if (mTargetDoor)
+	{
+		MoveDoor(Seconds);
+	}
+}
+
+/// @brief ボタンの順番と制御するドアを設定する関数
+/// @param ButtonSequence 押す順番に並べたボタンアクタ
+/// @param TargetDoor 開閉させるドアアクタ
+void AGimmick_ButtonManager::SetupSequence(const TArray<AGimmick_Button*>& ButtonSequence, AActor* TargetDoor)
+{
+	mButtonSequence = ButtonSequence;
+	mTargetDoor = TargetDoor;
+}
+
+/// @brief ドアの移動量と速度を設定する関数
+/// @param MoveOffset ドアの移動量
+/// @param MoveSpeed ドアの移動速度
+void AGimmick_ButtonManager::SetDoorMovement(const FVector& MoveOffset, float MoveSpeed)
+{
+	mDoorMoveOffset = MoveOffset;
+	mDoorMoveSpeed = MoveSpeed;
+}
+
 /// @brief ボタンが押されたかどうかチェックする関数
 /// @param PressedButton //押されたボタンアクタ
 void AGimmick_ButtonManager::OnButtonPressed(AGimmick_Button* PressedButton)
 {
-	//すでにクリア済みの場合は何もしない
-	if (bSequenceCompleted && !bResetAfterSuccess)
-	{
-		return;
-	}
+	//押されたボタンが次に押すべきボタンか確認（すでにクリア済みの場合は何もしない）
+	GimmickMath::FSequenceState State{ mCurrentStep, bSequenceCompleted };
+	const GimmickMath::ESequenceResult Result = GimmickMath::PressSequenceButton(State, mButtonSequence.GetData(), mButtonSequence.Num(), PressedButton, bResetAfterSuccess);
+	mCurrentStep = State.Step;
 
-	//押されたボタンが次に押すべきボタンか確認
-	if (mCurrentStep < mButtonSequence.Num() && mButtonSequence[mCurrentStep] == PressedButton)
+	switch (Result)
 	{
+	case GimmickMath::ESequenceResult::Advanced:
+	case GimmickMath::ESequenceResult::Completed:
 		//正解
-		mCurrentStep++;
-
 		UE_LOG(LogTemp, Error, TEXT("Success!!!"));
 
+		GimmickEvents::Emit(EGimmickEventType::SequenceAdvanced, this);
+
 		//すべてのボタンを正しい順番で押した
-		if (mCurrentStep >= mButtonSequence.Num())
+		if (Result == GimmickMath::ESequenceResult::Completed)
 		{
 			OnSequenceSuccess();
 		}
-	}
-	else
-	{
+		break;
+
+	case GimmickMath::ESequenceResult::Failed:
 		//間違ったボタンが押された
 		OnSequenceFailure(PressedButton);
+		break;
+
+	default:
+		break;
 	}
 }
 
@@ -90,8 +183,9 @@ void AGimmick_ButtonManager::OnSequenceSuccess()
 {
 	bSequenceCompleted = true;
 	bDoorOpen = true;
-	// ビジュアルフィードバック（オプション）
-	// 例: パーティクルエフェクト、サウンド再生など
+
+	//パーティクルエフェクトやサウンド再生などの演出は、イベントバス経由で UGimmickFeedbackSubsystem::OnGimmickFeedback が受け取る
+	GimmickEvents::Emit(EGimmickEventType::SequenceCompleted, this);
 }
 
 /// @brief ボタンの押す順番を間違えた事を通知する関数
@@ -100,6 +194,8 @@ void AGimmick_ButtonManager::OnSequenceFailure(AGimmick_Button* WrongButton)
 {
 	int32 ExpectedIndex = mCurrentStep;
 	int32 ActualIndex = mButtonSequence.Find(WrongButton);
+
+	GimmickEvents::Emit(EGimmickEventType::SequenceFailed, this);
 }
 
 /// @brief ボタンを離した後リセットする関数
@@ -134,5 +230,17 @@ void AGimmick_ButtonManager::MoveDoor(float DeltaTime)
 		mDoorMoveSpeed
 	);
 
-	mTargetDoor->SetActorLocation(NewPosition);
+	//止まっているドアは更新しない
+	if (!NewPosition.Equals(CurrentPosition))
+	{
+		mTargetDoor->SetActorLocation(NewPosition);
+	}
+
+	//目標位置に着いた瞬間に通知する（手順の待ちなどに使う）
+	const bool bArrived = FVector::Dist(NewPosition, TargetPosition) < 1.0f;
+	if (bArrived && !bDoorArrived)
+	{
+		GimmickEvents::Emit(EGimmickEventType::DoorArrived, this);
+	}
+	bDoorArrived = bArrived;
 }
\ No newline at end of file
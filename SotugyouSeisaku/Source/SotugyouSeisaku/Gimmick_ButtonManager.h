@@ -4,12 +4,13 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "GimmickStateInterface.h"
 #include "Gimmick_ButtonManager.generated.h"
 
 class AGimmick_Button;
 
 UCLASS()
-class SOTUGYOUSEISAKU_API AGimmick_ButtonManager : public AActor
+class SOTUGYOUSEISAKU_API AGimmick_ButtonManager : public AActor, public IGimmickStateInterface
 {
 	GENERATED_BODY()
 
@@ -17,8 +18,17 @@ public:
 	AGimmick_ButtonManager();
 	virtual void Tick(float DeltaTime) override;
 
+	//IGimmickStateInterface
+	virtual EGimmickType GetGimmickType() const override { return EGimmickType::ButtonManager; }
+	virtual void SerializeGimmickState(FArchive& Ar) override;
+	virtual void AdvanceGimmickState(float Seconds) override;
+
+	//ボタンの配列の分をメモリ使用量に加える
+	virtual void GetResourceSizeEx(FResourceSizeEx& CumulativeResourceSize) override;
+
 protected:
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 private:
 	//管理するボタンのリスト（順番に押す必要がある）
@@ -54,6 +64,9 @@ private:
 	//ドアが開いているか
 	bool bDoorOpen = false;
 
+	//ドアが目標位置に着いているか（着いた瞬間に DoorArrived を通知する）
+	bool bDoorArrived = true;
+
 	//ドアの初期位置
 	FVector mDoorOriginalPosition;
 
@@ -69,6 +82,18 @@ public:
 	UFUNCTION()
 	void OnButtonReleased(AGimmick_Button* ReleasedButton);
 
+	//ボタンの順番と制御するドアを設定（BeginPlay前にコードから配置する場合に使用）
+	void SetupSequence(const TArray<AGimmick_Button*>& ButtonSequence, AActor* TargetDoor);
+
+	//ドアの移動量と速度を設定（BeginPlay前に呼ぶ）
+	void SetDoorMovement(const FVector& MoveOffset, float MoveSpeed);
+
+	//押す順番に並んだボタンを取得（パズルの検証用）
+	const TArray<AGimmick_Button*>& GetButtonSequence() const { return mButtonSequence; }
+
+	//制御するドアを取得（自動プレイボットの経路作り用）
+	AActor* GetTargetDoor() const { return mTargetDoor; }
+
 private:
 	//シーケンスをリセット
 	void ResetSequence();
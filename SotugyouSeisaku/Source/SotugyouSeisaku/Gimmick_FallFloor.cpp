@@ -3,37 +3,206 @@
 
 #include "Gimmick_FallFloor.h"
 #include "GameFramework/Character.h"
+#include "GimmickEvents.h"
+#include "GimmickSubsystem.h"
+#include "GimmickSchedulerSubsystem.h"
+#include "GimmickTimerSubsystem.h"
+#include "GimmickPreloadSubsystem.h"
+#include "GimmickTypes.h"
+#include "Gimmick_PushBlock.h"
+#include "GimmickMath.h"
+#include "GimmickCollapseSubsystem.h"
+#include "Engine/Level.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+namespace GimmickFallFloor
+{
+	/// @brief 落ちて再生成を待っている床
+	///        削除した床の代わりに、再生成と保存に必要なものを持つ（再生成タイマーと保存用の読み書き処理が共有する）
+	struct FFallenFloor
+	{
+		//落ちた床がいたレベル（再生成する床もここに置き、セルと一緒にアンロードされるようにする）
+		TWeakObjectPtr<ULevel> Level;
+
+		//落ちた床の固定ID（再生成した床が引き継ぐ）
+		uint64 Id = 0;
+
+		TSubclassOf<AGimmick_FallFloor> FloorClass;
+		FTransform SpawnTransform;
+
+		//共有設定はアセットか生成したアクタが持ち続けるので弱参照、上書きは削除した床と一緒に消えるので値を写す
+		TWeakObjectPtr<UGimmickFallFloorConfig> Config;
+		TArray<FGimmickConfigOverride> Overrides;
+
+		FGimmickTimerHandle RespawnTimer;
+
+		UWorld* GetWorld() const
+		{
+			const ULevel* FloorLevel = Level.Get();
+			return FloorLevel ? FloorLevel->OwningWorld.Get() : nullptr;
+		}
+	};
+
+	/// @brief 落ちる床の代わりになる情報を作る
+	/// @param Floor 落ちる床
+	TSharedRef<FFallenFloor> MakeFallenFloor(const AGimmick_FallFloor* Floor)
+	{
+		TSharedRef<FFallenFloor> Fallen = MakeShared<FFallenFloor>();
+		Fallen->Level = Floor->GetLevel();
+		Fallen->Id = GimmickIds::GetStableId(Floor);
+		Fallen->FloorClass = Floor->GetClass();
+		Fallen->SpawnTransform = FTransform(Floor->GetActorRotation(), Floor->mOriginalLocation);
+		Fallen->Config = Floor->mConfig.Get();
+		Fallen->Overrides = Floor->mOverrides ? Floor->mOverrides->mEntries : TArray<FGimmickConfigOverride>();
+		return Fallen;
+	}
+
+	/// @brief 落ちた床を再生成する
+	/// @param Fallen 落ちた床
+	/// @return 再生成した床
+	AGimmick_FallFloor* Respawn(const TSharedRef<FFallenFloor>& Fallen)
+	{
+		UWorld* World = Fallen->GetWorld();
+		if (UGimmickSubsystem* Gimmicks = World ? World->GetSubsystem<UGimmickSubsystem>() : nullptr)
+		{
+			Gimmicks->RemoveAbsentGimmick(Fallen->Id);
+		}
+		return AGimmick_FallFloor::RespawnFloor(Fallen->Level.Get(), Fallen->FloorClass, Fallen->SpawnTransform, Fallen->Config.Get(), Fallen->Overrides, Fallen->Id);
+	}
+
+	void SerializeFallenState(const TSharedRef<FFallenFloor>& Fallen, FArchive& Ar);
+
+	/// @brief 落ちた床の再生成を予約し、再生成まで保存データに含めるよう登録する（予約済みなら掛け直す）
+	///        床がいたセルが再生成より先にアンロードされたら、登録簿が予約を止めて状態を休眠中に移す
+	///        （セルが再ロードされると配置してあった床が登録され、その状態から残り時間で再生成を予約し直す）
+	/// @param Fallen 落ちた床
+	/// @param Seconds 再生成するまでの秒数
+	void ScheduleRespawn(const TSharedRef<FFallenFloor>& Fallen, float Seconds)
+	{
+		UWorld* World = Fallen->GetWorld();
+		UGimmickTimerSubsystem* Timers = World ? World->GetSubsystem<UGimmickTimerSubsystem>() : nullptr;
+		if (!Timers)
+		{
+			return;
+		}
+
+		//床は削除されるので、床がいたレベルを持ち主にしてワールドのタイミングホイールに登録する
+		Timers->ClearTimer(Fallen->RespawnTimer);
+		Fallen->RespawnTimer = Timers->SetTimer(Fallen->Level.Get(), Seconds, [Fallen]()
+		{
+			Fallen->RespawnTimer.Invalidate();
+			Respawn(Fallen);
+		});
+
+		if (UGimmickSubsystem* Gimmicks = World->GetSubsystem<UGimmickSubsystem>())
+		{
+			Gimmicks->AddAbsentGimmick(Fallen->Id, EGimmickType::FallFloor, Fallen->Level.Get(), [Fallen](FArchive& Ar)
+			{
+				SerializeFallenState(Fallen, Ar);
+			},
+			[Fallen]()
+			{
+				if (UGimmickTimerSubsystem* FallenTimers = UWorld::GetSubsystem<UGimmickTimerSubsystem>(Fallen->GetWorld()))
+				{
+					FallenTimers->ClearTimer(Fallen->RespawnTimer);
+				}
+			});
+		}
+	}
+
+	/// @brief 落ちている床の状態を AGimmick_FallFloor::SerializeGimmickState と同じ形式で読み書きする
+	/// @param Fallen 落ちた床
+	/// @param Ar 読み書きするアーカイブ
+	/// @brief 再生成までの残り時間を進める
+	/// @param Fallen 落ちた床
+	/// @param Seconds 進める時間（秒）
+	void AdvanceRespawn(const TSharedRef<FFallenFloor>& Fallen, float Seconds)
+	{
+		const UGimmickTimerSubsystem* Timers = UWorld::GetSubsystem<UGimmickTimerSubsystem>(Fallen->GetWorld());
+		if (Timers && Timers->IsTimerActive(Fallen->RespawnTimer) && Seconds > 0.0f)
+		{
+			ScheduleRespawn(Fallen, FMath::Max(Timers->GetTimerRemaining(Fallen->RespawnTimer) - Seconds, 0.0f));
+		}
+	}
+
+	void SerializeFallenState(const TSharedRef<FFallenFloor>& Fallen, FArchive& Ar)
+	{
+		UWorld* World = Fallen->GetWorld();
+		UGimmickTimerSubsystem* Timers = World ? World->GetSubsystem<UGimmickTimerSubsystem>() : nullptr;
+
+		uint8 bShaking = 0;
+		float ShakeTimer = 0.0f;
+		float DeleteRemaining = 0.0f;
+		uint8 bFallen = Ar.IsLoading() ? 0 : 1;
+		float RespawnRemaining = Timers ? FMath::Max(Timers->GetTimerRemaining(Fallen->RespawnTimer), 0.0f) : 0.0f;
+
+		Ar << bShaking << ShakeTimer << DeleteRemaining;
+		if (!Ar.IsLoading() || !Ar.AtEnd())
+		{
+			Ar << bFallen << RespawnRemaining;
+		}
+
+		if (!Ar.IsLoading())
+		{
+			return;
+		}
+
+		//落ちていたなら残り時間で再生成を掛け直す
+		if (bFallen)
+		{
+			ScheduleRespawn(Fallen, RespawnRemaining);
+			return;
+		}
+
+		//保存したときは立っていた床なので、すぐに再生成して揺れの状態を渡す
+		if (Timers)
+		{
+			Timers->ClearTimer(Fallen->RespawnTimer);
+		}
+		if (AGimmick_FallFloor* Floor = Respawn(Fallen))
+		{
+			TArray<uint8> State;
+			FMemoryWriter Writer(State);
+			Writer << bShaking << ShakeTimer << DeleteRemaining;
+
+			FMemoryReader Reader(State);
+			Floor->SerializeGimmickState(Reader);
+		}
+	}
+}
 
 // Sets default values
 
 /// @brief コンストラクタ　落ちる床の各種設定
 AGimmick_FallFloor::AGimmick_FallFloor()
 {
- 	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
-	PrimaryActorTick.bCanEverTick = true;
+	LLM_SCOPE_BYTAG(Gimmick);
+
+	//揺れはスケジューラで更新するのでTickしない
+	PrimaryActorTick.bCanEverTick = false;
 
-	//ルートコンポーネント作成
-	mRoot = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
-	RootComponent = mRoot;
+	//サーバーから複製する（踏まれた・落ちたときだけ起こす）
+	bReplicates = true;
+	NetDormancy = DORM_Initial;
 
-	//床のメッシュ
+	//床のメッシュ（ルートにする、揺らすのでMovable）
 	mMesh = CreateDefaultSubobject<UStaticMeshComponent>(TEXT("FloorMesh"));
-	mMesh->SetupAttachment(RootComponent);
+	mMesh->SetMobility(EComponentMobility::Movable);
+	RootComponent = mMesh;
 
 	//トリガーボックスの設定
 	mTriggerBox = CreateDefaultSubobject<UBoxComponent>(TEXT("TriggerBox"));
 	mTriggerBox->SetupAttachment(RootComponent);
 	mTriggerBox->SetBoxExtent(FVector(50.0f, 50.0f, 20.0f));
 	mTriggerBox->SetCollisionResponseToAllChannels(ECR_Overlap);
-
-	// デフォルト値を設定
-	mShakeAmplitude = 5.0f;  //揺れの強さ
-	mShakeFrequency = 20.0f; //揺れの速さ
 }
 
 // Called when the game starts or when spawned
 void AGimmick_FallFloor::BeginPlay()
 {
+	LLM_SCOPE_BYTAG(Gimmick);
+
 	Super::BeginPlay();
 
 	//オーバーラップイベントをバインド
@@ -41,23 +210,187 @@ void AGimmick_FallFloor::BeginPlay()
 
 	//床の元の位置を保存
 	mOriginalLocation = GetActorLocation();
+
+	//同じメッシュのギミックとまとめて描画する
+	if (bUseInstancedRendering && UGimmickInstanceSubsystem::IsEnabled())
+	{
+		if (UGimmickInstanceSubsystem* Instances = GetWorld()->GetSubsystem<UGimmickInstanceSubsystem>())
+		{
+			mMeshInstance = Instances->AddInstance(mMesh);
+		}
+	}
+
+	//ギミック登録簿に登録（保存されていた状態があればここで復元される）
+	if (UGimmickSubsystem* Gimmicks = GetWorld()->GetSubsystem<UGimmickSubsystem>())
+	{
+		Gimmicks->RegisterGimmick(this);
+	}
 }
 
-// Called every frame
-void AGimmick_FallFloor::Tick(float DeltaTime)
+void AGimmick_FallFloor::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
-	Super::Tick(DeltaTime);
+	StopShake();
 
-	//揺れている間（警告アニメーション）
-	if (bIsShaking)
+	if (UGimmickTimerSubsystem* Timers = GetWorld()->GetSubsystem<UGimmickTimerSubsystem>())
+	{
+		Timers->ClearTimer(mDeleteTimer);
+	}
+
+	//共有インスタンスを解放
+	if (UGimmickInstanceSubsystem* Instances = GetWorld()->GetSubsystem<UGimmickInstanceSubsystem>())
+	{
+		Instances->RemoveInstance(mMeshInstance);
+	}
+
+	//ギミック登録簿から削除（ストリーミングで外れる場合は状態を保存）
+	if (UGimmickSubsystem* Gimmicks = GetWorld()->GetSubsystem<UGimmickSubsystem>())
+	{
+		Gimmicks->UnregisterGimmick(this, EndPlayReason);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+/// @brief 揺れを開始する関数（揺れの更新をスケジューラに登録する）
+void AGimmick_FallFloor::StartShake()
+{
+	//揺れは見た目だけなので、専用サーバーなどでは揺らさない（床は元の位置のまま）
+	if (!GimmickCosmetics::ShouldRun(this))
+	{
+		return;
+	}
+
+	UGimmickSchedulerSubsystem* Scheduler = GetWorld()->GetSubsystem<UGimmickSchedulerSubsystem>();
+	if (!Scheduler || mShakeTask.IsValid())
+	{
+		return;
+	}
+
+	//プレイヤーの近くでは毎フレーム、遠くでは予算が余ったときに揺らす
+	mShakeTask = Scheduler->RegisterTask(this, EGimmickTaskPriority::Normal, [this](float DeltaTime)
+	{
+		UpdateShake(DeltaTime);
+	}, this);
+}
+
+/// @brief 揺れを停止する関数
+void AGimmick_FallFloor::StopShake()
+{
+	if (UGimmickSchedulerSubsystem* Scheduler = GetWorld()->GetSubsystem<UGimmickSchedulerSubsystem>())
+	{
+		Scheduler->UnregisterTask(mShakeTask);
+	}
+}
+
+/// @brief 床を揺らす関数（警告アニメーション）
+/// @param DeltaTime 前回揺らしてからの経過時間（後回しにされた分も含む）
+void AGimmick_FallFloor::UpdateShake(float DeltaTime)
+{
+	mShakeTimer += DeltaTime;
+
+	//床を揺らす
+	const FFallFloorSettings& Settings = GetSettings();
+	SetActorLocation(mOriginalLocation + GimmickMath::GetShakeOffset(mShakeTimer, Settings.ShakeFrequency, Settings.ShakeAmplitude));
+}
+
+/// @brief 実行時状態を保存・復元する関数
+///        形式: [揺れているか][揺れた時間][落ちるまでの残り][落ちているか][再生成までの残り]
+///        （落ちている床はアクタがないので、後ろの2つは GimmickFallFloor::SerializeFallenState が書く。古い保存データにはない）
+/// @param Ar 読み書きするアーカイブ
+void AGimmick_FallFloor::SerializeGimmickState(FArchive& Ar)
+{
+	UGimmickTimerSubsystem* Timers = GetWorld()->GetSubsystem<UGimmickTimerSubsystem>();
+	uint8 bShaking = bIsShaking ? 1 : 0;
+	float DeleteRemaining = bIsShaking && Timers ? FMath::Max(Timers->GetTimerRemaining(mDeleteTimer), 0.0f) : 0.0f;
+	uint8 bFallen = 0;
+	float RespawnRemaining = 0.0f;
+
+	Ar << bShaking << mShakeTimer << DeleteRemaining;
+	if (!Ar.IsLoading() || !Ar.AtEnd())
+	{
+		Ar << bFallen << RespawnRemaining;
+	}
+
+	if (Ar.IsLoading())
+	{
+		//保存したとき・セルがアンロードされたときは落ちていた床なので、削除して残り時間で再生成を予約する（落ちる演出はしない）
+		//続けて AdvanceGimmickState が呼ばれたら、止まっていた分だけ再生成を早める
+		if (bFallen)
+		{
+			mFallen = GimmickFallFloor::MakeFallenFloor(this);
+			GimmickFallFloor::ScheduleRespawn(mFallen.ToSharedRef(), RespawnRemaining);
+			StopShake();
+			Destroy();
+			return;
+		}
+
+		bIsShaking = bShaking != 0;
+		if (Timers)
+		{
+			Timers->ClearTimer(mDeleteTimer);
+		}
+
+		//揺れている途中なら残り時間で削除タイマーを掛け直す
+		if (bIsShaking)
+		{
+			ScheduleDelete(DeleteRemaining);
+			StartShake();
+		}
+		else
+		{
+			StopShake();
+			SetActorLocation(mOriginalLocation);
+		}
+	}
+}
+
+/// @brief 止まっていた時間分だけ状態を進める関数
+/// @param Seconds 進める時間（秒）
+void AGimmick_FallFloor::AdvanceGimmickState(float Seconds)
+{
+	//落ちていた状態を読み込んで削除した床は、再生成までの残り時間を進める
+	if (mFallen.IsValid())
+	{
+		GimmickFallFloor::AdvanceRespawn(mFallen.ToSharedRef(), Seconds);
+		return;
+	}
+
+	if (!bIsShaking || Seconds <= 0.0f)
+	{
+		return;
+	}
+
+	mShakeTimer += Seconds;
+
+	//止まっている間に落ちているはずなら、次の刻みで落とす
+	const UGimmickTimerSubsystem* Timers = GetWorld()->GetSubsystem<UGimmickTimerSubsystem>();
+	const float DeleteRemaining = Timers ? Timers->GetTimerRemaining(mDeleteTimer) - Seconds : 0.0f;
+	ScheduleDelete(FMath::Max(DeleteRemaining, 0.0f));
+}
+
+/// @brief 時間飛ばしで状態を進める関数
+///        削除と再生成はタイミングホイールが期限の順に呼ぶので、揺れの位相だけ進める
+/// @param Seconds 進める時間（秒）
+void AGimmick_FallFloor::FastForwardGimmickState(float Seconds)
+{
+	if (bIsShaking && Seconds > 0.0f)
 	{
-		mShakeTimer += DeltaTime;
-		FVector ShakeOffset;
-		ShakeOffset.X = FMath::Sin(mShakeTimer * mShakeFrequency) * mShakeAmplitude;
-		ShakeOffset.Y = FMath::Cos(mShakeTimer * mShakeFrequency) * mShakeAmplitude;
+		mShakeTimer += Seconds;
+	}
+}
 
-		//床を揺らす
-		SetActorLocation(mOriginalLocation + ShakeOffset);
+/// @brief 床の削除を予約する関数
+/// @param Seconds 削除するまでの秒数（0 なら次の刻み）
+void AGimmick_FallFloor::ScheduleDelete(float Seconds)
+{
+	if (UGimmickTimerSubsystem* Timers = GetWorld()->GetSubsystem<UGimmickTimerSubsystem>())
+	{
+		Timers->ClearTimer(mDeleteTimer);
+		mDeleteTimer = Timers->SetTimer(this, Seconds, [this]()
+		{
+			mDeleteTimer.Invalidate();
+			DeleteFloor();
+		});
 	}
 }
 
@@ -83,28 +416,109 @@ void AGimmick_FallFloor::OnTriggerBeginOverlap(UPrimitiveComponent* OverlappedCo
 	bIsShaking = true;
 	mShakeTimer = 0.0f;
 
+	GimmickEvents::Emit(EGimmickEventType::FallFloorTriggered, this);
+
+	StartShake();
+
 	//一定時間後に床を削除
-	GetWorldTimerManager().SetTimer(DeleteTimerHandle, this, &AGimmick_FallFloor::DeleteFloor, mDeleteDelay, false);
+	ScheduleDelete(GetSettings().DeleteDelay);
 }
 
-/// @brief 床の削除を開始する。Tickで位置を更新するようになる。
+/// @brief 床を削除する。崩れる様子が設定されていれば破片の再生を始める。
 void AGimmick_FallFloor::DeleteFloor()
 {
-	//一定時間後に再生成
-	GetWorldTimerManager().SetTimer(RespawnTimerHandle, this, &AGimmick_FallFloor::RespawnFloor, mRespawnDelay, false);
+	//一定時間後に再生成（再生成までの残り時間は保存データに含める）
+	GimmickFallFloor::ScheduleRespawn(GimmickFallFloor::MakeFallenFloor(this), GetSettings().RespawnDelay);
+
+	GimmickEvents::Emit(EGimmickEventType::FallFloorFallen, this);
+
+	//上に乗って眠っているブロックを起こす（床と一緒に落ちるように）
+	AGimmick_PushBlock::WakeBlocksOn(this);
+
+	//崩れる様子を焼き込んだ結果から再生する（揺れる前の位置から、物理のシミュレーションはしない）
+	if (UGimmickCollapseSubsystem* Collapses = GetWorld()->GetSubsystem<UGimmickCollapseSubsystem>())
+	{
+		Collapses->Play(GetSettings().CollapseCache, FTransform(GetActorRotation(), mOriginalLocation, GetActorScale3D()), mMesh->GetMaterial(0));
+	}
 
+	StopShake();
 	Destroy();//床を削除 → プレイヤーは落下
 }
 
 /// @brief 床を再生成する関数
-void AGimmick_FallFloor::RespawnFloor()
+/// @param Level 削除した床がいたレベル（同じレベルに置き、セルと一緒にアンロードされるようにする）
+/// @param FloorClass 削除した床のクラス
+/// @param SpawnTransform 削除した床の元の位置・回転
+/// @param Config 削除した床の共有設定
+/// @param Overrides 削除した床の上書き
+/// @param InheritedId 削除した床の固定ID（再生成した床が引き継ぐ、0 なら引き継がない）
+/// @return 再生成した床（生成できなければ nullptr）
+AGimmick_FallFloor* AGimmick_FallFloor::RespawnFloor(ULevel* Level, TSubclassOf<AGimmick_FallFloor> FloorClass, const FTransform& SpawnTransform,
+	UGimmickFallFloorConfig* Config, const TArray<FGimmickConfigOverride>& Overrides, uint64 InheritedId)
 {
-	if (!GetWorld()) return;
+	UWorld* World = Level ? Level->OwningWorld.Get() : nullptr;
+	if (!World) return nullptr;
 
 	FActorSpawnParameters SpawnParams;
+	SpawnParams.OverrideLevel = Level;
 	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;//衝突を無視して再生成
+	SpawnParams.bDeferConstruction = true;
+
+	//元の位置・回転で同じ床クラスを再生成（クラスは削除した床のものでロード済み、ここで読み込みが起きたら数える）
+	GimmickLoading::FSyncLoadScope LoadScope(World, TEXT("AGimmick_FallFloor::RespawnFloor"));
+	AGimmick_FallFloor* NewFloor = World->SpawnActor<AGimmick_FallFloor>(FloorClass, SpawnTransform, SpawnParams);
+	if (NewFloor)
+	{
+		//再生成は各マシンのタイマーで同じように行うので、サーバーから複製しない
+		NewFloor->SetReplicates(false);
 
-	//元の位置・回転で同じ床クラスを再生成
-	GetWorld()->SpawnActor<AGimmick_FallFloor>(GetClass(), mOriginalLocation, GetActorRotation(), SpawnParams);
+		//削除した床と同じ設定・同じIDにする（BeginPlay で登録される前に）
+		NewFloor->mInheritedId = InheritedId;
+		NewFloor->mConfig = Config;
+		if (Overrides.Num() > 0)
+		{
+			UGimmickConfigOverrides::FindOrAdd(NewFloor, NewFloor->mOverrides)->mEntries = Overrides;
+		}
+		NewFloor->FinishSpawning(SpawnTransform);
+	}
+
+	GimmickEvents::Emit(EGimmickEventType::FallFloorRespawned, NewFloor);
+	return NewFloor;
 }
 
+#if WITH_EDITORONLY_DATA
+/// @brief 読み込み時に、以前のルートの位置をメッシュに、床ごとに保存していた以前の設定を個別の上書きに移す
+void AGimmick_FallFloor::PostLoad()
+{
+	Super::PostLoad();
+
+	//以前の版で別に持っていたルートに保存されている位置を、ルートにしたメッシュに移す
+	GimmickMigration::MigrateRemovedRoot(this, mMesh);
+
+	//アーキタイプ（ブループリントのクラスの既定値など）と違う値だけがこのアクタに保存されているので、アーキタイプの値と比べる
+	//（クラスの既定値と比べると、アーキタイプで変えた値をクラスの既定値に戻したアクタを移せない）
+	//移した後も値は戻さない（アーキタイプから値を引き継いだアクタは同じ値になり、二重に移さない）
+	const AGimmick_FallFloor* Archetype = Cast<AGimmick_FallFloor>(GetArchetype());
+	if (!Archetype)
+	{
+		Archetype = GetDefault<AGimmick_FallFloor>();
+	}
+	auto Overrides = [this]() { return UGimmickConfigOverrides::FindOrAdd(this, mOverrides); };
+	if (mRespawnDelay_DEPRECATED != Archetype->mRespawnDelay_DEPRECATED)
+	{
+		Overrides()->Set(EGimmickConfigParam::RespawnDelay, mRespawnDelay_DEPRECATED);
+	}
+	if (mDeleteDelay_DEPRECATED != Archetype->mDeleteDelay_DEPRECATED)
+	{
+		Overrides()->Set(EGimmickConfigParam::DeleteDelay, mDeleteDelay_DEPRECATED);
+	}
+	if (mShakeAmplitude_DEPRECATED != Archetype->mShakeAmplitude_DEPRECATED)
+	{
+		Overrides()->Set(EGimmickConfigParam::ShakeAmplitude, mShakeAmplitude_DEPRECATED);
+	}
+	if (mShakeFrequency_DEPRECATED != Archetype->mShakeFrequency_DEPRECATED)
+	{
+		Overrides()->Set(EGimmickConfigParam::ShakeFrequency, mShakeFrequency_DEPRECATED);
+	}
+}
+#endif
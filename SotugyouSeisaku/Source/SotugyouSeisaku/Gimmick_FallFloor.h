@@ -5,17 +5,23 @@
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
 #include "Components/BoxComponent.h"
-#include "TimerManager.h"
+#include "GimmickTimerSubsystem.h"
+#include "GimmickStateInterface.h"
+#include "GimmickInstanceSubsystem.h"
+#include "GimmickSchedulerSubsystem.h"
+#include "GimmickConfig.h"
 #include "Gimmick_FallFloor.generated.h"
 
+namespace GimmickFallFloor
+{
+	struct FFallenFloor;
+}
+
 UCLASS()
-class SOTUGYOUSEISAKU_API AGimmick_FallFloor : public AActor
+class SOTUGYOUSEISAKU_API AGimmick_FallFloor : public AActor, public IGimmickStateInterface
 {
 	GENERATED_BODY()
 
-	UPROPERTY(VisibleAnywhere)
-	TObjectPtr<USceneComponent> mRoot;
-
 	UPROPERTY(VisibleAnywhere)
 	TObjectPtr<UStaticMeshComponent> mMesh;
 
@@ -30,26 +36,33 @@ public:
 protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 public:	
-	// Called every frame
-	virtual void Tick(float DeltaTime) override;
-
-	//元に戻るまでの時間
+	//IGimmickStateInterface
+	virtual EGimmickType GetGimmickType() const override { return EGimmickType::FallFloor; }
+	virtual void SerializeGimmickState(FArchive& Ar) override;
+	virtual void AdvanceGimmickState(float Seconds) override;
+	virtual void FastForwardGimmickState(float Seconds) override;
+	virtual uint64 GetInheritedGimmickId() const override { return mInheritedId; }
+
+	//共有設定（同じ調整の床で1つのアセットを参照する、未設定ならクラスの既定値）
 	UPROPERTY(EditAnywhere, Category = "Falling Floor")
-	float mRespawnDelay = 0.0f;
+	TObjectPtr<UGimmickFallFloorConfig> mConfig;
 
-	//床削除までの時間
-	UPROPERTY(EditAnywhere, Category = "Falling Floor")
-	float mDeleteDelay = 2.0f;
+	//この床だけの上書き（上書きする床だけが持つ）
+	UPROPERTY(EditAnywhere, Instanced, Category = "Falling Floor")
+	TObjectPtr<UGimmickConfigOverrides> mOverrides;
 
-	//揺れの強さ
-	UPROPERTY(EditAnywhere, Category = "Falling Floor")
-	float mShakeAmplitude = 0.0f;
+	//実際に使う設定（共有設定に上書きを適用したもの）
+	const FFallFloorSettings& GetSettings() const { return GimmickConfig::Resolve(mConfig.Get(), mOverrides.Get()); }
 
-	//揺れの速さ
-	UPROPERTY(EditAnywhere, Category = "Falling Floor")
-	float mShakeFrequency = 0.0f;
+	//同じメッシュのギミックと共有インスタンスでまとめて描画するか
+	UPROPERTY(EditAnywhere, Category = "Rendering")
+	bool bUseInstancedRendering = true;
+
+	//共有インスタンスのハンドル
+	FGimmickInstanceHandle mMeshInstance;
 
 	//床の元の位置
 	FVector mOriginalLocation;
@@ -60,18 +73,50 @@ public:
 	//揺れる時間
 	float mShakeTimer = 0.0f;
 
-	//落下を遅延実行するためのタイマー
-	FTimerHandle DeleteTimerHandle;
-	//床の再生成タイマー
-	FTimerHandle RespawnTimerHandle;
+	//揺れの処理（見た目だけなので予算内で実行する）
+	FGimmickTaskHandle mShakeTask;
+
+	//落下を遅延実行するためのタイマー（ギミックのタイミングホイールに登録する）
+	FGimmickTimerHandle mDeleteTimer;
+
+	//再生成した床なら、落ちた元の床の固定ID（保存データで同じ床として扱う）
+	uint64 mInheritedId = 0;
+
+	//落ちていた状態を読み込んで削除した床の、再生成の予約（続けて呼ばれる AdvanceGimmickState で残り時間を進める）
+	TSharedPtr<GimmickFallFloor::FFallenFloor> mFallen;
 
 	//オーバーラップイベント
 	UFUNCTION()
 	void OnTriggerBeginOverlap(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor,
 		UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult);
 
+	//揺れを開始・停止する関数
+	void StartShake();
+	void StopShake();
+
+	//床を揺らす関数
+	void UpdateShake(float DeltaTime);
+
+	//床の削除を予約する（予約済みなら掛け直す）
+	void ScheduleDelete(float Seconds);
+
 	//一定時間経過後に呼ばれ、床を削除する関数
 	void DeleteFloor();
-	//床が落下した後、一定時間後に元の位置へ戻す処理を行う関数
-	void RespawnFloor();
+	//床が落下した後、元のレベル・元の位置に同じ床を同じ設定で再生成する関数（削除した床ではなくワールドのタイミングホイールから呼ばれる）
+	static AGimmick_FallFloor* RespawnFloor(ULevel* Level, TSubclassOf<AGimmick_FallFloor> FloorClass, const FTransform& SpawnTransform,
+		UGimmickFallFloorConfig* Config, const TArray<FGimmickConfigOverride>& Overrides, uint64 InheritedId = 0);
+
+#if WITH_EDITORONLY_DATA
+	//読み込み時に以前のルートの位置をメッシュへ移し、共有設定を参照する前に床ごとに保存していた設定を上書きへ移す
+	virtual void PostLoad() override;
+
+	UPROPERTY()
+	float mRespawnDelay_DEPRECATED = 0.0f;
+	UPROPERTY()
+	float mDeleteDelay_DEPRECATED = 2.0f;
+	UPROPERTY()
+	float mShakeAmplitude_DEPRECATED = 5.0f;
+	UPROPERTY()
+	float mShakeFrequency_DEPRECATED = 20.0f;
+#endif
 };
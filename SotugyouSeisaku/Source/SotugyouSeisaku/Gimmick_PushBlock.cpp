@@ -6,19 +6,38 @@
 #include "Components/StaticMeshComponent.h"
 #include "SotugyouSeisakuCharacter.h"
 #include "GameFramework/CharacterMovementComponent.h"
+#include "GimmickEvents.h"
+#include "GimmickSubsystem.h"
+#include "GimmickTypes.h"
+#include "GimmickMath.h"
 
 
 // Sets default values
 AGimmick_PushBlock::AGimmick_PushBlock()
 {
- 	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
-	PrimaryActorTick.bCanEverTick = true;
+	LLM_SCOPE_BYTAG(Gimmick);
+
+	//Tickしない（登録簿の位置は押されて動いたときと、止まって眠ったときに更新する）
+	PrimaryActorTick.bCanEverTick = false;
 
 	mMesh = CreateDefaultSubobject<UStaticMeshComponent>(TEXT("mMesh"));
-	RootComponent = mRoot;
+	RootComponent = mMesh;
 
 	mMesh->SetSimulatePhysics(true);
 
+	//止まったことを知らせてもらう（少しの揺れでは起きたままにならないよう、眠る判定を緩める）
+	mMesh->BodyInstance.bGenerateWakeEvents = true;
+	mMesh->BodyInstance.SleepFamily = ESleepFamily::Custom;
+	mMesh->BodyInstance.CustomSleepThresholdMultiplier = 4.0f;
+
+	//眠っている間の衝突で起きられるように、衝突を知らせてもらう
+	mMesh->SetNotifyRigidBodyCollision(true);
+
+	//サーバーから位置を複製する（止まって眠っている間は休止）
+	bReplicates = true;
+	SetReplicatingMovement(true);
+	NetDormancy = DORM_Initial;
+
 	//プレイヤー（Pawn）とは重なるように設定
 	mMesh->SetCollisionResponseToChannel(ECC_Pawn, ECR_Overlap);
 
@@ -32,14 +51,53 @@ AGimmick_PushBlock::AGimmick_PushBlock()
 // Called when the game starts or when spawned
 void AGimmick_PushBlock::BeginPlay()
 {
+	LLM_SCOPE_BYTAG(Gimmick);
+
 	Super::BeginPlay();
-	
+
+	mMesh->OnComponentSleep.AddDynamic(this, &AGimmick_PushBlock::OnBodySleep);
+	mMesh->OnComponentHit.AddDynamic(this, &AGimmick_PushBlock::OnBodyHit);
+
+	//ギミック登録簿に登録（保存されていた状態があればここで復元される）
+	if (UGimmickSubsystem* Gimmicks = GetWorld()->GetSubsystem<UGimmickSubsystem>())
+	{
+		Gimmicks->RegisterGimmick(this);
+	}
+}
+
+void AGimmick_PushBlock::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UGimmickTimerSubsystem* Timers = GetWorld()->GetSubsystem<UGimmickTimerSubsystem>())
+	{
+		Timers->ClearTimer(mSleepTimer);
+	}
+
+	//ギミック登録簿から削除（ストリーミングで外れる場合は状態を保存）
+	if (UGimmickSubsystem* Gimmicks = GetWorld()->GetSubsystem<UGimmickSubsystem>())
+	{
+		Gimmicks->UnregisterGimmick(this, EndPlayReason);
+	}
+
+	Super::EndPlay(EndPlayReason);
 }
 
-// Called every frame
-void AGimmick_PushBlock::Tick(float DeltaTime)
+/// @brief 実行時状態を保存・復元する関数
+/// @param Ar 読み書きするアーカイブ
+void AGimmick_PushBlock::SerializeGimmickState(FArchive& Ar)
 {
-	Super::Tick(DeltaTime);
+	FVector3f Location(GetActorLocation());
+	FQuat4f Rotation(GetActorQuat());
+
+	Ar << Location << Rotation;
+
+	if (Ar.IsLoading())
+	{
+		SetActorLocationAndRotation(FVector(Location), FQuat(Rotation), false, nullptr, ETeleportType::TeleportPhysics);
+
+		//戻した位置で落ち着くまでシミュレーションする
+		Wake();
+		UpdateRegistryLocation();
+	}
 }
 
 /// @brief プレイヤーに押された時に呼ばれる関数
@@ -49,6 +107,12 @@ void AGimmick_PushBlock::StartPushing(ASotugyouSeisakuCharacter* PushingPlayer)
 	//ブロックが押されている状態
 	bIsBeginePushed = true;
 	mPushingPlayer = PushingPlayer;
+
+	//押されている間は眠らせない
+	Wake();
+	WakeNeighbours();
+
+	GimmickEvents::Emit(EGimmickEventType::BlockPushStarted, this);
 }
 
 /// @brief プレイヤーが自分を押すのをやめたときに呼ばれる関数
@@ -56,15 +120,19 @@ void AGimmick_PushBlock::StopPushing()
 {
 	bIsBeginePushed = false;
 	mPushingPlayer = nullptr;
+
+	//押し終わった位置で落ち着いたら、物理エンジンが止めたときに眠らせる
+	UpdateRegistryLocation();
+
+	GimmickEvents::Emit(EGimmickEventType::BlockPushStopped, this);
 }
 
 /// @brief プレイヤーが移動した分だけ自分も同じ方向・量で動かす
 /// @param DeltaMove プレイヤーが１フレームで移動した量
 void AGimmick_PushBlock::MoveWithPlayer(const FVector& DeltaMove)
 {
-	//アクターをワールド座標で移動
-	FHitResult Hit;
-	AddActorWorldOffset(DeltaMove, false, &Hit);
+	//アクターをワールド座標で移動（スイープしないので衝突結果は受け取らない）
+	AddActorWorldOffset(DeltaMove, false);
 }
 
 /// @brief プレイヤーを中心にYaw回転させる
@@ -82,40 +150,195 @@ void AGimmick_PushBlock::RotateAroundPlayer(const FVector& PlayerCenter, float D
 	FVector RotatedPos = RotationQuat.RotateVector(RelativePos);
 
 	//新しいブロック位置 = プレイヤー位置 + 回転後の相対位置
-	SetActorLocation(PlayerCenter + RotatedPos);
+	//ブロック自身の回転もYaw方向に回す（位置と回転を1回の更新で反映する）
+	SetActorLocationAndRotation(PlayerCenter + RotatedPos, GetActorQuat() * RotationQuat);
+}
+
+/// @brief プレイヤーの1フレーム分の移動と回転に追従する
+///        移動してから回転した結果を先に計算し、位置と回転を1回の更新で反映する（子の更新・物理の同期・オーバーラップの更新も1回）
+/// @param DeltaMove プレイヤーが１フレームで移動した量
+/// @param PlayerCenter 移動後のプレイヤーの位置
+/// @param DeltaYaw プレイヤーが１フレームで回転した量（度）
+void AGimmick_PushBlock::FollowPlayer(const FVector& DeltaMove, const FVector& PlayerCenter, float DeltaYaw)
+{
+	const bool bMove = !DeltaMove.IsNearlyZero(0.001f);
+	const bool bRotate = !FMath::IsNearlyZero(DeltaYaw, 0.01f);
+	if (!bMove && !bRotate)
+	{
+		return;
+	}
 
-	//ブロック自身の回転もYaw方向に回す
-	AddActorLocalRotation(FRotator(0.f, DeltaYaw, 0.f));
+	FVector Location = GetActorLocation();
+	FQuat Rotation = GetActorQuat();
+	if (bMove)
+	{
+		Location += DeltaMove;
+	}
+	if (bRotate)
+	{
+		const FQuat RotationQuat(FVector::UpVector, FMath::DegreesToRadians(DeltaYaw));
+		Location = PlayerCenter + RotationQuat.RotateVector(Location - PlayerCenter);
+		Rotation = Rotation * RotationQuat;
+	}
+	SetActorLocationAndRotation(Location, Rotation);
+
+	//動かした先で当たりそうなブロックを先に起こす（眠っているブロックは押し返さないので、すり抜けたり押し出されたりしないように）
+	UpdateRegistryLocation();
+	WakeNeighbours();
 }
 
-bool AGimmick_PushBlock::CanBePushedByPlayer(const FVector& PlayerLocation)const
+/// @brief 物理エンジンがブロックを止めたときに呼ばれる関数
+///        少し待ってから物理シミュレーションを止める（待っている間に動き出したらやめる）
+/// @param SleepingComponent 止まったコンポーネント
+/// @param BoneName ボーン名（使わない）
+void AGimmick_PushBlock::OnBodySleep(UPrimitiveComponent* SleepingComponent, FName BoneName)
 {
-	//ブロックからプレイヤーへの方向ベクトル
-	FVector ToPlayer = PlayerLocation - GetActorLocation();
-	ToPlayer.Z = 0.0f;
+	if (bIsSleeping || bIsBeginePushed)
+	{
+		return;
+	}
+
+	//止まった位置を登録簿に反映する
+	UpdateRegistryLocation();
 
-	if (ToPlayer.IsNearlyZero())
+	//物理の通知の中で物理の状態を変えないよう、眠らせるのはタイマーから行う
+	UGimmickTimerSubsystem* Timers = GetWorld()->GetSubsystem<UGimmickTimerSubsystem>();
+	if (!Timers)
 	{
-		return false;
+		return;
 	}
 
-	ToPlayer.Normalize();
+	Timers->ClearTimer(mSleepTimer);
+	mSleepTimer = Timers->SetTimer(this, mSleepDelay, [this]()
+	{
+		mSleepTimer.Invalidate();
 
-	//ブロックの「押せる面」の法線方向をワールド座標に変換
-	FVector WorldPushDir = GetActorRotation().RotateVector(mPushDir);
-	WorldPushDir.Z = 0.0f;
-	WorldPushDir.Normalize();
+		//待っている間に起きて動いていたらまた止まるまで待つ
+		if (!bIsBeginePushed && !mMesh->RigidBodyIsAwake())
+		{
+			Sleep();
+		}
+	});
+}
 
-	//プレイヤーが押せる面の「反対側」にいる必要がある
-	float DotProduct = FVector::DotProduct(ToPlayer, WorldPushDir);
+/// @brief 眠っている間に何かがぶつかったときに呼ばれる関数
+///        一定以上の強さの衝突なら起きる
+/// @param HitComponent 自分のコンポーネント
+/// @param OtherActor ぶつかったアクター
+/// @param OtherComp ぶつかったコンポーネント
+/// @param NormalImpulse 衝突の力積
+/// @param Hit 衝突の情報
+void AGimmick_PushBlock::OnBodyHit(UPrimitiveComponent* HitComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, FVector NormalImpulse, const FHitResult& Hit)
+{
+	if (bIsSleeping && NormalImpulse.SizeSquared() >= FMath::Square(mWakeImpulse))
+	{
+		Wake();
+	}
+}
+
+/// @brief 物理シミュレーションを止めて眠らせる関数
+///        止めている間は動かない物体として扱われ、ソルバーの計算に入らない
+void AGimmick_PushBlock::Sleep()
+{
+	if (bIsSleeping)
+	{
+		return;
+	}
+
+	bIsSleeping = true;
+	mMesh->SetSimulatePhysics(false);
+	UpdateRegistryLocation();
+
+	//止まった位置を送ったら休止する
+	if (HasAuthority())
+	{
+		SetNetDormancy(DORM_DormantAll);
+	}
+}
+
+/// @brief 物理シミュレーションを再開する関数
+void AGimmick_PushBlock::Wake()
+{
+	if (UGimmickTimerSubsystem* Timers = GetWorld()->GetSubsystem<UGimmickTimerSubsystem>())
+	{
+		Timers->ClearTimer(mSleepTimer);
+	}
+
+	//動いている間は位置を送り続ける（配置されたままの休止中のブロックも押されたら起こす）
+	if (HasAuthority())
+	{
+		SetNetDormancy(DORM_Awake);
+	}
+
+	if (!bIsSleeping)
+	{
+		return;
+	}
+
+	bIsSleeping = false;
+	mMesh->SetSimulatePhysics(true);
+	mMesh->WakeRigidBody();
+}
+
+/// @brief 周りの眠っているブロックを起こす関数
+void AGimmick_PushBlock::WakeNeighbours() const
+{
+	const UGimmickSubsystem* Gimmicks = GetWorld()->GetSubsystem<UGimmickSubsystem>();
+	if (!Gimmicks || mWakeRadius <= 0.0f)
+	{
+		return;
+	}
+
+	Gimmicks->ForEachGimmickInRadius(EGimmickType::PushBlock, GetActorLocation(), mWakeRadius, [this](AActor* Gimmick)
+	{
+		AGimmick_PushBlock* Block = static_cast<AGimmick_PushBlock*>(Gimmick);
+		if (Block != this && Block->IsSleeping())
+		{
+			Block->Wake();
+		}
+	});
+}
+
+/// @brief 支えている床などが動く・消えるときに、その上に乗っているブロックを起こす関数
+/// @param Support 支えているアクター（動く床・落ちる床）
+void AGimmick_PushBlock::WakeBlocksOn(const AActor* Support)
+{
+	const UWorld* World = Support ? Support->GetWorld() : nullptr;
+	const UGimmickSubsystem* Gimmicks = World ? World->GetSubsystem<UGimmickSubsystem>() : nullptr;
+	if (!Gimmicks)
+	{
+		return;
+	}
 
-	//DotProductが負 = プレイヤーは押せる面の反対側にいる
-	//角度を計算
-	float AngleRadians = FMath::Acos(FMath::Clamp(-DotProduct, -1.0f, 1.0f));
-	float AngleDegrees = FMath::RadiansToDegrees(AngleRadians);
+	//床の範囲を上に広げた範囲にブロックの中心があれば乗っているとみなす
+	constexpr float SupportHeight = 300.0f;
+	FBox Bounds = Support->GetComponentsBoundingBox();
+	Bounds.Max.Z += SupportHeight;
 
-	bool bCanPush = AngleDegrees <= mPushAngle;
+	Gimmicks->ForEachGimmickInBounds(Bounds, [](AActor* Gimmick)
+	{
+		if (AGimmick_PushBlock* Block = Cast<AGimmick_PushBlock>(Gimmick))
+		{
+			Block->Wake();
+		}
+	});
+}
+
+/// @brief 登録簿の位置を更新する関数
+void AGimmick_PushBlock::UpdateRegistryLocation() const
+{
+	if (UGimmickSubsystem* Gimmicks = GetWorld()->GetSubsystem<UGimmickSubsystem>())
+	{
+		Gimmicks->UpdateGimmickLocation(this);
+	}
+}
+
+bool AGimmick_PushBlock::CanBePushedByPlayer(const FVector& PlayerLocation)const
+{
+	//ブロックの「押せる面」の法線方向をワールド座標に変換
+	const FVector WorldPushDir = GimmickMath::GetPushDir2D(GetActorRotation().RotateVector(mPushDir));
 
-	return bCanPush;
+	//プレイヤーが押せる面の「反対側」の mPushAngle 以内にいる必要がある
+	return GimmickMath::IsInPushCone(PlayerLocation - GetActorLocation(), WorldPushDir, GimmickMath::PushConeCos(mPushAngle));
 }
 
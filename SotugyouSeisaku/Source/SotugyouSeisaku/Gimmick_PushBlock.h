@@ -4,16 +4,16 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "GimmickStateInterface.h"
+#include "GimmickTimerSubsystem.h"
 #include "Gimmick_PushBlock.generated.h"
 
 UCLASS()
-class SOTUGYOUSEISAKU_API AGimmick_PushBlock : public AActor
+class SOTUGYOUSEISAKU_API AGimmick_PushBlock : public AActor, public IGimmickStateInterface
 {
 	GENERATED_BODY()
 
-	UPROPERTY(VisibleAnywhere)
-	TObjectPtr<USceneComponent> mRoot;
-
+	//ブロックのメッシュ（物理シミュレーションするのでルートにする）
 	UPROPERTY(VisibleAnywhere)
 	TObjectPtr<UStaticMeshComponent> mMesh;
 
@@ -24,13 +24,15 @@ public:
 protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 	UPROPERTY()
 	ASotugyouSeisakuCharacter* mPushingPlayer;
 
 public:	
-	// Called every frame
-	virtual void Tick(float DeltaTime) override;
+	//IGimmickStateInterface
+	virtual EGimmickType GetGimmickType() const override { return EGimmickType::PushBlock; }
+	virtual void SerializeGimmickState(FArchive& Ar) override;
 
 	//押す処理
 	UFUNCTION()
@@ -44,12 +46,25 @@ public:
 
 	//プレイヤーを中心に回転する
 	UFUNCTION()
-	void RotateAroundPlayer(const FVector& DeltaMove, float DeltaYaw);
+	void RotateAroundPlayer(const FVector& PlayerCenter, float DeltaYaw);
+
+	//プレイヤーの1フレーム分の移動と回転に追従する（位置と回転を1回の更新で反映）
+	UFUNCTION()
+	void FollowPlayer(const FVector& DeltaMove, const FVector& PlayerCenter, float DeltaYaw);
 
 	//プレイヤーがブロックを押せる位置にいるかチェック
 	UFUNCTION()
 	bool CanBePushedByPlayer(const FVector& PlayerLocation) const;
 
+	//眠っている（止まっていて、物理シミュレーションを止めている）か
+	bool IsSleeping() const { return bIsSleeping; }
+
+	//物理シミュレーションを再開する（眠っていなければ何もしない）
+	void Wake();
+
+	//支えている床などが動く・消えるときに、その上に乗っているブロックを起こす
+	static void WakeBlocksOn(const AActor* Support);
+
 	//押す力
 	int mPushPower = 0;
 
@@ -63,4 +78,40 @@ public:
 	//押せる角度の許容範囲
 	UPROPERTY(EditAnywhere, Category = "Push Settings", meta = (ClampMin = "0.0", ClampMax = "180.0"))
 	float mPushAngle = 45.0f;
+
+	//止まってから眠らせるまでの時間（秒）　止まってすぐ動き出すブロックを何度も切り替えないようにする
+	UPROPERTY(EditAnywhere, Category = "Physics Sleep", meta = (ClampMin = "0.0"))
+	float mSleepDelay = 0.5f;
+
+	//眠っているブロックを起こす衝突の強さ（力積）　これより弱い接触では起きない
+	UPROPERTY(EditAnywhere, Category = "Physics Sleep", meta = (ClampMin = "0.0"))
+	float mWakeImpulse = 2000.0f;
+
+	//押されている間、周りの眠っているブロックを起こす半径（cm）
+	UPROPERTY(EditAnywhere, Category = "Physics Sleep", meta = (ClampMin = "0.0"))
+	float mWakeRadius = 250.0f;
+
+private:
+	//物理エンジンがブロックを止めたときに呼ばれる
+	UFUNCTION()
+	void OnBodySleep(UPrimitiveComponent* SleepingComponent, FName BoneName);
+
+	//眠っている間に何かがぶつかったときに呼ばれる
+	UFUNCTION()
+	void OnBodyHit(UPrimitiveComponent* HitComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, FVector NormalImpulse, const FHitResult& Hit);
+
+	//物理シミュレーションを止めて眠らせる
+	void Sleep();
+
+	//周りの眠っているブロックを起こす
+	void WakeNeighbours() const;
+
+	//登録簿の位置を更新する
+	void UpdateRegistryLocation() const;
+
+	//眠っているか
+	bool bIsSleeping = false;
+
+	//眠らせるまでのタイマー
+	FGimmickTimerHandle mSleepTimer;
 };
@@ -8,6 +8,8 @@ public class SotugyouSeisaku : ModuleRules
 	{
 		PCHUsage = PCHUsageMode.UseExplicitOrSharedPCHs;
 
-		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "InputCore", "EnhancedInput" });
+		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "InputCore", "EnhancedInput", "NavigationSystem", "AIModule", "NetCore", "ReplicationGraph" });
+
+		PrivateDependencyModuleNames.AddRange(new string[] { "Json" });
 	}
 }
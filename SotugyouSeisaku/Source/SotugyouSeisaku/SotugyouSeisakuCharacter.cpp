@@ -12,6 +12,9 @@
 #include "InputActionValue.h"
 #include "Kismet/GameplayStatics.h"
 #include "Gimmick_PushBlock.h"
+#include "GimmickReplaySubsystem.h"
+#include "GimmickSubsystem.h"
+#include "EngineUtils.h"
 
 DEFINE_LOG_CATEGORY(LogTemplateCharacter);
 
@@ -58,13 +61,11 @@ void ASotugyouSeisakuCharacter::BeginPlay()
 	PrevLocation = GetActorLocation();
 	PrevRotation = GetActorRotation();
 
-	//レベル内の PlayerStart を検索
-	TArray<AActor*> Starts;
-	UGameplayStatics::GetAllActorsOfClass(GetWorld(), APlayerStart::StaticClass(), Starts);
-
-	if (Starts.Num() > 0)
+	//レベル内の最初の PlayerStart を使用（見つかった時点で打ち切る）
+	for (TActorIterator<APlayerStart> It(GetWorld()); It; ++It)
 	{
-		mPlayerStart = Starts[0]; //最初の PlayerStart を使用
+		mPlayerStart = *It;
+		break;
 	}
 }
 
@@ -91,18 +92,11 @@ void ASotugyouSeisakuCharacter::Tick(float DeltaTime)
 		FVector DeltaMove = GetActorLocation() - PrevLocation;
 		DeltaMove.Z = 0.f;//高さは無視
 
-		//ブロックに移動量を渡す
-		if (!DeltaMove.IsNearlyZero(0.001f))
-		{
-			mTargetBlock->MoveWithPlayer(DeltaMove);
-		}
-
 		//プレイヤー中心での回転
 		float DeltaYaw = GetActorRotation().Yaw - PrevRotation.Yaw;
-		if (!FMath::IsNearlyZero(DeltaYaw, 0.01f))
-		{
-			mTargetBlock->RotateAroundPlayer(GetActorLocation(), DeltaYaw);
-		}
+
+		//ブロックに移動量と回転量をまとめて渡す（ブロックの更新は1回で済む）
+		mTargetBlock->FollowPlayer(DeltaMove, GetActorLocation(), DeltaYaw);
 	}
 
 	//次フレームに向けて位置を更新
@@ -143,6 +137,56 @@ void ASotugyouSeisakuCharacter::SetupPlayerInputComponent(UInputComponent* Playe
 		//ブロックを押す/終了
 		EnhancedInputComponent->BindAction(mPushAction, ETriggerEvent::Triggered, this, &ASotugyouSeisakuCharacter::StartPush);
 		EnhancedInputComponent->BindAction(mPushAction, ETriggerEvent::Completed, this, &ASotugyouSeisakuCharacter::StopPush);
+
+		//リプレイ記録用（各アクションが発火したフレームの値を記録）
+		for (int32 i = 0; i < static_cast<int32>(EGimmickReplayInput::Count); i++)
+		{
+			if (UInputAction* Action = GetReplayInputAction(static_cast<EGimmickReplayInput>(i)))
+			{
+				EnhancedInputComponent->BindAction(Action, ETriggerEvent::Triggered, this, &ASotugyouSeisakuCharacter::RecordReplayInput);
+			}
+		}
+	}
+}
+
+/// @brief リプレイで記録・注入する入力アクションを取得する
+/// @param Input 入力の種類
+/// @return 対応する入力アクション
+UInputAction* ASotugyouSeisakuCharacter::GetReplayInputAction(EGimmickReplayInput Input) const
+{
+	switch (Input)
+	{
+	case EGimmickReplayInput::Move:
+		return MoveAction;
+	case EGimmickReplayInput::Look:
+		return LookAction;
+	case EGimmickReplayInput::Jump:
+		return JumpAction;
+	case EGimmickReplayInput::Push:
+		return mPushAction;
+	default:
+		return nullptr;
+	}
+}
+
+/// @brief 入力をリプレイに記録する
+/// @param Instance 発火した入力アクションの情報
+void ASotugyouSeisakuCharacter::RecordReplayInput(const FInputActionInstance& Instance)
+{
+	UGimmickReplaySubsystem* Replay = GetWorld()->GetSubsystem<UGimmickReplaySubsystem>();
+	if (!Replay || !Replay->IsRecording())
+	{
+		return;
+	}
+
+	for (int32 i = 0; i < static_cast<int32>(EGimmickReplayInput::Count); i++)
+	{
+		const EGimmickReplayInput Input = static_cast<EGimmickReplayInput>(i);
+		if (Instance.GetSourceAction() == GetReplayInputAction(Input))
+		{
+			Replay->RecordInput(Input, Instance.GetValue());
+			break;
+		}
 	}
 }
 
@@ -181,6 +225,17 @@ void ASotugyouSeisakuCharacter::Look(const FInputActionValue& Value)
 /// @brief ギミックを検出する関数
 void ASotugyouSeisakuCharacter::CheckForGimmick()
 {
+	//近くに押せるブロックがなければレイを飛ばさない
+	//（ブロックの中心は当たった面より奥にあるので、検索半径には余裕を持たせる）
+	if (const UGimmickSubsystem* Gimmicks = GetWorld()->GetSubsystem<UGimmickSubsystem>())
+	{
+		if (!Gimmicks->FindNearestPushBlock(GetActorLocation(), mPushDistance + mPushBlockSearchMargin))
+		{
+			mTargetBlock = nullptr;
+			return;
+		}
+	}
+
 	//プレイヤーの現在位置取得
 	FVector Start = GetActorLocation();
 	//プレイヤーの前方方向にmPushDistance 分だけ進んだ位置を計算
@@ -259,6 +314,8 @@ void ASotugyouSeisakuCharacter::StopPush()
 /// @brief リスポーン関数
 void ASotugyouSeisakuCharacter::RespawnPlayer()
 {
+	mRespawnCount++;
+
 	if (mPlayerStart)
 	{
 		//位置と向きをリセット
@@ -7,6 +7,7 @@
 #include "Logging/LogMacros.h"
 #include "Gimmick_PushBlock.h"
 #include "GameFramework/PlayerStart.h"
+#include "GimmickTypes.h"
 #include "SotugyouSeisakuCharacter.generated.h"
 
 class USpringArmComponent;
@@ -14,6 +15,7 @@ class UCameraComponent;
 class UInputMappingContext;
 class UInputAction;
 struct FInputActionValue;
+struct FInputActionInstance;
 
 DECLARE_LOG_CATEGORY_EXTERN(LogTemplateCharacter, Log, All);
 
@@ -73,6 +75,9 @@ protected:
 	void StartPush();
 	UFUNCTION()
 	void StopPush();
+
+	//入力をリプレイに記録する
+	void RecordReplayInput(const FInputActionInstance& Instance);
 			
 
 protected:
@@ -90,10 +95,16 @@ public:
 	/** Returns FollowCamera subobject **/
 	FORCEINLINE class UCameraComponent* GetFollowCamera() const { return FollowCamera; }
 
+	//リプレイで記録・注入する入力アクションを取得
+	UInputAction* GetReplayInputAction(EGimmickReplayInput Input) const;
+
 	//プレイヤーを指定位置にリスポーンさせる関数
 	UFUNCTION()
 	void RespawnPlayer();
 
+	//リスポーンした回数（自動プレイボットの計測用）
+	int32 GetRespawnCount() const { return mRespawnCount; }
+
 	//押すブロック
 	UPROPERTY()
 	AGimmick_PushBlock* mTargetBlock;
@@ -109,6 +120,10 @@ public:
 	UPROPERTY(EditAnywhere,Category="Push")
 	float mPushDistance = 0.0f;
 
+	//ブロックを検出する前に登録簿で近くを探す範囲の余裕（ブロックの中心から面までの距離より大きくする）
+	UPROPERTY(EditAnywhere, Category = "Push")
+	float mPushBlockSearchMargin = 300.0f;
+
 	//リスポーンするZ座標
 	UPROPERTY(EditAnywhere, Category = "Respawn")
 	float mRespawnZ = 0.0f;
@@ -116,6 +131,9 @@ public:
 	//プレイヤーがギミックブロックを押しているかどうか
 	bool bIsPushing = false;
 
+	//リスポーンした回数
+	int32 mRespawnCount = 0;
+
 	//プレイヤーの前フレーム位置
 	FVector PrevLocation;
 	//プレイヤーの前フレーム回転値
@@ -2,14 +2,84 @@
 
 #include "SotugyouSeisakuGameMode.h"
 #include "SotugyouSeisakuCharacter.h"
-#include "UObject/ConstructorHelpers.h"
+#include "GimmickBotController.h"
+#include "GimmickSaveSubsystem.h"
+#include "Engine/AssetManager.h"
+#include "Engine/GameInstance.h"
+#include "Engine/StreamableManager.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
 
 ASotugyouSeisakuGameMode::ASotugyouSeisakuGameMode()
 {
-	// set default pawn class to our Blueprinted character
-	static ConstructorHelpers::FClassFinder<APawn> PlayerPawnBPClass(TEXT("/Game/ThirdPerson/Blueprints/BP_ThirdPersonCharacter"));
-	if (PlayerPawnBPClass.Class != NULL)
+	// set default pawn class to our Blueprinted character (loaded in InitGame, so the game mode class does not hard-reference it)
+	DefaultPawnSoftClass = TSoftClassPtr<APawn>(FSoftObjectPath(TEXT("/Game/ThirdPerson/Blueprints/BP_ThirdPersonCharacter.BP_ThirdPersonCharacter_C")));
+}
+
+void ASotugyouSeisakuGameMode::InitGame(const FString& MapName, const FString& Options, FString& ErrorMessage)
+{
+	// started with the map load and finished asynchronously; players are held back (PlayerCanRestart) until it completes
+	// only when DefaultPawnClass is still the native default, so a Blueprint game mode's pawn choice (e.g. BP_GameMode -> BP_Player) always wins
+	const ASotugyouSeisakuGameMode* NativeDefaults = GetDefault<ASotugyouSeisakuGameMode>();
+	if (!DefaultPawnSoftClass.IsNull() && DefaultPawnClass == NativeDefaults->DefaultPawnClass)
+	{
+		if (UClass* PawnClass = DefaultPawnSoftClass.Get())
+		{
+			DefaultPawnClass = PawnClass;
+		}
+		else
+		{
+			DefaultPawnClassHandle = UAssetManager::GetStreamableManager().RequestAsyncLoad(DefaultPawnSoftClass.ToSoftObjectPath(),
+				FStreamableDelegate::CreateUObject(this, &ASotugyouSeisakuGameMode::OnDefaultPawnClassLoaded), FStreamableManager::AsyncLoadHighPriority);
+		}
+	}
+
+	// -GimmickBot: the player is driven by the playthrough bot (soak and performance runs)
+	if (AGimmickBotController::IsRequested())
+	{
+		PlayerControllerClass = AGimmickBotController::StaticClass();
+	}
+
+	Super::InitGame(MapName, Options, ErrorMessage);
+}
+
+bool ASotugyouSeisakuGameMode::PlayerCanRestart_Implementation(APlayerController* Player)
+{
+	// the pawn class is still loading: OnDefaultPawnClassLoaded restarts the player instead
+	if (DefaultPawnClassHandle.IsValid() && DefaultPawnClassHandle->IsLoadingInProgress())
+	{
+		return false;
+	}
+
+	return Super::PlayerCanRestart_Implementation(Player);
+}
+
+void ASotugyouSeisakuGameMode::OnDefaultPawnClassLoaded()
+{
+	if (UClass* PawnClass = DefaultPawnSoftClass.Get())
+	{
+		DefaultPawnClass = PawnClass;
+	}
+	DefaultPawnClassHandle.Reset();
+
+	// players that logged in while the class was loading have no pawn yet
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		APlayerController* PlayerController = It->Get();
+		if (PlayerController && !PlayerController->GetPawn() && PlayerCanRestart(PlayerController))
+		{
+			RestartPlayer(PlayerController);
+		}
+	}
+}
+
+void ASotugyouSeisakuGameMode::StartPlay()
+{
+	Super::StartPlay();
+
+	// all actors have run BeginPlay: apply loaded puzzle progress before the first frame is rendered
+	if (UGimmickSaveSubsystem* GimmickSave = GetGameInstance()->GetSubsystem<UGimmickSaveSubsystem>())
 	{
-		DefaultPawnClass = PlayerPawnBPClass.Class;
+		GimmickSave->ApplyPendingState(GetWorld());
 	}
 }
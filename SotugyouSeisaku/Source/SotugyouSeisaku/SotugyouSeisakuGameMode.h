@@ -6,6 +6,8 @@
 #include "GameFramework/GameModeBase.h"
 #include "SotugyouSeisakuGameMode.generated.h"
 
+struct FStreamableHandle;
+
 UCLASS(minimalapi)
 class ASotugyouSeisakuGameMode : public AGameModeBase
 {
@@ -13,6 +15,22 @@ class ASotugyouSeisakuGameMode : public AGameModeBase
 
 public:
 	ASotugyouSeisakuGameMode();
+
+	virtual void InitGame(const FString& MapName, const FString& Options, FString& ErrorMessage) override;
+	virtual void StartPlay() override;
+	virtual bool PlayerCanRestart_Implementation(APlayerController* Player) override;
+
+	// soft reference to the player character; resolved into DefaultPawnClass while the map loads, not when this class loads
+	// ignored when a subclass (e.g. a Blueprint game mode) has set DefaultPawnClass itself
+	UPROPERTY(EditDefaultsOnly, Category = Classes)
+	TSoftClassPtr<APawn> DefaultPawnSoftClass;
+
+private:
+	// called when the async load of DefaultPawnSoftClass finishes: spawns the players that joined while it was loading
+	void OnDefaultPawnClassLoaded();
+
+	// in-flight load of DefaultPawnSoftClass (players are not spawned until it completes)
+	TSharedPtr<FStreamableHandle> DefaultPawnClassHandle;
 };
 
 